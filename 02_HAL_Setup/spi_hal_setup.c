@@ -3,210 +3,140 @@
  *
  * Demonstrates SPI peripheral HAL setup skeleton
  * Learning objectives:
- * - SPI peripheral configuration
+ * - SPI peripheral configuration through the SPI driver
  * - Master/Slave mode setup
  * - Clock polarity and phase
- * - Data frame format
+ * - Data frame format (8 or 16 bits)
+ * - Block transfers: pipelined polling and DMA
+ * - Transaction queue for several devices with their own chip selects
  */
 
 #include "../drivers/inc/stm32f446re.h"
+#include "../drivers/inc/stm32f446re_spi_driver.h"
+#include "../drivers/inc/stm32f446re_rcc_driver.h"
 #include <stdio.h>
 
-/* SPI Configuration Structure */
-typedef struct {
-    uint8_t DeviceMode;      // Master or Slave
-    uint8_t BusConfig;       // Full-duplex, Half-duplex, Simplex
-    uint8_t ClockSpeed;      // Baud rate prescaler
-    uint8_t DataSize;        // 8-bit or 16-bit
-    uint8_t CPOL;           // Clock polarity
-    uint8_t CPHA;           // Clock phase
-    uint8_t SSM;            // Software slave management
-} SPI_Config_t;
+static SPI_Handle_t spi1_handle;
+static volatile uint8_t xfer_done = 0;
 
-/* SPI Register Structure (simplified) */
-typedef struct {
-    volatile uint32_t CR1;    // Control register 1
-    volatile uint32_t CR2;    // Control register 2
-    volatile uint32_t SR;     // Status register
-    volatile uint32_t DR;     // Data register
-} SPI_RegDef_t;
+/* Queued transactions: storage for the pointers, and two devices on SPI1 */
+static SPI_Transaction_t *spi1_slots[8];
+static SPI_Device_t flash_dev;      // Mode 0, 8-bit, CS on PB6
+static SPI_Device_t imu_dev;        // Mode 3, 16-bit, CS on PC7
 
-#define SPI1_REG ((SPI_RegDef_t*)SPI1_BASEADDR)
-#define SPI2_REG ((SPI_RegDef_t*)SPI2_BASEADDR)
-
-/* SPI Mode definitions */
-#define SPI_MODE_MASTER     1
-#define SPI_MODE_SLAVE      0
-
-/* Bus config */
-#define SPI_BUS_FULL_DUPLEX     0
-#define SPI_BUS_HALF_DUPLEX     1
-#define SPI_BUS_SIMPLEX_RX      2
-
-/* Clock speed (prescaler) */
-#define SPI_SPEED_DIV2      0
-#define SPI_SPEED_DIV4      1
-#define SPI_SPEED_DIV8      2
-#define SPI_SPEED_DIV16     3
-#define SPI_SPEED_DIV32     4
-#define SPI_SPEED_DIV64     5
-#define SPI_SPEED_DIV128    6
-#define SPI_SPEED_DIV256    7
-
-void SPI_ClockEnable(void)
+void SPI_PrintSetup(void)
 {
-    printf("=== SPI Clock Configuration ===\n");
+    uint32_t cr1 = SPI1->CR1;
     
-    /* Enable SPI1 clock (APB2 bus) */
-    printf("1. Enabling SPI1 peripheral clock...\n");
-    RCC->APB2ENR |= (1 << 12);  // SPI1EN bit
-    printf("   SPI1 clock enabled (APB2)\n");
-    printf("   APB2ENR = 0x%08lX\n\n", (unsigned long)RCC->APB2ENR);
-}
-
-void SPI_GPIOSetup(void)
-{
-    printf("=== SPI GPIO Configuration ===\n");
+    printf("=== SPI Configuration (SPI_Init) ===\n");
+    
+    /* Clock: SPI1 sits on APB2 */
+    printf("1. Clocks\n");
+    printf("   APB2ENR = 0x%08lX (SPI1EN bit 12), AHB1ENR = 0x%08lX (GPIOAEN bit 0)\n",
+           (unsigned long)RCC->APB2ENR, (unsigned long)RCC->AHB1ENR);
     
     /*
-     * SPI1 Pins on STM32F446RE:
+     * SPI1 Pins on STM32F446RE (driver default):
      * PA5 - SPI1_SCK  (AF5)
      * PA6 - SPI1_MISO (AF5)
      * PA7 - SPI1_MOSI (AF5)
      * PA4 - SPI1_NSS  (AF5) - optional, can use GPIO for CS
+     * Alternate function, push-pull, very high speed, no pull
      */
-    
-    printf("1. Enabling GPIOA clock...\n");
-    RCC->AHB1ENR |= (1 << 0);
-    
-    printf("2. Configuring PA5 (SCK), PA6 (MISO), PA7 (MOSI)...\n");
-    
-    /* Set PA5, PA6, PA7 to Alternate Function mode */
-    GPIOA->MODER &= ~((0x3 << 10) | (0x3 << 12) | (0x3 << 14));
-    GPIOA->MODER |= ((0x2 << 10) | (0x2 << 12) | (0x2 << 14));
-    printf("   Mode: Alternate Function\n");
-    
-    /* Set speed to very high */
-    GPIOA->OSPEEDR &= ~((0x3 << 10) | (0x3 << 12) | (0x3 << 14));
-    GPIOA->OSPEEDR |= ((0x3 << 10) | (0x3 << 12) | (0x3 << 14));
-    printf("   Speed: Very High\n");
-    
-    /* Set output type to push-pull */
-    GPIOA->OTYPER &= ~((1 << 5) | (1 << 6) | (1 << 7));
-    printf("   Output Type: Push-Pull\n");
-    
-    /* No pull-up/down for SPI pins */
-    GPIOA->PUPDR &= ~((0x3 << 10) | (0x3 << 12) | (0x3 << 14));
-    printf("   Pull-up/down: None\n");
-    
-    /* Configure alternate function AF5 for SPI1 */
-    GPIOA->AFR[0] &= ~((0xF << 20) | (0xF << 24) | (0xF << 28));
-    GPIOA->AFR[0] |= ((0x5 << 20) | (0x5 << 24) | (0x5 << 28));
-    printf("   Alternate Function: AF5 (SPI1)\n\n");
+    printf("2. Pins: PA5 (SCK), PA6 (MISO), PA7 (MOSI), AF5\n");
+    printf("   MODER = 0x%08lX, AFR[0] = 0x%08lX\n",
+           (unsigned long)GPIOA->MODER, (unsigned long)GPIOA->AFR[0]);
+    
+    /* SCK = PCLK2 / 2^(BR+1), PCLK2 read from the RCC */
+    printf("3. Clock Speed: APB2 %lu Hz / %u = %lu Hz\n",
+           (unsigned long)RCC_GetPCLK2Value(), 2U << ((cr1 >> SPI_CR1_BR) & 0x7U),
+           (unsigned long)spi1_handle.SclkHz);
+    
+    printf("4. Device Mode: %s, %d-bit frames, CPOL=%lu, CPHA=%lu, SSM %s\n",
+           (cr1 & (1U << SPI_CR1_MSTR)) ? "Master" : "Slave",
+           (cr1 & (1U << SPI_CR1_DFF)) ? 16 : 8,
+           (unsigned long)((cr1 >> SPI_CR1_CPOL) & 1U), (unsigned long)((cr1 >> SPI_CR1_CPHA) & 1U),
+           (cr1 & (1U << SPI_CR1_SSM)) ? "Enabled" : "Disabled");
+    printf("   CR1 = 0x%08lX, CR2 = 0x%08lX\n\n", (unsigned long)cr1, (unsigned long)SPI1->CR2);
 }
 
-void SPI_Configure(SPI_Config_t *config)
+void SPI_XferCallback(SPI_Handle_t *pSPIHandle, uint8_t event)
 {
-    printf("=== SPI Configuration ===\n");
-    
-    uint32_t cr1_temp = 0;
-    
-    /* 1. Device mode (Master/Slave) */
-    printf("1. Device Mode: ");
-    if (config->DeviceMode == SPI_MODE_MASTER) {
-        printf("Master\n");
-        cr1_temp |= (1 << 2);  // MSTR bit
-    } else {
-        printf("Slave\n");
-    }
-    
-    /* 2. Bus configuration */
-    printf("2. Bus Config: ");
-    switch (config->BusConfig) {
-        case SPI_BUS_FULL_DUPLEX:
-            printf("Full-Duplex\n");
-            break;
-        case SPI_BUS_HALF_DUPLEX:
-            printf("Half-Duplex\n");
-            cr1_temp |= (1 << 15);  // BIDIMODE
-            break;
-        case SPI_BUS_SIMPLEX_RX:
-            printf("Simplex RX-only\n");
-            cr1_temp |= (1 << 10);  // RXONLY
-            break;
-    }
-    
-    /* 3. Clock speed (baud rate prescaler) */
-    printf("3. Clock Speed: DIV_%d\n", 1 << (config->ClockSpeed + 1));
-    cr1_temp |= (config->ClockSpeed << 3);  // BR[2:0]
-    
-    /* 4. Data size */
-    printf("4. Data Size: %d-bit\n", config->DataSize);
-    if (config->DataSize == 16) {
-        cr1_temp |= (1 << 11);  // DFF bit
-    }
-    
-    /* 5. Clock polarity (CPOL) */
-    printf("5. Clock Polarity (CPOL): %d\n", config->CPOL);
-    if (config->CPOL) {
-        cr1_temp |= (1 << 1);
-    }
+    (void)pSPIHandle;
     
-    /* 6. Clock phase (CPHA) */
-    printf("6. Clock Phase (CPHA): %d\n", config->CPHA);
-    if (config->CPHA) {
-        cr1_temp |= (1 << 0);
+    /* Runs in interrupt context once the last frame has been received */
+    if (event == SPI_EVENT_XFER_CMPLT) {
+        xfer_done = 1;
     }
-    
-    /* 7. Software slave management */
-    printf("7. Software Slave Management: %s\n", config->SSM ? "Enabled" : "Disabled");
-    if (config->SSM) {
-        cr1_temp |= (1 << 9);   // SSM
-        cr1_temp |= (1 << 8);   // SSI (internal slave select)
-    }
-    
-    /* Write configuration to CR1 */
-    SPI1_REG->CR1 = cr1_temp;
-    
-    printf("\n   CR1 = 0x%08lX\n\n", (unsigned long)SPI1_REG->CR1);
 }
 
-void SPI_Enable(void)
+uint8_t SPI_Setup(void)
 {
-    printf("=== Enabling SPI Peripheral ===\n");
-    
-    /* Set SPE bit in CR1 to enable SPI */
-    SPI1_REG->CR1 |= (1 << 6);
-    
-    printf("SPI1 enabled (SPE bit set)\n");
-    printf("CR1 = 0x%08lX\n\n", (unsigned long)SPI1_REG->CR1);
+    SPI_Config_t *config = &spi1_handle.SPIConfig;
+    
+    spi1_handle.pSPIx = SPI1;
+    spi1_handle.Callback = SPI_XferCallback;
+    config->SPI_DeviceMode = SPI_DEVICE_MODE_MASTER;
+    config->SPI_BusConfig = SPI_BUS_CONFIG_FD;
+    config->SPI_SclkSpeed = SPI_SCLK_SPEED_DIV8;  // APB2/8 = 84MHz/8 = 10.5 MHz
+    config->SPI_DFF = SPI_DFF_8BITS;
+    config->SPI_CPOL = SPI_CPOL_LOW;
+    config->SPI_CPHA = SPI_CPHA_LOW;
+    config->SPI_SSM = SPI_SSM_EN;  // Software slave management, CS on a GPIO
+    
+    /* Clocks, PA5/PA6/PA7 in AF5, CR1 written once, then SPE */
+    return SPI_Init(&spi1_handle);
 }
 
-void SPI_TransmitByte(uint8_t data)
+void SPI_DMAInit(void)
 {
-    /* Wait for TXE (Transmit buffer Empty) */
-    while (!(SPI1_REG->SR & (1 << 1)));
-    
-    /* Write data to DR */
-    SPI1_REG->DR = data;
+    /*
+     * SPI1 DMA requests are on DMA2, channel 3: RX on stream 0, TX on
+     * stream 3. The RX stream's transfer complete ends a block; the TX
+     * stream interrupt only reports transfer errors.
+     */
+    printf("=== SPI DMA Configuration ===\n");
+    SPI_IRQConfig(IRQ_NO_DMA2_STREAM0, 6, ENABLE);
+    SPI_IRQConfig(IRQ_NO_DMA2_STREAM3, 6, ENABLE);
+    printf("NVIC: DMA2 stream 0 (IRQ %d), stream 3 (IRQ %d) enabled\n\n",
+           IRQ_NO_DMA2_STREAM0, IRQ_NO_DMA2_STREAM3);
 }
 
-uint8_t SPI_ReceiveByte(void)
+void SPI_QueueSetup(void)
 {
-    /* Wait for RXNE (Receive buffer Not Empty) */
-    while (!(SPI1_REG->SR & (1 << 0)));
-    
-    /* Read data from DR */
-    return (uint8_t)(SPI1_REG->DR & 0xFF);
+    /*
+     * Each device keeps its own speed, frame size and mode. CR1 is only
+     * rewritten when the next queued transaction is for a device with
+     * different settings; the chip select is a GPIO pin driven low for
+     * the length of the transaction.
+     */
+    flash_dev = (SPI_Device_t){ SPI_SCLK_SPEED_DIV4, SPI_DFF_8BITS, SPI_CPOL_LOW, SPI_CPHA_LOW, GPIOB, 6 };
+    imu_dev = (SPI_Device_t){ SPI_SCLK_SPEED_DIV32, SPI_DFF_16BITS, SPI_CPOL_HIGH, SPI_CPHA_HIGH, GPIOC, 7 };
+    SPI_DeviceInit(&flash_dev);
+    SPI_DeviceInit(&imu_dev);
+    SPI_QueueInit(&spi1_handle, spi1_slots, 8);
+    
+    /* Same priority as the DMA streams: both run the queue */
+    printf("=== SPI Transaction Queue ===\n");
+    SPI_IRQConfig(IRQ_NO_SPI1, 6, ENABLE);
+    printf("NVIC: SPI1 (IRQ %d) enabled, 8 queue slots\n", IRQ_NO_SPI1);
+    printf("Devices: flash CS PB6 (mode 0, 8-bit), IMU CS PC7 (mode 3, 16-bit)\n\n");
 }
 
-uint8_t SPI_TransferByte(uint8_t data)
+/* Interrupt handlers: the driver does the work */
+void SPI1_IRQHandler(void)
 {
-    /* Transmit byte */
-    SPI_TransmitByte(data);
-    
-    /* Receive byte (in full-duplex, we always receive) */
-    return SPI_ReceiveByte();
+    SPI_IRQHandling(&spi1_handle);
+}
+
+void DMA2_Stream0_IRQHandler(void)
+{
+    SPI_DMAIRQHandling(&spi1_handle);
+}
+
+void DMA2_Stream3_IRQHandler(void)
+{
+    SPI_DMAIRQHandling(&spi1_handle);
 }
 
 void demonstrate_spi_modes(void)
@@ -258,44 +188,51 @@ int main(void)
     demonstrate_spi_modes();
     demonstrate_spi_clock_modes();
     
-    /* Step 1: Enable clocks */
-    SPI_ClockEnable();
-    
-    /* Step 2: Configure GPIO pins for SPI */
-    SPI_GPIOSetup();
+    /* Step 1: Clocks, pins, frame format, enable */
+    if (!SPI_Setup()) {
+        return 1;
+    }
+    SPI_PrintSetup();
     
-    /* Step 3: Configure SPI peripheral */
-    SPI_Config_t spi_config = {
-        .DeviceMode = SPI_MODE_MASTER,
-        .BusConfig = SPI_BUS_FULL_DUPLEX,
-        .ClockSpeed = SPI_SPEED_DIV8,  // APB2/8 = 84MHz/8 = 10.5 MHz
-        .DataSize = 8,
-        .CPOL = 0,
-        .CPHA = 0,
-        .SSM = 1  // Software slave management enabled
-    };
-    SPI_Configure(&spi_config);
+    /* Step 2: Interrupts for DMA block transfers */
+    SPI_DMAInit();
     
-    /* Step 4: Enable SPI peripheral */
-    SPI_Enable();
+    /* Step 3: Devices and the transaction queue */
+    SPI_QueueSetup();
     
     printf("=== SPI Initialization Complete ===\n\n");
     
     /* Demonstrate usage */
     printf("=== SPI Usage Example ===\n");
-    printf("Example: Transmitting 0xA5 and receiving response\n\n");
+    printf("Example: Transmitting a command block and reading the response\n\n");
     
     printf("Note: Actual transmission would occur here\n");
     printf("      Connect SPI device to SPI1 pins:\n");
     printf("      PA5 - SCK, PA6 - MISO, PA7 - MOSI\n\n");
     
+    /*
+     * Byte-at-a-time transfer (write DR, wait RXNE, read DR) leaves SCK
+     * idle between bytes while the CPU turns around. The driver writes
+     * the next frame into the TX buffer while the previous one is still
+     * shifting, so a block goes out back-to-back at the full SCK rate.
+     */
     printf("Example code:\n");
-    printf("  uint8_t tx_data = 0xA5;\n");
-    printf("  SPI_TransmitByte(tx_data);\n");
-    printf("  uint8_t rx_data = SPI_ReceiveByte();\n\n");
-    
-    printf("  // Or use transfer for full-duplex:\n");
-    printf("  uint8_t response = SPI_TransferByte(0xA5);\n\n");
+    printf("  uint8_t cmd[4] = { 0x03, 0x00, 0x10, 0x00 };\n");
+    printf("  uint8_t data[256];\n");
+    printf("  SPI_SendData(&spi1_handle, cmd, 4);            // Transmit-only, RX discarded\n");
+    printf("  SPI_ReceiveData(&spi1_handle, data, 256);      // Clocks out 0xFF dummies\n");
+    printf("  SPI_TransferData(&spi1_handle, tx, rx, len);   // Full duplex\n\n");
+    
+    printf("  // Or hand the block to DMA2 and keep working:\n");
+    printf("  SPI_TransferDMA(&spi1_handle, NULL, data, 256);\n");
+    printf("  while (!xfer_done) { /* other work */ }\n\n");
+    
+    printf("  // Or queue transactions for several devices; each asserts its CS,\n");
+    printf("  // runs from the SPI or DMA interrupt and calls Done when finished:\n");
+    printf("  static SPI_Transaction_t rd = { &flash_dev, cmd, NULL, 4, NULL, NULL, 0 };\n");
+    printf("  static SPI_Transaction_t acc = { &imu_dev, NULL, accel, 6, on_accel, NULL, 0 };\n");
+    printf("  SPI_Submit(&spi1_handle, &rd);\n");
+    printf("  SPI_Submit(&spi1_handle, &acc);                // Returns at once\n\n");
     
     printf("=== SPI Setup Example Complete ===\n");
     
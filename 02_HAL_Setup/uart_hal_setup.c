@@ -3,237 +3,174 @@
  *
  * Demonstrates UART peripheral HAL setup skeleton
  * Learning objectives:
- * - UART peripheral configuration
- * - Baud rate calculation
+ * - UART peripheral configuration through the USART driver
+ * - Baud rate calculation from the live APB clock
  * - Frame format setup
  * - Basic transmit/receive setup
+ * - Non-blocking transmit (TXE interrupt and DMA)
  */
 
 #include "../drivers/inc/stm32f446re.h"
+#include "../drivers/inc/stm32f446re_usart_driver.h"
+#include "../drivers/inc/stm32f446re_rcc_driver.h"
 #include <stdio.h>
+#include <string.h>
 
-/* UART Configuration Structure (simplified) */
-typedef struct {
-    uint32_t BaudRate;
-    uint8_t WordLength;    // 8 or 9 bits
-    uint8_t StopBits;      // 1 or 2
-    uint8_t Parity;        // None, Even, Odd
-    uint8_t Mode;          // TX, RX, or TX_RX
-} UART_Config_t;
+/* Non-blocking TX: ring buffer drained by TXE, DMA1 stream 6 for blocks */
+#define TX_BUFFER_SIZE  128   // Power of two
 
-/* UART register structure (simplified) */
-typedef struct {
-    volatile uint32_t SR;    // Status register
-    volatile uint32_t DR;    // Data register
-    volatile uint32_t BRR;   // Baud rate register
-    volatile uint32_t CR1;   // Control register 1
-    volatile uint32_t CR2;   // Control register 2
-    volatile uint32_t CR3;   // Control register 3
-} USART_RegDef_t;
+static uint8_t tx_storage[TX_BUFFER_SIZE];
+static USART_Handle_t usart2_handle;
+static volatile uint8_t tx_done = 0;
 
-#define USART2 ((USART_RegDef_t*)USART2_BASEADDR)
-
-void UART_ClockEnable(void)
+void UART_PrintSetup(void)
 {
-    printf("=== UART Clock Configuration ===\n");
+    uint32_t brr = USART2->BRR;
     
-    /* Enable USART2 clock (APB1 bus) */
-    printf("1. Enabling USART2 peripheral clock...\n");
-    RCC->APB1ENR |= (1 << 17);  // USART2EN bit
-    printf("   USART2 clock enabled\n");
-    printf("   APB1ENR = 0x%08lX\n\n", (unsigned long)RCC->APB1ENR);
-}
-
-void UART_GPIOSetup(void)
-{
-    printf("=== UART GPIO Configuration ===\n");
+    printf("=== UART Configuration (USART_Init) ===\n");
+    
+    /* Clock: USART2 sits on APB1 */
+    printf("1. Clocks\n");
+    printf("   APB1ENR = 0x%08lX (USART2EN bit 17), AHB1ENR = 0x%08lX (GPIOAEN bit 0)\n",
+           (unsigned long)RCC->APB1ENR, (unsigned long)RCC->AHB1ENR);
     
     /*
-     * USART2 Pins on STM32F446RE:
+     * USART2 Pins on STM32F446RE (driver default):
      * PA2 - USART2_TX (AF7)
      * PA3 - USART2_RX (AF7)
+     * Alternate function, push-pull, high speed, pull-up
      */
-    
-    printf("1. Enabling GPIOA clock...\n");
-    RCC->AHB1ENR |= (1 << 0);
-    
-    printf("2. Configuring PA2 (TX) and PA3 (RX)...\n");
-    
-    /* Set PA2 and PA3 to Alternate Function mode */
-    GPIOA->MODER &= ~((0x3 << 4) | (0x3 << 6));  // Clear bits
-    GPIOA->MODER |= ((0x2 << 4) | (0x2 << 6));   // AF mode (10)
-    printf("   Mode: Alternate Function\n");
-    
-    /* Set speed to high */
-    GPIOA->OSPEEDR &= ~((0x3 << 4) | (0x3 << 6));
-    GPIOA->OSPEEDR |= ((0x3 << 4) | (0x3 << 6));
-    printf("   Speed: High\n");
-    
-    /* Set output type to push-pull */
-    GPIOA->OTYPER &= ~((1 << 2) | (1 << 3));
-    printf("   Output Type: Push-Pull\n");
-    
-    /* Set pull-up for both pins */
-    GPIOA->PUPDR &= ~((0x3 << 4) | (0x3 << 6));
-    GPIOA->PUPDR |= ((0x1 << 4) | (0x1 << 6));
-    printf("   Pull-up/down: Pull-up\n");
-    
-    /* Configure alternate function AF7 for USART2 */
-    GPIOA->AFR[0] &= ~((0xF << 8) | (0xF << 12));  // Clear AFR2 and AFR3
-    GPIOA->AFR[0] |= ((0x7 << 8) | (0x7 << 12));   // AF7
-    printf("   Alternate Function: AF7 (USART2)\n\n");
-}
-
-void UART_BaudRateConfig(uint32_t baud_rate)
-{
-    printf("=== UART Baud Rate Configuration ===\n");
+    printf("2. Pins: PA2 (TX), PA3 (RX), AF7\n");
+    printf("   MODER = 0x%08lX, AFR[0] = 0x%08lX\n",
+           (unsigned long)GPIOA->MODER, (unsigned long)GPIOA->AFR[0]);
     
     /*
      * Baud rate calculation:
      * BRR = (f_PCLK) / (8 * (2 - OVER8) * baud_rate)
      * 
-     * Assuming:
-     * - APB1 clock = 42 MHz (typical after PLL config)
-     * - OVER8 = 0 (16x oversampling)
-     * - Baud rate = 115200
-     * 
-     * BRR = 42000000 / (16 * 115200) = 22.786
-     * Mantissa = 22, Fraction = 0.786 * 16 = 12.576 ≈ 13
-     * BRR = (22 << 4) | 13 = 0x016D
+     * With 16x oversampling BRR holds USARTDIV in 1/16 units, so the
+     * driver programs round(f_PCLK / baud_rate). f_PCLK is read from
+     * the RCC (RCC_GetPCLK1Value), not assumed:
+     * - 16 MHz (HSI after reset): 139 = 0x008B, -799 ppm
+     * - 42 MHz (84 MHz PLL, APB1 /2): 365 = 0x016D, -1141 ppm
      */
-    
-    printf("1. Calculating BRR value...\n");
-    uint32_t apb1_clock = 42000000;  // Assuming 42 MHz
-    uint32_t usartdiv = apb1_clock / (16 * baud_rate);
-    uint32_t fraction = ((apb1_clock % (16 * baud_rate)) * 16) / (16 * baud_rate);
-    
-    uint32_t brr_value = (usartdiv << 4) | (fraction & 0xF);
-    
-    printf("   APB1 Clock: %lu Hz\n", (unsigned long)apb1_clock);
-    printf("   Baud Rate: %lu\n", (unsigned long)baud_rate);
-    printf("   Mantissa: %lu\n", (unsigned long)usartdiv);
-    printf("   Fraction: %lu\n", (unsigned long)fraction);
-    printf("   BRR Value: 0x%04lX\n\n", (unsigned long)brr_value);
-    
-    USART2->BRR = brr_value;
+    printf("3. Baud rate\n");
+    printf("   APB1 Clock: %lu Hz\n", (unsigned long)RCC_GetPCLK1Value());
+    printf("   Mantissa: %lu, Fraction: %lu\n", (unsigned long)(brr >> 4), (unsigned long)(brr & 0xF));
+    printf("   BRR Value: 0x%04lX\n", (unsigned long)brr);
+    printf("   Actual: %lu baud (%ld ppm)\n",
+           (unsigned long)usart2_handle.BaudActual, (long)usart2_handle.BaudErrorPpm);
+    
+    /* Frame format: 8N1, TE + RE + UE */
+    printf("4. Frame\n");
+    printf("   CR1 = 0x%08lX\n", (unsigned long)USART2->CR1);
+    printf("   CR2 = 0x%08lX\n\n", (unsigned long)USART2->CR2);
 }
 
-void UART_FrameConfig(UART_Config_t *config)
+void UART_TxCallback(USART_Handle_t *pUSARTHandle, uint8_t event)
 {
-    printf("=== UART Frame Configuration ===\n");
-    
-    uint32_t cr1_temp = 0;
-    
-    /* Word length */
-    printf("1. Word Length: %d bits\n", config->WordLength);
-    if (config->WordLength == 9) {
-        cr1_temp |= (1 << 12);  // M bit
-    }
+    (void)pUSARTHandle;
     
-    /* Parity */
-    printf("2. Parity: ");
-    switch (config->Parity) {
-        case 0:
-            printf("None\n");
-            break;
-        case 1:
-            printf("Even\n");
-            cr1_temp |= (1 << 10);  // PCE bit
-            break;
-        case 2:
-            printf("Odd\n");
-            cr1_temp |= (1 << 10) | (1 << 9);  // PCE + PS
-            break;
+    /* Runs in interrupt context once the last stop bit has been sent */
+    if (event == USART_EVENT_TX_CMPLT) {
+        tx_done = 1;
     }
+}
+
+uint8_t UART_Setup(uint32_t baud_rate)
+{
+    USART_Config_t *config = &usart2_handle.USART_Config;
     
-    /* Enable TX and RX */
-    printf("3. Mode: ");
-    if (config->Mode & 0x1) {
-        printf("TX ");
-        cr1_temp |= (1 << 3);  // TE bit
-    }
-    if (config->Mode & 0x2) {
-        printf("RX ");
-        cr1_temp |= (1 << 2);  // RE bit
-    }
-    printf("\n");
-    
-    /* Apply CR1 configuration */
-    USART2->CR1 = cr1_temp;
-    
-    /* Stop bits (CR2) */
-    printf("4. Stop Bits: %d\n", config->StopBits);
-    uint32_t cr2_temp = 0;
-    if (config->StopBits == 2) {
-        cr2_temp |= (0x2 << 12);  // STOP[1:0] = 10
+    /*
+     * Busy-waiting on TXE costs ~87 us of CPU per byte at 115200 baud.
+     * Instead (USART_XFER_DMA):
+     * - USART_Send copies short blocks into a ring buffer; the TXE
+     *   interrupt moves one byte per interrupt to DR, TC signals the end
+     * - Blocks of USART_DMA_MIN_LEN bytes or more go to DMA1 stream 6
+     *   (channel 4 = USART2_TX): two interrupts per block, whatever its length
+     * Reception stays polled here (UART_ReceiveChar).
+     */
+    usart2_handle.pUSARTx = USART2;
+    usart2_handle.Callback = UART_TxCallback;
+    config->USART_Mode = USART_MODE_TXRX;
+    config->USART_Baud = baud_rate;
+    config->USART_NoOfStopBits = USART_STOPBITS_1;
+    config->USART_WordLength = USART_WORDLEN_8BITS;
+    config->USART_ParityControl = USART_PARITY_DISABLE;
+    config->USART_HWFlowControl = USART_HW_FLOW_CTRL_NONE;
+    config->USART_Oversampling = USART_OVERSAMPLING_AUTO;
+    config->USART_TxMode = USART_XFER_DMA;
+    config->USART_RxMode = USART_XFER_POLL;
+    config->pTxStorage = tx_storage;
+    config->TxStorageSize = TX_BUFFER_SIZE;
+    
+    /* Clocks, PA2/PA3 in AF7, BRR from the live APB1 clock, 8N1, UE */
+    if (!USART_Init(&usart2_handle)) {
+        printf("USART_Init failed: baud rate out of reach of the APB1 clock\n");
+        return 0;
     }
-    USART2->CR2 = cr2_temp;
-    
-    printf("\n   CR1 = 0x%08lX\n", (unsigned long)USART2->CR1);
-    printf("   CR2 = 0x%08lX\n\n", (unsigned long)USART2->CR2);
+    return 1;
 }
 
-void UART_Enable(void)
+void UART_TxEngineInit(void)
 {
-    printf("=== Enabling UART Peripheral ===\n");
-    
-    /* Set UE bit in CR1 to enable USART */
-    USART2->CR1 |= (1 << 13);
-    
-    printf("USART2 enabled (UE bit set)\n");
-    printf("CR1 = 0x%08lX\n\n", (unsigned long)USART2->CR1);
+    printf("=== Non-blocking TX Configuration ===\n");
+    printf("1. TX ring buffer: %d bytes, DMA for blocks of %u+ bytes\n",
+           TX_BUFFER_SIZE, USART_DMA_MIN_LEN);
+    
+    USART_IRQConfig(IRQ_NO_USART2, 5, ENABLE);
+    USART_IRQConfig(IRQ_NO_DMA1_STREAM6, 6, ENABLE);
+    printf("2. NVIC: USART2 (IRQ %d), DMA1 stream 6 (IRQ %d) enabled\n\n",
+           IRQ_NO_USART2, IRQ_NO_DMA1_STREAM6);
 }
 
-void UART_TransmitChar(char data)
+/* Queue one byte; returns 0 if the TX buffer is full */
+uint8_t UART_TransmitChar(char data)
 {
-    /* Wait for TXE (Transmit Data Register Empty) */
-    while (!(USART2->SR & (1 << 7)));
+    uint8_t byte = (uint8_t)data;
     
-    /* Write data to DR */
-    USART2->DR = data;
+    return (uint8_t)USART_Send(&usart2_handle, &byte, 1);
 }
 
-void UART_TransmitString(const char *str)
+/* Queue a string; returns the number of bytes accepted. Long strings go
+ * out by DMA in place, so str must stay valid until tx_done */
+uint32_t UART_TransmitString(const char *str)
 {
-    while (*str) {
-        UART_TransmitChar(*str++);
-    }
+    return USART_Send(&usart2_handle, (const uint8_t *)str, strlen(str));
+}
+
+/* Interrupt handlers: the driver does the TX work */
+void USART2_IRQHandler(void)
+{
+    USART_IRQHandling(&usart2_handle);
+}
+
+void DMA1_Stream6_IRQHandler(void)
+{
+    USART_TxDMAIRQHandling(&usart2_handle);
 }
 
 char UART_ReceiveChar(void)
 {
-    /* Wait for RXNE (Read Data Register Not Empty) */
-    while (!(USART2->SR & (1 << 5)));
+    uint8_t c;
     
-    /* Read data from DR */
-    return (char)(USART2->DR & 0xFF);
+    /* Waits for RXNE (Read Data Register Not Empty), then reads DR */
+    USART_Receive(&usart2_handle, &c, 1);
+    return (char)c;
 }
 
 int main(void)
 {
     printf("=== UART HAL Setup Example ===\n\n");
     
-    /* Step 1: Enable clocks */
-    UART_ClockEnable();
-    
-    /* Step 2: Configure GPIO pins for UART */
-    UART_GPIOSetup();
-    
-    /* Step 3: Configure baud rate */
-    UART_BaudRateConfig(115200);
-    
-    /* Step 4: Configure frame format */
-    UART_Config_t uart_config = {
-        .BaudRate = 115200,
-        .WordLength = 8,
-        .StopBits = 1,
-        .Parity = 0,  // None
-        .Mode = 0x3   // TX and RX
-    };
-    UART_FrameConfig(&uart_config);
+    /* Step 1: Clocks, pins, baud rate, frame format, transfer modes */
+    if (!UART_Setup(115200)) {
+        return 1;
+    }
+    UART_PrintSetup();
     
-    /* Step 5: Enable UART peripheral */
-    UART_Enable();
+    /* Step 2: Interrupts for the IT/DMA transmit engine */
+    UART_TxEngineInit();
     
     printf("=== UART Initialization Complete ===\n\n");
     
@@ -247,7 +184,9 @@ int main(void)
     
     /* Pseudo-code for actual transmission */
     printf("Example code:\n");
-    printf("  UART_TransmitString(\"Hello UART!\\n\");\n");
+    printf("  UART_TransmitString(\"Hello UART!\\n\");  // Queued, returns at once\n");
+    printf("  USART_Send(&usart2_handle, block, len);   // 16+ bytes: zero-copy DMA, block untouched until callback\n");
+    printf("  while (!tx_done) { /* other work */ }\n");
     printf("  char received = UART_ReceiveChar();\n\n");
     
     printf("=== UART Setup Example Complete ===\n");
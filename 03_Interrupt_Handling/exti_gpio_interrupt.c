@@ -12,28 +12,7 @@
 #include "../drivers/inc/stm32f446re.h"
 #include <stdio.h>
 
-/* EXTI Register Structure */
-typedef struct {
-    volatile uint32_t IMR;    // Interrupt mask register
-    volatile uint32_t EMR;    // Event mask register
-    volatile uint32_t RTSR;   // Rising trigger selection
-    volatile uint32_t FTSR;   // Falling trigger selection
-    volatile uint32_t SWIER;  // Software interrupt event
-    volatile uint32_t PR;     // Pending register
-} EXTI_RegDef_t;
-
-#define EXTI ((EXTI_RegDef_t*)EXT1_BASEADDR)
-
-/* SYSCFG Register Structure (for EXTI config) */
-typedef struct {
-    volatile uint32_t MEMRMP;
-    volatile uint32_t PMC;
-    volatile uint32_t EXTICR[4];  // External interrupt configuration
-    uint32_t RESERVED[2];
-    volatile uint32_t CMPCR;
-} SYSCFG_RegDef_t;
-
-#define SYSCFG ((SYSCFG_RegDef_t*)SYSCFC_BASEADDR)
+/* EXTI_RegDef_t/EXTI and SYSCFG_RegDef_t/SYSCFG come from stm32f446re.h */
 
 /* NVIC registers */
 #define NVIC_ISER0      ((volatile uint32_t*)0xE000E100)
@@ -3,59 +3,30 @@
  *
  * Demonstrates Timer interrupt configuration and usage
  * Learning objectives:
- * - Timer peripheral initialization
+ * - Timer peripheral initialization through the timer driver
  * - Update interrupt configuration
- * - Prescaler and period calculation
+ * - Prescaler and period calculation from the live clock tree
  * - Creating periodic interrupts
+ * - One-pulse, output compare and input capture
+ * - Many software timers on one compare channel (tickless)
  */
 
 #include "../drivers/inc/stm32f446re.h"
+#include "../drivers/inc/stm32f446re_timer_driver.h"
+#include "../drivers/inc/stm32f446re_rcc_driver.h"
 #include <stdio.h>
 
-/* Timer Register Structure (TIM2-TIM5) */
-typedef struct {
-    volatile uint32_t CR1;     // Control register 1
-    volatile uint32_t CR2;     // Control register 2
-    volatile uint32_t SMCR;    // Slave mode control
-    volatile uint32_t DIER;    // DMA/Interrupt enable
-    volatile uint32_t SR;      // Status register
-    volatile uint32_t EGR;     // Event generation
-    volatile uint32_t CCMR1;   // Capture/compare mode 1
-    volatile uint32_t CCMR2;   // Capture/compare mode 2
-    volatile uint32_t CCER;    // Capture/compare enable
-    volatile uint32_t CNT;     // Counter
-    volatile uint32_t PSC;     // Prescaler
-    volatile uint32_t ARR;     // Auto-reload register
-    uint32_t RESERVED1;
-    volatile uint32_t CCR1;    // Capture/compare 1
-    volatile uint32_t CCR2;    // Capture/compare 2
-    volatile uint32_t CCR3;    // Capture/compare 3
-    volatile uint32_t CCR4;    // Capture/compare 4
-    uint32_t RESERVED2;
-    volatile uint32_t DCR;     // DMA control
-    volatile uint32_t DMAR;    // DMA address
-    volatile uint32_t OR;      // Option register
-} TIM_RegDef_t;
-
-#define TIM2 ((TIM_RegDef_t*)0x40000000)
-#define TIM3 ((TIM_RegDef_t*)0x40000400)
-#define TIM4 ((TIM_RegDef_t*)0x40000800)
-#define TIM5 ((TIM_RegDef_t*)0x40000C00)
-
-/* NVIC registers */
-#define NVIC_ISER0      ((volatile uint32_t*)0xE000E100)
-#define NVIC_IPR        ((volatile uint32_t*)0xE000E400)
-
-/* IRQ numbers */
-#define IRQ_TIM2        28
-#define IRQ_TIM3        29
-#define IRQ_TIM4        30
-#define IRQ_TIM5        50
-
 /* Global timer variables */
 volatile uint32_t timer_tick_count = 0;
 volatile uint32_t milliseconds = 0;
 
+static TIM_Handle_t htim2;      // Periodic update interrupt
+static TIM_Handle_t htim3;      // One-pulse
+static TIM_Handle_t htim5;      // Free-running: input capture and software timers
+
+static TIM_SoftTimer_t led_timer;
+static TIM_SoftTimer_t timeout_timer;
+
 void demonstrate_timer_architecture(void)
 {
     printf("=== Timer Architecture ===\n\n");
@@ -70,7 +41,8 @@ void demonstrate_timer_architecture(void)
     printf("   - Up, down, or up/down counting\n");
     printf("   - 4 capture/compare channels\n");
     printf("   - PWM generation\n");
-    printf("   - Input capture\n\n");
+    printf("   - Input capture\n");
+    printf("   - TIM2/TIM5 32-bit, TIM3/TIM4 16-bit (this driver: TIM2-TIM5)\n\n");
     
     printf("3. Advanced Timers (TIM1, TIM8)\n");
     printf("   - All general-purpose features\n");
@@ -79,92 +51,51 @@ void demonstrate_timer_architecture(void)
     printf("   - Break input\n\n");
     
     printf("Timer Frequency Calculation:\n");
-    printf("Timer_Freq = APB_Clock / (Prescaler + 1)\n");
+    printf("TIMxCLK = PCLK1, or 2 x PCLK1 when the APB1 prescaler is not 1\n");
+    printf("Timer_Freq = TIMxCLK / (Prescaler + 1)\n");
     printf("Update_Freq = Timer_Freq / (Period + 1)\n\n");
 }
 
-void TIM2_ClockEnable(void)
+void tim_on_event(TIM_Handle_t *pTIMHandle, uint8_t Event)
 {
-    printf("=== Enabling TIM2 Clock ===\n");
-    
-    /* TIM2 is on APB1 bus */
-    printf("1. TIM2 is on APB1 bus\n");
-    printf("2. Enabling TIM2 clock in RCC->APB1ENR...\n");
-    
-    RCC->APB1ENR |= (1 << 0);  // TIM2EN bit
+    (void)pTIMHandle;
     
-    printf("   RCC->APB1ENR = 0x%08lX\n", (unsigned long)RCC->APB1ENR);
-    printf("   TIM2 clock enabled\n\n");
+    if (Event == TIM_EVENT_UPDATE)
+    {
+        timer_tick_count++;
+        milliseconds++;  // If 1ms timer
+    }
 }
 
-void TIM2_BasicConfig(uint16_t prescaler, uint32_t period)
+void TIM_PrintSetup(TIM_Handle_t *pTIMHandle)
 {
-    printf("=== Configuring TIM2 ===\n");
-    
-    printf("1. Setting prescaler to %d...\n", prescaler);
-    TIM2->PSC = prescaler;
-    printf("   TIM2->PSC = %d\n", TIM2->PSC);
-    
-    printf("2. Setting auto-reload value to %lu...\n", (unsigned long)period);
-    TIM2->ARR = period;
-    printf("   TIM2->ARR = %lu\n\n", (unsigned long)TIM2->ARR);
-    
-    /* Calculate resulting frequency */
-    uint32_t apb1_clock = 42000000;  // Assuming 42 MHz
-    float timer_freq = (float)apb1_clock / (prescaler + 1);
-    float update_freq = timer_freq / (period + 1);
-    
-    printf("Frequency Calculation:\n");
-    printf("   APB1 Clock: %lu Hz\n", (unsigned long)apb1_clock);
-    printf("   Timer Frequency: %.2f Hz\n", timer_freq);
-    printf("   Update Frequency: %.2f Hz\n", update_freq);
-    printf("   Update Period: %.3f ms\n\n", 1000.0f / update_freq);
-}
-
-void TIM2_InterruptConfig(void)
-{
-    printf("=== Configuring TIM2 Interrupt ===\n");
-    
-    /* Enable update interrupt */
-    printf("1. Enabling update interrupt (UIE bit)...\n");
-    TIM2->DIER |= (1 << 0);  // UIE - Update interrupt enable
-    printf("   TIM2->DIER = 0x%08lX\n\n", (unsigned long)TIM2->DIER);
-    
-    /* Configure NVIC */
-    printf("2. Configuring NVIC for TIM2 (IRQ %d)...\n", IRQ_TIM2);
-    
-    /* Enable interrupt */
-    *NVIC_ISER0 |= (1 << IRQ_TIM2);
-    printf("   Interrupt enabled in NVIC\n");
-    
-    /* Set priority */
-    uint8_t priority = 6;
-    uint8_t shift = (IRQ_TIM2 % 4) * 8 + 4;
-    volatile uint32_t *ipr = NVIC_IPR + (IRQ_TIM2 / 4);
-    *ipr &= ~(0xF << shift);
-    *ipr |= (priority << shift);
-    printf("   Priority set to %d\n\n", priority);
-}
-
-void TIM2_Start(void)
-{
-    printf("=== Starting TIM2 ===\n");
-    
-    /* Enable counter */
-    printf("1. Enabling counter (CEN bit)...\n");
-    TIM2->CR1 |= (1 << 0);  // CEN - Counter enable
-    
-    printf("   TIM2->CR1 = 0x%08lX\n", (unsigned long)TIM2->CR1);
-    printf("   Timer started!\n\n");
+    TIM_RegDef_t *pTIMx = pTIMHandle->pTIMx;
+    uint32_t tick_hz = pTIMHandle->ClockHz / pTIMHandle->Prescaler;
+    
+    printf("   TIMxCLK: %lu Hz (PCLK1 %lu Hz)\n", (unsigned long)pTIMHandle->ClockHz,
+           (unsigned long)RCC_GetPCLK1Value());
+    printf("   PSC = %lu, ARR = %lu\n", (unsigned long)pTIMx->PSC, (unsigned long)pTIMx->ARR);
+    printf("   Timer Frequency: %lu Hz\n", (unsigned long)tick_hz);
+    printf("   Update Period: %.3f ms\n\n", 1000.0 * ((double)pTIMHandle->AutoReload + 1.0) / tick_hz);
 }
 
-void TIM2_Stop(void)
+uint8_t TIM2_PeriodicConfig(uint32_t period_us)
 {
-    printf("=== Stopping TIM2 ===\n");
-    
-    /* Disable counter */
-    TIM2->CR1 &= ~(1 << 0);
-    printf("   Timer stopped\n\n");
+    htim2.pTIMx = TIM2;
+    htim2.Callback = tim_on_event;
+    htim2.TIMConfig.TIM_PeriodUs = period_us;
+    htim2.TIMConfig.TIM_TickHz = 0;              // Finest resolution that fits
+    htim2.TIMConfig.TIM_OnePulse = TIM_ONE_PULSE_DI;
+    htim2.TIMConfig.TIM_UpdateIT = ENABLE;
+    
+    if (!TIM_Init(&htim2))
+    {
+        printf("   Period %lu us does not fit TIM2\n\n", (unsigned long)period_us);
+        return 0;
+    }
+    TIM_PrintSetup(&htim2);
+    TIM_IRQConfig(IRQ_NO_TIM2, 6, ENABLE);
+    return 1;
 }
 
 void example_1ms_timer(void)
@@ -172,25 +103,13 @@ void example_1ms_timer(void)
     printf("=== Example: 1ms Periodic Timer ===\n\n");
     
     /*
-     * Goal: Generate interrupt every 1ms
-     * APB1 clock: 42 MHz
-     * 
-     * For 1ms (1000 Hz):
-     * Timer_Freq = 42,000,000 / (41 + 1) = 1,000,000 Hz
-     * Update_Freq = 1,000,000 / (999 + 1) = 1,000 Hz = 1ms
+     * TIM_Init picks PSC/ARR from the period and TIMxCLK:
+     * on HSI (16 MHz) PSC = 0, ARR = 15999; with APB1 at 42 MHz the
+     * timer clock is doubled to 84 MHz and ARR = 83999.
+     * Nothing assumes a fixed APB1 frequency.
      */
-    
-    printf("Target: 1ms interrupt period\n");
-    printf("APB1 Clock: 42 MHz\n\n");
-    
-    printf("Calculation:\n");
-    printf("Prescaler: 42 - 1 = 41\n");
-    printf("Period: 1000 - 1 = 999\n");
-    printf("Result: 42MHz / 42 / 1000 = 1kHz = 1ms\n\n");
-    
-    TIM2_ClockEnable();
-    TIM2_BasicConfig(41, 999);
-    TIM2_InterruptConfig();
+    TIM2_PeriodicConfig(1000);
+    TIM_Start(&htim2);
     
     printf("1ms timer configured. ISR will be called every 1ms.\n\n");
 }
@@ -199,24 +118,7 @@ void example_100us_timer(void)
 {
     printf("=== Example: 100us Periodic Timer ===\n\n");
     
-    /*
-     * Goal: Generate interrupt every 100us (10 kHz)
-     * APB1 clock: 42 MHz
-     * 
-     * Timer_Freq = 42,000,000 / (4 + 1) = 8,400,000 Hz
-     * Update_Freq = 8,400,000 / (839 + 1) = 10,000 Hz = 100us
-     */
-    
-    printf("Target: 100us interrupt period\n\n");
-    
-    printf("Calculation:\n");
-    printf("Prescaler: 4\n");
-    printf("Period: 839\n");
-    printf("Result: 42MHz / 5 / 840 = 10kHz = 100us\n\n");
-    
-    TIM2_ClockEnable();
-    TIM2_BasicConfig(4, 839);
-    TIM2_InterruptConfig();
+    TIM2_PeriodicConfig(100);
     
     printf("100us timer configured.\n\n");
 }
@@ -226,27 +128,32 @@ void example_1second_timer(void)
     printf("=== Example: 1 Second Timer ===\n\n");
     
     /*
-     * Goal: Generate interrupt every 1 second (1 Hz)
-     * APB1 clock: 42 MHz
-     * 
-     * Timer_Freq = 42,000,000 / (41999 + 1) = 1,000 Hz
-     * Update_Freq = 1,000 / (999 + 1) = 1 Hz = 1 second
+     * TIM2 is 32-bit: 1 s at 16 MHz fits without a prescaler (ARR = 15999999).
+     * On a 16-bit timer (TIM3) the driver would pick PSC = 249, ARR = 63999,
+     * the first prescaler within 1/16 above the minimum (245) that divides
+     * the period exactly.
      */
-    
-    printf("Target: 1 second interrupt period\n\n");
-    
-    printf("Calculation:\n");
-    printf("Prescaler: 41999\n");
-    printf("Period: 999\n");
-    printf("Result: 42MHz / 42000 / 1000 = 1Hz = 1s\n\n");
-    
-    TIM2_ClockEnable();
-    TIM2_BasicConfig(41999, 999);
-    TIM2_InterruptConfig();
+    TIM2_PeriodicConfig(1000000);
     
     printf("1 second timer configured.\n\n");
 }
 
+/* Vector table entries */
+void TIM2_IRQHandler(void)
+{
+    TIM_IRQHandling(&htim2);
+}
+
+void TIM3_IRQHandler(void)
+{
+    TIM_IRQHandling(&htim3);
+}
+
+void TIM5_IRQHandler(void)
+{
+    TIM_IRQHandling(&htim5);
+}
+
 void demonstrate_isr_implementation(void)
 {
     printf("=== Timer ISR Implementation ===\n\n");
@@ -255,25 +162,20 @@ void demonstrate_isr_implementation(void)
     
     printf("void TIM2_IRQHandler(void)\n");
     printf("{\n");
-    printf("    // Check update interrupt flag\n");
-    printf("    if (TIM2->SR & (1 << 0)) {\n");
-    printf("        // Clear update interrupt flag (MUST DO!)\n");
-    printf("        TIM2->SR &= ~(1 << 0);\n");
-    printf("        \n");
-    printf("        // Handle timer tick\n");
+    printf("    TIM_IRQHandling(&htim2);   // Clears UIF, calls htim2.Callback\n");
+    printf("}\n\n");
+    
+    printf("void tim_on_event(TIM_Handle_t *pTIMHandle, uint8_t Event)\n");
+    printf("{\n");
+    printf("    if (Event == TIM_EVENT_UPDATE) {\n");
     printf("        timer_tick_count++;\n");
     printf("        milliseconds++;  // If 1ms timer\n");
-    printf("        \n");
-    printf("        // Toggle LED every 500ms\n");
-    printf("        if (milliseconds %% 500 == 0) {\n");
-    printf("            GPIO_ToggleOutputPin(GPIOA, GPIO_PIN_NO_5);\n");
-    printf("        }\n");
     printf("    }\n");
     printf("}\n\n");
     
     printf("Important Notes:\n");
-    printf("1. Always check SR register flags\n");
-    printf("2. Clear interrupt flag by writing 0\n");
+    printf("1. The driver only handles flags whose interrupt is enabled\n");
+    printf("2. Flags are cleared by writing 0 (SR = ~flag), never read-modify-write\n");
     printf("3. Keep ISR execution short\n");
     printf("4. Avoid blocking operations in ISR\n\n");
 }
@@ -282,7 +184,7 @@ void demonstrate_timer_modes(void)
 {
     printf("=== Timer Counting Modes ===\n\n");
     
-    printf("1. Up-counting Mode (default)\n");
+    printf("1. Up-counting Mode (default, used by the driver)\n");
     printf("   - Counts from 0 to ARR\n");
     printf("   - Update event on overflow\n");
     printf("   - CR1.DIR = 0\n\n");
@@ -298,7 +200,7 @@ void demonstrate_timer_modes(void)
     printf("   - CR1.CMS = 01, 10, or 11\n\n");
     
     printf("Example: Down-counting mode\n");
-    printf("TIM2->CR1 |= (1 << 4);  // Set DIR bit\n\n");
+    printf("TIM2->CR1 |= (1 << TIM_CR1_DIR);  // Set DIR bit\n\n");
 }
 
 void demonstrate_one_pulse_mode(void)
@@ -307,12 +209,92 @@ void demonstrate_one_pulse_mode(void)
     
     printf("One-pulse mode generates single pulse:\n");
     printf("- Counter stops after update event\n");
-    printf("- Useful for delays and timeouts\n\n");
+    printf("- Useful for delays and timeouts\n");
+    printf("- With PWM2 on a channel: pulse from CCR to ARR on the pin\n\n");
+    
+    /* 1 ms period, pulse on TIM3_CH1 from 250 us to 1 ms */
+    htim3.pTIMx = TIM3;
+    htim3.Callback = tim_on_event;
+    htim3.TIMConfig.TIM_PeriodUs = 1000;
+    htim3.TIMConfig.TIM_TickHz = 0;
+    htim3.TIMConfig.TIM_OnePulse = TIM_ONE_PULSE_EN;
+    htim3.TIMConfig.TIM_UpdateIT = DISABLE;
+    
+    if (TIM_Init(&htim3))
+    {
+        TIM_OCConfig(&htim3, TIM_CHANNEL_1, TIM_OC_MODE_PWM2, TIM_UsToTicks(&htim3, 250));
+        TIM_PrintSetup(&htim3);
+        printf("   CR1 = 0x%08lX (OPM), CCMR1 = 0x%08lX (OC1M PWM2), CCR1 = %lu\n",
+               (unsigned long)TIM3->CR1, (unsigned long)TIM3->CCMR1, (unsigned long)TIM3->CCR[0]);
+        printf("   TIM_Start(&htim3) fires one pulse; CEN clears itself at the update\n\n");
+    }
+}
+
+void demonstrate_input_capture(void)
+{
+    printf("=== Input Capture ===\n\n");
+    
+    /* TIM5 free-running at 1 MHz: captures are in microseconds */
+    htim5.pTIMx = TIM5;
+    htim5.Callback = tim_on_event;
+    htim5.TIMConfig.TIM_PeriodUs = 0;
+    htim5.TIMConfig.TIM_TickHz = 1000000;
+    htim5.TIMConfig.TIM_OnePulse = TIM_ONE_PULSE_DI;
+    htim5.TIMConfig.TIM_UpdateIT = DISABLE;
+    TIM_Init(&htim5);
+    
+    /* Both edges of TIM5_CH2 (PA1, AF2), filter 3 against contact bounce */
+    TIM_ICConfig(&htim5, TIM_CHANNEL_2, TIM_IC_EDGE_BOTH, 3);
+    TIM_ChannelITConfig(&htim5, TIM_CHANNEL_2, ENABLE);
+    
+    printf("   CCMR1 = 0x%08lX (CC2S = TI2, IC2F = 3)\n", (unsigned long)TIM5->CCMR1);
+    printf("   CCER  = 0x%08lX (CC2E, CC2P, CC2NP: both edges)\n", (unsigned long)TIM5->CCER);
+    printf("   Each edge: htim5.Capture[1] = CCR2, then TIM_EVENT_CC2;\n");
+    printf("   pulse width = difference of two captures (modulo 2^32)\n\n");
+}
+
+void led_timer_expired(TIM_SoftTimer_t *pTimer)
+{
+    (void)pTimer;
+    /* GPIO_ToggleOutputPin(GPIOA, GPIO_PIN_NO_5); */
+}
+
+void timeout_expired(TIM_SoftTimer_t *pTimer)
+{
+    *(volatile uint8_t *)pTimer->pContext = 1;
+}
+
+void demonstrate_software_timers(void)
+{
+    static volatile uint8_t timed_out = 0;
+    
+    printf("=== Software Timers on One Compare Channel ===\n\n");
     
-    printf("Configuration:\n");
-    printf("TIM2->CR1 |= (1 << 3);  // OPM bit\n");
-    printf("TIM2->CR1 |= (1 << 0);  // Start counter\n");
-    printf("// Timer stops automatically after period\n\n");
+    printf("A 1 ms tick interrupt runs 1000 times a second whether or not\n");
+    printf("anything is due. The software timer service keeps its timers sorted\n");
+    printf("by deadline and loads only the earliest into CCR4 of the free-running\n");
+    printf("TIM5: the interrupt fires once per expiry, and the core can sleep\n");
+    printf("until then.\n\n");
+    
+    TIM_SoftTimerInit(&htim5, TIM_CHANNEL_4);
+    TIM_IRQConfig(IRQ_NO_TIM5, 5, ENABLE);
+    TIM_Start(&htim5);
+    
+    led_timer.Fn = led_timer_expired;
+    TIM_SoftTimerStart(&htim5, &led_timer, TIM_UsToTicks(&htim5, 500000), TIM_UsToTicks(&htim5, 500000));
+    
+    timeout_timer.Fn = timeout_expired;
+    timeout_timer.pContext = (void *)&timed_out;
+    TIM_SoftTimerStart(&htim5, &timeout_timer, TIM_UsToTicks(&htim5, 20000), 0);
+    
+    printf("   LED every 500 ms (periodic), 20 ms communication timeout (one-shot)\n");
+    printf("   CCR4 = %lu (earliest deadline), next expiry in %lu ticks\n",
+           (unsigned long)TIM5->CCR[3], (unsigned long)TIM_SoftTimerNextTicks(&htim5));
+    printf("   Longest delay: %lu ticks (a quarter of the counter range)\n\n",
+           (unsigned long)TIM_SoftTimerMaxTicks(&htim5));
+    
+    /* Response arrived in time: the timeout never fires */
+    TIM_SoftTimerStop(&htim5, &timeout_timer);
 }
 
 int main(void)
@@ -333,14 +315,18 @@ int main(void)
     
     demonstrate_one_pulse_mode();
     
+    demonstrate_input_capture();
+    
+    demonstrate_software_timers();
+    
     printf("=== Key Points Summary ===\n");
-    printf("1. Enable timer clock in RCC\n");
-    printf("2. Configure prescaler and period (ARR)\n");
+    printf("1. Enable timer clock in RCC (TIM_Init does it)\n");
+    printf("2. Derive prescaler and period (ARR) from the actual TIMxCLK\n");
     printf("3. Enable update interrupt in DIER\n");
     printf("4. Configure and enable NVIC\n");
     printf("5. Start timer by setting CEN bit\n");
     printf("6. Clear SR flag in ISR\n");
-    printf("7. Choose appropriate prescaler/period for target frequency\n");
+    printf("7. Many deadlines: one compare channel, interrupt only when one is due\n");
     
     printf("\n=== Example Complete ===\n");
     
@@ -7,9 +7,12 @@
  * - Cycle counting basics
  * - DWT (Data Watchpoint and Trace) for precise delays
  * - Timer-based delays
+ * - Many concurrent timeouts with a timing wheel
  */
 
 #include "../drivers/inc/stm32f446re.h"
+#include "../drivers/inc/stm32f446re_timer_driver.h"
+#include "../drivers/inc/timer_wheel.h"
 #include <stdio.h>
 
 /* DWT (Data Watchpoint and Trace) Registers */
@@ -170,8 +173,6 @@ void demonstrate_timer_delay(void)
     /* Assuming APB1 = 42 MHz */
     /* Prescaler = 41 gives 1 MHz (1us per tick) */
     
-    TIM_RegDef_t *TIM2 = (TIM_RegDef_t*)0x40000000;
-    
     printf("Configuring TIM2 for microsecond delays...\n");
     TIM2->PSC = 41;  // 42 MHz / 42 = 1 MHz = 1us
     TIM2->ARR = 0xFFFFFFFF;  // Maximum period
@@ -266,6 +267,85 @@ void demonstrate_non_blocking_delay(void)
     printf("        // ...\n");
     printf("    }\n");
     printf("}\n\n");
+    
+    printf("Every timer is checked on every pass: fine for a few,\n");
+    printf("too slow for hundreds of protocol timeouts (see the timing wheel)\n\n");
+}
+
+/* Timing wheel driven by a 1 ms TIM2 update interrupt */
+static TimerWheel_t wheel;
+static TIM_Handle_t htim2;
+static WheelTimer_t led_timer;
+static WheelTimer_t response_timeout[8];
+
+void wheel_tick(TIM_Handle_t *pTIMHandle, uint8_t Event)
+{
+    (void)pTIMHandle;
+    
+    if (Event == TIM_EVENT_UPDATE)
+        TimerWheel_Tick(&wheel);    // Only counts: callbacks run in the main loop
+}
+
+void TIM2_IRQHandler(void)
+{
+    TIM_IRQHandling(&htim2);
+}
+
+void led_toggle(WheelTimer_t *pTimer)
+{
+    (void)pTimer;
+    GPIOA->ODR ^= (1 << 5);
+}
+
+void response_timed_out(WheelTimer_t *pTimer)
+{
+    printf("  t = %lu ms: link %u timed out\n", (unsigned long)wheel.Now,
+           (unsigned)(uintptr_t)pTimer->pContext);
+}
+
+void demonstrate_timer_wheel(void)
+{
+    printf("=== Timing Wheel (Many Software Timers) ===\n\n");
+    
+    printf("Timers sit in the wheel slot of their expiry tick:\n");
+    printf("- Start and stop are O(1), whatever the number of timers\n");
+    printf("- Each tick looks at one slot, not at every timer\n");
+    printf("- The interrupt only counts ticks; callbacks run in the main loop\n\n");
+    
+    TimerWheel_Init(&wheel);
+    
+    htim2.pTIMx = TIM2;
+    htim2.Callback = wheel_tick;
+    htim2.TIMConfig.TIM_PeriodUs = 1000;          // 1 tick = 1 ms
+    htim2.TIMConfig.TIM_TickHz = 0;
+    htim2.TIMConfig.TIM_OnePulse = TIM_ONE_PULSE_DI;
+    htim2.TIMConfig.TIM_UpdateIT = ENABLE;
+    TIM_Init(&htim2);
+    TIM_IRQConfig(IRQ_NO_TIM2, 6, ENABLE);
+    
+    led_timer.Fn = led_toggle;
+    TimerWheel_Start(&wheel, &led_timer, 500, 500);
+    
+    /* One timeout per request sent; a response stops its timer */
+    for (uint32_t i = 0; i < 8; i++) {
+        response_timeout[i].Fn = response_timed_out;
+        response_timeout[i].pContext = (void *)(uintptr_t)i;
+        TimerWheel_Start(&wheel, &response_timeout[i], 100 + i * 50, 0);
+    }
+    for (uint32_t i = 0; i < 8; i += 2)
+        TimerWheel_Stop(&wheel, &response_timeout[i]);
+    
+    TIM_Start(&htim2);
+    
+    printf("LED every 500 ms, 8 response timeouts (4 answered):\n");
+    while (wheel.Now < 1200) {
+        TimerWheel_Process(&wheel);
+    }
+    
+    TIM_Stop(&htim2);
+    TIM_IRQConfig(IRQ_NO_TIM2, 6, DISABLE);
+    printf("  %lu callbacks, %lu timers still running\n\n",
+           (unsigned long)wheel.Expired, (unsigned long)wheel.Active);
 }
 
 int main(void)
@@ -288,12 +368,15 @@ int main(void)
     
     demonstrate_non_blocking_delay();
     
+    demonstrate_timer_wheel();
+    
     printf("=== Key Takeaways ===\n");
     printf("1. Simple loops are inaccurate and compiler-dependent\n");
     printf("2. DWT cycle counter provides precise delays\n");
     printf("3. Timer-based delays are versatile\n");
     printf("4. Always prefer non-blocking delays in production\n");
     printf("5. Calibrate delays for your specific clock frequency\n");
+    printf("6. Many timeouts: timing wheel, O(1) start/stop, callbacks out of the ISR\n");
     
     printf("\n=== Example Complete ===\n");
     
@@ -24,25 +24,9 @@ DebugErrorTracker_t g_debug_error_tracker = {0};
 #define LED_PORT        GPIOA
 #define DEBOUNCE_MS     50
 
-/* EXTI and SYSCFG */
-typedef struct {
-    volatile uint32_t IMR;
-    volatile uint32_t EMR;
-    volatile uint32_t RTSR;
-    volatile uint32_t FTSR;
-    volatile uint32_t SWIER;
-    volatile uint32_t PR;
-} EXTI_RegDef_t;
-
-typedef struct {
-    volatile uint32_t MEMRMP;
-    volatile uint32_t PMC;
-    volatile uint32_t EXTICR[4];
-} SYSCFG_RegDef_t;
-
-#define EXTI ((EXTI_RegDef_t*)EXT1_BASEADDR)
-#define SYSCFG ((SYSCFG_RegDef_t*)SYSCFC_BASEADDR)
-#define NVIC_ISER1 ((volatile uint32_t*)0xE000E104)
+#define BUTTON_PRIORITY 5
+
+void Button_Callback(uint8_t pin);
 
 /* Global state */
 volatile uint8_t led_state = 0;
@@ -87,29 +71,18 @@ void Button_Init(void)
     /* Configure button GPIO */
     button.pGPIOx = BUTTON_PORT;
     button.GPIO_PINConfig.GPIO_PinNumber = BUTTON_PIN;
-    button.GPIO_PINConfig.GPIO_PinMode = GPIO_MODE_IN;
+    button.GPIO_PINConfig.GPIO_PinMode = GPIO_MODE_IT_FT;  // Input, falling edge
     button.GPIO_PINConfig.GPIO_PinSpeed = GPIO_SPEED_FAST;
     button.GPIO_PINConfig.GPIO_PinPupdCpntrol = GPIO_PIN_PU;
+    button.GPIO_PINConfig.GPIO_PinOPType = GPIO_OP_TYPE_PP;
+    button.GPIO_PINConfig.GPIO_PinAltFunMode = 0;
     
+    /* GPIO_Init maps PC13 to EXTI13 (SYSCFG), selects the edge and unmasks it */
     GPIO_Init(&button);
-    
-    DEBUG_INFO("Button GPIO configured");
-    
-    /* Configure EXTI */
-    RCC->APB2ENR |= (1 << 14);  // Enable SYSCFG clock
-    
-    /* Map PC13 to EXTI13 */
-    SYSCFG->EXTICR[3] &= ~(0xF << 4);
-    SYSCFG->EXTICR[3] |= (0x2 << 4);  // Port C
-    
-    /* Configure falling edge trigger */
-    EXTI->FTSR |= (1 << 13);
-    
-    /* Enable EXTI13 interrupt */
-    EXTI->IMR |= (1 << 13);
+    GPIO_RegisterCallback(BUTTON_PIN, Button_Callback);
     
     /* Enable in NVIC (EXTI15_10 is IRQ 40) */
-    *NVIC_ISER1 |= (1 << (40 - 32));
+    GPIO_IRQConfig(GPIO_PinToIRQ(BUTTON_PIN), BUTTON_PRIORITY, ENABLE);
     
     DEBUG_INFO("Button interrupt configured");
 }
@@ -136,25 +109,21 @@ void LED_Toggle(void)
     }
 }
 
-/* Interrupt handler */
-void EXTI15_10_IRQHandler(void)
+/* Button callback, run by the driver's EXTI15_10_IRQHandler after it has
+ * cleared the EXTI13 pending flag */
+void Button_Callback(uint8_t pin)
 {
-    /* Check if EXTI13 triggered */
-    if (EXTI->PR & (1 << 13))
+    (void)pin;
+    
+    /* Debouncing */
+    uint32_t current_time = get_tick();
+    if (current_time - last_press_time > DEBOUNCE_MS)
     {
-        /* Debouncing */
-        uint32_t current_time = get_tick();
-        if (current_time - last_press_time > DEBOUNCE_MS)
-        {
-            /* Valid button press */
-            button_presses++;
-            LED_Toggle();
-            
-            last_press_time = current_time;
-        }
+        /* Valid button press */
+        button_presses++;
+        LED_Toggle();
         
-        /* Clear pending flag */
-        EXTI->PR |= (1 << 13);
+        last_press_time = current_time;
     }
 }
 
@@ -212,8 +181,8 @@ int main(void)
  *    - Counts button presses
  * 
  * 4. Clean ISR implementation
- *    - Checks which interrupt fired
- *    - Clears pending flag
+ *    - Driver's EXTI15_10_IRQHandler finds the line and clears the pending flag
+ *    - Project code is only a callback (GPIO_RegisterCallback)
  *    - Minimal processing in ISR
  * 
  * Expected Behavior:
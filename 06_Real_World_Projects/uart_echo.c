@@ -6,44 +6,43 @@
  * - UART peripheral setup
  * - Transmit and receive operations
  * - Interrupt-driven I/O
- * - Circular buffer implementation
+ * - Circular DMA reception with idle-line detection
+ * - Lock-free ring buffer between ISR/DMA and main loop
+ * - Non-blocking TX: TXE interrupt for echo bytes, DMA for banners
  */
 
 #include "../drivers/inc/stm32f446re.h"
 #include "../drivers/inc/debug_utils.h"
+#include "../drivers/inc/stm32f446re_usart_driver.h"
 #include <stdio.h>
 #include <string.h>
 
 /* Global error tracker */
 DebugErrorTracker_t g_debug_error_tracker = {0};
 
-/* UART Register Structure */
-typedef struct {
-    volatile uint32_t SR;    // Status register
-    volatile uint32_t DR;    // Data register
-    volatile uint32_t BRR;   // Baud rate register
-    volatile uint32_t CR1;   // Control register 1
-    volatile uint32_t CR2;   // Control register 2
-    volatile uint32_t CR3;   // Control register 3
-} USART_RegDef_t;
-
-#define USART2 ((USART_RegDef_t*)USART2_BASEADDR)
-
 /* Configuration */
 #define BAUD_RATE       115200
-#define APB1_CLOCK      42000000UL
 
-/* Circular buffer for RX */
-#define RX_BUFFER_SIZE  128
+/* RX: DMA1 stream 5 writes circularly into rx_storage, the storage of the
+ * driver's RX ring buffer (usart2_handle.RxBuffer). Half/full-transfer and
+ * idle-line interrupts publish the bytes, one interrupt per burst instead
+ * of one per character. Size must be a power of two and hold what can
+ * arrive while the main loop is busy. */
+#define RX_BUFFER_SIZE  256
+#define RX_CHUNK        32
+
+static uint8_t rx_storage[RX_BUFFER_SIZE];
+volatile uint32_t rx_frames = 0;
 
-typedef struct {
-    uint8_t buffer[RX_BUFFER_SIZE];
-    volatile uint16_t head;
-    volatile uint16_t tail;
-    volatile uint16_t count;
-} CircularBuffer_t;
+/* TX: echo bytes are queued into the driver's ring buffer and sent by the
+ * TXE interrupt; constant blocks of USART_DMA_MIN_LEN bytes or more go by
+ * DMA1 stream 6 without being copied */
+#define TX_BUFFER_SIZE      256
 
-CircularBuffer_t rx_buffer = {0};
+static uint8_t tx_storage[TX_BUFFER_SIZE];
+USART_Handle_t usart2_handle;
+volatile uint32_t tx_completions = 0;
+volatile uint32_t tx_dropped = 0;
 
 /* Delay function */
 void delay_ms(uint32_t ms)
@@ -51,141 +50,123 @@ void delay_ms(uint32_t ms)
     for (volatile uint32_t i = 0; i < ms * 4000; i++);
 }
 
-/* Buffer functions */
-uint8_t buffer_is_empty(CircularBuffer_t *buf)
-{
-    return (buf->count == 0);
-}
-
-uint8_t buffer_is_full(CircularBuffer_t *buf)
-{
-    return (buf->count >= RX_BUFFER_SIZE);
-}
-
-void buffer_put(CircularBuffer_t *buf, uint8_t data)
-{
-    if (!buffer_is_full(buf)) {
-        buf->buffer[buf->head] = data;
-        buf->head = (buf->head + 1) % RX_BUFFER_SIZE;
-        buf->count++;
-    }
-}
-
-uint8_t buffer_get(CircularBuffer_t *buf)
+/* Driver events: TX completion, end of an RX burst */
+void UART_EventCallback(USART_Handle_t *pUSARTHandle, uint8_t event)
 {
-    uint8_t data = 0;
+    (void)pUSARTHandle;
     
-    if (!buffer_is_empty(buf)) {
-        data = buf->buffer[buf->tail];
-        buf->tail = (buf->tail + 1) % RX_BUFFER_SIZE;
-        buf->count--;
+    if (event == USART_EVENT_TX_CMPLT) {
+        tx_completions++;
+    }
+    else if (event == USART_EVENT_RX_IDLE) {
+        rx_frames++;    // pUSARTHandle->RxFrameLen bytes in the burst
     }
-    
-    return data;
-}
-
-/* UART GPIO configuration */
-void UART_GPIO_Init(void)
-{
-    /* Enable GPIOA clock */
-    RCC->AHB1ENR |= (1 << 0);
-    
-    /* PA2 (TX) and PA3 (RX) - AF7 */
-    GPIOA->MODER &= ~((0x3 << 4) | (0x3 << 6));
-    GPIOA->MODER |= ((0x2 << 4) | (0x2 << 6));  // AF mode
-    
-    GPIOA->OSPEEDR |= ((0x3 << 4) | (0x3 << 6));  // High speed
-    
-    GPIOA->PUPDR &= ~((0x3 << 4) | (0x3 << 6));
-    GPIOA->PUPDR |= ((0x1 << 4) | (0x1 << 6));  // Pull-up
-    
-    /* AF7 for USART2 */
-    GPIOA->AFR[0] &= ~((0xF << 8) | (0xF << 12));
-    GPIOA->AFR[0] |= ((0x7 << 8) | (0x7 << 12));
-    
-    DEBUG_INFO("UART GPIO configured");
 }
 
 /* UART peripheral initialization */
-void UART_Init(void)
+uint8_t UART_Init(void)
 {
-    /* Enable USART2 clock */
-    RCC->APB1ENR |= (1 << 17);
-    
-    /* Baud rate calculation */
-    uint32_t usartdiv = APB1_CLOCK / (16 * BAUD_RATE);
-    uint32_t fraction = ((APB1_CLOCK % (16 * BAUD_RATE)) * 16) / (16 * BAUD_RATE);
-    USART2->BRR = (usartdiv << 4) | (fraction & 0xF);
+    USART_Config_t *config = &usart2_handle.USART_Config;
     
-    /* Configure: 8-bit, no parity, 1 stop bit */
-    USART2->CR1 = 0;
-    USART2->CR1 |= (1 << 3);   // TE - Transmit enable
-    USART2->CR1 |= (1 << 2);   // RE - Receive enable
-    USART2->CR1 |= (1 << 5);   // RXNE interrupt enable
+    /* 8N1 on PA2/PA3 (AF7); BRR is computed from the running APB1 clock */
+    usart2_handle.pUSARTx = USART2;
+    usart2_handle.Callback = UART_EventCallback;
+    config->USART_Mode = USART_MODE_TXRX;
+    config->USART_Baud = BAUD_RATE;
+    config->USART_NoOfStopBits = USART_STOPBITS_1;
+    config->USART_WordLength = USART_WORDLEN_8BITS;
+    config->USART_ParityControl = USART_PARITY_DISABLE;
+    config->USART_HWFlowControl = USART_HW_FLOW_CTRL_NONE;
+    config->USART_Oversampling = USART_OVERSAMPLING_AUTO;
     
-    USART2->CR2 = 0;           // 1 stop bit
+    /* TX: ring buffer + TXE, DMA1 stream 6 for blocks.
+     * RX: circular DMA1 stream 5 with IDLE, HT and TC interrupts */
+    config->USART_TxMode = USART_XFER_DMA;
+    config->USART_RxMode = USART_XFER_DMA;
+    config->pTxStorage = tx_storage;
+    config->TxStorageSize = TX_BUFFER_SIZE;
+    config->pRxStorage = rx_storage;
+    config->RxStorageSize = RX_BUFFER_SIZE;
     
-    /* Enable USART */
-    USART2->CR1 |= (1 << 13);  // UE - USART enable
+    if (!USART_Init(&usart2_handle)) {
+        DEBUG_ERROR("USART_Init failed");
+        return 0;
+    }
     
-    /* Enable USART2 interrupt in NVIC */
-    volatile uint32_t *NVIC_ISER1 = (volatile uint32_t*)0xE000E104;
-    *NVIC_ISER1 |= (1 << (38 - 32));  // USART2 is IRQ 38
+    /* Enable USART2 and DMA interrupts in NVIC. USART2 and the RX stream
+     * share a priority: both publish RX data and must not preempt each other */
+    USART_IRQConfig(IRQ_NO_USART2, 5, ENABLE);
+    USART_IRQConfig(IRQ_NO_DMA1_STREAM5, 5, ENABLE);
+    USART_IRQConfig(IRQ_NO_DMA1_STREAM6, 6, ENABLE);
     
-    DEBUG_INFO("UART initialized at %lu baud", (unsigned long)BAUD_RATE);
+    DEBUG_INFO("UART initialized at %lu baud (%ld ppm)",
+               (unsigned long)usart2_handle.BaudActual, (long)usart2_handle.BaudErrorPpm);
+    return 1;
 }
 
-/* UART transmit functions */
+/* UART transmit functions - queue and return, never wait for TXE */
 void UART_TransmitChar(char c)
 {
-    /* Wait for TXE */
-    while (!(USART2->SR & (1 << 7)));
+    uint8_t byte = (uint8_t)c;
     
-    /* Write data */
-    USART2->DR = c;
+    if (!USART_Send(&usart2_handle, &byte, 1)) {
+        tx_dropped++;
+    }
 }
 
+/* str must stay valid until sent: long strings go out by DMA in place,
+ * short ones (or any while the DMA is busy) are queued behind it */
 void UART_TransmitString(const char *str)
 {
-    while (*str) {
-        UART_TransmitChar(*str++);
-    }
+    uint32_t len = strlen(str);
+    
+    tx_dropped += len - USART_Send(&usart2_handle, (const uint8_t *)str, len);
 }
 
-/* UART interrupt handler */
+/* UART interrupt handler: IDLE (end of RX burst), TXE and TC */
 void USART2_IRQHandler(void)
 {
-    /* Check RXNE flag */
-    if (USART2->SR & (1 << 5))
-    {
-        /* Read data (clears RXNE flag) */
-        uint8_t data = USART2->DR & 0xFF;
-        
-        /* Put in buffer */
-        buffer_put(&rx_buffer, data);
-    }
+    USART_IRQHandling(&usart2_handle);
+}
+
+/* USART2 RX DMA (stream 5) interrupt handler: half/full buffer */
+void DMA1_Stream5_IRQHandler(void)
+{
+    USART_RxDMAIRQHandling(&usart2_handle);
+}
+
+/* USART2 TX DMA (stream 6) interrupt handler */
+void DMA1_Stream6_IRQHandler(void)
+{
+    USART_TxDMAIRQHandling(&usart2_handle);
 }
 
 /* Process received data */
 void process_rx_data(void)
 {
-    while (!buffer_is_empty(&rx_buffer))
+    uint8_t chunk[RX_CHUNK];
+    uint32_t len;
+    
+    while ((len = RingBuffer_GetBulk(&usart2_handle.RxBuffer, chunk, RX_CHUNK)) != 0)
     {
-        uint8_t c = buffer_get(&rx_buffer);
-        
-        /* Echo character */
-        UART_TransmitChar(c);
-        
-        /* Handle special characters */
-        if (c == '\r') {
-            UART_TransmitChar('\n');
-        }
-        else if (c == '\n') {
-            // Already sent
-        }
-        else if (c == 0x7F || c == 0x08) {  // Backspace/DEL
-            UART_TransmitChar(' ');
+        for (uint32_t i = 0; i < len; i++)
+        {
+            uint8_t c = chunk[i];
+            
+            /* Echo character */
             UART_TransmitChar(c);
+            
+            /* Handle special characters */
+            if (c == '\r') {
+                UART_TransmitChar('\n');
+            }
+            else if (c == '\n') {
+                // Already sent
+            }
+            else if (c == 0x7F || c == 0x08) {  // Backspace/DEL
+                UART_TransmitChar(' ');
+                UART_TransmitChar(c);
+            }
         }
     }
 }
@@ -197,9 +178,10 @@ int main(void)
     
     DEBUG_INFO("System starting...");
     
-    /* Initialize UART */
-    UART_GPIO_Init();
-    UART_Init();
+    /* Initialize UART (pins, baud rate, RX DMA into rx_storage) */
+    if (!UART_Init()) {
+        return 1;
+    }
     
     /* Send welcome message */
     const char *welcome = "\r\n=== STM32 UART Echo ===\r\n";
@@ -222,7 +204,10 @@ int main(void)
         /* Periodic status */
         if (++loop_count >= 1000000) {
             loop_count = 0;
-            DEBUG_LOG("Buffer: %d/%d", rx_buffer.count, RX_BUFFER_SIZE);
+            DEBUG_LOG("Buffer: %lu/%d, frames: %lu, overruns: %lu, TX done: %lu, TX dropped: %lu",
+                      (unsigned long)RingBuffer_Count(&usart2_handle.RxBuffer), RX_BUFFER_SIZE,
+                      (unsigned long)rx_frames, (unsigned long)usart2_handle.RxOverruns,
+                      (unsigned long)tx_completions, (unsigned long)tx_dropped);
         }
     }
     
@@ -234,20 +219,29 @@ int main(void)
  * 
  * 1. UART Configuration
  *    - 115200 baud, 8 data bits, no parity, 1 stop bit
- *    - GPIO alternate function setup
- *    - Proper baud rate calculation
+ *    - USART driver: GPIO alternate function setup from its port table
+ *    - BRR computed from the live APB1 clock, rounding error reported
  * 
- * 2. Interrupt-driven Reception
- *    - RXNE interrupt for efficient RX
- *    - Circular buffer for data storage
+ * 2. DMA Reception
+ *    - DMA1 stream 5 (channel 4) writes circularly into the RX ring buffer
+ *    - Half/full-transfer and IDLE-line interrupts publish the bytes: one
+ *      interrupt per burst instead of one per character
+ *    - Lock-free SPSC ring buffer (drivers/src/ring_buffer.c): the driver
+ *      only writes the head index, the main loop only the tail
  *    - No polling required
  * 
- * 3. Echo Functionality
+ * 3. Non-blocking Transmission
+ *    - UART_TransmitChar/String queue and return immediately
+ *    - TXE interrupt drains the driver's TX ring buffer
+ *    - Banners of 16+ bytes sent by DMA1 stream 6 (channel 4), zero-copy
+ *    - Completion reported through the handle callback
+ * 
+ * 4. Echo Functionality
  *    - Echoes received characters back
  *    - Handles special characters (CR, LF, backspace)
  *    - Buffer overflow protection
  * 
- * 4. Clean Code Organization
+ * 5. Clean Code Organization
  *    - Separate initialization functions
  *    - Buffer management abstraction
  *    - ISR kept minimal
@@ -265,8 +259,8 @@ int main(void)
  *    - Confirm TX/RX not swapped
  * 
  * 2. Garbled characters?
- *    - Check baud rate calculation
- *    - Verify APB1 clock frequency
+ *    - Check the BaudErrorPpm logged at startup
+ *    - Verify the terminal uses the same baud rate
  *    - Check for framing errors
  * 
  * 3. Missing characters?
@@ -277,7 +271,7 @@ int main(void)
  * Extensions:
  * 1. Implement command line interface
  * 2. Add AT command parser
- * 3. Implement DMA for transfers
+ * 3. Split RX bursts into lines on USART_EVENT_RX_IDLE
  * 4. Add flow control (RTS/CTS)
  * 5. Create line buffer with editing
  * 6. Implement printf redirection to UART
@@ -1,37 +1,845 @@
+/*
+ * sim_adc.c - Virtual ADC Simulator
+ * 12-bit SAR ADC with conversion timing, scan sequences and signal sources
+ */
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
 #include <time.h>
 
-#define ADC_RESOLUTION 1024  // 10-bit resolution for the ADC
-#define ADC_CHANNELS 16      // Number of available ADC channels
+#include "board_config.h"
+#include "sim_log.h"
+#include "sim_rand.h"
+#include "sim_clock.h"
+#include "sim_sched.h"
+#include "sim_nvic.h"
+#include "sim_adc.h"
+
+// ADC kernel clock is PCLK2 divided by the ADC prescaler; the board's
+// default APB2 clock sets the initial PCLK2 divider
+#if defined(APB2_CLOCK_HZ)
+#define ADC_PCLK2_DIV_DEFAULT (SYSTEM_CLOCK_HZ / APB2_CLOCK_HZ)
+#else
+#define ADC_PCLK2_DIV_DEFAULT (SYSTEM_CLOCK_HZ / APB_CLOCK_HZ)
+#endif
+
+#define ADC_PI 3.14159265358979323846
+
+// Register bits
+#define ADC_CR1_EOCIE    (1U << 5)
+#define ADC_CR1_SCAN     (1U << 8)
+#define ADC_CR1_RES_POS  24
+#define ADC_CR2_ADON     (1U << 0)
+#define ADC_CR2_CONT     (1U << 1)
+#define ADC_CR2_SWSTART  (1U << 30)
+#define ADC_SQR1_L_POS   20
 
+// Error codes
+#define ADC_ERROR_NONE            0
+#define ADC_ERROR_INVALID_CHANNEL 1
+#define ADC_ERROR_CONFIG          2
+#define ADC_ERROR_SOURCE          3
+#define ADC_ERROR_BUSY            4
+
+// Signal source of one channel
 typedef struct {
-    int currentValue;
-} VirtualADC;
+    uint8_t type;
+    double offset;     // Constant level, sine offset or ramp low (V)
+    double amplitude;  // Sine amplitude or ramp span (V)
+    double freq_hz;
+    double noise;      // Uniform noise amplitude added to the source (V)
+    float *replay;     // Replay samples (V)
+    uint32_t replay_len;
+    uint32_t replay_pos;
+} ADCSource;
+
+// Virtual ADC state
+static VirtualADCRegs adc_regs;
+static ADCSource sources[ADC_CHANNELS];
+static double adc_vref = 3.3;
+static uint8_t adc_prescaler = 4;
+static uint8_t pclk2_div = ADC_PCLK2_DIV_DEFAULT;  // Core cycles per PCLK2 cycle
+static uint32_t trigger_hz = 0;  // 0: back-to-back scans (continuous mode)
+static VirtualADCStats adc_stats;
+static SimRand adc_rng;
+static uint32_t conv_event = SIM_EVENT_INVALID;
+static uint8_t seq_pos = 0;
+static uint8_t adc_initialized = 0;
+static uint8_t last_error = ADC_ERROR_NONE;
+
+// ADC clock cycles of each sample time code
+static const uint16_t sample_cycles[8] = {3, 15, 28, 56, 84, 112, 144, 480};
+
+// Resolution in bits from CR1 RES (12, 10, 8 or 6)
+static inline uint8_t res_bits(void) {
+    return (uint8_t)(12 - 2 * ((adc_regs.CR1 >> ADC_CR1_RES_POS) & 0x3U));
+}
+
+// Sample time code of a channel from SMPR1/SMPR2
+static inline uint8_t sample_time_code(uint8_t channel) {
+    if (channel < 10) return (uint8_t)((adc_regs.SMPR2 >> (3 * channel)) & 0x7U);
+    return (uint8_t)((adc_regs.SMPR1 >> (3 * (channel - 10))) & 0x7U);
+}
+
+// Regular sequence length from SQR1 L
+static inline uint8_t seq_length(void) {
+    return (uint8_t)(((adc_regs.SQR1 >> ADC_SQR1_L_POS) & 0xFU) + 1);
+}
+
+// Channel in a regular sequence slot (SQ1 is slot 0)
+static inline uint8_t seq_channel(uint8_t slot) {
+    if (slot < 6) return (uint8_t)((adc_regs.SQR3 >> (5 * slot)) & 0x1FU);
+    if (slot < 12) return (uint8_t)((adc_regs.SQR2 >> (5 * (slot - 6))) & 0x1FU);
+    return (uint8_t)((adc_regs.SQR1 >> (5 * (slot - 12))) & 0x1FU);
+}
+
+// ADC clock frequency from the current core clock
+static inline uint32_t adcclk_hz(void) {
+    return SimClock_GetFrequency() / pclk2_div / adc_prescaler;
+}
+
+// Core cycles for one conversion: sampling plus one ADC clock per bit
+static uint64_t conversion_cycles(uint8_t channel) {
+    uint64_t adc_clocks = (uint64_t)sample_cycles[sample_time_code(channel)] + res_bits();
+    return adc_clocks * adc_prescaler * pclk2_div;
+}
+
+// Pin voltage of a channel at a given virtual cycle
+static double source_volts(uint8_t channel, uint64_t cycle) {
+    ADCSource *src = &sources[channel];
+    double t = (double)SimClock_CycleToTimeNs(cycle) * 1e-9;
+    double v;
+    
+    switch (src->type) {
+        case ADC_SOURCE_SINE:
+            v = src->offset + src->amplitude * sin(2.0 * ADC_PI * src->freq_hz * t);
+            break;
+        case ADC_SOURCE_RAMP: {
+            double phase = src->freq_hz * t;
+            v = src->offset + src->amplitude * (phase - floor(phase));
+            break;
+        }
+        case ADC_SOURCE_REPLAY:
+            v = src->replay[src->replay_pos];
+            if (++src->replay_pos >= src->replay_len) src->replay_pos = 0;
+            break;
+        default:
+            v = src->offset;
+            break;
+    }
+    
+    if (src->noise > 0.0) {
+        v += src->noise * ((double)SimRand_Next(&adc_rng) * (2.0 / 4294967296.0) - 1.0);
+    }
+    return v;
+}
+
+// Quantize a voltage to the current resolution (clamped to the rails)
+static inline uint16_t quantize(double volts, uint16_t full_scale) {
+    double code = volts * (full_scale + 1) / adc_vref;
+    
+    if (code <= 0.0) return 0;
+    if (code >= full_scale) return full_scale;
+    return (uint16_t)code;
+}
+
+// Sample and convert one channel starting at the given cycle
+static uint16_t convert(uint8_t channel, uint64_t cycle) {
+    uint16_t full_scale = (uint16_t)((1U << res_bits()) - 1);
+    uint16_t value = quantize(source_volts(channel, cycle), full_scale);
+    
+    adc_stats.conversions++;
+    return value;
+}
+
+// Release a replay buffer
+static void clear_replay(ADCSource *src) {
+    free(src->replay);
+    src->replay = NULL;
+    src->replay_len = 0;
+    src->replay_pos = 0;
+}
+
+// Validate a channel number
+static uint8_t check_channel(uint8_t channel) {
+    if (channel >= ADC_CHANNELS) {
+        last_error = ADC_ERROR_INVALID_CHANNEL;
+        SIM_LOG_ERROR("[VirtualADC] Error: Invalid ADC channel %d\n", channel);
+        return 0;
+    }
+    return 1;
+}
+
+// Initialize the virtual ADC: clock on, ADON set, 12-bit, single channel 0
+void VirtualADC_Init(void) {
+    if (adc_initialized) return;
+    
+    memset(&adc_regs, 0, sizeof(adc_regs));
+    memset(sources, 0, sizeof(sources));
+    memset(&adc_stats, 0, sizeof(adc_stats));
+    adc_regs.CR2 = ADC_CR2_ADON;
+    adc_vref = 3.3;
+    adc_prescaler = 4;
+    pclk2_div = ADC_PCLK2_DIV_DEFAULT;
+    trigger_hz = 0;
+    conv_event = SIM_EVENT_INVALID;
+    SimRand_SeedStream(&adc_rng, SIM_RAND_STREAM_ADC);
+    
+    // Internal channels: temperature sensor at 25 C, VREFINT, VBAT / 4
+    sources[ADC_CHANNEL_TEMP].offset = 0.76;
+    sources[ADC_CHANNEL_VREFINT].offset = 1.21;
+    sources[ADC_CHANNEL_VBAT].offset = 3.0 / 4;
+    
+    adc_initialized = 1;
+    SIM_LOG_INFO("[VirtualADC] Initialized %d channels, %d-bit, ADCCLK %lu Hz\n",
+                 ADC_CHANNELS, res_bits(), (unsigned long)adcclk_hz());
+}
+
+// Get the register block (configuration may be written directly)
+VirtualADCRegs *VirtualADC_GetRegs(void) {
+    if (!adc_initialized) VirtualADC_Init();
+    
+    return &adc_regs;
+}
+
+// Get last error code
+uint8_t VirtualADC_GetLastError(void) {
+    return last_error;
+}
+
+// Reseed the noise generator (replays the same noise sequence)
+void VirtualADC_SetSeed(uint64_t seed) {
+    if (!adc_initialized) VirtualADC_Init();
+    
+    SimRand_Seed(&adc_rng, seed);
+}
+
+// Set resolution (12, 10, 8 or 6 bits)
+uint8_t VirtualADC_SetResolution(uint8_t bits) {
+    if (!adc_initialized) VirtualADC_Init();
+    
+    if (bits > 12 || bits < 6 || (bits & 1U)) {
+        last_error = ADC_ERROR_CONFIG;
+        SIM_LOG_ERROR("[VirtualADC] Error: Unsupported resolution %d bits\n", bits);
+        return 0;
+    }
+    
+    adc_regs.CR1 = (adc_regs.CR1 & ~(0x3U << ADC_CR1_RES_POS)) |
+                   ((uint32_t)((12 - bits) / 2) << ADC_CR1_RES_POS);
+    SIM_LOG_DEBUG("[VirtualADC] Resolution %d bits\n", bits);
+    
+    last_error = ADC_ERROR_NONE;
+    return 1;
+}
+
+// Set ADC prescaler (PCLK2 divided by 2, 4, 6 or 8)
+uint8_t VirtualADC_SetPrescaler(uint8_t div) {
+    if (!adc_initialized) VirtualADC_Init();
+    
+    if (div < 2 || div > 8 || (div & 1U)) {
+        last_error = ADC_ERROR_CONFIG;
+        SIM_LOG_ERROR("[VirtualADC] Error: Invalid prescaler /%d\n", div);
+        return 0;
+    }
+    
+    adc_prescaler = div;
+    SIM_LOG_DEBUG("[VirtualADC] ADCCLK = %lu Hz\n", (unsigned long)adcclk_hz());
+    
+    last_error = ADC_ERROR_NONE;
+    return 1;
+}
+
+// Set the APB2 prescaler (RCC CFGR PPRE2: core clock divided by 1, 2, 4,
+// 8 or 16) that PCLK2 runs at
+uint8_t VirtualADC_SetPCLK2Divider(uint8_t div) {
+    if (!adc_initialized) VirtualADC_Init();
+    
+    if (div == 0 || div > 16 || (div & (div - 1U))) {
+        last_error = ADC_ERROR_CONFIG;
+        SIM_LOG_ERROR("[VirtualADC] Error: Invalid PCLK2 divider /%d\n", div);
+        return 0;
+    }
+    
+    pclk2_div = div;
+    SIM_LOG_DEBUG("[VirtualADC] ADCCLK = %lu Hz\n", (unsigned long)adcclk_hz());
+    
+    last_error = ADC_ERROR_NONE;
+    return 1;
+}
+
+// Set reference voltage (full scale)
+void VirtualADC_SetVref(double vref) {
+    if (!adc_initialized) VirtualADC_Init();
+    
+    if (vref > 0.0) {
+        adc_vref = vref;
+    }
+}
+
+// Set sample time of a channel (ADC_SAMPLETIME_x)
+uint8_t VirtualADC_SetSampleTime(uint8_t channel, uint8_t sample_time) {
+    if (!adc_initialized) VirtualADC_Init();
+    
+    if (!check_channel(channel)) return 0;
+    if (sample_time > ADC_SAMPLETIME_480CYCLES) {
+        last_error = ADC_ERROR_CONFIG;
+        return 0;
+    }
+    
+    if (channel < 10) {
+        adc_regs.SMPR2 = (adc_regs.SMPR2 & ~(0x7U << (3 * channel))) |
+                         ((uint32_t)sample_time << (3 * channel));
+    } else {
+        uint8_t shift = (uint8_t)(3 * (channel - 10));
+        adc_regs.SMPR1 = (adc_regs.SMPR1 & ~(0x7U << shift)) | ((uint32_t)sample_time << shift);
+    }
+    
+    last_error = ADC_ERROR_NONE;
+    return 1;
+}
+
+// Set the regular sequence (SQR1-3); more than one channel enables scan mode
+uint8_t VirtualADC_SetSequence(const uint8_t *channels, uint8_t length) {
+    if (!adc_initialized) VirtualADC_Init();
+    
+    if (channels == NULL || length == 0 || length > ADC_MAX_SEQUENCE) {
+        last_error = ADC_ERROR_CONFIG;
+        SIM_LOG_ERROR("[VirtualADC] Error: Invalid sequence length %d\n", length);
+        return 0;
+    }
+    
+    uint32_t sqr[3] = {0, 0, 0};  // SQR3, SQR2, SQR1
+    for (uint8_t slot = 0; slot < length; slot++) {
+        if (!check_channel(channels[slot])) return 0;
+        sqr[slot / 6] |= (uint32_t)channels[slot] << (5 * (slot % 6));
+    }
+    
+    adc_regs.SQR3 = sqr[0];
+    adc_regs.SQR2 = sqr[1];
+    adc_regs.SQR1 = sqr[2] | ((uint32_t)(length - 1) << ADC_SQR1_L_POS);
+    adc_regs.CR1 = (length > 1) ? (adc_regs.CR1 | ADC_CR1_SCAN) : (adc_regs.CR1 & ~ADC_CR1_SCAN);
+    SIM_LOG_DEBUG("[VirtualADC] Sequence of %d channel(s)\n", length);
+    
+    last_error = ADC_ERROR_NONE;
+    return 1;
+}
 
-VirtualADC adc[ADC_CHANNELS];
+// Set the scan trigger rate for block reads (timer-triggered sampling);
+// 0 runs scans back-to-back
+void VirtualADC_SetTriggerRate(uint32_t hz) {
+    if (!adc_initialized) VirtualADC_Init();
+    
+    trigger_hz = hz;
+    SIM_LOG_DEBUG("[VirtualADC] Trigger rate %lu Hz\n", (unsigned long)hz);
+}
+
+// Core clock cycles one conversion of a channel takes
+uint64_t VirtualADC_GetConversionCycles(uint8_t channel) {
+    if (!adc_initialized) VirtualADC_Init();
+    
+    if (channel >= ADC_CHANNELS) return 0;
+    return conversion_cycles(channel);
+}
+
+// Replace a channel's source, keeping its noise setting
+static uint8_t set_source(uint8_t channel, uint8_t type, double offset,
+                          double amplitude, double freq_hz) {
+    if (!adc_initialized) VirtualADC_Init();
+    
+    if (!check_channel(channel)) return 0;
+    
+    ADCSource *src = &sources[channel];
+    clear_replay(src);
+    src->type = type;
+    src->offset = offset;
+    src->amplitude = amplitude;
+    src->freq_hz = freq_hz;
+    
+    last_error = ADC_ERROR_NONE;
+    return 1;
+}
+
+// Constant voltage on a channel
+uint8_t VirtualADC_SetSourceConstant(uint8_t channel, double volts) {
+    return set_source(channel, ADC_SOURCE_CONSTANT, volts, 0.0, 0.0);
+}
+
+// Sine wave: offset + amplitude * sin(2 pi f t), t in virtual time
+uint8_t VirtualADC_SetSourceSine(uint8_t channel, double offset, double amplitude, double freq_hz) {
+    return set_source(channel, ADC_SOURCE_SINE, offset, amplitude, freq_hz);
+}
+
+// Sawtooth from low to high, freq_hz times per second
+uint8_t VirtualADC_SetSourceRamp(uint8_t channel, double low, double high, double freq_hz) {
+    return set_source(channel, ADC_SOURCE_RAMP, low, high - low, freq_hz);
+}
+
+// Uniform noise of +/- amplitude volts on top of the channel's source
+uint8_t VirtualADC_SetNoise(uint8_t channel, double amplitude) {
+    if (!adc_initialized) VirtualADC_Init();
+    
+    if (!check_channel(channel)) return 0;
+    
+    sources[channel].noise = (amplitude > 0.0) ? amplitude : 0.0;
+    last_error = ADC_ERROR_NONE;
+    return 1;
+}
+
+// Install loaded replay samples on a channel
+static uint8_t set_replay(uint8_t channel, float *samples, uint32_t count, const char *path) {
+    if (count == 0) {
+        free(samples);
+        last_error = ADC_ERROR_SOURCE;
+        SIM_LOG_ERROR("[VirtualADC] Error: No samples in %s\n", path);
+        return 0;
+    }
+    
+    set_source(channel, ADC_SOURCE_REPLAY, 0.0, 0.0, 0.0);
+    sources[channel].replay = samples;
+    sources[channel].replay_len = count;
+    SIM_LOG_INFO("[VirtualADC] Channel %d replays %lu samples from %s\n",
+                 channel, (unsigned long)count, path);
+    return 1;
+}
+
+// Replay volts from a CSV file (first column, one sample per line, lines
+// that do not start with a number are skipped). Replay wraps at the end.
+uint8_t VirtualADC_LoadReplayCSV(uint8_t channel, const char *path) {
+    if (!adc_initialized) VirtualADC_Init();
+    
+    if (!check_channel(channel)) return 0;
+    
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        last_error = ADC_ERROR_SOURCE;
+        SIM_LOG_ERROR("[VirtualADC] Error: Cannot open %s\n", path);
+        return 0;
+    }
+    
+    uint32_t count = 0, capacity = 1024;
+    float *samples = malloc(capacity * sizeof(float));
+    char line[256];
+    
+    while (samples != NULL && fgets(line, sizeof(line), f) != NULL) {
+        char *end;
+        double v = strtod(line, &end);
+        if (end == line) continue;
+        if (count == capacity) {
+            float *grown = realloc(samples, 2 * capacity * sizeof(float));
+            if (grown == NULL) break;
+            samples = grown;
+            capacity *= 2;
+        }
+        samples[count++] = (float)v;
+    }
+    fclose(f);
+    
+    if (samples == NULL) {
+        last_error = ADC_ERROR_SOURCE;
+        return 0;
+    }
+    return set_replay(channel, samples, count, path);
+}
+
+// Replay raw 12-bit codes from a binary file of little-endian uint16
+// (for example a capture from the real board), scaled by the current Vref
+uint8_t VirtualADC_LoadReplayBinary(uint8_t channel, const char *path) {
+    if (!adc_initialized) VirtualADC_Init();
+    
+    if (!check_channel(channel)) return 0;
+    
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        last_error = ADC_ERROR_SOURCE;
+        SIM_LOG_ERROR("[VirtualADC] Error: Cannot open %s\n", path);
+        return 0;
+    }
+    
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    
+    uint32_t count = (size > 0) ? (uint32_t)(size / 2) : 0;
+    float *samples = malloc((count ? count : 1) * sizeof(float));
+    uint8_t raw[2];
+    uint32_t n = 0;
+    
+    while (samples != NULL && n < count && fread(raw, 1, 2, f) == 2) {
+        uint16_t code = (uint16_t)(raw[0] | (raw[1] << 8));
+        samples[n++] = (float)((code & 0x0FFFU) * adc_vref / 4096.0);
+    }
+    fclose(f);
+    
+    if (samples == NULL) {
+        last_error = ADC_ERROR_SOURCE;
+        return 0;
+    }
+    return set_replay(channel, samples, n, path);
+}
+
+// Single blocking conversion of one channel
+uint8_t VirtualADC_ReadChannel(uint8_t channel, uint16_t *value) {
+    if (!adc_initialized) VirtualADC_Init();
+    
+    if (!check_channel(channel) || value == NULL) return 0;
+    
+    if (conv_event != SIM_EVENT_INVALID) {
+        last_error = ADC_ERROR_BUSY;
+        SIM_LOG_ERROR("[VirtualADC] Error: Conversion in progress\n");
+        return 0;
+    }
+    
+    uint64_t start = SimClock_GetCycles();
+    *value = convert(channel, start);
+    SimClock_Advance(conversion_cycles(channel));
+    adc_regs.DR = *value;
+    adc_regs.SR |= ADC_SR_EOC;
+    
+    SIM_LOG_TRACE("[VirtualADC] Channel %d = %d\n", channel, *value);
+    last_error = ADC_ERROR_NONE;
+    return 1;
+}
+
+// Single conversion of one channel in volts (negative on error)
+double VirtualADC_ReadVoltage(uint8_t channel) {
+    uint16_t value;
+    
+    if (!VirtualADC_ReadChannel(channel, &value)) return -1.0;
+    return value * adc_vref / (1U << res_bits());
+}
+
+// One scan of the regular sequence into values[0..length-1]
+uint8_t VirtualADC_ReadSequence(uint16_t *values) {
+    if (!adc_initialized) VirtualADC_Init();
+    
+    if (values == NULL) return 0;
+    return VirtualADC_ReadBlock(values, seq_length()) == seq_length();
+}
+
+// DMA-style block read: count conversions of the regular sequence, repeated
+// as needed, stored in order. Scans start at the trigger rate (or back-to-back)
+// and the virtual clock is advanced once by the total time. Trigger k falls
+// at start + k * f_core / trigger_hz, exact for rates that do not divide the
+// core clock; every trigger that arrives while a scan is running is missed.
+uint32_t VirtualADC_ReadBlock(uint16_t *buffer, uint32_t count) {
+    if (!adc_initialized) VirtualADC_Init();
+    
+    if (buffer == NULL || count == 0) return 0;
+    
+    if (conv_event != SIM_EVENT_INVALID) {
+        last_error = ADC_ERROR_BUSY;
+        SIM_LOG_ERROR("[VirtualADC] Error: Conversion in progress\n");
+        return 0;
+    }
+    
+    // Decode the sequence once for the whole block
+    uint8_t length = seq_length();
+    uint8_t channels[ADC_MAX_SEQUENCE];
+    uint64_t cycles[ADC_MAX_SEQUENCE];
+    for (uint8_t slot = 0; slot < length; slot++) {
+        channels[slot] = seq_channel(slot);
+        if (channels[slot] >= ADC_CHANNELS) {
+            last_error = ADC_ERROR_CONFIG;
+            return 0;
+        }
+        cycles[slot] = conversion_cycles(channels[slot]);
+    }
+    
+    uint16_t full_scale = (uint16_t)((1U << res_bits()) - 1);
+    uint64_t f_core = SimClock_GetFrequency();
+    uint64_t start = SimClock_GetCycles();
+    uint64_t now = start;
+    uint64_t trigger = 0;  // Index of the next trigger
+    uint32_t n = 0;
+    uint8_t slot = 0;
+    
+    while (n < count) {
+        if (slot == 0 && trigger_hz) {
+            uint64_t next_trigger = start + trigger * f_core / trigger_hz;
+            if (now > next_trigger) {
+                // Previous scan overran: skip to the first trigger after it
+                uint64_t first = ((now - start) * trigger_hz + f_core - 1) / f_core;
+                adc_stats.overruns += (uint32_t)(first - trigger);
+                adc_regs.SR |= ADC_SR_OVR;
+                trigger = first;
+                next_trigger = start + trigger * f_core / trigger_hz;
+            }
+            now = next_trigger;
+            trigger++;
+        }
+    
+        buffer[n++] = quantize(source_volts(channels[slot], now), full_scale);
+        now += cycles[slot];
+        if (++slot == length) slot = 0;
+    }
+    
+    adc_stats.conversions += n;
+    adc_regs.DR = buffer[n - 1];
+    adc_regs.SR |= ADC_SR_EOC;
+    SimClock_Advance(now - start);
+    
+    SIM_LOG_TRACE("[VirtualADC] Block of %lu conversions in %llu cycles\n",
+                  (unsigned long)n, (unsigned long long)(now - start));
+    last_error = ADC_ERROR_NONE;
+    return n;
+}
 
-void initADC() {
-    srand(time(NULL));  // Seed the random number generator
-    for(int i = 0; i < ADC_CHANNELS; i++) {
-        adc[i].currentValue = 0;
+// Scheduled end of one conversion in an interrupt-driven sequence
+static void conversion_done(void *ctx) {
+    (void)ctx;
+    uint8_t channel = seq_channel(seq_pos);
+    
+    conv_event = SIM_EVENT_INVALID;
+    if (adc_regs.SR & ADC_SR_EOC) {
+        adc_regs.SR |= ADC_SR_OVR;  // Previous result was never read
+        adc_stats.overruns++;
     }
+    adc_regs.DR = convert(channel, SimClock_GetCycles() - conversion_cycles(channel));
+    adc_regs.SR |= ADC_SR_EOC;
+    SIM_LOG_TRACE("[VirtualADC] EOC channel %d = %lu\n", channel, (unsigned long)adc_regs.DR);
+    
+    // Next slot, or restart the sequence in continuous mode
+    if (++seq_pos < seq_length() || (adc_regs.CR2 & ADC_CR2_CONT)) {
+        if (seq_pos == seq_length()) seq_pos = 0;
+        conv_event = SimSched_Post(conversion_cycles(seq_channel(seq_pos)), conversion_done, NULL);
+    } else {
+        adc_regs.CR2 &= ~ADC_CR2_SWSTART;
+    }
+    
+    if (adc_regs.CR1 & ADC_CR1_EOCIE) {
+        VirtualNVIC_SetPending(IRQ_ADC);
+    }
+}
+
+// Start converting the regular sequence in the background. Each end of
+// conversion is an event on the scheduler; with EOCIE set it raises IRQ_ADC.
+uint8_t VirtualADC_Start(uint8_t continuous) {
+    if (!adc_initialized) VirtualADC_Init();
+    
+    if (conv_event != SIM_EVENT_INVALID) {
+        last_error = ADC_ERROR_BUSY;
+        return 0;
+    }
+    
+    adc_regs.CR2 = continuous ? (adc_regs.CR2 | ADC_CR2_CONT) : (adc_regs.CR2 & ~ADC_CR2_CONT);
+    adc_regs.CR2 |= ADC_CR2_SWSTART;
+    adc_regs.SR |= ADC_SR_STRT;
+    seq_pos = 0;
+    conv_event = SimSched_Post(conversion_cycles(seq_channel(0)), conversion_done, NULL);
+    if (conv_event == SIM_EVENT_INVALID) {
+        last_error = ADC_ERROR_BUSY;
+        return 0;
+    }
+    
+    SIM_LOG_DEBUG("[VirtualADC] Conversion started (%s)\n", continuous ? "continuous" : "single");
+    last_error = ADC_ERROR_NONE;
+    return 1;
+}
+
+// Stop background conversions
+void VirtualADC_Stop(void) {
+    if (!adc_initialized) VirtualADC_Init();
+    
+    SimSched_Cancel(conv_event);
+    conv_event = SIM_EVENT_INVALID;
+    adc_regs.CR2 &= ~(ADC_CR2_SWSTART | ADC_CR2_CONT);
+    adc_regs.SR &= ~ADC_SR_STRT;
+}
+
+// Enable/disable the end-of-conversion interrupt (CR1 EOCIE)
+void VirtualADC_EnableInterrupt(uint8_t enable) {
+    if (!adc_initialized) VirtualADC_Init();
+    
+    adc_regs.CR1 = enable ? (adc_regs.CR1 | ADC_CR1_EOCIE) : (adc_regs.CR1 & ~ADC_CR1_EOCIE);
+}
+
+// Read the data register (clears EOC, as reading DR does)
+uint16_t VirtualADC_GetValue(void) {
+    if (!adc_initialized) VirtualADC_Init();
+    
+    adc_regs.SR &= ~ADC_SR_EOC;
+    return (uint16_t)adc_regs.DR;
 }
 
-int readADC(int channel) {
-    if (channel < 0 || channel >= ADC_CHANNELS) {
-        printf("Error: Invalid ADC channel\n");
-        return -1;
+// Copy conversion statistics
+void VirtualADC_GetStats(VirtualADCStats *stats) {
+    if (stats != NULL) {
+        *stats = adc_stats;
     }
-    adc[channel].currentValue = rand() % ADC_RESOLUTION;  // Simulate ADC reading
-    return adc[channel].currentValue;
 }
 
-int main() {
-    initADC();
-    for (int i = 0; i < ADC_CHANNELS; i++) {
-        int value = readADC(i);
-        printf("ADC Channel %d Reading: %d\n", i, value);
+// Reset conversion statistics
+void VirtualADC_ResetStats(void) {
+    memset(&adc_stats, 0, sizeof(adc_stats));
+}
+
+#ifdef RUN_STANDALONE_TEST
+#include "sim_test.h"
+
+static unsigned eoc_count = 0;
+
+static void adc_irq_handler(void) {
+    uint16_t value = VirtualADC_GetValue();
+    eoc_count++;
+    printf("  [Handler] ADC EOC %u: DR=%d at %llu us\n", eoc_count, value,
+           (unsigned long long)SimClock_GetTimeUs());
+}
+
+// Test function - only compiled when RUN_STANDALONE_TEST is defined
+int main(void) {
+    printf("=== Virtual ADC Test ===\n\n");
+    
+    VirtualADC_Init();
+    
+    // Test 1: Constant input, 12-bit and 8-bit
+    printf("--- Test 1: Single Conversion ---\n");
+    uint16_t value;
+    VirtualADC_SetSourceConstant(0, 1.65);
+    VirtualADC_ReadChannel(0, &value);
+    check(value == 2048, "1.65 V at 12 bits reads 2048");
+    VirtualADC_SetResolution(8);
+    VirtualADC_ReadChannel(0, &value);
+    check(value == 128, "1.65 V at 8 bits reads 128");
+    VirtualADC_SetResolution(12);
+    check(fabs(VirtualADC_ReadVoltage(ADC_CHANNEL_VREFINT) - 1.21) < 0.002, "VREFINT reads 1.21 V");
+    check(VirtualADC_ReadChannel(ADC_CHANNELS, &value) == 0, "invalid channel rejected");
+    
+    // Test 2: Conversion time from the clock tree
+    printf("\n--- Test 2: Conversion Time ---\n");
+    uint64_t base = VirtualADC_GetConversionCycles(0);
+    printf("3-cycle sampling, 12 bits, PCLK2 /%d, ADCCLK /4: %llu core cycles\n",
+           (int)ADC_PCLK2_DIV_DEFAULT, (unsigned long long)base);
+    check(base == 15 * 4 * ADC_PCLK2_DIV_DEFAULT, "(3 + 12) ADC clocks x 4 x PCLK2 divider");
+    VirtualADC_SetPCLK2Divider(4);
+    check(VirtualADC_GetConversionCycles(0) == 15 * 4 * 4, "PCLK2 /4 sets the core cycles per ADC clock");
+    check(VirtualADC_SetPCLK2Divider(3) == 0 && VirtualADC_GetConversionCycles(0) == 15 * 4 * 4,
+          "PCLK2 /3 rejected, divider kept");
+    VirtualADC_SetPCLK2Divider(ADC_PCLK2_DIV_DEFAULT);
+    SimClock_SetFrequency(SYSTEM_CLOCK_HZ / 2);
+    check(VirtualADC_GetConversionCycles(0) == base, "core clock change keeps cycles per conversion");
+    SimClock_SetFrequency(SYSTEM_CLOCK_HZ);
+    
+    // Test 3: Scan sequence with different sources
+    printf("\n--- Test 3: Scan Sequence ---\n");
+    const uint8_t seq[] = {1, 2, 3, ADC_CHANNEL_TEMP};
+    VirtualADC_SetSourceSine(1, 1.65, 1.0, 1000.0);
+    VirtualADC_SetSourceRamp(2, 0.0, 3.3, 500.0);
+    VirtualADC_SetSourceConstant(3, 2.5);
+    VirtualADC_SetNoise(3, 0.01);
+    VirtualADC_SetSampleTime(3, ADC_SAMPLETIME_480CYCLES);
+    VirtualADC_SetSequence(seq, 4);
+    uint16_t scan[4];
+    int in_range = 1;
+    for (int i = 0; i < 3; i++) {
+        VirtualADC_ReadSequence(scan);
+        printf("Scan %d: sine=%4d ramp=%4d 2.5V+noise=%4d temp=%4d\n",
+               i, scan[0], scan[1], scan[2], scan[3]);
+        // 2.5 V +/- 10 mV is 3103 +/- 13 codes; 0.76 V is 943
+        if (scan[2] < 3090 || scan[2] > 3116 || scan[3] != 943) in_range = 0;
+        SimClock_Advance(SimClock_UsToCycles(250));
+    }
+    check(in_range, "noisy constant and temperature sensor within range");
+    
+    // Test 4: Interrupt-driven conversions on the event scheduler
+    printf("\n--- Test 4: EOC Interrupt ---\n");
+    VirtualNVIC_SetHandler(IRQ_ADC, adc_irq_handler, "ADC");
+    VirtualNVIC_EnableIRQ(IRQ_ADC);
+    VirtualADC_EnableInterrupt(1);
+    VirtualADC_SetSequence(seq, 2);
+    uint64_t started = SimClock_GetCycles();
+    VirtualADC_Start(0);
+    while (SimSched_RunNext()) {
     }
-    return 0;
-}
\ No newline at end of file
+    VirtualADC_EnableInterrupt(0);
+    check(eoc_count == 2, "one EOC interrupt per sequence slot");
+    check(SimClock_GetCycles() - started >= VirtualADC_GetConversionCycles(1) + VirtualADC_GetConversionCycles(2),
+          "sequence took both conversion times");
+    
+    // Test 5: CSV replay
+    printf("\n--- Test 5: CSV Replay ---\n");
+    const char *csv = "adc_replay_test.csv";
+    FILE *f = fopen(csv, "w");
+    if (f != NULL) {
+        fprintf(f, "volts\n0.0\n0.825\n1.65\n3.3\n");
+        fclose(f);
+        check(VirtualADC_LoadReplayCSV(4, csv), "CSV loaded");
+        remove(csv);
+        uint16_t replay[6];
+        printf("Replay:");
+        for (int i = 0; i < 6; i++) {
+            VirtualADC_ReadChannel(4, &replay[i]);
+            printf(" %d", replay[i]);
+        }
+        printf("\n");
+        // Replay samples are floats: 0.825 V and 1.65 V land just below 1024 and 2048
+        check(replay[0] == 0 && replay[1] == 1023 && replay[2] == 2047 && replay[3] == 4095,
+              "replayed codes 0, 1023, 2047, 4095");
+        check(replay[4] == replay[0] && replay[5] == replay[1], "replay wraps after 4 samples");
+    } else {
+        sim_test_fail("cannot write adc_replay_test.csv");
+    }
+    
+    // Test 6: Timer-triggered block read (1 MSPS sine + noise)
+    printf("\n--- Test 6: Block Read Throughput ---\n");
+    uint8_t saved_level = SimLog_GetLevel();
+    SimLog_SetLevel(SIM_LOG_LEVEL_NONE);
+    const uint32_t block = 4000000;
+    uint16_t *samples = malloc(block * sizeof(uint16_t));
+    if (samples != NULL) {
+        VirtualADC_SetSourceSine(5, 1.65, 1.5, 10000.0);
+        VirtualADC_SetNoise(5, 0.005);
+        VirtualADC_SetSequence((const uint8_t[]){5}, 1);
+        VirtualADC_SetTriggerRate(1000000);
+        VirtualADC_ResetStats();
+        uint64_t sim_start = SimClock_GetTimeUs();
+        clock_t start = clock();
+        uint32_t n = VirtualADC_ReadBlock(samples, block);
+        clock_t end = clock();
+        VirtualADCStats stats;
+        VirtualADC_GetStats(&stats);
+        uint16_t lo = 4095, hi = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            if (samples[i] < lo) lo = samples[i];
+            if (samples[i] > hi) hi = samples[i];
+        }
+        printf("%lu samples (%llu us simulated) in %.3f ms, range %d..%d, overruns %lu\n",
+               (unsigned long)n, (unsigned long long)(SimClock_GetTimeUs() - sim_start),
+               (double)(end - start) * 1000.0 / CLOCKS_PER_SEC, lo, hi,
+               (unsigned long)stats.overruns);
+        check(n == block && stats.overruns == 0, "4M samples at 1 MSPS, no overruns");
+        // 1.65 V +/- 1.5 V is codes 186..3909 before noise
+        check(lo < 200 && hi > 3890, "samples span the sine");
+    
+        // A rate that does not divide the core clock keeps its long-term rate
+        VirtualADC_SetTriggerRate(7000);
+        uint64_t cycles_start = SimClock_GetCycles();
+        VirtualADC_ReadBlock(samples, 7000);
+        uint64_t f_core = SimClock_GetFrequency();
+        check(SimClock_GetCycles() - cycles_start == 6999 * f_core / 7000 + VirtualADC_GetConversionCycles(5),
+              "7 kHz trigger: 7000 samples in one second");
+    
+        // Trigger faster than the conversion time: each scan misses the
+        // triggers that arrive while it runs
+        VirtualADC_SetTriggerRate(1000000);
+        VirtualADC_SetSampleTime(5, ADC_SAMPLETIME_480CYCLES);
+        VirtualADC_ResetStats();
+        VirtualADC_ReadBlock(samples, 1000);
+        VirtualADC_GetStats(&stats);
+        uint64_t period = f_core / 1000000;
+        uint64_t missed = (VirtualADC_GetConversionCycles(5) + period - 1) / period - 1;
+        printf("480-cycle sampling at 1 MSPS: %lu overruns in 1000 samples\n",
+               (unsigned long)stats.overruns);
+        check(stats.overruns == 999 * missed, "every trigger during a scan counted as missed");
+        check(VirtualADC_GetRegs()->SR & ADC_SR_OVR, "OVR set");
+        free(samples);
+    } else {
+        sim_test_fail("cannot allocate the sample block");
+    }
+    SimLog_SetLevel(saved_level);
+    
+    return sim_test_result("Virtual ADC");
+}
+#endif  // RUN_STANDALONE_TEST
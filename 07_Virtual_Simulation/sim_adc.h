@@ -0,0 +1,103 @@
+/*
+ * sim_adc.h - Virtual ADC interface
+ * 12-bit SAR ADC model with scan sequences, signal sources and block reads
+ */
+
+#ifndef SIM_ADC_H_
+#define SIM_ADC_H_
+
+#include <stdint.h>
+
+#define ADC_CHANNELS      19  // IN0-IN15, temperature sensor, VREFINT, VBAT
+#define ADC_MAX_SEQUENCE  16  // Regular sequence length (SQR1 L + 1)
+#define ADC_CHANNEL_TEMP    16
+#define ADC_CHANNEL_VREFINT 17
+#define ADC_CHANNEL_VBAT    18
+
+#define IRQ_ADC 18  // ADC1/2/3 global interrupt (STM32F446)
+
+// Sample time codes (SMPRx), ADC clock cycles in the name
+#define ADC_SAMPLETIME_3CYCLES   0
+#define ADC_SAMPLETIME_15CYCLES  1
+#define ADC_SAMPLETIME_28CYCLES  2
+#define ADC_SAMPLETIME_56CYCLES  3
+#define ADC_SAMPLETIME_84CYCLES  4
+#define ADC_SAMPLETIME_112CYCLES 5
+#define ADC_SAMPLETIME_144CYCLES 6
+#define ADC_SAMPLETIME_480CYCLES 7
+
+// Status register flags
+#define ADC_SR_EOC   (1U << 1)  // End of conversion
+#define ADC_SR_STRT  (1U << 4)  // Regular conversion started
+#define ADC_SR_OVR   (1U << 5)  // Overrun: data lost or trigger missed
+
+// Signal source types
+#define ADC_SOURCE_CONSTANT 0
+#define ADC_SOURCE_SINE     1
+#define ADC_SOURCE_RAMP     2
+#define ADC_SOURCE_REPLAY   3
+
+// Virtual ADC register block (regular-channel subset of ADC_TypeDef, same offsets)
+typedef struct {
+    uint32_t SR;        // 0x00: status
+    uint32_t CR1;       // 0x04: RES[25:24], SCAN[8], EOCIE[5]
+    uint32_t CR2;       // 0x08: SWSTART[30], CONT[1], ADON[0]
+    uint32_t SMPR1;     // 0x0C: sample time, channels 10-18
+    uint32_t SMPR2;     // 0x10: sample time, channels 0-9
+    uint32_t JOFR[4];   // 0x14: injected offsets (not modelled)
+    uint32_t HTR;       // 0x24
+    uint32_t LTR;       // 0x28
+    uint32_t SQR1;      // 0x2C: L[23:20], SQ13-16
+    uint32_t SQR2;      // 0x30: SQ7-12
+    uint32_t SQR3;      // 0x34: SQ1-6
+    uint32_t JSQR;      // 0x38
+    uint32_t JDR[4];    // 0x3C
+    uint32_t DR;        // 0x4C: last regular conversion
+} VirtualADCRegs;
+
+// Conversion counters (reset with VirtualADC_ResetStats)
+typedef struct {
+    uint32_t conversions;
+    uint32_t overruns;  // Triggers missed because a scan was still running
+                        // (block reads) or results never read (Start)
+} VirtualADCStats;
+
+void VirtualADC_Init(void);
+VirtualADCRegs *VirtualADC_GetRegs(void);
+uint8_t VirtualADC_GetLastError(void);
+void VirtualADC_SetSeed(uint64_t seed);
+
+// Configuration
+uint8_t VirtualADC_SetResolution(uint8_t bits);
+uint8_t VirtualADC_SetPrescaler(uint8_t div);
+uint8_t VirtualADC_SetPCLK2Divider(uint8_t div);
+void VirtualADC_SetVref(double vref);
+uint8_t VirtualADC_SetSampleTime(uint8_t channel, uint8_t sample_time);
+uint8_t VirtualADC_SetSequence(const uint8_t *channels, uint8_t length);
+void VirtualADC_SetTriggerRate(uint32_t hz);
+uint64_t VirtualADC_GetConversionCycles(uint8_t channel);
+
+// Signal sources (volts at the pin; noise is uniform and adds to any source)
+uint8_t VirtualADC_SetSourceConstant(uint8_t channel, double volts);
+uint8_t VirtualADC_SetSourceSine(uint8_t channel, double offset, double amplitude, double freq_hz);
+uint8_t VirtualADC_SetSourceRamp(uint8_t channel, double low, double high, double freq_hz);
+uint8_t VirtualADC_SetNoise(uint8_t channel, double amplitude);
+uint8_t VirtualADC_LoadReplayCSV(uint8_t channel, const char *path);
+uint8_t VirtualADC_LoadReplayBinary(uint8_t channel, const char *path);
+
+// Blocking reads (advance the virtual clock by the conversion time)
+uint8_t VirtualADC_ReadChannel(uint8_t channel, uint16_t *value);
+double VirtualADC_ReadVoltage(uint8_t channel);
+uint8_t VirtualADC_ReadSequence(uint16_t *values);
+uint32_t VirtualADC_ReadBlock(uint16_t *buffer, uint32_t count);
+
+// Interrupt-driven conversion of the sequence on the event scheduler
+uint8_t VirtualADC_Start(uint8_t continuous);
+void VirtualADC_Stop(void);
+void VirtualADC_EnableInterrupt(uint8_t enable);
+uint16_t VirtualADC_GetValue(void);
+
+void VirtualADC_GetStats(VirtualADCStats *stats);
+void VirtualADC_ResetStats(void);
+
+#endif /* SIM_ADC_H_ */
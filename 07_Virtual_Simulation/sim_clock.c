@@ -0,0 +1,110 @@
+/*
+ * sim_clock.c - Virtual core clock for the simulation framework
+ * Counts simulated CPU cycles at the SYSTEM_CLOCK_HZ of the selected board
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "board_config.h"
+#include "sim_log.h"
+#include "sim_clock.h"
+
+// Virtual clock state
+static uint64_t sim_cycles = 0;
+static uint32_t sim_clock_hz = SYSTEM_CLOCK_HZ;
+static uint64_t epoch_cycles = 0;  // Cycle count at the last frequency change
+static uint64_t epoch_ns = 0;      // Time reached at that point
+static uint8_t clock_initialized = 0;
+
+// Initialize the virtual clock at the board's default core frequency
+void SimClock_Init(void) {
+    if (clock_initialized) return;
+    
+    sim_cycles = 0;
+    sim_clock_hz = SYSTEM_CLOCK_HZ;
+    epoch_cycles = 0;
+    epoch_ns = 0;
+    clock_initialized = 1;
+    SIM_LOG_INFO("[SimClock] %s core clock %lu Hz\n",
+                 BOARD_SERIES, (unsigned long)sim_clock_hz);
+}
+
+// Rewind the cycle counter to zero (frequency is kept)
+void SimClock_Reset(void) {
+    if (!clock_initialized) SimClock_Init();
+    
+    sim_cycles = 0;
+    epoch_cycles = 0;
+    epoch_ns = 0;
+}
+
+// Change the core clock frequency (e.g. after a simulated PLL switch).
+// Time already elapsed is kept; only later cycles run at the new rate.
+void SimClock_SetFrequency(uint32_t hz) {
+    if (!clock_initialized) SimClock_Init();
+    
+    if (hz == 0) {
+        SIM_LOG_ERROR("[SimClock] ERROR: Frequency must be non-zero\n");
+        return;
+    }
+    
+    epoch_ns = SimClock_CycleToTimeNs(sim_cycles);
+    epoch_cycles = sim_cycles;
+    sim_clock_hz = hz;
+    SIM_LOG_DEBUG("[SimClock] Core clock set to %lu Hz\n", (unsigned long)hz);
+}
+
+// Get core clock frequency
+uint32_t SimClock_GetFrequency(void) {
+    if (!clock_initialized) SimClock_Init();
+    
+    return sim_clock_hz;
+}
+
+// Get elapsed core cycles since reset
+uint64_t SimClock_GetCycles(void) {
+    return sim_cycles;
+}
+
+// Advance simulated time
+void SimClock_Advance(uint64_t cycles) {
+    if (!clock_initialized) SimClock_Init();
+    
+    sim_cycles += cycles;
+}
+
+// Convert milliseconds to core cycles
+uint64_t SimClock_MsToCycles(uint32_t ms) {
+    if (!clock_initialized) SimClock_Init();
+    
+    return (uint64_t)ms * sim_clock_hz / 1000U;
+}
+
+// Convert microseconds to core cycles
+uint64_t SimClock_UsToCycles(uint32_t us) {
+    if (!clock_initialized) SimClock_Init();
+    
+    return (uint64_t)us * sim_clock_hz / 1000000U;
+}
+
+// Nanoseconds since reset at a cycle count (not before the last
+// frequency change): the time reached then plus the cycles since at the
+// current frequency
+uint64_t SimClock_CycleToTimeNs(uint64_t cycle) {
+    if (!clock_initialized) SimClock_Init();
+    
+    uint64_t delta = cycle - epoch_cycles;
+    return epoch_ns + (delta / sim_clock_hz) * 1000000000U +
+           (delta % sim_clock_hz) * 1000000000U / sim_clock_hz;
+}
+
+// Milliseconds since reset (HAL_GetTick time base)
+uint32_t SimClock_GetTickMs(void) {
+    return (uint32_t)(SimClock_CycleToTimeNs(sim_cycles) / 1000000U);
+}
+
+// Microseconds since reset
+uint64_t SimClock_GetTimeUs(void) {
+    return SimClock_CycleToTimeNs(sim_cycles) / 1000U;
+}
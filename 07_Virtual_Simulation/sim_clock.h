@@ -0,0 +1,30 @@
+/*
+ * sim_clock.h - Virtual core clock for the simulation framework
+ * Global cycle counter advanced by the virtual peripherals and HAL_Delay
+ */
+
+#ifndef SIM_CLOCK_H_
+#define SIM_CLOCK_H_
+
+#include <stdint.h>
+
+// Cortex-M4 costs charged by the virtual peripherals (core clock cycles)
+#define SIM_CYCLES_GPIO_ACCESS      2   // One AHB1 GPIO register access
+#define SIM_CYCLES_APB_ACCESS       4   // One APB register access (EXTI, SYSCFG)
+#define SIM_CYCLES_IRQ_ENTRY        12  // Exception entry (stacking + vector fetch)
+#define SIM_CYCLES_IRQ_TAIL_CHAIN   6   // Handler to handler without unstacking
+#define SIM_CYCLES_IRQ_EXIT         10  // Exception return (unstacking)
+
+void SimClock_Init(void);
+void SimClock_Reset(void);
+void SimClock_SetFrequency(uint32_t hz);
+uint32_t SimClock_GetFrequency(void);
+uint64_t SimClock_GetCycles(void);
+void SimClock_Advance(uint64_t cycles);
+uint64_t SimClock_MsToCycles(uint32_t ms);
+uint64_t SimClock_UsToCycles(uint32_t us);
+uint64_t SimClock_CycleToTimeNs(uint64_t cycle);
+uint32_t SimClock_GetTickMs(void);
+uint64_t SimClock_GetTimeUs(void);
+
+#endif /* SIM_CLOCK_H_ */
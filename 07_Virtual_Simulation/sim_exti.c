@@ -0,0 +1,414 @@
+/*
+ * sim_exti.c - Virtual EXTI/SYSCFG Simulator
+ * Latches GPIO edges in EXTI->PR and raises the EXTI IRQs on the virtual NVIC
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "sim_log.h"
+#include "sim_clock.h"
+#include "sim_nvic.h"
+#include "sim_exti.h"
+
+#define EXTI_MAX_PORTS 9  // GPIOA to GPIOI
+
+// Error codes
+#define EXTI_ERROR_NONE         0
+#define EXTI_ERROR_INVALID_LINE 1
+#define EXTI_ERROR_INVALID_PORT 2
+#define EXTI_ERROR_TRIGGER      3
+
+// Charge n EXTI/SYSCFG register accesses to the virtual clock
+#define EXTI_BUS_ACCESS(n) SimClock_Advance((uint64_t)(n) * SIM_CYCLES_APB_ACCESS)
+
+// Virtual EXTI/SYSCFG state
+static VirtualEXTIRegs exti;
+static VirtualSYSCFGRegs syscfg;
+static VirtualEXTICallback line_callbacks[EXTI_GPIO_LINES];
+static uint8_t exti_initialized = 0;
+static uint8_t last_error = EXTI_ERROR_NONE;
+
+// Index of the lowest set bit (x must be non-zero)
+static inline int lowest_set_bit(uint32_t x) {
+#if defined(__GNUC__)
+    return __builtin_ctz(x);
+#else
+    int n = 0;
+    while (!(x & 1U)) { x >>= 1; n++; }
+    return n;
+#endif
+}
+
+// Source port selected in SYSCFG->EXTICR for a line
+static inline uint8_t line_port(uint8_t line) {
+    return (uint8_t)((syscfg.EXTICR[line / 4] >> (4 * (line % 4))) & 0xFU);
+}
+
+// EXTI lines served by an IRQ (0 if it is not an EXTI IRQ)
+static uint32_t irq_lines(int irq_num) {
+    switch (irq_num) {
+        case IRQ_EXTI0:     return 0x0001U;
+        case IRQ_EXTI1:     return 0x0002U;
+        case IRQ_EXTI2:     return 0x0004U;
+        case IRQ_EXTI3:     return 0x0008U;
+        case IRQ_EXTI4:     return 0x0010U;
+        case IRQ_EXTI9_5:   return 0x03E0U;
+        case IRQ_EXTI15_10: return 0xFC00U;
+        default:            return 0;
+    }
+}
+
+// NVIC handler shared by all EXTI IRQs: clear the pending lines it
+// serves and run their callbacks, lowest line first
+static void exti_irq_handler(void) {
+    uint32_t pending = exti.PR & irq_lines(VirtualNVIC_GetActiveIRQ());
+    
+    exti.PR &= ~pending;  // Write 1 to clear
+    exti.SWIER &= ~pending;
+    EXTI_BUS_ACCESS(2);
+    
+    while (pending) {
+        uint8_t line = (uint8_t)lowest_set_bit(pending);
+        pending &= pending - 1;
+    
+        if (line_callbacks[line] != NULL) {
+            line_callbacks[line](line_port(line), line);
+        } else {
+            SIM_LOG_WARN("[VirtualEXTI] WARNING: No callback for EXTI%d\n", line);
+        }
+    }
+}
+
+// Latch a line in PR and request its IRQ (masked lines are ignored)
+static uint8_t raise_line(uint8_t line) {
+    uint32_t bit = 1U << line;
+    
+    if (!(exti.IMR & bit)) {
+        return 0;
+    }
+    
+    exti.PR |= bit;
+    SIM_LOG_TRACE("[VirtualEXTI] EXTI%d pending, raising IRQ %d\n",
+                  line, VirtualEXTI_LineToIRQ(line));
+    VirtualNVIC_SetPending(VirtualEXTI_LineToIRQ(line));
+    return 1;
+}
+
+// Initialize EXTI/SYSCFG and install the EXTI IRQ handlers on the NVIC
+void VirtualEXTI_Init(void) {
+    if (exti_initialized) return;
+    
+    static const struct { uint8_t irq; const char *name; } exti_irqs[] = {
+        {IRQ_EXTI0, "EXTI0"}, {IRQ_EXTI1, "EXTI1"}, {IRQ_EXTI2, "EXTI2"},
+        {IRQ_EXTI3, "EXTI3"}, {IRQ_EXTI4, "EXTI4"}, {IRQ_EXTI9_5, "EXTI9_5"},
+        {IRQ_EXTI15_10, "EXTI15_10"},
+    };
+    
+    memset(&exti, 0, sizeof(exti));
+    memset(&syscfg, 0, sizeof(syscfg));
+    memset(line_callbacks, 0, sizeof(line_callbacks));
+    exti_initialized = 1;
+    
+    for (size_t i = 0; i < sizeof(exti_irqs) / sizeof(exti_irqs[0]); i++) {
+        VirtualNVIC_SetHandler(exti_irqs[i].irq, exti_irq_handler, exti_irqs[i].name);
+    }
+    
+    SIM_LOG_INFO("[VirtualEXTI] Initialized %d GPIO lines\n", EXTI_GPIO_LINES);
+}
+
+// Get the EXTI register block (PR bits may be cleared directly by user handlers)
+VirtualEXTIRegs *VirtualEXTI_GetRegs(void) {
+    if (!exti_initialized) VirtualEXTI_Init();
+    
+    return &exti;
+}
+
+// Get the SYSCFG register block
+VirtualSYSCFGRegs *VirtualSYSCFG_GetRegs(void) {
+    if (!exti_initialized) VirtualEXTI_Init();
+    
+    return &syscfg;
+}
+
+// Get last error code
+uint8_t VirtualEXTI_GetLastError(void) {
+    return last_error;
+}
+
+// NVIC IRQ number of an EXTI line (0xFF for lines without a GPIO IRQ)
+uint8_t VirtualEXTI_LineToIRQ(uint8_t line) {
+    if (line <= 4) return (uint8_t)(IRQ_EXTI0 + line);
+    if (line <= 9) return IRQ_EXTI9_5;
+    if (line < EXTI_GPIO_LINES) return IRQ_EXTI15_10;
+    return 0xFF;
+}
+
+// Route a line to a GPIO port and select its trigger edges (SYSCFG->EXTICR,
+// RTSR, FTSR, IMR). EXTI_TRIGGER_NONE releases the line if the port owns it.
+uint8_t VirtualEXTI_ConfigureLine(uint8_t line, uint8_t port, uint8_t trigger) {
+    if (!exti_initialized) VirtualEXTI_Init();
+    
+    if (line >= EXTI_GPIO_LINES) {
+        last_error = EXTI_ERROR_INVALID_LINE;
+        SIM_LOG_ERROR("[VirtualEXTI] ERROR: Invalid EXTI line %d\n", line);
+        return 0;
+    }
+    
+    if (port >= EXTI_MAX_PORTS) {
+        last_error = EXTI_ERROR_INVALID_PORT;
+        SIM_LOG_ERROR("[VirtualEXTI] ERROR: Invalid port %d\n", port);
+        return 0;
+    }
+    
+    if (trigger > EXTI_TRIGGER_BOTH) {
+        last_error = EXTI_ERROR_TRIGGER;
+        SIM_LOG_ERROR("[VirtualEXTI] ERROR: Invalid trigger %d\n", trigger);
+        return 0;
+    }
+    
+    uint32_t bit = 1U << line;
+    uint8_t shift = (uint8_t)(4 * (line % 4));
+    
+    if (trigger == EXTI_TRIGGER_NONE) {
+        if (line_port(line) == port) {
+            exti.IMR &= ~bit;
+            exti.RTSR &= ~bit;
+            exti.FTSR &= ~bit;
+            syscfg.EXTICR[line / 4] &= ~(0xFU << shift);
+            EXTI_BUS_ACCESS(4);
+        }
+        last_error = EXTI_ERROR_NONE;
+        return 1;
+    }
+    
+    syscfg.EXTICR[line / 4] = (syscfg.EXTICR[line / 4] & ~(0xFU << shift)) |
+                              ((uint32_t)port << shift);
+    exti.RTSR = (trigger & EXTI_TRIGGER_RISING) ? (exti.RTSR | bit) : (exti.RTSR & ~bit);
+    exti.FTSR = (trigger & EXTI_TRIGGER_FALLING) ? (exti.FTSR | bit) : (exti.FTSR & ~bit);
+    exti.IMR |= bit;
+    EXTI_BUS_ACCESS(4);
+    
+    SIM_LOG_DEBUG("[VirtualEXTI] EXTI%d <- GPIO%c (%s%s), IRQ %d\n",
+                  line, 'A' + port,
+                  (trigger & EXTI_TRIGGER_RISING) ? "R" : "",
+                  (trigger & EXTI_TRIGGER_FALLING) ? "F" : "",
+                  VirtualEXTI_LineToIRQ(line));
+    
+    last_error = EXTI_ERROR_NONE;
+    return 1;
+}
+
+// Register the callback run when a line is serviced
+uint8_t VirtualEXTI_SetCallback(uint8_t line, VirtualEXTICallback callback) {
+    if (!exti_initialized) VirtualEXTI_Init();
+    
+    if (line >= EXTI_GPIO_LINES) {
+        last_error = EXTI_ERROR_INVALID_LINE;
+        return 0;
+    }
+    
+    line_callbacks[line] = callback;
+    last_error = EXTI_ERROR_NONE;
+    return 1;
+}
+
+// Lines routed from a port with their interrupt unmasked
+uint16_t VirtualEXTI_GetPortLines(uint8_t port) {
+    if (!exti_initialized) VirtualEXTI_Init();
+    
+    uint16_t lines = 0;
+    uint32_t unmasked = exti.IMR & 0xFFFFU;
+    
+    while (unmasked) {
+        uint8_t line = (uint8_t)lowest_set_bit(unmasked);
+        unmasked &= unmasked - 1;
+        if (line_port(line) == port) {
+            lines |= (uint16_t)(1U << line);
+        }
+    }
+    return lines;
+}
+
+// Edge on a GPIO pin (edge: 1 = rising, 0 = falling). Returns 1 if the
+// edge was latched, 0 if the line belongs to another port, the edge is
+// not selected or the line is masked.
+uint8_t VirtualEXTI_SignalEdge(uint8_t port, uint8_t pin, uint8_t edge) {
+    if (!exti_initialized) VirtualEXTI_Init();
+    
+    if (pin >= EXTI_GPIO_LINES || port >= EXTI_MAX_PORTS) {
+        last_error = EXTI_ERROR_INVALID_LINE;
+        return 0;
+    }
+    
+    uint32_t trigger = edge ? exti.RTSR : exti.FTSR;
+    if (line_port(pin) != port || !(trigger & (1U << pin))) {
+        return 0;
+    }
+    
+    return raise_line(pin);
+}
+
+// Software interrupt: same path as an edge, regardless of trigger selection
+uint8_t VirtualEXTI_GenerateSWI(uint8_t line) {
+    if (!exti_initialized) VirtualEXTI_Init();
+    
+    if (line >= EXTI_GPIO_LINES) {
+        last_error = EXTI_ERROR_INVALID_LINE;
+        return 0;
+    }
+    
+    exti.SWIER |= 1U << line;
+    EXTI_BUS_ACCESS(1);
+    return raise_line(line);
+}
+
+// Get EXTI pending register
+uint32_t VirtualEXTI_GetPending(void) {
+    if (!exti_initialized) VirtualEXTI_Init();
+    
+    EXTI_BUS_ACCESS(1);
+    return exti.PR;
+}
+
+// Clear pending lines (write 1 to clear, also clears their SWIER bits)
+void VirtualEXTI_ClearPending(uint32_t line_mask) {
+    if (!exti_initialized) VirtualEXTI_Init();
+    
+    exti.PR &= ~line_mask;
+    exti.SWIER &= ~line_mask;
+    EXTI_BUS_ACCESS(1);
+}
+
+// Print EXTI/SYSCFG state
+void VirtualEXTI_PrintState(void) {
+    if (!exti_initialized) VirtualEXTI_Init();
+    
+    printf("\n=== Virtual EXTI State ===\n");
+    printf("IMR=0x%04X RTSR=0x%04X FTSR=0x%04X SWIER=0x%04X PR=0x%04X\n",
+           (unsigned)exti.IMR, (unsigned)exti.RTSR, (unsigned)exti.FTSR,
+           (unsigned)exti.SWIER, (unsigned)exti.PR);
+    printf("EXTICR1-4: 0x%04X 0x%04X 0x%04X 0x%04X\n",
+           (unsigned)syscfg.EXTICR[0], (unsigned)syscfg.EXTICR[1],
+           (unsigned)syscfg.EXTICR[2], (unsigned)syscfg.EXTICR[3]);
+    printf("Line | Source | Edge | IRQ | Pend\n");
+    printf("-----+--------+------+-----+-----\n");
+    
+    for (uint8_t line = 0; line < EXTI_GPIO_LINES; line++) {
+        uint32_t bit = 1U << line;
+        if (!(exti.IMR & bit)) continue;
+        printf(" %2d  |  P%c%-2d  |  %s%s  | %3d |  %s\n",
+               line, 'A' + line_port(line), line,
+               (exti.RTSR & bit) ? "R" : "-", (exti.FTSR & bit) ? "F" : "-",
+               VirtualEXTI_LineToIRQ(line), (exti.PR & bit) ? "Y" : "N");
+    }
+    printf("==========================\n\n");
+}
+
+#ifdef RUN_STANDALONE_TEST
+#include "sim_test.h"
+
+static unsigned line_hits[EXTI_GPIO_LINES];
+static uint8_t line_order[8];
+static unsigned line_order_len = 0;
+
+static void line_callback(uint8_t port, uint8_t pin) {
+    line_hits[pin]++;
+    if (line_order_len < sizeof(line_order)) line_order[line_order_len++] = pin;
+    printf("  [Callback] EXTI%d from P%c%d (NVIC depth %d)\n",
+           pin, 'A' + port, pin, VirtualNVIC_GetActiveDepth());
+}
+
+// Test function - only compiled when RUN_STANDALONE_TEST is defined
+int main(void) {
+    printf("=== Virtual EXTI Test ===\n\n");
+    
+    VirtualEXTI_Init();
+    for (uint8_t line = 0; line < EXTI_GPIO_LINES; line++) {
+        VirtualEXTI_SetCallback(line, line_callback);
+    }
+    
+    // Test 1: PC13 falling edge through SYSCFG, EXTI and NVIC
+    printf("--- Test 1: PC13 Falling Edge ---\n");
+    VirtualEXTI_ConfigureLine(13, 2, EXTI_TRIGGER_FALLING);
+    VirtualNVIC_EnableIRQ(IRQ_EXTI15_10);
+    VirtualEXTI_SignalEdge(2, 13, 0);
+    VirtualNVIC_ProcessInterrupts();
+    check(line_hits[13] == 1 && VirtualEXTI_GetPending() == 0, "PC13 falling edge handled, PR cleared");
+    check(VirtualEXTI_SignalEdge(2, 13, 1) == 0, "rising edge not latched (falling trigger)");
+    check(VirtualEXTI_SignalEdge(0, 13, 0) == 0, "PA13 edge not latched (line owned by GPIOC)");
+    
+    // Test 2: Global mask holds the request until interrupts are re-enabled
+    printf("\n--- Test 2: Global Interrupt Mask ---\n");
+    VirtualNVIC_DisableGlobalIRQ();
+    VirtualEXTI_SignalEdge(2, 13, 0);
+    VirtualNVIC_ProcessInterrupts();
+    printf("Masked: PR=0x%04X, IRQ pending=%d\n",
+           (unsigned)VirtualEXTI_GetPending(), VirtualNVIC_IsPending(IRQ_EXTI15_10));
+    check(VirtualEXTI_GetPending() == (1U << 13) && VirtualNVIC_IsPending(IRQ_EXTI15_10) &&
+          line_hits[13] == 1, "masked: PR13 and the IRQ stay pending");
+    VirtualNVIC_EnableGlobalIRQ();
+    VirtualNVIC_ProcessInterrupts();
+    printf("Unmasked: PR=0x%04X\n", (unsigned)VirtualEXTI_GetPending());
+    check(VirtualEXTI_GetPending() == 0 && line_hits[13] == 2, "unmasked: handled once, PR cleared");
+    
+    // Test 3: NVIC priority decides which line is serviced first
+    printf("\n--- Test 3: Priority Between Lines ---\n");
+    VirtualEXTI_ConfigureLine(0, 0, EXTI_TRIGGER_RISING);   // PA0
+    VirtualEXTI_ConfigureLine(1, 0, EXTI_TRIGGER_FALLING);  // PA1
+    VirtualNVIC_SetPriority(IRQ_EXTI0, 3);
+    VirtualNVIC_SetPriority(IRQ_EXTI1, 1);
+    VirtualNVIC_EnableIRQ(IRQ_EXTI0);
+    VirtualNVIC_EnableIRQ(IRQ_EXTI1);
+    VirtualEXTI_SignalEdge(0, 0, 1);
+    VirtualEXTI_SignalEdge(0, 1, 0);
+    printf("Expect EXTI1 (priority 1) before EXTI0 (priority 3):\n");
+    line_order_len = 0;
+    VirtualNVIC_ProcessInterrupts();
+    check(line_order_len == 2 && line_order[0] == 1 && line_order[1] == 0,
+          "EXTI1 (priority 1) before EXTI0 (priority 3)");
+    
+    // Test 4: Lines 5-9 share one IRQ and one handler run
+    printf("\n--- Test 4: Shared EXTI9_5 Handler ---\n");
+    VirtualEXTI_ConfigureLine(5, 1, EXTI_TRIGGER_BOTH);     // PB5
+    VirtualEXTI_ConfigureLine(7, 1, EXTI_TRIGGER_RISING);   // PB7
+    VirtualNVIC_EnableIRQ(IRQ_EXTI9_5);
+    VirtualNVIC_ResetStats();
+    VirtualEXTI_SignalEdge(1, 7, 1);
+    VirtualEXTI_SignalEdge(1, 5, 0);
+    VirtualNVIC_ProcessInterrupts();
+    VirtualNVICStats stats;
+    VirtualNVIC_GetStats(&stats);
+    printf("Handler runs: %u, latency %u cycles\n",
+           (unsigned)stats.dispatched, (unsigned)stats.last_latency_cycles);
+    check(stats.dispatched == 1 && line_hits[5] == 1 && line_hits[7] == 1,
+          "one EXTI9_5 handler run serves lines 5 and 7");
+    
+    // Test 5: Disabled NVIC line keeps the EXTI request latched
+    printf("\n--- Test 5: NVIC Line Disabled ---\n");
+    VirtualNVIC_DisableIRQ(IRQ_EXTI0);
+    VirtualEXTI_SignalEdge(0, 0, 1);
+    VirtualNVIC_ProcessInterrupts();
+    printf("EXTI0 hits: %u, PR=0x%04X\n",
+           line_hits[0], (unsigned)VirtualEXTI_GetPending());
+    check(line_hits[0] == 1 && (VirtualEXTI_GetPending() & 1U),
+          "disabled IRQ: no handler run, PR0 stays latched");
+    VirtualEXTI_ClearPending(1U << 0);
+    VirtualNVIC_ClearPending(IRQ_EXTI0);
+    
+    // Test 6: Software interrupt and release
+    printf("\n--- Test 6: Software Interrupt ---\n");
+    VirtualEXTI_ConfigureLine(2, 3, EXTI_TRIGGER_RISING);   // PD2
+    VirtualNVIC_EnableIRQ(IRQ_EXTI2);
+    VirtualEXTI_GenerateSWI(2);
+    VirtualNVIC_ProcessInterrupts();
+    check(line_hits[2] == 1, "software interrupt runs the EXTI2 handler");
+    VirtualEXTI_ConfigureLine(2, 3, EXTI_TRIGGER_NONE);
+    check(VirtualEXTI_SignalEdge(3, 2, 1) == 0, "released line no longer latches");
+    
+    VirtualEXTI_PrintState();
+    
+    return sim_test_result("Virtual EXTI");
+}
+#endif  // RUN_STANDALONE_TEST
@@ -0,0 +1,64 @@
+/*
+ * sim_exti.h - Virtual EXTI/SYSCFG interface
+ * Routes GPIO edges to EXTI lines and raises the matching NVIC IRQs
+ */
+
+#ifndef SIM_EXTI_H_
+#define SIM_EXTI_H_
+
+#include <stdint.h>
+
+// EXTI IRQ numbers (STM32F446, same as exti_gpio_interrupt.c)
+#define IRQ_EXTI0       6
+#define IRQ_EXTI1       7
+#define IRQ_EXTI2       8
+#define IRQ_EXTI3       9
+#define IRQ_EXTI4       10
+#define IRQ_EXTI9_5     23
+#define IRQ_EXTI15_10   40
+
+#define EXTI_GPIO_LINES 16  // Lines 0-15 come from GPIO pins
+
+// Trigger selection for VirtualEXTI_ConfigureLine
+#define EXTI_TRIGGER_NONE    0  // Release the line (IMR, RTSR, FTSR cleared)
+#define EXTI_TRIGGER_RISING  1
+#define EXTI_TRIGGER_FALLING 2
+#define EXTI_TRIGGER_BOTH    3
+
+// Virtual EXTI register block (same layout as EXTI_RegDef_t)
+typedef struct {
+    uint32_t IMR;    // 0x00: interrupt mask
+    uint32_t EMR;    // 0x04: event mask
+    uint32_t RTSR;   // 0x08: rising trigger selection
+    uint32_t FTSR;   // 0x0C: falling trigger selection
+    uint32_t SWIER;  // 0x10: software interrupt event
+    uint32_t PR;     // 0x14: pending, write 1 to clear
+} VirtualEXTIRegs;
+
+// Virtual SYSCFG register block (same layout as SYSCFG_RegDef_t)
+typedef struct {
+    uint32_t MEMRMP;
+    uint32_t PMC;
+    uint32_t EXTICR[4];  // 4 bits per line: source port (0 = A ... 8 = I)
+    uint32_t RESERVED[2];
+    uint32_t CMPCR;
+} VirtualSYSCFGRegs;
+
+// Line callback, run from the EXTI IRQ handler after the pending bit is cleared
+typedef void (*VirtualEXTICallback)(uint8_t port, uint8_t pin);
+
+void VirtualEXTI_Init(void);
+VirtualEXTIRegs *VirtualEXTI_GetRegs(void);
+VirtualSYSCFGRegs *VirtualSYSCFG_GetRegs(void);
+uint8_t VirtualEXTI_GetLastError(void);
+uint8_t VirtualEXTI_LineToIRQ(uint8_t line);
+uint8_t VirtualEXTI_ConfigureLine(uint8_t line, uint8_t port, uint8_t trigger);
+uint8_t VirtualEXTI_SetCallback(uint8_t line, VirtualEXTICallback callback);
+uint16_t VirtualEXTI_GetPortLines(uint8_t port);
+uint8_t VirtualEXTI_SignalEdge(uint8_t port, uint8_t pin, uint8_t edge);
+uint8_t VirtualEXTI_GenerateSWI(uint8_t line);
+uint32_t VirtualEXTI_GetPending(void);
+void VirtualEXTI_ClearPending(uint32_t line_mask);
+void VirtualEXTI_PrintState(void);
+
+#endif /* SIM_EXTI_H_ */
@@ -9,8 +9,16 @@
 #include <string.h>
 #include <time.h>
 
+#include "sim_log.h"
+#include "sim_gpio.h"
+#include "sim_clock.h"
+#include "sim_nvic.h"
+#include "sim_exti.h"
+#include "sim_rand.h"
+
 #define MAX_GPIO_PORTS 9  // GPIOA to GPIOI
 #define MAX_GPIO_PINS 16  // 0-15 pins per port
+#define MAX_OUTPUT_LISTENERS 4
 
 // GPIO Pin Modes
 #define GPIO_MODE_INPUT     0
@@ -44,64 +52,188 @@
 #define GPIO_ERROR_INTERRUPT    4
 #define GPIO_ERROR_PINMUX       5
 
-// Virtual GPIO Pin State
-typedef struct {
-    uint8_t mode;           // Pin mode
-    uint8_t output_type;    // Push-pull or open-drain
-    uint8_t speed;          // Speed setting
-    uint8_t pupd;           // Pull-up/pull-down
-    uint8_t alt_function;   // Alternate function (0-15)
-    uint8_t value;          // Current pin value (0 or 1)
-    uint8_t irq_enabled;    // Interrupt enabled flag
-    void (*irq_handler)(uint8_t port, uint8_t pin); // Interrupt callback
-} VirtualGPIOPin;
-
-// Virtual GPIO Port
+// Virtual GPIO Port (edge detection lives in the virtual EXTI, sim_exti.c)
 typedef struct {
-    VirtualGPIOPin pins[MAX_GPIO_PINS];
+    VirtualGPIORegs regs;
     uint8_t clock_enabled;
     char name;  // 'A' to 'I'
 } VirtualGPIOPort;
 
+// Charge n GPIO register accesses to the virtual clock
+#define GPIO_BUS_ACCESS(n) SimClock_Advance((uint64_t)(n) * SIM_CYCLES_GPIO_ACCESS)
+
 // Global GPIO state
 static VirtualGPIOPort gpio_ports[MAX_GPIO_PORTS];
 static uint8_t gpio_initialized = 0;
 static uint8_t error_injection_enabled = 0;
 static uint8_t last_error = GPIO_ERROR_NONE;
+static SimRand gpio_rng;  // Floating inputs and error injection
+
+// Models watching output latches (chip selects of virtual SPI devices)
+static struct {
+    VirtualGPIOOutputListener fn;
+    void *ctx;
+} output_listeners[MAX_OUTPUT_LISTENERS];
+static uint8_t output_listener_count = 0;
+
+// Gather bit 0 of each 2-bit field into a 16-bit pin mask
+static uint16_t compress_pairs(uint32_t x) {
+    x &= 0x55555555U;
+    x = (x | (x >> 1)) & 0x33333333U;
+    x = (x | (x >> 2)) & 0x0F0F0F0FU;
+    x = (x | (x >> 4)) & 0x00FF00FFU;
+    x = (x | (x >> 8)) & 0x0000FFFFU;
+    return (uint16_t)x;
+}
+
+// Pins whose 2-bit field in reg equals value (0-3)
+static uint16_t field_match_mask(uint32_t reg, uint8_t value) {
+    uint32_t pattern = 0x55555555U * value;
+    uint32_t diff = reg ^ pattern;  // 00 where field matches
+    return compress_pairs(~(diff | (diff >> 1)));
+}
+
+// Spread a 16-bit pin mask to a 32-bit mask covering each pin's 2-bit field
+static uint32_t expand_pairs(uint16_t mask) {
+    uint32_t x = mask;
+    x = (x | (x << 8)) & 0x00FF00FFU;
+    x = (x | (x << 4)) & 0x0F0F0F0FU;
+    x = (x | (x << 2)) & 0x33333333U;
+    x = (x | (x << 1)) & 0x55555555U;
+    return x * 0x3U;
+}
+
+// Spread an 8-bit pin mask to a 32-bit mask covering each pin's AFR nibble
+static uint32_t expand_nibbles(uint8_t mask) {
+    uint32_t x = mask;
+    x = (x | (x << 12)) & 0x000F000FU;
+    x = (x | (x << 6)) & 0x03030303U;
+    x = (x | (x << 3)) & 0x11111111U;
+    return x * 0xFU;
+}
+
+// Replace the 2-bit field of every pin in mask with value
+static void set_fields2(uint32_t *reg, uint16_t mask, uint32_t value) {
+    uint32_t field_mask = expand_pairs(mask);
+    *reg = (*reg & ~field_mask) | (field_mask & (0x55555555U * (value & 0x3U)));
+}
+
+// EXTI trigger selection for a pin mode (NONE for non-interrupt modes)
+static uint8_t exti_trigger(uint8_t mode) {
+    switch (mode) {
+        case GPIO_MODE_IT_RISING:  return EXTI_TRIGGER_RISING;
+        case GPIO_MODE_IT_FALLING: return EXTI_TRIGGER_FALLING;
+        case GPIO_MODE_IT_BOTH:    return EXTI_TRIGGER_BOTH;
+        default:                   return EXTI_TRIGGER_NONE;
+    }
+}
+
+// Apply one configuration to every pin in mask, one store per register.
+// Interrupt modes are inputs routed to their EXTI line; any other mode
+// releases EXTI lines this port owned (as HAL_GPIO_Init does).
+static void port_configure(VirtualGPIOPort *gp, uint16_t mask, uint8_t mode,
+                           uint8_t output_type, uint8_t speed, uint8_t pupd) {
+    VirtualGPIORegs *r = &gp->regs;
+    uint8_t port = (uint8_t)(gp->name - 'A');
+    uint8_t trigger = exti_trigger(mode);
+    
+    set_fields2(&r->MODER, mask, (mode <= GPIO_MODE_ANALOG) ? mode : GPIO_MODE_INPUT);
+    r->OTYPER = (r->OTYPER & ~(uint32_t)mask) | (output_type ? mask : 0U);
+    set_fields2(&r->OSPEEDR, mask, speed);
+    set_fields2(&r->PUPDR, mask, pupd);
+    
+    // Only lines this port may own need touching when releasing
+    uint16_t lines = (trigger == EXTI_TRIGGER_NONE) ? (mask & VirtualEXTI_GetPortLines(port)) : mask;
+    for (uint8_t pin = 0; lines; pin++, lines >>= 1) {
+        if (lines & 1U) {
+            VirtualEXTI_ConfigureLine(pin, port, trigger);
+        }
+    }
+}
+
+// Sample the pins selected by mask into IDR and return the new IDR
+// Non-input pins read back the ODR latch; inputs follow their pull
+// resistor and floating inputs read random levels
+static uint16_t port_sample_inputs(VirtualGPIOPort *gp, uint16_t mask) {
+    VirtualGPIORegs *r = &gp->regs;
+    uint16_t in = field_match_mask(r->MODER, GPIO_MODE_INPUT) & mask;
+    uint16_t pu = field_match_mask(r->PUPDR, GPIO_PUPD_UP);
+    uint16_t pd = field_match_mask(r->PUPDR, GPIO_PUPD_DOWN);
+    uint16_t floating = in & (uint16_t)~(pu | pd);
+    uint16_t level = (uint16_t)(r->ODR & ~in) | (in & pu);
+    
+    if (floating) {
+        level |= floating & (uint16_t)SimRand_Next(&gpio_rng);  // Simulate floating inputs
+    }
+    
+    r->IDR = (r->IDR & ~(uint32_t)mask) | (level & mask);
+    return (uint16_t)r->IDR;
+}
+
+// Load the ODR latch and tell the output listeners if it changed
+static void port_set_odr(VirtualGPIOPort *gp, uint16_t value) {
+    uint16_t old_odr = (uint16_t)gp->regs.ODR;
+    
+    gp->regs.ODR = value;
+    if (value == old_odr) return;
+    
+    for (uint8_t i = 0; i < output_listener_count; i++) {
+        output_listeners[i].fn(output_listeners[i].ctx, (uint8_t)(gp - gpio_ports), old_odr, value);
+    }
+}
+
+// Apply a BSRR write: low half sets, high half resets (set wins)
+static void port_write_bsrr(VirtualGPIOPort *gp, uint32_t bsrr) {
+    port_set_odr(gp, (uint16_t)((gp->regs.ODR & ~(bsrr >> 16) & 0xFFFFU) | (bsrr & 0xFFFFU)));
+}
 
 // Function to initialize virtual GPIO system
 void VirtualGPIO_Init(void) {
     if (gpio_initialized) return;
     
-    srand(time(NULL));
+    SimRand_SeedStream(&gpio_rng, SIM_RAND_STREAM_GPIO);
     
-    // Initialize all ports
+    // Initialize all ports to reset state
+    memset(gpio_ports, 0, sizeof(gpio_ports));
     for (int port = 0; port < MAX_GPIO_PORTS; port++) {
         gpio_ports[port].name = 'A' + port;
-        gpio_ports[port].clock_enabled = 0;
-        
-        // Initialize all pins to default state
-        for (int pin = 0; pin < MAX_GPIO_PINS; pin++) {
-            gpio_ports[port].pins[pin].mode = GPIO_MODE_INPUT;
-            gpio_ports[port].pins[pin].output_type = GPIO_OTYPE_PP;
-            gpio_ports[port].pins[pin].speed = GPIO_SPEED_LOW;
-            gpio_ports[port].pins[pin].pupd = GPIO_PUPD_NONE;
-            gpio_ports[port].pins[pin].alt_function = 0;
-            gpio_ports[port].pins[pin].value = 0;
-            gpio_ports[port].pins[pin].irq_enabled = 0;
-            gpio_ports[port].pins[pin].irq_handler = NULL;
-        }
     }
     
     gpio_initialized = 1;
-    printf("[VirtualGPIO] Initialized %d GPIO ports with %d pins each\n", 
-           MAX_GPIO_PORTS, MAX_GPIO_PINS);
+    SIM_LOG_INFO("[VirtualGPIO] Initialized %d GPIO ports with %d pins each\n", 
+                 MAX_GPIO_PORTS, MAX_GPIO_PINS);
+}
+
+// Get the register block of a port (NULL for invalid port)
+// Configuration registers may be read and written directly; call
+// VirtualGPIO_SyncInputs() before reading IDR to refresh input levels
+VirtualGPIORegs *VirtualGPIO_GetRegs(uint8_t port) {
+    if (!gpio_initialized) VirtualGPIO_Init();
+    
+    if (port >= MAX_GPIO_PORTS) {
+        last_error = GPIO_ERROR_INVALID_PORT;
+        return NULL;
+    }
+    
+    return &gpio_ports[port].regs;
+}
+
+// Refresh IDR from the current pin configuration (all 16 pins)
+void VirtualGPIO_SyncInputs(uint8_t port) {
+    if (!gpio_initialized) VirtualGPIO_Init();
+    
+    if (port >= MAX_GPIO_PORTS) {
+        last_error = GPIO_ERROR_INVALID_PORT;
+        return;
+    }
+    
+    port_sample_inputs(&gpio_ports[port], 0xFFFFU);
 }
 
 // Enable/disable error injection for testing
 void VirtualGPIO_SetErrorInjection(uint8_t enable) {
     error_injection_enabled = enable;
-    printf("[VirtualGPIO] Error injection %s\n", enable ? "ENABLED" : "DISABLED");
+    SIM_LOG_INFO("[VirtualGPIO] Error injection %s\n", enable ? "ENABLED" : "DISABLED");
 }
 
 // Get last error code
@@ -109,14 +241,37 @@ uint8_t VirtualGPIO_GetLastError(void) {
     return last_error;
 }
 
+// Reseed floating inputs and error injection (replays the same sequence)
+void VirtualGPIO_SetSeed(uint64_t seed) {
+    if (!gpio_initialized) VirtualGPIO_Init();
+    
+    SimRand_Seed(&gpio_rng, seed);
+}
+
+// Call fn(ctx, port, old_odr, new_odr) whenever an output latch changes,
+// e.g. so a virtual SPI device sees its chip select. Listeners run in the
+// middle of a register access and must not call back into the GPIO API.
+uint8_t VirtualGPIO_AddOutputListener(VirtualGPIOOutputListener fn, void *ctx) {
+    if (fn == NULL || output_listener_count == MAX_OUTPUT_LISTENERS) {
+        last_error = GPIO_ERROR_CONFIG;
+        return 0;
+    }
+    
+    output_listeners[output_listener_count].fn = fn;
+    output_listeners[output_listener_count].ctx = ctx;
+    output_listener_count++;
+    last_error = GPIO_ERROR_NONE;
+    return 1;
+}
+
 // Simulate random errors when error injection is enabled
 static uint8_t inject_error(void) {
     if (!error_injection_enabled) return 0;
     
     // 10% chance of error when injection is enabled
-    if (rand() % 10 == 0) {
-        last_error = (rand() % 5) + 1;  // Errors 1-5
-        printf("[VirtualGPIO] ERROR INJECTED: Code %d\n", last_error);
+    if (SimRand_OneIn(&gpio_rng, 10)) {
+        last_error = (uint8_t)(SimRand_Below(&gpio_rng, 5) + 1);  // Errors 1-5
+        SIM_LOG_WARN("[VirtualGPIO] ERROR INJECTED: Code %d\n", last_error);
         return 1;
     }
     return 0;
@@ -134,7 +289,7 @@ uint8_t VirtualGPIO_EnableClock(uint8_t port) {
     if (inject_error()) return 0;
     
     gpio_ports[port].clock_enabled = 1;
-    printf("[VirtualGPIO] Clock enabled for GPIO%c\n", gpio_ports[port].name);
+    SIM_LOG_INFO("[VirtualGPIO] Clock enabled for GPIO%c\n", gpio_ports[port].name);
     return 1;
 }
 
@@ -145,34 +300,67 @@ uint8_t VirtualGPIO_ConfigurePin(uint8_t port, uint8_t pin, uint8_t mode,
     
     if (port >= MAX_GPIO_PORTS) {
         last_error = GPIO_ERROR_INVALID_PORT;
-        printf("[VirtualGPIO] ERROR: Invalid port %d\n", port);
+        SIM_LOG_ERROR("[VirtualGPIO] ERROR: Invalid port %d\n", port);
         return 0;
     }
     
     if (pin >= MAX_GPIO_PINS) {
         last_error = GPIO_ERROR_INVALID_PIN;
-        printf("[VirtualGPIO] ERROR: Invalid pin %d\n", pin);
+        SIM_LOG_ERROR("[VirtualGPIO] ERROR: Invalid pin %d\n", pin);
         return 0;
     }
     
     if (!gpio_ports[port].clock_enabled) {
         last_error = GPIO_ERROR_CONFIG;
-        printf("[VirtualGPIO] ERROR: Clock not enabled for GPIO%c\n", 
-               gpio_ports[port].name);
+        SIM_LOG_ERROR("[VirtualGPIO] ERROR: Clock not enabled for GPIO%c\n", 
+                      gpio_ports[port].name);
         return 0;
     }
     
     if (inject_error()) return 0;
     
     // Configure the pin
-    VirtualGPIOPin *p = &gpio_ports[port].pins[pin];
-    p->mode = mode;
-    p->output_type = output_type;
-    p->speed = speed;
-    p->pupd = pupd;
+    port_configure(&gpio_ports[port], (uint16_t)(1U << pin), mode, output_type, speed, pupd);
+    GPIO_BUS_ACCESS(8);  // Read-modify-write of MODER, OTYPER, OSPEEDR, PUPDR
+    
+    SIM_LOG_DEBUG("[VirtualGPIO] Configured GPIO%c.%d: Mode=%d, Type=%d, Speed=%d, PUPD=%d\n",
+                  gpio_ports[port].name, pin, mode, output_type, speed, pupd);
+    
+    last_error = GPIO_ERROR_NONE;
+    return 1;
+}
+
+// Configure every pin in pin_mask with the same settings
+uint8_t VirtualGPIO_ConfigurePins(uint8_t port, uint16_t pin_mask, uint8_t mode,
+                                  uint8_t output_type, uint8_t speed, uint8_t pupd) {
+    if (!gpio_initialized) VirtualGPIO_Init();
+    
+    if (port >= MAX_GPIO_PORTS) {
+        last_error = GPIO_ERROR_INVALID_PORT;
+        SIM_LOG_ERROR("[VirtualGPIO] ERROR: Invalid port %d\n", port);
+        return 0;
+    }
+    
+    if (pin_mask == 0) {
+        last_error = GPIO_ERROR_INVALID_PIN;
+        SIM_LOG_ERROR("[VirtualGPIO] ERROR: Empty pin mask\n");
+        return 0;
+    }
     
-    printf("[VirtualGPIO] Configured GPIO%c.%d: Mode=%d, Type=%d, Speed=%d, PUPD=%d\n",
-           gpio_ports[port].name, pin, mode, output_type, speed, pupd);
+    if (!gpio_ports[port].clock_enabled) {
+        last_error = GPIO_ERROR_CONFIG;
+        SIM_LOG_ERROR("[VirtualGPIO] ERROR: Clock not enabled for GPIO%c\n", 
+                      gpio_ports[port].name);
+        return 0;
+    }
+    
+    if (inject_error()) return 0;
+    
+    port_configure(&gpio_ports[port], pin_mask, mode, output_type, speed, pupd);
+    GPIO_BUS_ACCESS(8);  // Read-modify-write of MODER, OTYPER, OSPEEDR, PUPDR
+    
+    SIM_LOG_DEBUG("[VirtualGPIO] Configured GPIO%c mask 0x%04X: Mode=%d, Type=%d, Speed=%d, PUPD=%d\n",
+                  gpio_ports[port].name, pin_mask, mode, output_type, speed, pupd);
     
     last_error = GPIO_ERROR_NONE;
     return 1;
@@ -184,21 +372,50 @@ uint8_t VirtualGPIO_SetAltFunction(uint8_t port, uint8_t pin, uint8_t alt_func)
     
     if (port >= MAX_GPIO_PORTS || pin >= MAX_GPIO_PINS) {
         last_error = GPIO_ERROR_PINMUX;
-        printf("[VirtualGPIO] ERROR: Invalid port/pin for alternate function\n");
+        SIM_LOG_ERROR("[VirtualGPIO] ERROR: Invalid port/pin for alternate function\n");
         return 0;
     }
     
     if (inject_error()) return 0;
     
-    VirtualGPIOPin *p = &gpio_ports[port].pins[pin];
-    if (p->mode != GPIO_MODE_ALTERNATE) {
+    VirtualGPIORegs *r = &gpio_ports[port].regs;
+    if (((r->MODER >> (2 * pin)) & 0x3U) != GPIO_MODE_ALTERNATE) {
+        last_error = GPIO_ERROR_PINMUX;
+        SIM_LOG_WARN("[VirtualGPIO] WARNING: Pin not in alternate mode\n");
+    }
+    
+    uint8_t shift = 4 * (pin % 8);
+    r->AFR[pin / 8] = (r->AFR[pin / 8] & ~(0xFU << shift)) | ((uint32_t)(alt_func & 0xFU) << shift);
+    GPIO_BUS_ACCESS(2);
+    SIM_LOG_DEBUG("[VirtualGPIO] GPIO%c.%d alternate function set to AF%d\n",
+                  gpio_ports[port].name, pin, alt_func);
+    
+    last_error = GPIO_ERROR_NONE;
+    return 1;
+}
+
+// Set the same alternate function for every pin in pin_mask
+uint8_t VirtualGPIO_SetAltFunctionPins(uint8_t port, uint16_t pin_mask, uint8_t alt_func) {
+    if (!gpio_initialized) VirtualGPIO_Init();
+    
+    if (port >= MAX_GPIO_PORTS) {
         last_error = GPIO_ERROR_PINMUX;
-        printf("[VirtualGPIO] WARNING: Pin not in alternate mode\n");
+        SIM_LOG_ERROR("[VirtualGPIO] ERROR: Invalid port/pin for alternate function\n");
+        return 0;
     }
     
-    p->alt_function = alt_func;
-    printf("[VirtualGPIO] GPIO%c.%d alternate function set to AF%d\n",
-           gpio_ports[port].name, pin, alt_func);
+    if (inject_error()) return 0;
+    
+    VirtualGPIORegs *r = &gpio_ports[port].regs;
+    uint32_t af = 0x11111111U * (alt_func & 0xFU);
+    uint32_t lo = expand_nibbles((uint8_t)(pin_mask & 0xFFU));
+    uint32_t hi = expand_nibbles((uint8_t)(pin_mask >> 8));
+    r->AFR[0] = (r->AFR[0] & ~lo) | (af & lo);
+    r->AFR[1] = (r->AFR[1] & ~hi) | (af & hi);
+    GPIO_BUS_ACCESS(4);
+    
+    SIM_LOG_DEBUG("[VirtualGPIO] GPIO%c mask 0x%04X alternate function set to AF%d\n",
+                  gpio_ports[port].name, pin_mask, alt_func);
     
     last_error = GPIO_ERROR_NONE;
     return 1;
@@ -215,14 +432,15 @@ uint8_t VirtualGPIO_WritePin(uint8_t port, uint8_t pin, uint8_t value) {
     
     if (inject_error()) return 0;
     
-    VirtualGPIOPin *p = &gpio_ports[port].pins[pin];
-    if (p->mode != GPIO_MODE_OUTPUT) {
-        printf("[VirtualGPIO] WARNING: Writing to non-output pin GPIO%c.%d\n",
-               gpio_ports[port].name, pin);
+    VirtualGPIOPort *gp = &gpio_ports[port];
+    if (((gp->regs.MODER >> (2 * pin)) & 0x3U) != GPIO_MODE_OUTPUT) {
+        SIM_LOG_WARN("[VirtualGPIO] WARNING: Writing to non-output pin GPIO%c.%d\n",
+                     gpio_ports[port].name, pin);
     }
     
-    p->value = value ? 1 : 0;
-    printf("[VirtualGPIO] GPIO%c.%d <- %d\n", gpio_ports[port].name, pin, p->value);
+    port_write_bsrr(gp, value ? (1U << pin) : (1U << (pin + 16)));
+    GPIO_BUS_ACCESS(1);
+    SIM_LOG_TRACE("[VirtualGPIO] GPIO%c.%d <- %d\n", gpio_ports[port].name, pin, value ? 1 : 0);
     
     last_error = GPIO_ERROR_NONE;
     return 1;
@@ -239,23 +457,12 @@ uint8_t VirtualGPIO_ReadPin(uint8_t port, uint8_t pin, uint8_t *value) {
     
     if (inject_error()) return 0;
     
-    VirtualGPIOPin *p = &gpio_ports[port].pins[pin];
-    
     // Simulate input based on pull-up/pull-down or random for floating
-    if (p->mode == GPIO_MODE_INPUT) {
-        if (p->pupd == GPIO_PUPD_UP) {
-            *value = 1;
-        } else if (p->pupd == GPIO_PUPD_DOWN) {
-            *value = 0;
-        } else {
-            *value = rand() % 2;  // Simulate floating input
-        }
-        p->value = *value;
-    } else {
-        *value = p->value;
-    }
+    uint16_t idr = port_sample_inputs(&gpio_ports[port], (uint16_t)(1U << pin));
+    GPIO_BUS_ACCESS(1);
+    *value = (idr >> pin) & 0x1U;
     
-    printf("[VirtualGPIO] GPIO%c.%d -> %d\n", gpio_ports[port].name, pin, *value);
+    SIM_LOG_TRACE("[VirtualGPIO] GPIO%c.%d -> %d\n", gpio_ports[port].name, pin, *value);
     
     last_error = GPIO_ERROR_NONE;
     return 1;
@@ -270,11 +477,99 @@ uint8_t VirtualGPIO_TogglePin(uint8_t port, uint8_t pin) {
         return 0;
     }
     
-    VirtualGPIOPin *p = &gpio_ports[port].pins[pin];
-    p->value = !p->value;
+    VirtualGPIOPort *gp = &gpio_ports[port];
+    uint32_t odr = gp->regs.ODR;
+    uint32_t bit = 1U << pin;
+    
+    // Set the bits that are low, reset the bits that are high (one BSRR write)
+    port_write_bsrr(gp, ((odr & bit) << 16) | (~odr & bit));
+    GPIO_BUS_ACCESS(2);  // ODR read + BSRR write
+    
+    SIM_LOG_TRACE("[VirtualGPIO] GPIO%c.%d toggled to %d\n", 
+                  gpio_ports[port].name, pin, (int)((gp->regs.ODR >> pin) & 0x1U));
+    
+    last_error = GPIO_ERROR_NONE;
+    return 1;
+}
+
+// Write all 16 output bits of a port (ODR store)
+uint8_t VirtualGPIO_WritePort(uint8_t port, uint16_t value) {
+    if (!gpio_initialized) VirtualGPIO_Init();
+    
+    if (port >= MAX_GPIO_PORTS) {
+        last_error = GPIO_ERROR_INVALID_PORT;
+        return 0;
+    }
+    
+    if (inject_error()) return 0;
+    
+    port_set_odr(&gpio_ports[port], value);
+    GPIO_BUS_ACCESS(1);
+    SIM_LOG_TRACE("[VirtualGPIO] GPIO%c <- 0x%04X\n", gpio_ports[port].name, value);
+    
+    last_error = GPIO_ERROR_NONE;
+    return 1;
+}
+
+// Read all 16 pin levels of a port (IDR sample)
+uint8_t VirtualGPIO_ReadPort(uint8_t port, uint16_t *value) {
+    if (!gpio_initialized) VirtualGPIO_Init();
+    
+    if (port >= MAX_GPIO_PORTS) {
+        last_error = GPIO_ERROR_INVALID_PORT;
+        return 0;
+    }
+    
+    if (inject_error()) return 0;
+    
+    *value = port_sample_inputs(&gpio_ports[port], 0xFFFFU);
+    GPIO_BUS_ACCESS(1);
+    SIM_LOG_TRACE("[VirtualGPIO] GPIO%c -> 0x%04X\n", gpio_ports[port].name, *value);
+    
+    last_error = GPIO_ERROR_NONE;
+    return 1;
+}
+
+// Raw BSRR write: bits 0-15 set, bits 16-31 reset (set wins on conflict)
+uint8_t VirtualGPIO_WriteBSRR(uint8_t port, uint32_t bsrr) {
+    if (!gpio_initialized) VirtualGPIO_Init();
+    
+    if (port >= MAX_GPIO_PORTS) {
+        last_error = GPIO_ERROR_INVALID_PORT;
+        return 0;
+    }
+    
+    if (inject_error()) return 0;
+    
+    port_write_bsrr(&gpio_ports[port], bsrr);
+    GPIO_BUS_ACCESS(1);
+    SIM_LOG_TRACE("[VirtualGPIO] GPIO%c BSRR <- 0x%08X\n", gpio_ports[port].name, (unsigned)bsrr);
+    
+    last_error = GPIO_ERROR_NONE;
+    return 1;
+}
+
+// Atomically set the pins in set_mask and clear the pins in reset_mask
+uint8_t VirtualGPIO_SetResetPins(uint8_t port, uint16_t set_mask, uint16_t reset_mask) {
+    return VirtualGPIO_WriteBSRR(port, ((uint32_t)reset_mask << 16) | set_mask);
+}
+
+// Toggle every pin in pin_mask with a single BSRR write
+uint8_t VirtualGPIO_TogglePins(uint8_t port, uint16_t pin_mask) {
+    if (!gpio_initialized) VirtualGPIO_Init();
+    
+    if (port >= MAX_GPIO_PORTS) {
+        last_error = GPIO_ERROR_INVALID_PORT;
+        return 0;
+    }
+    
+    VirtualGPIOPort *gp = &gpio_ports[port];
+    uint32_t odr = gp->regs.ODR;
+    port_write_bsrr(gp, ((odr & pin_mask) << 16) | (~odr & pin_mask));
+    GPIO_BUS_ACCESS(2);  // ODR read + BSRR write
     
-    printf("[VirtualGPIO] GPIO%c.%d toggled to %d\n", 
-           gpio_ports[port].name, pin, p->value);
+    SIM_LOG_TRACE("[VirtualGPIO] GPIO%c mask 0x%04X toggled, ODR=0x%04X\n",
+                  gp->name, pin_mask, (unsigned)gp->regs.ODR);
     
     last_error = GPIO_ERROR_NONE;
     return 1;
@@ -292,52 +587,46 @@ uint8_t VirtualGPIO_ConfigureInterrupt(uint8_t port, uint8_t pin, uint8_t mode,
     
     if (inject_error()) return 0;
     
-    VirtualGPIOPin *p = &gpio_ports[port].pins[pin];
-    p->mode = mode;
-    p->irq_enabled = 1;
-    p->irq_handler = handler;
+    if (mode < GPIO_MODE_IT_RISING || mode > GPIO_MODE_IT_BOTH) {
+        last_error = GPIO_ERROR_INTERRUPT;
+        SIM_LOG_ERROR("[VirtualGPIO] ERROR: Invalid interrupt mode %d\n", mode);
+        return 0;
+    }
+    
+    // Input mode plus SYSCFG/EXTI routing; the NVIC line is enabled separately
+    set_fields2(&gpio_ports[port].regs.MODER, (uint16_t)(1U << pin), GPIO_MODE_INPUT);
+    GPIO_BUS_ACCESS(2);
+    VirtualEXTI_ConfigureLine(pin, port, exti_trigger(mode));
+    VirtualEXTI_SetCallback(pin, handler);
     
-    printf("[VirtualGPIO] Interrupt configured for GPIO%c.%d (Mode: %d)\n",
-           gpio_ports[port].name, pin, mode);
+    SIM_LOG_DEBUG("[VirtualGPIO] Interrupt configured for GPIO%c.%d (Mode: %d)\n",
+                  gpio_ports[port].name, pin, mode);
     
     last_error = GPIO_ERROR_NONE;
     return 1;
 }
 
-// Simulate interrupt trigger
+// Simulate an external edge on a pin (edge: 1 = rising, 0 = falling).
+// The edge is latched by the virtual EXTI and raised on the NVIC; the
+// CPU then takes the interrupt if its priority and masking allow.
 void VirtualGPIO_SimulateInterrupt(uint8_t port, uint8_t pin, uint8_t edge) {
     if (!gpio_initialized) VirtualGPIO_Init();
     
     if (port >= MAX_GPIO_PORTS || pin >= MAX_GPIO_PINS) {
-        printf("[VirtualGPIO] ERROR: Cannot simulate interrupt on invalid pin\n");
+        SIM_LOG_ERROR("[VirtualGPIO] ERROR: Cannot simulate interrupt on invalid pin\n");
         return;
     }
     
-    VirtualGPIOPin *p = &gpio_ports[port].pins[pin];
-    
-    if (!p->irq_enabled) {
-        printf("[VirtualGPIO] WARNING: Interrupt not enabled for GPIO%c.%d\n",
-               gpio_ports[port].name, pin);
+    if (!(VirtualEXTI_GetPortLines(port) & (1U << pin))) {
+        SIM_LOG_WARN("[VirtualGPIO] WARNING: Interrupt not enabled for GPIO%c.%d\n",
+                     gpio_ports[port].name, pin);
         return;
     }
     
-    // Check if edge matches configured mode
-    uint8_t should_trigger = 0;
-    if ((p->mode == GPIO_MODE_IT_RISING && edge == 1) ||
-        (p->mode == GPIO_MODE_IT_FALLING && edge == 0) ||
-        (p->mode == GPIO_MODE_IT_BOTH)) {
-        should_trigger = 1;
-    }
-    
-    if (should_trigger) {
-        printf("[VirtualGPIO] INTERRUPT triggered on GPIO%c.%d (Edge: %s)\n",
-               gpio_ports[port].name, pin, edge ? "RISING" : "FALLING");
-        
-        if (p->irq_handler != NULL) {
-            p->irq_handler(port, pin);
-        } else {
-            printf("[VirtualGPIO] WARNING: No interrupt handler registered\n");
-        }
+    if (VirtualEXTI_SignalEdge(port, pin, edge)) {
+        SIM_LOG_TRACE("[VirtualGPIO] INTERRUPT triggered on GPIO%c.%d (Edge: %s)\n",
+                      gpio_ports[port].name, pin, edge ? "RISING" : "FALLING");
+        VirtualNVIC_ProcessInterrupts();
     }
 }
 
@@ -346,20 +635,38 @@ void VirtualGPIO_PrintPortState(uint8_t port) {
     if (!gpio_initialized) VirtualGPIO_Init();
     
     if (port >= MAX_GPIO_PORTS) {
-        printf("[VirtualGPIO] ERROR: Invalid port\n");
+        SIM_LOG_ERROR("[VirtualGPIO] ERROR: Invalid port\n");
         return;
     }
     
-    printf("\n=== GPIO%c State ===\n", gpio_ports[port].name);
-    printf("Clock: %s\n", gpio_ports[port].clock_enabled ? "ENABLED" : "DISABLED");
+    VirtualGPIOPort *gp = &gpio_ports[port];
+    VirtualGPIORegs *r = &gp->regs;
+    VirtualEXTIRegs *exti = VirtualEXTI_GetRegs();
+    uint16_t irq_lines = VirtualEXTI_GetPortLines(port);
+    
+    printf("\n=== GPIO%c State ===\n", gp->name);
+    printf("Clock: %s\n", gp->clock_enabled ? "ENABLED" : "DISABLED");
+    printf("MODER=0x%08X OTYPER=0x%04X OSPEEDR=0x%08X PUPDR=0x%08X\n",
+           (unsigned)r->MODER, (unsigned)r->OTYPER, (unsigned)r->OSPEEDR, (unsigned)r->PUPDR);
+    printf("IDR=0x%04X ODR=0x%04X AFRL=0x%08X AFRH=0x%08X\n",
+           (unsigned)r->IDR, (unsigned)r->ODR, (unsigned)r->AFR[0], (unsigned)r->AFR[1]);
     printf("Pin | Mode | Type | Speed | PUPD | AF | Value | IRQ\n");
     printf("----+------+------+-------+------+----+-------+----\n");
     
     for (int pin = 0; pin < MAX_GPIO_PINS; pin++) {
-        VirtualGPIOPin *p = &gpio_ports[port].pins[pin];
+        uint8_t mode = (r->MODER >> (2 * pin)) & 0x3U;
+        uint32_t level = (mode == GPIO_MODE_INPUT) ? r->IDR : r->ODR;
+        uint8_t rising = (irq_lines & exti->RTSR) >> pin & 0x1U;
+        uint8_t falling = (irq_lines & exti->FTSR) >> pin & 0x1U;
+        if (mode == GPIO_MODE_INPUT && (rising || falling)) {
+            mode = (rising && falling) ? GPIO_MODE_IT_BOTH :
+                   rising ? GPIO_MODE_IT_RISING : GPIO_MODE_IT_FALLING;
+        }
         printf("%2d  |  %d   |  %d   |   %d   |  %d   | %2d |   %d   | %s\n",
-               pin, p->mode, p->output_type, p->speed, p->pupd, 
-               p->alt_function, p->value, p->irq_enabled ? "Y" : "N");
+               pin, mode, (int)((r->OTYPER >> pin) & 0x1U),
+               (int)((r->OSPEEDR >> (2 * pin)) & 0x3U), (int)((r->PUPDR >> (2 * pin)) & 0x3U),
+               (int)((r->AFR[pin / 8] >> (4 * (pin % 8))) & 0xFU), (int)((level >> pin) & 0x1U),
+               ((irq_lines >> pin) & 0x1U) ? "Y" : "N");
     }
     printf("==================\n\n");
 }
@@ -370,6 +677,8 @@ void example_irq_handler(uint8_t port, uint8_t pin) {
 }
 
 #ifdef RUN_STANDALONE_TEST
+#include "sim_test.h"
+
 // Test function - only compiled when RUN_STANDALONE_TEST is defined
 int main(void) {
     printf("=== Virtual GPIO Driver Test ===\n\n");
@@ -384,6 +693,10 @@ int main(void) {
                              GPIO_SPEED_HIGH, GPIO_PUPD_NONE);
     VirtualGPIO_WritePin(0, 5, 1);
     VirtualGPIO_TogglePin(0, 5);
+    VirtualGPIORegs *pa = VirtualGPIO_GetRegs(0);
+    check((pa->MODER & (0x3U << 10)) == (0x1U << 10), "PA5 MODER field = output");
+    check((pa->OSPEEDR & (0x3U << 10)) == (0x3U << 10), "PA5 OSPEEDR field = high");
+    check((pa->ODR & (1U << 5)) == 0, "write 1 then toggle: PA5 ODR bit clear");
     
     // Test 2: Input pin with pull-up
     printf("\n--- Test 2: Input Pin Configuration ---\n");
@@ -392,17 +705,20 @@ int main(void) {
                              GPIO_SPEED_LOW, GPIO_PUPD_UP);
     uint8_t value;
     VirtualGPIO_ReadPin(1, 3, &value);
+    check(value == 1, "PB3 input reads 1 through the pull-up");
     
     // Test 3: Alternate function (Pin Mux)
     printf("\n--- Test 3: Alternate Function ---\n");
     VirtualGPIO_ConfigurePin(0, 9, GPIO_MODE_ALTERNATE, GPIO_OTYPE_PP,
                              GPIO_SPEED_FAST, GPIO_PUPD_NONE);
     VirtualGPIO_SetAltFunction(0, 9, 7);  // AF7 for USART
+    check((pa->AFR[1] & 0xF0U) == 0x70U, "PA9 AFR[1] field = AF7");
     
     // Test 4: Interrupt configuration
     printf("\n--- Test 4: Interrupt Configuration ---\n");
     VirtualGPIO_EnableClock(2);  // GPIOC
     VirtualGPIO_ConfigureInterrupt(2, 13, GPIO_MODE_IT_RISING, example_irq_handler);
+    VirtualNVIC_EnableIRQ(IRQ_EXTI15_10);
     VirtualGPIO_SimulateInterrupt(2, 13, 1);  // Rising edge
     VirtualGPIO_SimulateInterrupt(2, 13, 0);  // Falling edge (should not trigger)
     
@@ -421,7 +737,37 @@ int main(void) {
     printf("\n--- Test 6: Port State Display ---\n");
     VirtualGPIO_PrintPortState(0);
     
-    printf("\n=== All Tests Complete ===\n");
-    return 0;
+    // Test 7: Port-wide and masked operations
+    printf("\n--- Test 7: Port-Wide Operations ---\n");
+    VirtualGPIO_EnableClock(3);  // GPIOD
+    VirtualGPIO_ConfigurePins(3, 0xFFFF, GPIO_MODE_OUTPUT, GPIO_OTYPE_PP,
+                              GPIO_SPEED_HIGH, GPIO_PUPD_NONE);
+    VirtualGPIORegs *pd = VirtualGPIO_GetRegs(3);
+    check(pd->MODER == 0x55555555U && pd->OSPEEDR == 0xFFFFFFFFU, "ConfigurePins: all 16 pins output, high speed");
+    uint16_t port_value;
+    VirtualGPIO_WritePort(3, 0xA5A5);
+    VirtualGPIO_ReadPort(3, &port_value);
+    check(port_value == 0xA5A5, "WritePort: GPIOD = 0xA5A5");
+    VirtualGPIO_SetResetPins(3, 0x000F, 0x00F0);
+    VirtualGPIO_ReadPort(3, &port_value);
+    check(port_value == 0xA50F, "SetResetPins(0x000F, 0x00F0): GPIOD = 0xA50F");
+    VirtualGPIO_TogglePins(3, 0xFF00);
+    VirtualGPIO_ReadPort(3, &port_value);
+    check(port_value == 0x5A0F, "TogglePins(0xFF00): GPIOD = 0x5A0F");
+    
+    // Test 8: Silent mode throughput
+    printf("\n--- Test 8: Silent Mode Toggle Throughput ---\n");
+    uint8_t saved_level = SimLog_GetLevel();
+    SimLog_SetLevel(SIM_LOG_LEVEL_NONE);
+    clock_t start = clock();
+    for (int i = 0; i < 1000000; i++) {
+        VirtualGPIO_TogglePin(0, 5);
+    }
+    clock_t end = clock();
+    SimLog_SetLevel(saved_level);
+    printf("1000000 toggles in %.3f ms\n",
+           (double)(end - start) * 1000.0 / CLOCKS_PER_SEC);
+    
+    return sim_test_result("Virtual GPIO");
 }
 #endif  // RUN_STANDALONE_TEST
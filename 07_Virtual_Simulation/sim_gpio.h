@@ -0,0 +1,59 @@
+/*
+ * sim_gpio.h - Virtual GPIO Driver interface
+ * Register block type and API shared by the HAL wrapper and user tests
+ */
+
+#ifndef SIM_GPIO_H_
+#define SIM_GPIO_H_
+
+#include <stdint.h>
+
+// Virtual GPIO register block
+// Same layout as a real STM32F4 GPIO port (see GPIO_RegDef_t in
+// drivers/inc/stm32f446re.h), one 32-bit word per register
+typedef struct {
+    uint32_t MODER;    // 0x00: 2 bits per pin (input/output/AF/analog)
+    uint32_t OTYPER;   // 0x04: 1 bit per pin (push-pull/open-drain)
+    uint32_t OSPEEDR;  // 0x08: 2 bits per pin
+    uint32_t PUPDR;    // 0x0C: 2 bits per pin
+    uint32_t IDR;      // 0x10: sampled pin levels
+    uint32_t ODR;      // 0x14: output latch
+    uint32_t BSRR;     // 0x18: write-only set/reset, always reads 0
+    uint32_t LCKR;     // 0x1C: configuration lock
+    uint32_t AFR[2];   // 0x20: 4 bits per pin, AFR[0] pins 0-7, AFR[1] pins 8-15
+} VirtualGPIORegs;
+
+// Output latch change of a port (ODR before and after)
+typedef void (*VirtualGPIOOutputListener)(void *ctx, uint8_t port, uint16_t old_odr, uint16_t new_odr);
+
+void VirtualGPIO_Init(void);
+VirtualGPIORegs *VirtualGPIO_GetRegs(uint8_t port);
+void VirtualGPIO_SyncInputs(uint8_t port);
+void VirtualGPIO_SetErrorInjection(uint8_t enable);
+uint8_t VirtualGPIO_GetLastError(void);
+void VirtualGPIO_SetSeed(uint64_t seed);
+uint8_t VirtualGPIO_EnableClock(uint8_t port);
+uint8_t VirtualGPIO_ConfigurePin(uint8_t port, uint8_t pin, uint8_t mode,
+                                 uint8_t output_type, uint8_t speed, uint8_t pupd);
+uint8_t VirtualGPIO_ConfigurePins(uint8_t port, uint16_t pin_mask, uint8_t mode,
+                                  uint8_t output_type, uint8_t speed, uint8_t pupd);
+uint8_t VirtualGPIO_SetAltFunction(uint8_t port, uint8_t pin, uint8_t alt_func);
+uint8_t VirtualGPIO_SetAltFunctionPins(uint8_t port, uint16_t pin_mask, uint8_t alt_func);
+uint8_t VirtualGPIO_WritePin(uint8_t port, uint8_t pin, uint8_t value);
+uint8_t VirtualGPIO_ReadPin(uint8_t port, uint8_t pin, uint8_t *value);
+uint8_t VirtualGPIO_TogglePin(uint8_t port, uint8_t pin);
+
+// Port-wide and masked operations (one register access each)
+uint8_t VirtualGPIO_WritePort(uint8_t port, uint16_t value);
+uint8_t VirtualGPIO_ReadPort(uint8_t port, uint16_t *value);
+uint8_t VirtualGPIO_WriteBSRR(uint8_t port, uint32_t bsrr);
+uint8_t VirtualGPIO_SetResetPins(uint8_t port, uint16_t set_mask, uint16_t reset_mask);
+uint8_t VirtualGPIO_TogglePins(uint8_t port, uint16_t pin_mask);
+uint8_t VirtualGPIO_AddOutputListener(VirtualGPIOOutputListener fn, void *ctx);
+
+uint8_t VirtualGPIO_ConfigureInterrupt(uint8_t port, uint8_t pin, uint8_t mode,
+                                       void (*handler)(uint8_t, uint8_t));
+void VirtualGPIO_SimulateInterrupt(uint8_t port, uint8_t pin, uint8_t edge);
+void VirtualGPIO_PrintPortState(uint8_t port);
+
+#endif /* SIM_GPIO_H_ */
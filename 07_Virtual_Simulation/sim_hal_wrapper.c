@@ -8,6 +8,14 @@
 #include <stdint.h>
 #include <string.h>
 
+#include "sim_log.h"
+#include "sim_gpio.h"
+#include "sim_nvic.h"
+#include "sim_exti.h"
+#include "sim_clock.h"
+#include "sim_sched.h"
+#include "sim_test.h"
+
 // HAL Status codes
 typedef enum {
     HAL_OK       = 0x00U,
@@ -18,7 +26,7 @@ typedef enum {
 
 // GPIO Configuration Structure (HAL-compatible)
 typedef struct {
-    uint32_t Pin;        // Pin number (0-15)
+    uint32_t Pin;        // Pin bitmask (GPIO_PIN_x, may combine several pins)
     uint32_t Mode;       // GPIO mode
     uint32_t Pull;       // Pull-up/Pull-down
     uint32_t Speed;      // GPIO speed
@@ -31,23 +39,6 @@ typedef enum {
     GPIO_PIN_SET
 } GPIO_PinState;
 
-// Forward declarations for virtual driver functions
-extern void VirtualGPIO_Init(void);
-extern uint8_t VirtualGPIO_EnableClock(uint8_t port);
-extern uint8_t VirtualGPIO_ConfigurePin(uint8_t port, uint8_t pin, uint8_t mode, 
-                                        uint8_t output_type, uint8_t speed, uint8_t pupd);
-extern uint8_t VirtualGPIO_WritePin(uint8_t port, uint8_t pin, uint8_t value);
-extern uint8_t VirtualGPIO_ReadPin(uint8_t port, uint8_t pin, uint8_t *value);
-extern uint8_t VirtualGPIO_TogglePin(uint8_t port, uint8_t pin);
-extern uint8_t VirtualGPIO_SetAltFunction(uint8_t port, uint8_t pin, uint8_t alt_func);
-extern uint8_t VirtualGPIO_ConfigureInterrupt(uint8_t port, uint8_t pin, uint8_t mode,
-                                               void (*handler)(uint8_t, uint8_t));
-
-extern void VirtualNVIC_Init(void);
-extern uint8_t VirtualNVIC_EnableIRQ(uint8_t irq_num);
-extern uint8_t VirtualNVIC_DisableIRQ(uint8_t irq_num);
-extern uint8_t VirtualNVIC_SetPriority(uint8_t irq_num, uint8_t priority);
-
 // GPIO Port mapping (A=0, B=1, etc.)
 #define GPIOA_PORT 0
 #define GPIOB_PORT 1
@@ -59,6 +50,25 @@ extern uint8_t VirtualNVIC_SetPriority(uint8_t irq_num, uint8_t priority);
 #define GPIOH_PORT 7
 #define GPIOI_PORT 8
 
+// GPIO Pins (HAL compatible bitmasks)
+#define GPIO_PIN_0              ((uint16_t)0x0001)
+#define GPIO_PIN_1              ((uint16_t)0x0002)
+#define GPIO_PIN_2              ((uint16_t)0x0004)
+#define GPIO_PIN_3              ((uint16_t)0x0008)
+#define GPIO_PIN_4              ((uint16_t)0x0010)
+#define GPIO_PIN_5              ((uint16_t)0x0020)
+#define GPIO_PIN_6              ((uint16_t)0x0040)
+#define GPIO_PIN_7              ((uint16_t)0x0080)
+#define GPIO_PIN_8              ((uint16_t)0x0100)
+#define GPIO_PIN_9              ((uint16_t)0x0200)
+#define GPIO_PIN_10             ((uint16_t)0x0400)
+#define GPIO_PIN_11             ((uint16_t)0x0800)
+#define GPIO_PIN_12             ((uint16_t)0x1000)
+#define GPIO_PIN_13             ((uint16_t)0x2000)
+#define GPIO_PIN_14             ((uint16_t)0x4000)
+#define GPIO_PIN_15             ((uint16_t)0x8000)
+#define GPIO_PIN_All            ((uint16_t)0xFFFF)
+
 // GPIO Modes (HAL compatible)
 #define GPIO_MODE_INPUT         0x00000000U
 #define GPIO_MODE_OUTPUT_PP     0x00000001U
@@ -70,6 +80,13 @@ extern uint8_t VirtualNVIC_SetPriority(uint8_t irq_num, uint8_t priority);
 #define GPIO_MODE_IT_FALLING    0x10210000U
 #define GPIO_MODE_IT_RISING_FALLING 0x10310000U
 
+// NVIC Priority Groups (HAL compatible PRIGROUP values)
+#define NVIC_PRIORITYGROUP_0    0x00000007U  // 0 bits preemption, 4 bits sub-priority
+#define NVIC_PRIORITYGROUP_1    0x00000006U  // 1 bit  preemption, 3 bits sub-priority
+#define NVIC_PRIORITYGROUP_2    0x00000005U  // 2 bits preemption, 2 bits sub-priority
+#define NVIC_PRIORITYGROUP_3    0x00000004U  // 3 bits preemption, 1 bit  sub-priority
+#define NVIC_PRIORITYGROUP_4    0x00000003U  // 4 bits preemption, 0 bits sub-priority
+
 // GPIO Pull-up/Pull-down
 #define GPIO_NOPULL             0x00000000U
 #define GPIO_PULLUP             0x00000001U
@@ -101,20 +118,27 @@ static uint8_t is_interrupt_mode(uint32_t hal_mode) {
 
 // Helper function to get interrupt type from HAL mode
 static uint8_t get_interrupt_type(uint32_t hal_mode) {
-    if (hal_mode & 0x00100000U) return 4;  // RISING
-    if (hal_mode & 0x00200000U) return 5;  // FALLING
-    if (hal_mode & 0x00300000U) return 6;  // BOTH
-    return 4;  // Default to rising
+    switch (hal_mode & 0x00300000U) {
+        case 0x00200000U: return 5;  // FALLING
+        case 0x00300000U: return 6;  // BOTH
+        default: return 4;           // RISING
+    }
 }
 
 // HAL GPIO Initialization
 HAL_StatusTypeDef HAL_GPIO_Init(uint8_t port, GPIO_InitTypeDef *GPIO_Init) {
     if (GPIO_Init == NULL) {
-        printf("[HAL] ERROR: NULL GPIO_Init structure\n");
+        SIM_LOG_ERROR("[HAL] ERROR: NULL GPIO_Init structure\n");
         return HAL_ERROR;
     }
     
-    printf("[HAL] Initializing GPIO port %d, pin %d\n", port, GPIO_Init->Pin);
+    uint16_t pin_mask = (uint16_t)GPIO_Init->Pin;
+    SIM_LOG_DEBUG("[HAL] Initializing GPIO port %d, pins 0x%04X\n", port, pin_mask);
+    
+    if (pin_mask == 0) {
+        SIM_LOG_ERROR("[HAL] ERROR: Empty pin mask\n");
+        return HAL_ERROR;
+    }
     
     // Enable clock
     if (!VirtualGPIO_EnableClock(port)) {
@@ -124,50 +148,58 @@ HAL_StatusTypeDef HAL_GPIO_Init(uint8_t port, GPIO_InitTypeDef *GPIO_Init) {
     // Check if interrupt mode
     if (is_interrupt_mode(GPIO_Init->Mode)) {
         uint8_t irq_type = get_interrupt_type(GPIO_Init->Mode);
-        if (!VirtualGPIO_ConfigureInterrupt(port, GPIO_Init->Pin, irq_type, NULL)) {
+        
+        // Input with pull for all pins, each routed to its EXTI line
+        // (the EXTIx IRQ still has to be enabled with HAL_NVIC_EnableIRQ)
+        if (!VirtualGPIO_ConfigurePins(port, pin_mask, irq_type, 0,
+                                       GPIO_Init->Speed, GPIO_Init->Pull)) {
             return HAL_ERROR;
         }
     } else {
-        // Configure pin
+        // Configure all pins in the mask at once
         uint8_t mode = hal_mode_to_virtual(GPIO_Init->Mode);
         uint8_t output_type = (GPIO_Init->Mode & 0x10) ? 1 : 0;
         
-        if (!VirtualGPIO_ConfigurePin(port, GPIO_Init->Pin, mode, output_type,
+        if (!VirtualGPIO_ConfigurePins(port, pin_mask, mode, output_type,
                                        GPIO_Init->Speed, GPIO_Init->Pull)) {
             return HAL_ERROR;
         }
         
         // Set alternate function if needed
         if (mode == 2) {  // Alternate function
-            if (!VirtualGPIO_SetAltFunction(port, GPIO_Init->Pin, GPIO_Init->Alternate)) {
+            if (!VirtualGPIO_SetAltFunctionPins(port, pin_mask, GPIO_Init->Alternate)) {
                 return HAL_ERROR;
             }
         }
     }
     
-    printf("[HAL] GPIO initialization complete\n");
+    SIM_LOG_DEBUG("[HAL] GPIO initialization complete\n");
     return HAL_OK;
 }
 
-// HAL GPIO Read Pin
-GPIO_PinState HAL_GPIO_ReadPin(uint8_t port, uint16_t pin) {
-    uint8_t value = 0;
+// HAL GPIO Read Pin (SET if any pin in the mask is high)
+GPIO_PinState HAL_GPIO_ReadPin(uint8_t port, uint16_t GPIO_Pin) {
+    uint16_t value = 0;
     
-    if (VirtualGPIO_ReadPin(port, pin, &value)) {
-        return value ? GPIO_PIN_SET : GPIO_PIN_RESET;
+    if (VirtualGPIO_ReadPort(port, &value)) {
+        return (value & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
     }
     
     return GPIO_PIN_RESET;
 }
 
-// HAL GPIO Write Pin
-void HAL_GPIO_WritePin(uint8_t port, uint16_t pin, GPIO_PinState state) {
-    VirtualGPIO_WritePin(port, pin, state == GPIO_PIN_SET ? 1 : 0);
+// HAL GPIO Write Pin (BSRR set or reset of every pin in the mask)
+void HAL_GPIO_WritePin(uint8_t port, uint16_t GPIO_Pin, GPIO_PinState state) {
+    if (state == GPIO_PIN_SET) {
+        VirtualGPIO_SetResetPins(port, GPIO_Pin, 0);
+    } else {
+        VirtualGPIO_SetResetPins(port, 0, GPIO_Pin);
+    }
 }
 
-// HAL GPIO Toggle Pin
-void HAL_GPIO_TogglePin(uint8_t port, uint16_t pin) {
-    VirtualGPIO_TogglePin(port, pin);
+// HAL GPIO Toggle Pin (every pin in the mask, single BSRR write)
+void HAL_GPIO_TogglePin(uint8_t port, uint16_t GPIO_Pin) {
+    VirtualGPIO_TogglePins(port, GPIO_Pin);
 }
 
 // HAL NVIC Enable IRQ
@@ -180,28 +212,51 @@ void HAL_NVIC_DisableIRQ(uint8_t irq_num) {
     VirtualNVIC_DisableIRQ(irq_num);
 }
 
+// HAL NVIC Set Priority Grouping
+void HAL_NVIC_SetPriorityGrouping(uint32_t priority_group) {
+    if (priority_group < NVIC_PRIORITYGROUP_4 || priority_group > NVIC_PRIORITYGROUP_0) {
+        SIM_LOG_ERROR("[HAL] ERROR: Invalid priority group 0x%X\n", (unsigned)priority_group);
+        return;
+    }
+    
+    VirtualNVIC_SetPriorityGrouping((uint8_t)(7U - priority_group));
+}
+
 // HAL NVIC Set Priority
 void HAL_NVIC_SetPriority(uint8_t irq_num, uint32_t preempt_priority, uint32_t sub_priority) {
-    // Combine priorities using 4-bit scheme:
-    // Bits [3:2] = preemption priority (0-3)
-    // Bits [1:0] = sub priority (0-3)
-    // This simulates the typical STM32 priority grouping
-    uint8_t priority = (preempt_priority << 2) | (sub_priority & 0x3);
-    if (priority > 15) priority = 15;
-    
-    VirtualNVIC_SetPriority(irq_num, priority);
+    // Combine priorities using the 4-bit scheme of the active grouping:
+    // upper bits = preemption priority, lower bits = sub priority
+    uint8_t sub_bits = 4 - VirtualNVIC_GetPriorityGrouping();
+    uint32_t preempt_max = (1U << (4 - sub_bits)) - 1;
+    uint32_t sub_max = (1U << sub_bits) - 1;
+    
+    if (preempt_priority > preempt_max) preempt_priority = preempt_max;
+    if (sub_priority > sub_max) sub_priority = sub_max;
+    
+    VirtualNVIC_SetPriority(irq_num, (uint8_t)((preempt_priority << sub_bits) | sub_priority));
 }
 
-// HAL Delay (simulated)
+// HAL Delay (runs scheduled events while skipping idle time, returns immediately)
 void HAL_Delay(uint32_t ms) {
-    printf("[HAL] Delay %d ms (simulated)\n", ms);
+    SIM_LOG_TRACE("[HAL] Delay %lu ms (simulated)\n", (unsigned long)ms);
+    SimSched_RunFor(SimClock_MsToCycles(ms));
+}
+
+// HAL tick in milliseconds, derived from the virtual cycle counter
+uint32_t HAL_GetTick(void) {
+    return SimClock_GetTickMs();
 }
 
 // HAL Init
 HAL_StatusTypeDef HAL_Init(void) {
-    printf("[HAL] HAL Initialization\n");
+    SIM_LOG_INFO("[HAL] HAL Initialization\n");
+    SimClock_Init();
+    SimSched_Init();
     VirtualGPIO_Init();
     VirtualNVIC_Init();
+    
+    // 2 bits preemption / 2 bits sub-priority (typical STM32 grouping)
+    HAL_NVIC_SetPriorityGrouping(NVIC_PRIORITYGROUP_2);
     return HAL_OK;
 }
 
@@ -213,7 +268,7 @@ void example_blink_led(void) {
     
     // Configure PA5 as output (LED)
     GPIO_InitTypeDef gpio;
-    gpio.Pin = 5;
+    gpio.Pin = GPIO_PIN_5;
     gpio.Mode = GPIO_MODE_OUTPUT_PP;
     gpio.Pull = GPIO_NOPULL;
     gpio.Speed = GPIO_SPEED_FREQ_LOW;
@@ -227,9 +282,9 @@ void example_blink_led(void) {
     // Blink LED
     for (int i = 0; i < 5; i++) {
         printf("\nBlink cycle %d:\n", i + 1);
-        HAL_GPIO_WritePin(GPIOA_PORT, 5, GPIO_PIN_SET);
+        HAL_GPIO_WritePin(GPIOA_PORT, GPIO_PIN_5, GPIO_PIN_SET);
         HAL_Delay(500);
-        HAL_GPIO_WritePin(GPIOA_PORT, 5, GPIO_PIN_RESET);
+        HAL_GPIO_WritePin(GPIOA_PORT, GPIO_PIN_5, GPIO_PIN_RESET);
         HAL_Delay(500);
     }
     
@@ -248,7 +303,7 @@ void example_button_interrupt(void) {
     
     // Configure PC13 as input with pull-up and interrupt on falling edge
     GPIO_InitTypeDef gpio;
-    gpio.Pin = 13;
+    gpio.Pin = GPIO_PIN_13;
     gpio.Mode = GPIO_MODE_IT_FALLING;
     gpio.Pull = GPIO_PULLUP;
     gpio.Speed = GPIO_SPEED_FREQ_LOW;
@@ -259,19 +314,74 @@ void example_button_interrupt(void) {
         return;
     }
     
+    // Callback run by the virtual EXTI15_10 handler for line 13
+    VirtualEXTI_SetCallback(13, button_irq_callback);
+    
     // Enable EXTI interrupt
-    HAL_NVIC_SetPriority(40, 0, 0);  // EXTI15_10 IRQ
-    HAL_NVIC_EnableIRQ(40);
+    HAL_NVIC_SetPriority(IRQ_EXTI15_10, 0, 0);
+    HAL_NVIC_EnableIRQ(IRQ_EXTI15_10);
     
     printf("Button configured. Simulate interrupt:\n");
     // In real code, interrupt would be triggered by hardware
     // Here we simulate it
-    extern void VirtualGPIO_SimulateInterrupt(uint8_t port, uint8_t pin, uint8_t edge);
     VirtualGPIO_SimulateInterrupt(GPIOC_PORT, 13, 0);  // Falling edge
     
     printf("\n=== Example Complete ===\n");
 }
 
+// Example: Debounced button (same scheme as 06_Real_World_Projects/button_interrupt.c)
+#define DEBOUNCE_MS 50
+
+static uint32_t last_press_time = 0;
+static uint32_t button_presses = 0;
+
+static void debounce_irq_callback(uint8_t port, uint8_t pin) {
+    uint32_t current_time = HAL_GetTick();
+    
+    if (current_time - last_press_time > DEBOUNCE_MS) {
+        button_presses++;
+        last_press_time = current_time;
+        printf("[Callback] Press %lu accepted on GPIO%c.%d at %lu ms\n",
+               (unsigned long)button_presses, 'A' + port, pin, (unsigned long)current_time);
+    } else {
+        printf("[Callback] Bounce ignored at %lu ms\n", (unsigned long)current_time);
+    }
+}
+
+void example_button_debounce(void) {
+    printf("\n=== Example: Button Debounce on Virtual Time ===\n");
+    
+    HAL_Init();
+    
+    GPIO_InitTypeDef gpio;
+    gpio.Pin = GPIO_PIN_0;
+    gpio.Mode = GPIO_MODE_IT_FALLING;
+    gpio.Pull = GPIO_PULLUP;
+    gpio.Speed = GPIO_SPEED_FREQ_LOW;
+    gpio.Alternate = 0;
+    
+    if (HAL_GPIO_Init(GPIOA_PORT, &gpio) != HAL_OK) {
+        printf("ERROR: Failed to initialize GPIO\n");
+        return;
+    }
+    VirtualEXTI_SetCallback(0, debounce_irq_callback);
+    HAL_NVIC_EnableIRQ(IRQ_EXTI0);
+    
+    // Contact bounce: edges 1 ms, 3 ms and 10 ms apart, then a second press
+    HAL_Delay(100);
+    uint32_t edge_gaps_ms[] = {0, 1, 3, 10, 200, 2};
+    for (size_t i = 0; i < sizeof(edge_gaps_ms) / sizeof(edge_gaps_ms[0]); i++) {
+        HAL_Delay(edge_gaps_ms[i]);
+        VirtualGPIO_SimulateInterrupt(GPIOA_PORT, 0, 0);
+    }
+    
+    printf("Presses counted: %lu, virtual time %lu ms, %llu cycles\n",
+           (unsigned long)button_presses, (unsigned long)HAL_GetTick(),
+           (unsigned long long)SimClock_GetCycles());
+    check(button_presses == 2, "two presses counted, bounces ignored");
+    printf("\n=== Example Complete ===\n");
+}
+
 // Test main function
 int main(void) {
     printf("=== HAL Wrapper Test Suite ===\n");
@@ -282,34 +392,36 @@ int main(void) {
     // Test 2: Button with interrupt
     example_button_interrupt();
     
-    // Test 3: Multiple GPIO configuration
+    // Test 3: Debounce against the virtual clock
+    example_button_debounce();
+    
+    // Test 4: Multiple GPIO configuration
     printf("\n=== Test: Multiple GPIO Pins ===\n");
     HAL_Init();
     
     GPIO_InitTypeDef gpio;
     
-    // Configure multiple pins
-    for (int pin = 0; pin < 8; pin++) {
-        gpio.Pin = pin;
-        gpio.Mode = GPIO_MODE_OUTPUT_PP;
-        gpio.Pull = GPIO_NOPULL;
-        gpio.Speed = GPIO_SPEED_FREQ_MEDIUM;
-        gpio.Alternate = 0;
-        
-        HAL_GPIO_Init(GPIOB_PORT, &gpio);
-    }
+    // Configure PB0-PB7 with one call
+    gpio.Pin = GPIO_PIN_0 | GPIO_PIN_1 | GPIO_PIN_2 | GPIO_PIN_3 |
+               GPIO_PIN_4 | GPIO_PIN_5 | GPIO_PIN_6 | GPIO_PIN_7;
+    gpio.Mode = GPIO_MODE_OUTPUT_PP;
+    gpio.Pull = GPIO_NOPULL;
+    gpio.Speed = GPIO_SPEED_FREQ_MEDIUM;
+    gpio.Alternate = 0;
+    
+    HAL_GPIO_Init(GPIOB_PORT, &gpio);
     
-    // Toggle all pins
+    // Toggle all pins with one call
     printf("\nToggling all configured pins:\n");
-    for (int pin = 0; pin < 8; pin++) {
-        HAL_GPIO_TogglePin(GPIOB_PORT, pin);
-    }
+    HAL_GPIO_TogglePin(GPIOB_PORT, (uint16_t)gpio.Pin);
+    printf("PB7 read back: %s\n",
+           HAL_GPIO_ReadPin(GPIOB_PORT, GPIO_PIN_7) == GPIO_PIN_SET ? "SET" : "RESET");
     
-    // Test 4: Alternate function
+    // Test 5: Alternate function
     printf("\n=== Test: Alternate Function (USART) ===\n");
     
     // Configure PA9 as USART1_TX (AF7)
-    gpio.Pin = 9;
+    gpio.Pin = GPIO_PIN_9;
     gpio.Mode = GPIO_MODE_AF_PP;
     gpio.Pull = GPIO_NOPULL;
     gpio.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
@@ -318,7 +430,7 @@ int main(void) {
     HAL_GPIO_Init(GPIOA_PORT, &gpio);
     
     // Configure PA10 as USART1_RX (AF7)
-    gpio.Pin = 10;
+    gpio.Pin = GPIO_PIN_10;
     gpio.Mode = GPIO_MODE_AF_PP;
     gpio.Pull = GPIO_PULLUP;
     gpio.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
@@ -326,6 +438,5 @@ int main(void) {
     
     HAL_GPIO_Init(GPIOA_PORT, &gpio);
     
-    printf("\n=== All HAL Tests Complete ===\n");
-    return 0;
+    return sim_test_result("HAL Wrapper");
 }
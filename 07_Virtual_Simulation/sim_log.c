@@ -0,0 +1,56 @@
+/*
+ * sim_log.c - Logging back-end for the virtual simulation framework
+ * Holds the runtime log level and forwards messages to the active sink
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdarg.h>
+
+#include "sim_log.h"
+
+// Runtime level defaults to everything that was compiled in
+uint8_t g_sim_log_level = SIM_LOG_COMPILE_LEVEL;
+
+static SimLogSink log_sink = SimLog_StdoutSink;
+static void *log_sink_ctx = NULL;
+
+// Set runtime log level (messages above it are dropped before formatting)
+void SimLog_SetLevel(uint8_t level) {
+    if (level > SIM_LOG_LEVEL_TRACE) level = SIM_LOG_LEVEL_TRACE;
+    g_sim_log_level = level;
+}
+
+// Get runtime log level
+uint8_t SimLog_GetLevel(void) {
+    return g_sim_log_level;
+}
+
+// Redirect log output; NULL restores the stdout sink
+void SimLog_SetSink(SimLogSink sink, void *ctx) {
+    log_sink = (sink != NULL) ? sink : SimLog_StdoutSink;
+    log_sink_ctx = (sink != NULL) ? ctx : NULL;
+}
+
+// Forward one message to the active sink
+void SimLog_Write(uint8_t level, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    log_sink(level, fmt, args, log_sink_ctx);
+    va_end(args);
+}
+
+// Default sink: formatted output to stdout
+void SimLog_StdoutSink(uint8_t level, const char *fmt, va_list args, void *ctx) {
+    (void)level;
+    (void)ctx;
+    vprintf(fmt, args);
+}
+
+// Discard everything (useful for benchmarks that still want the level checks)
+void SimLog_NullSink(uint8_t level, const char *fmt, va_list args, void *ctx) {
+    (void)level;
+    (void)fmt;
+    (void)args;
+    (void)ctx;
+}
@@ -0,0 +1,82 @@
+/*
+ * sim_log.h - Logging front-end shared by all virtual peripherals
+ * Compile-time level filtering plus runtime level and output sink control
+ */
+
+#ifndef SIM_LOG_H_
+#define SIM_LOG_H_
+
+#include <stdint.h>
+#include <stdarg.h>
+
+// Log levels (same ordering as DEBUG_LEVEL_* in debug_utils.h)
+#define SIM_LOG_LEVEL_NONE   0
+#define SIM_LOG_LEVEL_ERROR  1
+#define SIM_LOG_LEVEL_WARN   2
+#define SIM_LOG_LEVEL_INFO   3
+#define SIM_LOG_LEVEL_DEBUG  4
+#define SIM_LOG_LEVEL_TRACE  5
+
+// Highest level compiled in. A SIM_FAST build keeps only errors, so
+// per-operation trace calls are removed by the preprocessor.
+#ifndef SIM_LOG_COMPILE_LEVEL
+#ifdef SIM_FAST
+#define SIM_LOG_COMPILE_LEVEL SIM_LOG_LEVEL_ERROR
+#else
+#define SIM_LOG_COMPILE_LEVEL SIM_LOG_LEVEL_TRACE
+#endif
+#endif
+
+// Output sink: receives the level, the format string and its arguments
+typedef void (*SimLogSink)(uint8_t level, const char *fmt, va_list args, void *ctx);
+
+// Runtime level, checked inline before any formatting happens
+extern uint8_t g_sim_log_level;
+
+void SimLog_SetLevel(uint8_t level);
+uint8_t SimLog_GetLevel(void);
+void SimLog_SetSink(SimLogSink sink, void *ctx);
+void SimLog_Write(uint8_t level, const char *fmt, ...);
+
+// Built-in sinks
+void SimLog_StdoutSink(uint8_t level, const char *fmt, va_list args, void *ctx);
+void SimLog_NullSink(uint8_t level, const char *fmt, va_list args, void *ctx);
+
+#define SIM_LOG(level, fmt, ...) \
+    do { \
+        if ((level) <= g_sim_log_level) { \
+            SimLog_Write((level), fmt, ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+#if SIM_LOG_COMPILE_LEVEL >= SIM_LOG_LEVEL_ERROR
+#define SIM_LOG_ERROR(fmt, ...) SIM_LOG(SIM_LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#else
+#define SIM_LOG_ERROR(fmt, ...) ((void)0)
+#endif
+
+#if SIM_LOG_COMPILE_LEVEL >= SIM_LOG_LEVEL_WARN
+#define SIM_LOG_WARN(fmt, ...) SIM_LOG(SIM_LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#else
+#define SIM_LOG_WARN(fmt, ...) ((void)0)
+#endif
+
+#if SIM_LOG_COMPILE_LEVEL >= SIM_LOG_LEVEL_INFO
+#define SIM_LOG_INFO(fmt, ...) SIM_LOG(SIM_LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#else
+#define SIM_LOG_INFO(fmt, ...) ((void)0)
+#endif
+
+#if SIM_LOG_COMPILE_LEVEL >= SIM_LOG_LEVEL_DEBUG
+#define SIM_LOG_DEBUG(fmt, ...) SIM_LOG(SIM_LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#else
+#define SIM_LOG_DEBUG(fmt, ...) ((void)0)
+#endif
+
+#if SIM_LOG_COMPILE_LEVEL >= SIM_LOG_LEVEL_TRACE
+#define SIM_LOG_TRACE(fmt, ...) SIM_LOG(SIM_LOG_LEVEL_TRACE, fmt, ##__VA_ARGS__)
+#else
+#define SIM_LOG_TRACE(fmt, ...) ((void)0)
+#endif
+
+#endif /* SIM_LOG_H_ */
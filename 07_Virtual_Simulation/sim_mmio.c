@@ -0,0 +1,956 @@
+/*
+ * sim_mmio.c - Shadow register file for host builds of the bare-metal drivers
+ * The peripheral and System Control Space windows are anonymous mmaps;
+ * drivers built with USE_HOST_MMIO access them through the normal
+ * GPIOx/RCC/EXTI/NVIC pointers
+ */
+
+#define _GNU_SOURCE  // MAP_ANONYMOUS, REG_EFL
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#if defined(__linux__) && defined(__x86_64__)
+#include <ucontext.h>
+#define MMIO_HAVE_WRITE_TRAP 1  // Page-protection write trapping supported
+#endif
+
+#include "stm32f446re.h"
+#include "sim_log.h"
+#include "sim_clock.h"
+#include "sim_gpio.h"
+#include "sim_exti.h"
+#include "sim_nvic.h"
+#include "sim_mmio.h"
+
+#define GPIO_PORT_STRIDE (GPIOB_BASEADDR - GPIOA_BASEADDR)
+#define X86_EFLAGS_TF    0x100U  // Trap flag: single-step one instruction
+#define X86_PF_WRITE     0x2U    // Page fault error code: the access was a store
+#define NVIC_IRQ_COUNT   240     // IPR bytes, and handlers SimMMIO_AttachIRQ can hold
+
+// Error codes
+#define MMIO_ERROR_NONE        0
+#define MMIO_ERROR_MAP         1
+#define MMIO_ERROR_RANGE       2
+#define MMIO_ERROR_FULL        3
+#define MMIO_ERROR_UNSUPPORTED 4
+
+// Device address range backed by one mmap
+typedef struct {
+    uint32_t base;
+    uint32_t size;
+    uint8_t **host;
+} MMIOWindow;
+
+// Hooked register range and the values its hook last saw
+typedef struct {
+    uint8_t *host;       // Shadow address of the first register
+    uint32_t words;
+    SimMMIOWriteHook hook;
+    SimMMIORefreshFn refresh;
+    void *ctx;
+    uint32_t *snapshot;
+} MMIORegion;
+
+// Registers whose loads have side effects, and the pages that must fault
+// on a load to see them
+typedef struct {
+    uint8_t *host;
+    uint32_t size;
+    SimMMIOReadHook hook;
+    void *ctx;
+    uint8_t *page;
+    size_t page_len;
+} MMIOReadTrap;
+
+// Level-sensitive interrupt output of a peripheral
+typedef struct {
+    SimMMIOIRQLevelFn level;
+    void *ctx;
+} MMIOIRQLevel;
+
+uint8_t *sim_mmio_shadow = NULL;
+uint8_t *sim_mmio_scs = NULL;
+
+static const MMIOWindow windows[] = {
+    {SIM_MMIO_WINDOW_BASE, SIM_MMIO_WINDOW_SIZE, &sim_mmio_shadow},
+    {SIM_MMIO_SCS_BASE, SIM_MMIO_SCS_SIZE, &sim_mmio_scs},
+};
+#define MMIO_WINDOW_COUNT (sizeof(windows) / sizeof(windows[0]))
+
+static MMIORegion regions[SIM_MMIO_MAX_REGIONS];
+static uint8_t region_count = 0;
+static MMIOReadTrap read_traps[SIM_MMIO_MAX_READ_TRAPS];
+static uint8_t read_trap_count = 0;
+static uint8_t trap_enabled = 0;
+static volatile sig_atomic_t in_trap = 0;
+static SimMMIOStats mmio_stats;
+static uint8_t mmio_initialized = 0;
+static uint8_t last_error = MMIO_ERROR_NONE;
+static void (*irq_handlers[NVIC_IRQ_COUNT])(void);
+static MMIOIRQLevel irq_levels[NVIC_IRQ_COUNT];
+
+static inline volatile uint32_t *region_regs(const MMIORegion *r) {
+    return (volatile uint32_t *)r->host;
+}
+
+// Host address of a device address (NULL outside the windows)
+static uint8_t *window_addr(uint32_t addr) {
+    for (size_t i = 0; i < MMIO_WINDOW_COUNT; i++) {
+        if (addr >= windows[i].base && addr - windows[i].base < windows[i].size) {
+            return *windows[i].host + (addr - windows[i].base);
+        }
+    }
+    return NULL;
+}
+
+// Make the windows writable for the simulator, or read-only so driver
+// writes trap. Pages holding read-trapped registers then fault on loads too.
+static void protect_window(uint8_t read_only) {
+    for (size_t i = 0; i < MMIO_WINDOW_COUNT; i++) {
+        mprotect(*windows[i].host, windows[i].size,
+                 read_only ? PROT_READ : (PROT_READ | PROT_WRITE));
+    }
+    if (!read_only) return;
+    
+    for (uint8_t i = 0; i < read_trap_count; i++) {
+        mprotect(read_traps[i].page, read_traps[i].page_len, PROT_NONE);
+    }
+}
+
+// Read trap covering a shadow word (NULL if its loads have no side effects)
+static MMIOReadTrap *find_read_trap(const uint8_t *word) {
+    for (uint8_t i = 0; i < read_trap_count; i++) {
+        if (word >= read_traps[i].host && word < read_traps[i].host + read_traps[i].size) {
+            return &read_traps[i];
+        }
+    }
+    return NULL;
+}
+
+// Let the peripheral owning a shadow word refresh its registers. The
+// windows must be writable.
+static void refresh_region_at(const uint8_t *word) {
+    for (uint8_t i = 0; i < region_count; i++) {
+        MMIORegion *r = &regions[i];
+        volatile uint32_t *regs = region_regs(r);
+    
+        if (word < r->host || word >= r->host + 4 * r->words) continue;
+        if (r->refresh != NULL) {
+            r->refresh(r->ctx, regs);
+        }
+        for (uint32_t w = 0; w < r->words; w++) {
+            r->snapshot[w] = regs[w];
+        }
+        return;
+    }
+}
+
+// 1 if the shadow word differs from what its hook last saw (a load that
+// was part of a read-modify-write instruction)
+static uint8_t region_word_changed(const uint8_t *word) {
+    for (uint8_t i = 0; i < region_count; i++) {
+        MMIORegion *r = &regions[i];
+    
+        if (word < r->host || word >= r->host + 4 * r->words) continue;
+        return region_regs(r)[(word - r->host) / 4] != r->snapshot[(word - r->host) / 4];
+    }
+    return 0;
+}
+
+// Deliver changed registers to the hooks, then let every peripheral
+// refresh its status registers. The register at forced (the target of a
+// trapped store, or NULL) goes to its hook even if the value is unchanged,
+// since writing 1 to a write-1-to-clear bit that reads 1 is still a write.
+// The windows must be writable.
+static void sync_regions(const uint8_t *forced) {
+    for (uint8_t i = 0; i < region_count; i++) {
+        MMIORegion *r = &regions[i];
+        volatile uint32_t *regs = region_regs(r);
+    
+        for (uint32_t w = 0; w < r->words; w++) {
+            uint32_t value = regs[w];
+            if (value != r->snapshot[w] || (const uint8_t *)&regs[w] == forced) {
+                uint32_t old_value = r->snapshot[w];
+                r->snapshot[w] = value;
+                mmio_stats.hook_calls++;
+                r->hook(r->ctx, 4 * w, old_value, value);
+            }
+        }
+    }
+    
+    // A hook may change another peripheral's state (RCC reset of a GPIO port)
+    for (uint8_t i = 0; i < region_count; i++) {
+        MMIORegion *r = &regions[i];
+        volatile uint32_t *regs = region_regs(r);
+    
+        if (r->refresh != NULL) {
+            r->refresh(r->ctx, regs);
+        }
+        for (uint32_t w = 0; w < r->words; w++) {
+            r->snapshot[w] = regs[w];
+        }
+    }
+}
+
+#ifdef MMIO_HAVE_WRITE_TRAP
+static struct sigaction prev_segv;
+static volatile sig_atomic_t trap_pending = 0;
+static volatile sig_atomic_t trap_is_read = 0;
+static uint8_t *trap_word = NULL;
+
+// Shadow address to window index (-1 if outside every window)
+static int host_window(const uint8_t *addr) {
+    for (size_t i = 0; i < MMIO_WINDOW_COUNT; i++) {
+        const uint8_t *base = *windows[i].host;
+        if (addr >= base && addr < base + windows[i].size) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+// Driver store hit a read-only window, or a load hit a read-trapped page:
+// open the windows and single-step the access. Before an access to a
+// read-trapped register the peripheral brings its registers up to date
+// (read-modify-write instructions fault as stores).
+static void segv_handler(int sig, siginfo_t *info, void *uctx) {
+    uint8_t *addr = (uint8_t *)info->si_addr;
+    ucontext_t *uc = (ucontext_t *)uctx;
+    
+    if (!trap_enabled || host_window(addr) < 0) {
+        sigaction(SIGSEGV, &prev_segv, NULL);  // Not ours: fault again with the old handler
+        (void)sig;
+        return;
+    }
+    
+    protect_window(0);
+    trap_pending = 1;
+    trap_is_read = (uc->uc_mcontext.gregs[REG_ERR] & X86_PF_WRITE) == 0;
+    trap_word = (uint8_t *)((uintptr_t)addr & ~(uintptr_t)3);  // Byte stores (IPR) included
+    if (find_read_trap(trap_word) != NULL) {
+        in_trap = 1;
+        refresh_region_at(trap_word);
+        in_trap = 0;
+    }
+    uc->uc_mcontext.gregs[REG_EFL] |= X86_EFLAGS_TF;
+}
+
+// The access has completed: run the hooks and close the window again
+static void trap_handler(int sig, siginfo_t *info, void *uctx) {
+    (void)info;
+    
+    if (!trap_pending) {
+        signal(sig, SIG_DFL);
+        raise(sig);
+        return;
+    }
+    
+    ((ucontext_t *)uctx)->uc_mcontext.gregs[REG_EFL] &= ~(greg_t)X86_EFLAGS_TF;
+    trap_pending = 0;
+    in_trap = 1;
+    MMIOReadTrap *t = NULL;
+    if (trap_is_read) {
+        // Load from a read-trapped page; only the trapped registers react
+        t = find_read_trap(trap_word);
+        mmio_stats.read_traps++;
+        if (t != NULL) {
+            t->hook(t->ctx, (uint32_t)(trap_word - t->host));
+        }
+    }
+    if (!trap_is_read || region_word_changed(trap_word)) {
+        mmio_stats.traps++;
+        sync_regions(trap_word);
+    } else if (t != NULL) {
+        refresh_region_at(trap_word);
+    }
+    in_trap = 0;
+    protect_window(trap_enabled);
+}
+
+static void install_trap_handlers(void) {
+    static uint8_t installed = 0;
+    struct sigaction sa;
+    
+    if (installed) return;
+    
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_flags = SA_SIGINFO;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_sigaction = segv_handler;
+    sigaction(SIGSEGV, &sa, &prev_segv);
+    sa.sa_sigaction = trap_handler;
+    sigaction(SIGTRAP, &sa, NULL);
+    installed = 1;
+}
+#endif  // MMIO_HAVE_WRITE_TRAP
+
+// GPIO port register written by a driver
+static void gpio_write_hook(void *ctx, uint32_t offset, uint32_t old_value, uint32_t new_value) {
+    uint8_t port = (uint8_t)(uintptr_t)ctx;
+    (void)old_value;
+    
+    switch (offset) {
+        case offsetof(GPIO_RegDef_t, IDR):
+            break;  // Read-only, restored by the refresh
+        case offsetof(GPIO_RegDef_t, ODR):
+            VirtualGPIO_WritePort(port, (uint16_t)new_value);
+            break;
+        case offsetof(GPIO_RegDef_t, BSRR):
+            VirtualGPIO_WriteBSRR(port, new_value);
+            break;
+        default: {
+            // Configuration registers: same layout in the virtual port
+            uint32_t *vregs = (uint32_t *)VirtualGPIO_GetRegs(port);
+            vregs[offset / 4] = new_value;
+            SimClock_Advance(SIM_CYCLES_GPIO_ACCESS);
+            VirtualGPIO_SyncInputs(port);
+            SIM_LOG_TRACE("[SimMMIO] GPIO%c +0x%02X <- 0x%08X\n", 'A' + port,
+                          (unsigned)offset, (unsigned)new_value);
+            break;
+        }
+    }
+}
+
+// Mirror the virtual port into the shadow (BSRR is write-only, reads 0)
+static void gpio_refresh(void *ctx, volatile uint32_t *regs) {
+    const uint32_t *vregs = (const uint32_t *)VirtualGPIO_GetRegs((uint8_t)(uintptr_t)ctx);
+    
+    for (uint32_t w = 0; w < sizeof(GPIO_RegDef_t) / 4; w++) {
+        regs[w] = vregs[w];
+    }
+    regs[offsetof(GPIO_RegDef_t, BSRR) / 4] = 0;
+}
+
+// RCC register written by a driver: GPIO clock enables and port resets
+static void rcc_write_hook(void *ctx, uint32_t offset, uint32_t old_value, uint32_t new_value) {
+    uint32_t rising = new_value & ~old_value;
+    (void)ctx;
+    
+    SimClock_Advance(SIM_CYCLES_GPIO_ACCESS);
+    
+    if (offset == offsetof(RCC__RegDef_t, AHB1ENR)) {
+        for (uint8_t port = 0; port < GPIO_PORT_COUNT; port++) {
+            if (rising & (1U << port)) {
+                VirtualGPIO_EnableClock(port);
+            }
+        }
+    } else if (offset == offsetof(RCC__RegDef_t, AHB1RSTR)) {
+        for (uint8_t port = 0; port < GPIO_PORT_COUNT; port++) {
+            if (rising & (1U << port)) {
+                memset(VirtualGPIO_GetRegs(port), 0, sizeof(VirtualGPIORegs));
+                SIM_LOG_INFO("[SimMMIO] GPIO%c reset through RCC->AHB1RSTR\n", 'A' + port);
+            }
+        }
+    }
+}
+
+// EXTI register written by a driver: configuration is copied, SWIER and
+// PR (write 1 to clear) act on the virtual EXTI
+static void exti_write_hook(void *ctx, uint32_t offset, uint32_t old_value, uint32_t new_value) {
+    VirtualEXTIRegs *vexti = VirtualEXTI_GetRegs();
+    (void)ctx;
+    
+    SimClock_Advance(SIM_CYCLES_APB_ACCESS);
+    
+    switch (offset) {
+        case offsetof(EXTI_RegDef_t, SWIER): {
+            uint32_t rising = (new_value & ~old_value) & ((1U << EXTI_GPIO_LINES) - 1);
+            while (rising) {
+                uint8_t line = (uint8_t)__builtin_ctz(rising);
+                rising &= rising - 1;
+                VirtualEXTI_GenerateSWI(line);
+            }
+            break;
+        }
+        case offsetof(EXTI_RegDef_t, PR):
+            VirtualEXTI_ClearPending(new_value);
+            break;
+        default:
+            ((uint32_t *)vexti)[offset / 4] = new_value;
+            SIM_LOG_TRACE("[SimMMIO] EXTI +0x%02X <- 0x%08X\n", (unsigned)offset, (unsigned)new_value);
+            break;
+    }
+}
+
+static void exti_refresh(void *ctx, volatile uint32_t *regs) {
+    const uint32_t *vregs = (const uint32_t *)VirtualEXTI_GetRegs();
+    (void)ctx;
+    
+    for (uint32_t w = 0; w < sizeof(EXTI_RegDef_t) / 4; w++) {
+        regs[w] = vregs[w];
+    }
+}
+
+// SYSCFG register written by a driver (EXTICR port selection)
+static void syscfg_write_hook(void *ctx, uint32_t offset, uint32_t old_value, uint32_t new_value) {
+    (void)ctx;
+    (void)old_value;
+    
+    SimClock_Advance(SIM_CYCLES_APB_ACCESS);
+    ((uint32_t *)VirtualSYSCFG_GetRegs())[offset / 4] = new_value;
+}
+
+static void syscfg_refresh(void *ctx, volatile uint32_t *regs) {
+    const uint32_t *vregs = (const uint32_t *)VirtualSYSCFG_GetRegs();
+    (void)ctx;
+    
+    for (uint32_t w = 0; w < sizeof(SYSCFG_RegDef_t) / 4; w++) {
+        regs[w] = vregs[w];
+    }
+}
+
+// NVIC register written by a driver: ISER/ICER bits enable/disable IRQs,
+// IPR bytes set priorities (upper NO_PR_BITS_IMPLEMENTED bits)
+static void nvic_write_hook(void *ctx, uint32_t offset, uint32_t old_value, uint32_t new_value) {
+    (void)ctx;
+    
+    if (offset < offsetof(NVIC_RegDef_t, RESERVED0)) {
+        uint8_t base = (uint8_t)(8 * (offset - offsetof(NVIC_RegDef_t, ISER)));
+        while (new_value) {
+            VirtualNVIC_EnableIRQ((uint8_t)(base + __builtin_ctz(new_value)));
+            new_value &= new_value - 1;
+        }
+    } else if (offset >= offsetof(NVIC_RegDef_t, ICER) && offset < offsetof(NVIC_RegDef_t, RESERVED1)) {
+        uint8_t base = (uint8_t)(8 * (offset - offsetof(NVIC_RegDef_t, ICER)));
+        while (new_value) {
+            VirtualNVIC_DisableIRQ((uint8_t)(base + __builtin_ctz(new_value)));
+            new_value &= new_value - 1;
+        }
+    } else if (offset >= offsetof(NVIC_RegDef_t, IPR)) {
+        uint32_t irq = offset - offsetof(NVIC_RegDef_t, IPR);
+        for (uint8_t b = 0; b < 4; b++, irq++) {
+            uint8_t prio = (uint8_t)(new_value >> (8 * b));
+            if (prio != (uint8_t)(old_value >> (8 * b))) {
+                VirtualNVIC_SetPriority((uint8_t)irq, prio >> (8 - NO_PR_BITS_IMPLEMENTED));
+            }
+        }
+    }
+}
+
+// ISER and ICER both read back the enable bits, IPR the priorities
+static void nvic_refresh(void *ctx, volatile uint32_t *regs) {
+    (void)ctx;
+    
+    for (uint32_t w = 0; w < 8; w++) {
+        uint32_t enabled = 0;
+        for (uint32_t bit = 0; bit < 32 && 32 * w + bit < NVIC_IRQ_COUNT; bit++) {
+            if (VirtualNVIC_IsEnabled((uint8_t)(32 * w + bit))) {
+                enabled |= 1U << bit;
+            }
+        }
+        regs[offsetof(NVIC_RegDef_t, ISER) / 4 + w] = enabled;
+        regs[offsetof(NVIC_RegDef_t, ICER) / 4 + w] = enabled;
+    }
+    
+    volatile uint8_t *ipr = (volatile uint8_t *)regs + offsetof(NVIC_RegDef_t, IPR);
+    for (uint32_t irq = 0; irq < NVIC_IRQ_COUNT; irq++) {
+        ipr[irq] = (uint8_t)(VirtualNVIC_GetPriority((uint8_t)irq) << (8 - NO_PR_BITS_IMPLEMENTED));
+    }
+}
+
+// NVIC entry for a driver IRQ handler: the handler sees current status
+// registers and its writes are delivered before the NVIC continues. A
+// level-sensitive source that is still asserted pends the line again, so
+// the handler tail-chains as on the target.
+static void irq_trampoline(void) {
+    int irq = VirtualNVIC_GetActiveIRQ();
+    
+    if (irq < 0 || irq >= NVIC_IRQ_COUNT || irq_handlers[irq] == NULL) {
+        return;
+    }
+    
+    SimMMIO_Sync();
+    irq_handlers[irq]();
+    SimMMIO_Sync();
+    
+    if (irq_levels[irq].level != NULL && irq_levels[irq].level(irq_levels[irq].ctx)) {
+        VirtualNVIC_SetPending((uint8_t)irq);
+    }
+}
+
+// Map the shadow windows and attach the GPIO ports, RCC, EXTI, SYSCFG and
+// NVIC. Write trapping is switched on where the host supports it.
+uint8_t SimMMIO_Init(void) {
+    if (mmio_initialized) return 1;
+    
+    for (size_t i = 0; i < MMIO_WINDOW_COUNT; i++) {
+        void *window = mmap(NULL, windows[i].size, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (window == MAP_FAILED) {
+            last_error = MMIO_ERROR_MAP;
+            SIM_LOG_ERROR("[SimMMIO] ERROR: Cannot map %u byte shadow window\n",
+                          (unsigned)windows[i].size);
+            return 0;
+        }
+        *windows[i].host = window;
+    }
+    
+    memset(&mmio_stats, 0, sizeof(mmio_stats));
+    mmio_initialized = 1;
+    
+    for (uint8_t port = 0; port < GPIO_PORT_COUNT; port++) {
+        SimMMIO_AddRegion(GPIOA_BASEADDR + port * GPIO_PORT_STRIDE, sizeof(GPIO_RegDef_t),
+                          gpio_write_hook, gpio_refresh, (void *)(uintptr_t)port);
+    }
+    SimMMIO_AddRegion(RCC_BASEADDR, sizeof(RCC__RegDef_t), rcc_write_hook, NULL, NULL);
+    SimMMIO_AddRegion(EXTI_BASEADDR, sizeof(EXTI_RegDef_t), exti_write_hook, exti_refresh, NULL);
+    SimMMIO_AddRegion(SYSCFG_BASEADDR, sizeof(SYSCFG_RegDef_t), syscfg_write_hook, syscfg_refresh, NULL);
+    SimMMIO_AddRegion(NVIC_BASEADDR, offsetof(NVIC_RegDef_t, IPR) + NVIC_IRQ_COUNT,
+                      nvic_write_hook, nvic_refresh, NULL);
+    
+#ifdef MMIO_HAVE_WRITE_TRAP
+    SimMMIO_SetWriteTrap(1);
+#endif
+    
+    SIM_LOG_INFO("[SimMMIO] Shadow window 0x%08X-0x%08X at %p (write trap %s)\n",
+                 (unsigned)SIM_MMIO_WINDOW_BASE,
+                 (unsigned)(SIM_MMIO_WINDOW_BASE + SIM_MMIO_WINDOW_SIZE - 1),
+                 (void *)sim_mmio_shadow, trap_enabled ? "on" : "off");
+    
+    last_error = MMIO_ERROR_NONE;
+    return 1;
+}
+
+// Get last error code
+uint8_t SimMMIO_GetLastError(void) {
+    return last_error;
+}
+
+// Host address of a device address in a window (NULL outside them)
+volatile void *SimMMIO_Addr(uint32_t addr) {
+    if (!mmio_initialized && !SimMMIO_Init()) return NULL;
+    
+    uint8_t *host = window_addr(addr);
+    if (host == NULL) {
+        last_error = MMIO_ERROR_RANGE;
+    }
+    return host;
+}
+
+// Attach a peripheral to size bytes of registers at device address base.
+// The hook sees every register change; refresh (optional) writes the
+// peripheral's current state back after each batch of hooks.
+uint8_t SimMMIO_AddRegion(uint32_t base, uint32_t size, SimMMIOWriteHook hook,
+                          SimMMIORefreshFn refresh, void *ctx) {
+    if (!mmio_initialized && !SimMMIO_Init()) return 0;
+    
+    uint8_t *host = window_addr(base);
+    if (hook == NULL || size == 0 || (base & 3U) || (size & 3U) ||
+        host == NULL || window_addr(base + size - 1) != host + size - 1) {
+        last_error = MMIO_ERROR_RANGE;
+        SIM_LOG_ERROR("[SimMMIO] ERROR: Invalid region 0x%08X (+%u)\n", (unsigned)base, (unsigned)size);
+        return 0;
+    }
+    
+    if (region_count == SIM_MMIO_MAX_REGIONS) {
+        last_error = MMIO_ERROR_FULL;
+        SIM_LOG_ERROR("[SimMMIO] ERROR: Region table full (%d regions)\n", SIM_MMIO_MAX_REGIONS);
+        return 0;
+    }
+    
+    uint32_t *snapshot = calloc(size / 4, sizeof(uint32_t));
+    if (snapshot == NULL) {
+        last_error = MMIO_ERROR_MAP;
+        return 0;
+    }
+    
+    MMIORegion *r = &regions[region_count];
+    r->host = host;
+    r->words = size / 4;
+    r->hook = hook;
+    r->refresh = refresh;
+    r->ctx = ctx;
+    r->snapshot = snapshot;
+    
+    // Start from the peripheral's current state without calling the hook
+    protect_window(0);
+    volatile uint32_t *regs = region_regs(r);
+    if (refresh != NULL) {
+        refresh(ctx, regs);
+    }
+    for (uint32_t w = 0; w < r->words; w++) {
+        snapshot[w] = regs[w];
+    }
+    region_count++;
+    protect_window(trap_enabled);
+    
+    SIM_LOG_DEBUG("[SimMMIO] Region 0x%08X (+%u) attached\n", (unsigned)base, (unsigned)size);
+    last_error = MMIO_ERROR_NONE;
+    return 1;
+}
+
+// Make loads from size bytes of registers at device address base call
+// hook, for registers whose reads have side effects (status flags cleared
+// by a DR read). The register block should also be attached with
+// SimMMIO_AddRegion: its refresh runs before each trapped load, so the
+// load sees the peripheral's current state. Every load from the pages
+// holding the registers faults, so the whole page costs a trap per load.
+// Needs write trapping (Linux x86-64) to take effect.
+uint8_t SimMMIO_AddReadTrap(uint32_t base, uint32_t size, SimMMIOReadHook hook, void *ctx) {
+    if (!mmio_initialized && !SimMMIO_Init()) return 0;
+    
+#ifdef MMIO_HAVE_WRITE_TRAP
+    uint8_t *host = window_addr(base);
+    if (hook == NULL || size == 0 || (base & 3U) || (size & 3U) ||
+        host == NULL || window_addr(base + size - 1) != host + size - 1) {
+        last_error = MMIO_ERROR_RANGE;
+        SIM_LOG_ERROR("[SimMMIO] ERROR: Invalid read trap 0x%08X (+%u)\n", (unsigned)base, (unsigned)size);
+        return 0;
+    }
+    
+    if (read_trap_count == SIM_MMIO_MAX_READ_TRAPS) {
+        last_error = MMIO_ERROR_FULL;
+        SIM_LOG_ERROR("[SimMMIO] ERROR: Read trap table full (%d traps)\n", SIM_MMIO_MAX_READ_TRAPS);
+        return 0;
+    }
+    
+    uintptr_t page_size = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t first = (uintptr_t)host & ~(page_size - 1);
+    uintptr_t last = ((uintptr_t)host + size + page_size - 1) & ~(page_size - 1);
+    MMIOReadTrap *t = &read_traps[read_trap_count];
+    t->host = host;
+    t->size = size;
+    t->hook = hook;
+    t->ctx = ctx;
+    t->page = (uint8_t *)first;
+    t->page_len = last - first;
+    read_trap_count++;
+    protect_window(trap_enabled);
+    
+    SIM_LOG_DEBUG("[SimMMIO] Read trap 0x%08X (+%u) attached\n", (unsigned)base, (unsigned)size);
+    last_error = MMIO_ERROR_NONE;
+    return 1;
+#else
+    (void)base;
+    (void)size;
+    (void)hook;
+    (void)ctx;
+    last_error = MMIO_ERROR_UNSUPPORTED;
+    SIM_LOG_WARN("[SimMMIO] Read trapping not supported on this host\n");
+    return 0;
+#endif
+}
+
+// Enable/disable write trapping. With trapping on, every driver store runs
+// the hooks immediately (two signals per store). With it off the shadow is
+// plain memory, and hooks run at SimMMIO_Sync() with the net change only.
+uint8_t SimMMIO_SetWriteTrap(uint8_t enable) {
+    if (!mmio_initialized && !SimMMIO_Init()) return 0;
+    
+#ifdef MMIO_HAVE_WRITE_TRAP
+    if (enable) {
+        install_trap_handlers();
+    }
+    protect_window(0);
+    sync_regions(NULL);  // Writes made so far belong to the old mode
+    trap_enabled = enable ? 1 : 0;
+    protect_window(trap_enabled);
+    
+    SIM_LOG_DEBUG("[SimMMIO] Write trap %s\n", trap_enabled ? "on" : "off");
+    last_error = MMIO_ERROR_NONE;
+    return 1;
+#else
+    if (!enable) return 1;
+    last_error = MMIO_ERROR_UNSUPPORTED;
+    SIM_LOG_WARN("[SimMMIO] Write trapping not supported on this host, use SimMMIO_Sync()\n");
+    return 0;
+#endif
+}
+
+// 1 while hooks and refreshes run (trapped access or SimMMIO_Sync). Driver
+// code must not run then (the windows are open), so a peripheral that
+// raises an interrupt from a hook defers the NVIC pend, e.g. to a
+// zero-delay scheduler event.
+uint8_t SimMMIO_InTrap(void) {
+    return in_trap != 0;
+}
+
+// Run the hooks for everything written since the last sync and refresh the
+// shadow from the peripherals (e.g. after the test changed an input pin)
+void SimMMIO_Sync(void) {
+    if (!mmio_initialized && !SimMMIO_Init()) return;
+    
+    sig_atomic_t outer = in_trap;
+    in_trap = 1;
+    protect_window(0);
+    sync_regions(NULL);
+    protect_window(trap_enabled);
+    in_trap = outer;
+    mmio_stats.syncs++;
+}
+
+// Install a driver IRQ handler (e.g. EXTI15_10_IRQHandler) on the virtual
+// NVIC. Registers are synced around the call, so the handler reads current
+// status and its writes reach the peripherals before the NVIC continues.
+// Without write trapping, a store that leaves a register unchanged (writing
+// back the EXTI->PR bits just read) is not seen.
+uint8_t SimMMIO_AttachIRQ(uint8_t irq, void (*handler)(void), const char *name) {
+    if (!mmio_initialized && !SimMMIO_Init()) return 0;
+    
+    if (irq >= NVIC_IRQ_COUNT || handler == NULL) {
+        last_error = MMIO_ERROR_RANGE;
+        return 0;
+    }
+    
+    irq_handlers[irq] = handler;
+    if (!VirtualNVIC_SetHandler(irq, irq_trampoline, name)) {
+        irq_handlers[irq] = NULL;
+        last_error = MMIO_ERROR_RANGE;
+        return 0;
+    }
+    
+    last_error = MMIO_ERROR_NONE;
+    return 1;
+}
+
+// Declare an IRQ line level-sensitive: after each run of its handler
+// (attached with SimMMIO_AttachIRQ) the line is pended again while level()
+// reads 1, e.g. a USART whose TXE is still set with TXEIE enabled
+uint8_t SimMMIO_SetIRQLevel(uint8_t irq, SimMMIOIRQLevelFn level, void *ctx) {
+    if (irq >= NVIC_IRQ_COUNT) {
+        last_error = MMIO_ERROR_RANGE;
+        return 0;
+    }
+    
+    irq_levels[irq].level = level;
+    irq_levels[irq].ctx = ctx;
+    last_error = MMIO_ERROR_NONE;
+    return 1;
+}
+
+// Core clock cycles per APB1 (apb2 = 0) or APB2 clock cycle, from the
+// PPRE field of the shadow RCC->CFGR: 0xx /1, 100 /2 ... 111 /16
+uint32_t SimMMIO_GetAPBDivider(uint8_t apb2) {
+    if (!mmio_initialized && !SimMMIO_Init()) return 1;
+    
+    uint32_t cfgr = *(volatile uint32_t *)window_addr(RCC_BASEADDR + offsetof(RCC__RegDef_t, CFGR));
+    uint32_t ppre = (cfgr >> (apb2 ? RCC_CFGR_PPRE2 : RCC_CFGR_PPRE1)) & 0x7U;
+    return ppre < 4 ? 1U : 2U << (ppre - 4);
+}
+
+// Copy shadow register statistics
+void SimMMIO_GetStats(SimMMIOStats *stats) {
+    if (stats != NULL) {
+        *stats = mmio_stats;
+    }
+}
+
+#ifdef RUN_STANDALONE_TEST
+#include "stm32f446re_gpio_drivers.h"
+#include "sim_test.h"
+
+static uint8_t exti_order[4];
+static uint8_t exti_calls = 0;
+
+static void on_exti(uint8_t pin) {
+    if (exti_calls < sizeof(exti_order)) {
+        exti_order[exti_calls] = pin;
+    }
+    exti_calls++;
+}
+
+// Test function - only compiled when RUN_STANDALONE_TEST is defined
+// (built with USE_HOST_MMIO and linked with drivers/src/stm32f446re_gpio_drivers.c)
+int main(void) {
+    printf("=== Shadow Register (Host MMIO) Test ===\n\n");
+    
+    if (!SimMMIO_Init()) return 1;
+    
+    VirtualGPIORegs *pa = VirtualGPIO_GetRegs(0);
+    uint8_t level = 0;
+    uint8_t trapping = SimMMIO_SetWriteTrap(1);  // Store counts only hold when writes trap
+    
+    // Test 1: Bulk clock enable, then the real GPIO_Init configures the virtual port
+    printf("--- Test 1: GPIO_PeriClockControlPorts + GPIO_Init (PA5 output) ---\n");
+    SimMMIOStats before, after;
+    SimMMIO_GetStats(&before);
+    GPIO_PeriClockControlPorts(GPIO_PORT_BIT(GPIOA) | GPIO_PORT_BIT(GPIOB) | GPIO_PORT_BIT(GPIOC), ENABLE);
+    SimMMIO_Sync();
+    SimMMIO_GetStats(&after);
+    printf("AHB1ENR = 0x%08X after %lu trapped store(s)\n",
+           (unsigned)RCC->AHB1ENR, (unsigned long)(after.traps - before.traps));
+    check(RCC->AHB1ENR == 0x00000007U, "AHB1ENR = 0x7 (GPIOA-C clocked)");
+    check(!trapping || after.traps - before.traps == 1, "one trapped store for three ports");
+    GPIO_Handle_t led;
+    memset(&led, 0, sizeof(led));
+    led.pGPIOx = GPIOA;
+    led.GPIO_PINConfig.GPIO_PinNumber = GPIO_PIN_NO_5;
+    led.GPIO_PINConfig.GPIO_PinMode = GPIO_MODE_OUT;
+    led.GPIO_PINConfig.GPIO_PinSpeed = GPIO_SPEED_FAST;
+    led.GPIO_PINConfig.GPIO_PinOPType = GPIO_OP_TYPE_PP;
+    GPIO_Init(&led);
+    SimMMIO_Sync();  // Only needed when the host cannot trap writes
+    printf("Virtual GPIOA MODER=0x%08X OSPEEDR=0x%08X\n", (unsigned)pa->MODER, (unsigned)pa->OSPEEDR);
+    check(pa->MODER == 0x00000400U && pa->OSPEEDR == 0x00000800U, "PA5 output, fast speed in the virtual port");
+    
+    // Test 2: Pin writes reach the virtual pin
+    printf("\n--- Test 2: GPIO_WriteToOutputPin / Toggle ---\n");
+    GPIO_WriteToOutputPin(GPIOA, GPIO_PIN_NO_5, GPIO_PIN_SET);
+    SimMMIO_Sync();
+    VirtualGPIO_ReadPin(0, 5, &level);
+    check(level == 1, "set: PA5 = 1");
+    GPIO_ToggleOutputPin(GPIOA, GPIO_PIN_NO_5);
+    SimMMIO_Sync();
+    VirtualGPIO_ReadPin(0, 5, &level);
+    check(level == 0, "toggle: PA5 = 0");
+    
+    // Test 3: BSRR masked writes leave the other pins alone
+    printf("\n--- Test 3: GPIO_WriteMaskedPort / GPIO_ToggleOutputPins ---\n");
+    GPIO_WriteToOutputPort(GPIOA, 0x80F1);
+    GPIO_WriteMaskedPort(GPIOA, 0x0FF0, 0x0A50);
+    SimMMIO_Sync();
+    check(pa->ODR == 0x8A51U, "masked write: ODR = 0x8A51");
+    GPIO_ToggleOutputPins(GPIOA, 0x8003);
+    SimMMIO_Sync();
+    check(pa->ODR == 0x0A52U, "toggle 0x8003: ODR = 0x0A52");
+    
+    // Test 4: Multi-pin init and const port table, one store per register
+    printf("\n--- Test 4: GPIO_InitPins (16-bit bus) / GPIO_ApplyPortConfig ---\n");
+    GPIO_PinMaskConfig_t bus;
+    memset(&bus, 0, sizeof(bus));
+    bus.GPIO_PinMask = 0xFFFF;
+    bus.GPIO_PinMode = GPIO_MODE_OUT;
+    bus.GPIO_PinSpeed = GPIO_SPEED_HIGH;
+    SimMMIO_GetStats(&before);
+    GPIO_InitPins(GPIOB, &bus);
+    SimMMIO_Sync();
+    SimMMIO_GetStats(&after);
+    VirtualGPIORegs *pb = VirtualGPIO_GetRegs(1);
+    printf("GPIOB MODER=0x%08X OSPEEDR=0x%08X, %lu trapped stores\n",
+           (unsigned)pb->MODER, (unsigned)pb->OSPEEDR, (unsigned long)(after.traps - before.traps));
+    check(pb->MODER == 0x55555555U && pb->OSPEEDR == 0xFFFFFFFFU, "GPIOB all outputs, high speed");
+    check(!trapping || after.traps - before.traps == 5, "InitPins: 5 trapped stores");
+    
+    static const GPIO_PortConfig_t boot_config[] = {
+        // PD0-PD3 outputs starting high, PD12 input with pull-up
+        { 3, 0x00000055U, 0x0U, 0x000000FFU, 0x01000000U, 0x000FU, { 0U, 0U } },
+        // PE9 (TIM1_CH1, AF1) alternate function
+        { 4, 0x00080000U, 0x0U, 0x000C0000U, 0x0U, 0x0000U, { 0U, 0x00000010U } },
+    };
+    SimMMIO_GetStats(&before);
+    GPIO_ApplyPortConfig(boot_config, 2);
+    SimMMIO_Sync();
+    SimMMIO_GetStats(&after);
+    VirtualGPIORegs *pd = VirtualGPIO_GetRegs(3);
+    VirtualGPIORegs *pe = VirtualGPIO_GetRegs(4);
+    printf("GPIOD MODER=0x%08X IDR&0x100F=0x%04X, GPIOE AFR[1]=0x%08X, %lu trapped stores\n",
+           (unsigned)pd->MODER, (unsigned)(pd->IDR & 0x100FU), (unsigned)pe->AFR[1],
+           (unsigned long)(after.traps - before.traps));
+    check(pd->MODER == 0x00000055U && (pd->IDR & 0x100FU) == 0x100FU, "GPIOD PD0-3 high outputs, PD12 pulled up");
+    check(pe->AFR[1] == 0x00000010U, "GPIOE PE9 on AF1");
+    check(!trapping || after.traps - before.traps == 15, "ApplyPortConfig: 15 trapped stores");
+    
+    // Test 5: Input with pull-up reads back through the shadow IDR
+    printf("\n--- Test 5: GPIO_ReadFromInputPin (PC13 pull-up) ---\n");
+    GPIO_Handle_t button;
+    memset(&button, 0, sizeof(button));
+    button.pGPIOx = GPIOC;
+    button.GPIO_PINConfig.GPIO_PinNumber = GPIO_PIN_NO_13;
+    button.GPIO_PINConfig.GPIO_PinMode = GPIO_MODE_IN;
+    button.GPIO_PINConfig.GPIO_PinPupdCpntrol = GPIO_PIN_PU;
+    GPIO_Init(&button);
+    SimMMIO_Sync();
+    check(GPIO_ReadFromInputPin(GPIOC, GPIO_PIN_NO_13) == 1, "PC13 reads 1 through the pull-up");
+    
+    // Test 6: Port write and peripheral reset
+    printf("\n--- Test 6: GPIO_WriteToOutputPort / GPIO_DeInit ---\n");
+    GPIO_WriteToOutputPort(GPIOA, 0xA5A5);
+    SimMMIO_Sync();
+    check(pa->ODR == 0xA5A5U, "port write: virtual GPIOA ODR = 0xA5A5");
+    GPIO_DeInit(GPIOA);
+    SimMMIO_Sync();
+    printf("After DeInit: MODER=0x%08X ODR=0x%04X, driver sees MODER=0x%08X\n",
+           (unsigned)pa->MODER, (unsigned)pa->ODR, (unsigned)GPIOA->MODER);
+    check(pa->MODER == 0 && pa->ODR == 0 && GPIOA->MODER == 0, "DeInit resets the virtual port and the shadow");
+    
+    // Test 7: Driver EXTI engine, dispatched from the shared EXTI15_10 vector
+    printf("\n--- Test 7: GPIO_MODE_IT_FT / GPIO_IRQConfig / EXTI dispatch ---\n");
+    button.GPIO_PINConfig.GPIO_PinMode = GPIO_MODE_IT_FT;
+    GPIO_Init(&button);
+    GPIO_RegisterCallback(GPIO_PIN_NO_13, on_exti);
+    GPIO_IRQConfig(GPIO_PinToIRQ(GPIO_PIN_NO_13), 5, ENABLE);
+    SimMMIO_AttachIRQ(IRQ_NO_EXTI15_10, EXTI15_10_IRQHandler, "EXTI15_10");
+    SimMMIO_Sync();
+    VirtualEXTIRegs *vexti = VirtualEXTI_GetRegs();
+    printf("EXTICR4=0x%04X FTSR=0x%04X IMR=0x%04X, IRQ %d enabled=%d priority=%d\n",
+           (unsigned)VirtualSYSCFG_GetRegs()->EXTICR[3], (unsigned)vexti->FTSR,
+           (unsigned)vexti->IMR, IRQ_NO_EXTI15_10, VirtualNVIC_IsEnabled(IRQ_NO_EXTI15_10),
+           VirtualNVIC_GetPriority(IRQ_NO_EXTI15_10));
+    check(VirtualSYSCFG_GetRegs()->EXTICR[3] == 0x0020U, "EXTICR4 routes line 13 to port C");
+    check(vexti->FTSR == 0x2000U && vexti->IMR == 0x2000U, "FTSR and IMR select line 13 only");
+    check(VirtualNVIC_IsEnabled(IRQ_NO_EXTI15_10) && VirtualNVIC_GetPriority(IRQ_NO_EXTI15_10) == 5,
+          "IRQ 40 enabled at priority 5");
+    VirtualGPIO_SimulateInterrupt(2, 13, 0);
+    check(exti_calls == 1 && exti_order[0] == 13, "PC13 falling: one callback on line 13");
+    check(vexti->PR == 0, "PC13 falling: PR cleared by the handler");
+    
+    // Two lines of one vector pending together: serviced highest first
+    GPIO_PinMaskConfig_t lines;
+    memset(&lines, 0, sizeof(lines));
+    lines.GPIO_PinMask = (1U << 10) | (1U << 14);
+    lines.GPIO_PinMode = GPIO_MODE_IT_RT;
+    GPIO_InitPins(GPIOA, &lines);
+    GPIO_RegisterCallback(GPIO_PIN_NO_10, on_exti);
+    GPIO_RegisterCallback(GPIO_PIN_NO_14, on_exti);
+    SimMMIO_Sync();
+    exti_calls = 0;
+    VirtualEXTI_SignalEdge(0, 10, 1);
+    VirtualEXTI_SignalEdge(0, 14, 1);
+    VirtualNVIC_ProcessInterrupts();
+    check(exti_calls == 2 && exti_order[0] == 14 && exti_order[1] == 10, "PA10+PA14 rising: callbacks in order 14, 10");
+    check(vexti->PR == 0, "PA10+PA14 rising: PR cleared by the handler");
+    GPIO_IRQConfig(IRQ_NO_EXTI15_10, 0, DISABLE);
+    SimMMIO_Sync();
+    check(!VirtualNVIC_IsEnabled(IRQ_NO_EXTI15_10), "DISABLE clears the IRQ 40 enable");
+    
+    // Test 8: Driver throughput, trapped and untrapped
+    printf("\n--- Test 8: Driver Benchmark ---\n");
+    uint8_t saved_level = SimLog_GetLevel();
+    SimLog_SetLevel(SIM_LOG_LEVEL_NONE);
+    GPIO_Init(&led);
+    SimMMIO_Sync();
+    
+    if (SimMMIO_SetWriteTrap(1)) {
+        const uint32_t trapped = 20000;
+        SimMMIO_GetStats(&before);
+        clock_t start = clock();
+        for (uint32_t i = 0; i < trapped; i++) {
+            GPIO_ToggleOutputPin(GPIOA, GPIO_PIN_NO_5);
+        }
+        clock_t end = clock();
+        SimMMIO_GetStats(&after);
+        printf("Trapped: %lu toggles, %lu traps, %.0f ns per toggle\n",
+               (unsigned long)trapped, (unsigned long)(after.traps - before.traps),
+               (double)(end - start) * 1e9 / CLOCKS_PER_SEC / trapped);
+    }
+    
+    const uint32_t untrapped = 10000000;
+    SimMMIO_SetWriteTrap(0);
+    clock_t start = clock();
+    for (uint32_t i = 0; i < untrapped; i++) {
+        GPIO_ToggleOutputPin(GPIOA, GPIO_PIN_NO_5);
+    }
+    clock_t end = clock();
+    GPIO_WriteToOutputPin(GPIOA, GPIO_PIN_NO_5, GPIO_PIN_SET);
+    SimMMIO_Sync();
+    SimLog_SetLevel(saved_level);
+    VirtualGPIO_ReadPin(0, 5, &level);
+    printf("Untrapped: %lu toggles, %.2f ns per toggle\n",
+           (unsigned long)untrapped, (double)(end - start) * 1e9 / CLOCKS_PER_SEC / untrapped);
+    check(level == 1, "untrapped writes reach PA5 at the sync");
+    
+    SimMMIO_GetStats(&after);
+    printf("Stats: %lu syncs, %lu traps, %lu read traps, %lu hook calls\n", (unsigned long)after.syncs,
+           (unsigned long)after.traps, (unsigned long)after.read_traps, (unsigned long)after.hook_calls);
+    
+    return sim_test_result("MMIO");
+}
+#endif  // RUN_STANDALONE_TEST
@@ -0,0 +1,57 @@
+/*
+ * sim_mmio.h - Shadow register file for host builds of the bare-metal drivers
+ * Maps the STM32F446 peripheral address space into host memory and forwards
+ * register writes to the virtual peripherals
+ */
+
+#ifndef SIM_MMIO_H_
+#define SIM_MMIO_H_
+
+#include <stdint.h>
+
+#define SIM_MMIO_WINDOW_BASE 0x40000000U  // PERIPH_BASEADDR
+#define SIM_MMIO_WINDOW_SIZE 0x00080000U  // APB1, APB2 and AHB1 (up to 0x4007FFFF)
+#define SIM_MMIO_SCS_BASE    0xE000E000U  // Cortex-M System Control Space (NVIC)
+#define SIM_MMIO_SCS_SIZE    0x00001000U
+#define SIM_MMIO_MAX_REGIONS 32
+#define SIM_MMIO_MAX_READ_TRAPS 16
+
+// Called for each 32-bit register whose value changed (offset from region
+// base), and for the register a trapped store hit even if its value did
+// not change (write-1 registers such as EXTI->PR and NVIC->ICER)
+typedef void (*SimMMIOWriteHook)(void *ctx, uint32_t offset, uint32_t old_value, uint32_t new_value);
+// Called to copy peripheral state (status, input levels) back into the shadow
+typedef void (*SimMMIORefreshFn)(void *ctx, volatile uint32_t *regs);
+// Called after a load from a read-trapped register (offset from the trap
+// base), for reads with side effects such as a DR read clearing RXNE
+typedef void (*SimMMIOReadHook)(void *ctx, uint32_t offset);
+// Level of a peripheral's interrupt output
+typedef uint8_t (*SimMMIOIRQLevelFn)(void *ctx);
+
+// Shadow register files, the bases the drivers' MMIO_ADDR() and SCS_ADDR()
+// resolve against
+extern uint8_t *sim_mmio_shadow;
+extern uint8_t *sim_mmio_scs;
+
+typedef struct {
+    uint32_t syncs;      // SimMMIO_Sync() calls
+    uint32_t traps;      // Writes caught by page protection
+    uint32_t hook_calls; // Register changes delivered to hooks
+    uint32_t read_traps; // Loads caught on read-trapped pages
+} SimMMIOStats;
+
+uint8_t SimMMIO_Init(void);
+uint8_t SimMMIO_GetLastError(void);
+volatile void *SimMMIO_Addr(uint32_t addr);
+uint8_t SimMMIO_AddRegion(uint32_t base, uint32_t size, SimMMIOWriteHook hook,
+                          SimMMIORefreshFn refresh, void *ctx);
+uint8_t SimMMIO_AddReadTrap(uint32_t base, uint32_t size, SimMMIOReadHook hook, void *ctx);
+uint8_t SimMMIO_SetWriteTrap(uint8_t enable);
+uint8_t SimMMIO_InTrap(void);
+void SimMMIO_Sync(void);
+uint8_t SimMMIO_AttachIRQ(uint8_t irq, void (*handler)(void), const char *name);
+uint8_t SimMMIO_SetIRQLevel(uint8_t irq, SimMMIOIRQLevelFn level, void *ctx);
+uint32_t SimMMIO_GetAPBDivider(uint8_t apb2);
+void SimMMIO_GetStats(SimMMIOStats *stats);
+
+#endif /* SIM_MMIO_H_ */
@@ -7,9 +7,19 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <time.h>
+
+#include "sim_log.h"
+#include "sim_nvic.h"
+#include "sim_clock.h"
+#include "sim_rand.h"
 
 #define MAX_IRQ_LINES 240  // Support all STM32 variants (typical range: 82-90 for common STM32F4, up to 240 for larger devices)
 #define MAX_PRIORITY 15    // 4-bit priority (0-15, 0 is highest)
+#define IRQ_WORDS ((MAX_IRQ_LINES + 31) / 32)  // 32-bit words per priority bitmap
+#define PRIORITY_BITS 4    // Implemented priority bits (__NVIC_PRIO_BITS)
+#define THREAD_LEVEL (MAX_PRIORITY + 1)  // Preemption level of thread mode
+#define TAIL_CHAIN_LIMIT 1000  // Safety limit for back-to-back handlers
 
 // IRQ States
 #define IRQ_STATE_INACTIVE 0
@@ -27,6 +37,7 @@ typedef struct {
     uint8_t pending;
     uint8_t active;
     uint8_t priority;
+    uint64_t pend_cycle;  // Virtual clock when the line last became pending
     void (*handler)(void);
     char name[32];
 } VirtualIRQ;
@@ -37,6 +48,72 @@ static uint8_t nvic_initialized = 0;
 static uint8_t global_irq_enabled = 1;
 static uint8_t error_injection_enabled = 0;
 static uint8_t last_error = NVIC_ERROR_NONE;
+static SimRand nvic_rng;  // Error injection
+
+// Active-handler stack (top = currently executing handler). Only a strictly
+// higher preemption level can nest, so depth never exceeds the level count.
+static uint8_t active_stack[MAX_PRIORITY + 1];
+static uint8_t active_depth = 0;
+static uint8_t preempt_bits = PRIORITY_BITS;  // Priority grouping: preemption bits
+static VirtualNVICStats nvic_stats;
+
+// Ready set: lines that are enabled, pending and not active, bucketed by
+// priority. Two summary levels make the highest-priority lookup O(1).
+static uint32_t ready_bitmap[MAX_PRIORITY + 1][IRQ_WORDS];
+static uint8_t ready_words[MAX_PRIORITY + 1];  // Bit w set if ready_bitmap[p][w] != 0
+static uint16_t ready_priorities = 0;          // Bit p set if ready_words[p] != 0
+
+// Index of the lowest set bit (x must be non-zero)
+static inline int lowest_set_bit(uint32_t x) {
+#if defined(__GNUC__)
+    return __builtin_ctz(x);
+#else
+    int n = 0;
+    while (!(x & 1U)) { x >>= 1; n++; }
+    return n;
+#endif
+}
+
+// Remove one line from the ready bucket of the given priority
+static void ready_clear(uint8_t prio, uint8_t irq_num) {
+    uint8_t word = irq_num / 32;
+    
+    ready_bitmap[prio][word] &= ~(1U << (irq_num % 32));
+    if (ready_bitmap[prio][word] == 0) {
+        ready_words[prio] &= (uint8_t)~(1U << word);
+        if (ready_words[prio] == 0) {
+            ready_priorities &= (uint16_t)~(1U << prio);
+        }
+    }
+}
+
+// Insert or remove one line in the ready set according to its state
+static void update_ready(uint8_t irq_num) {
+    VirtualIRQ *irq = &irq_lines[irq_num];
+    uint8_t prio = irq->priority;
+    uint8_t word = irq_num / 32;
+    
+    if (irq->enabled && irq->pending && !irq->active) {
+        ready_bitmap[prio][word] |= 1U << (irq_num % 32);
+        ready_words[prio] |= (uint8_t)(1U << word);
+        ready_priorities |= (uint16_t)(1U << prio);
+    } else {
+        ready_clear(prio, irq_num);
+    }
+}
+
+// Preemption level of a priority under the current grouping (sub-priority bits dropped)
+static inline uint8_t preempt_level(uint8_t priority) {
+    return priority >> (PRIORITY_BITS - preempt_bits);
+}
+
+// Preemption level of the running context (thread mode when nothing is active)
+static inline uint8_t current_level(void) {
+    if (active_depth == 0) return THREAD_LEVEL;
+    return preempt_level(irq_lines[active_stack[active_depth - 1]].priority);
+}
+
+static void check_preemption(void);
 
 // Initialize the virtual NVIC
 void VirtualNVIC_Init(void) {
@@ -50,16 +127,24 @@ void VirtualNVIC_Init(void) {
         irq_lines[i].handler = NULL;
         snprintf(irq_lines[i].name, sizeof(irq_lines[i].name), "IRQ_%d", i);
     }
+    memset(ready_bitmap, 0, sizeof(ready_bitmap));
+    memset(ready_words, 0, sizeof(ready_words));
+    ready_priorities = 0;
+    
+    active_depth = 0;
+    preempt_bits = PRIORITY_BITS;
+    memset(&nvic_stats, 0, sizeof(nvic_stats));
+    SimRand_SeedStream(&nvic_rng, SIM_RAND_STREAM_NVIC);
     
     nvic_initialized = 1;
     global_irq_enabled = 1;
-    printf("[VirtualNVIC] Initialized with %d IRQ lines\n", MAX_IRQ_LINES);
+    SIM_LOG_INFO("[VirtualNVIC] Initialized with %d IRQ lines\n", MAX_IRQ_LINES);
 }
 
 // Enable error injection
 void VirtualNVIC_SetErrorInjection(uint8_t enable) {
     error_injection_enabled = enable;
-    printf("[VirtualNVIC] Error injection %s\n", enable ? "ENABLED" : "DISABLED");
+    SIM_LOG_INFO("[VirtualNVIC] Error injection %s\n", enable ? "ENABLED" : "DISABLED");
 }
 
 // Get last error
@@ -67,13 +152,20 @@ uint8_t VirtualNVIC_GetLastError(void) {
     return last_error;
 }
 
+// Reseed error injection (replays the same sequence)
+void VirtualNVIC_SetSeed(uint64_t seed) {
+    if (!nvic_initialized) VirtualNVIC_Init();
+    
+    SimRand_Seed(&nvic_rng, seed);
+}
+
 // Simulate errors
 static uint8_t inject_error(void) {
     if (!error_injection_enabled) return 0;
     
-    if (rand() % 10 == 0) {
-        last_error = (rand() % 2) + 1;
-        printf("[VirtualNVIC] ERROR INJECTED: Code %d\n", last_error);
+    if (SimRand_OneIn(&nvic_rng, 10)) {
+        last_error = (uint8_t)(SimRand_Below(&nvic_rng, 2) + 1);
+        SIM_LOG_WARN("[VirtualNVIC] ERROR INJECTED: Code %d\n", last_error);
         return 1;
     }
     return 0;
@@ -85,16 +177,18 @@ uint8_t VirtualNVIC_EnableIRQ(uint8_t irq_num) {
     
     if (irq_num >= MAX_IRQ_LINES) {
         last_error = NVIC_ERROR_INVALID_IRQ;
-        printf("[VirtualNVIC] ERROR: Invalid IRQ number %d\n", irq_num);
+        SIM_LOG_ERROR("[VirtualNVIC] ERROR: Invalid IRQ number %d\n", irq_num);
         return 0;
     }
     
     if (inject_error()) return 0;
     
     irq_lines[irq_num].enabled = 1;
-    printf("[VirtualNVIC] IRQ %d (%s) enabled\n", irq_num, irq_lines[irq_num].name);
+    update_ready(irq_num);
+    SIM_LOG_DEBUG("[VirtualNVIC] IRQ %d (%s) enabled\n", irq_num, irq_lines[irq_num].name);
     
     last_error = NVIC_ERROR_NONE;
+    check_preemption();
     return 1;
 }
 
@@ -108,7 +202,8 @@ uint8_t VirtualNVIC_DisableIRQ(uint8_t irq_num) {
     }
     
     irq_lines[irq_num].enabled = 0;
-    printf("[VirtualNVIC] IRQ %d (%s) disabled\n", irq_num, irq_lines[irq_num].name);
+    update_ready(irq_num);
+    SIM_LOG_DEBUG("[VirtualNVIC] IRQ %d (%s) disabled\n", irq_num, irq_lines[irq_num].name);
     
     last_error = NVIC_ERROR_NONE;
     return 1;
@@ -125,17 +220,21 @@ uint8_t VirtualNVIC_SetPriority(uint8_t irq_num, uint8_t priority) {
     
     if (priority > MAX_PRIORITY) {
         last_error = NVIC_ERROR_PRIORITY;
-        printf("[VirtualNVIC] ERROR: Invalid priority %d (max %d)\n", 
-               priority, MAX_PRIORITY);
+        SIM_LOG_ERROR("[VirtualNVIC] ERROR: Invalid priority %d (max %d)\n", 
+                      priority, MAX_PRIORITY);
         return 0;
     }
     
     if (inject_error()) return 0;
     
+    // Move the line to its new priority bucket
+    ready_clear(irq_lines[irq_num].priority, irq_num);
     irq_lines[irq_num].priority = priority;
-    printf("[VirtualNVIC] IRQ %d priority set to %d\n", irq_num, priority);
+    update_ready(irq_num);
+    SIM_LOG_DEBUG("[VirtualNVIC] IRQ %d priority set to %d\n", irq_num, priority);
     
     last_error = NVIC_ERROR_NONE;
+    check_preemption();
     return 1;
 }
 
@@ -150,6 +249,33 @@ uint8_t VirtualNVIC_GetPriority(uint8_t irq_num) {
     return irq_lines[irq_num].priority;
 }
 
+// Set priority grouping: number of priority bits used for preemption (0-4),
+// the remaining low bits are sub-priority (ordering only, never preempts)
+uint8_t VirtualNVIC_SetPriorityGrouping(uint8_t bits) {
+    if (!nvic_initialized) VirtualNVIC_Init();
+    
+    if (bits > PRIORITY_BITS) {
+        last_error = NVIC_ERROR_PRIORITY;
+        SIM_LOG_ERROR("[VirtualNVIC] ERROR: Invalid priority grouping %d (max %d)\n",
+                      bits, PRIORITY_BITS);
+        return 0;
+    }
+    
+    preempt_bits = bits;
+    SIM_LOG_DEBUG("[VirtualNVIC] Priority grouping: %d preemption / %d sub-priority bits\n",
+                  bits, PRIORITY_BITS - bits);
+    
+    last_error = NVIC_ERROR_NONE;
+    return 1;
+}
+
+// Get number of preemption priority bits
+uint8_t VirtualNVIC_GetPriorityGrouping(void) {
+    if (!nvic_initialized) VirtualNVIC_Init();
+    
+    return preempt_bits;
+}
+
 // Set IRQ handler
 uint8_t VirtualNVIC_SetHandler(uint8_t irq_num, void (*handler)(void), const char *name) {
     if (!nvic_initialized) VirtualNVIC_Init();
@@ -164,8 +290,8 @@ uint8_t VirtualNVIC_SetHandler(uint8_t irq_num, void (*handler)(void), const cha
         strncpy(irq_lines[irq_num].name, name, sizeof(irq_lines[irq_num].name) - 1);
     }
     
-    printf("[VirtualNVIC] Handler registered for IRQ %d (%s)\n", 
-           irq_num, irq_lines[irq_num].name);
+    SIM_LOG_DEBUG("[VirtualNVIC] Handler registered for IRQ %d (%s)\n", 
+                  irq_num, irq_lines[irq_num].name);
     
     last_error = NVIC_ERROR_NONE;
     return 1;
@@ -182,11 +308,16 @@ uint8_t VirtualNVIC_SetPending(uint8_t irq_num) {
     
     if (inject_error()) return 0;
     
+    if (!irq_lines[irq_num].pending) {
+        irq_lines[irq_num].pend_cycle = SimClock_GetCycles();
+    }
     irq_lines[irq_num].pending = 1;
-    printf("[VirtualNVIC] IRQ %d (%s) set to PENDING\n", 
-           irq_num, irq_lines[irq_num].name);
+    update_ready(irq_num);
+    SIM_LOG_TRACE("[VirtualNVIC] IRQ %d (%s) set to PENDING\n", 
+                  irq_num, irq_lines[irq_num].name);
     
     last_error = NVIC_ERROR_NONE;
+    check_preemption();
     return 1;
 }
 
@@ -200,8 +331,9 @@ uint8_t VirtualNVIC_ClearPending(uint8_t irq_num) {
     }
     
     irq_lines[irq_num].pending = 0;
-    printf("[VirtualNVIC] IRQ %d (%s) pending cleared\n", 
-           irq_num, irq_lines[irq_num].name);
+    update_ready(irq_num);
+    SIM_LOG_TRACE("[VirtualNVIC] IRQ %d (%s) pending cleared\n", 
+                  irq_num, irq_lines[irq_num].name);
     
     last_error = NVIC_ERROR_NONE;
     return 1;
@@ -218,63 +350,159 @@ uint8_t VirtualNVIC_IsPending(uint8_t irq_num) {
     return irq_lines[irq_num].pending;
 }
 
+// Check if IRQ is enabled
+uint8_t VirtualNVIC_IsEnabled(uint8_t irq_num) {
+    if (!nvic_initialized) VirtualNVIC_Init();
+    
+    if (irq_num >= MAX_IRQ_LINES) {
+        return 0;
+    }
+    
+    return irq_lines[irq_num].enabled;
+}
+
+// Check if IRQ handler is currently active (running or preempted)
+uint8_t VirtualNVIC_IsActive(uint8_t irq_num) {
+    if (!nvic_initialized) VirtualNVIC_Init();
+    
+    if (irq_num >= MAX_IRQ_LINES) {
+        return 0;
+    }
+    
+    return irq_lines[irq_num].active;
+}
+
+// Get the IRQ whose handler is executing (-1 in thread mode)
+int VirtualNVIC_GetActiveIRQ(void) {
+    if (!nvic_initialized) VirtualNVIC_Init();
+    
+    return active_depth ? active_stack[active_depth - 1] : -1;
+}
+
+// Get current handler nesting depth (0 in thread mode)
+uint8_t VirtualNVIC_GetActiveDepth(void) {
+    if (!nvic_initialized) VirtualNVIC_Init();
+    
+    return active_depth;
+}
+
 // Enable all interrupts globally
 void VirtualNVIC_EnableGlobalIRQ(void) {
     global_irq_enabled = 1;
-    printf("[VirtualNVIC] Global interrupts ENABLED\n");
+    SIM_LOG_DEBUG("[VirtualNVIC] Global interrupts ENABLED\n");
+    check_preemption();
 }
 
 // Disable all interrupts globally
 void VirtualNVIC_DisableGlobalIRQ(void) {
     global_irq_enabled = 0;
-    printf("[VirtualNVIC] Global interrupts DISABLED\n");
+    SIM_LOG_DEBUG("[VirtualNVIC] Global interrupts DISABLED\n");
 }
 
-// Find highest priority pending interrupt
+// Find highest priority pending interrupt (lowest IRQ number wins a tie)
 static int find_highest_priority_pending(void) {
-    int highest_irq = -1;
-    uint8_t highest_priority = MAX_PRIORITY + 1;
+    if (ready_priorities == 0) {
+        return -1;
+    }
     
-    for (int i = 0; i < MAX_IRQ_LINES; i++) {
-        if (irq_lines[i].enabled && irq_lines[i].pending && 
-            !irq_lines[i].active) {
-            if (irq_lines[i].priority < highest_priority) {
-                highest_priority = irq_lines[i].priority;
-                highest_irq = i;
+    int prio = lowest_set_bit(ready_priorities);
+    int word = lowest_set_bit(ready_words[prio]);
+    return word * 32 + lowest_set_bit(ready_bitmap[prio][word]);
+}
+
+// Highest priority pending IRQ that may preempt the running context (-1 if none)
+static int find_eligible(void) {
+    if (!global_irq_enabled) return -1;
+    
+    int irq_num = find_highest_priority_pending();
+    if (irq_num < 0 || preempt_level(irq_lines[irq_num].priority) >= current_level()) {
+        return -1;
+    }
+    return irq_num;
+}
+
+// Run one IRQ handler with pending/active bookkeeping
+static void run_handler(int irq_num) {
+    VirtualIRQ *irq = &irq_lines[irq_num];
+    uint32_t latency = (uint32_t)(SimClock_GetCycles() - irq->pend_cycle);
+    
+    SIM_LOG_TRACE("\n[VirtualNVIC] *** Processing IRQ %d (%s) Priority=%d Depth=%d ***\n",
+                  irq_num, irq->name, irq->priority, active_depth + 1);
+    
+    irq->pending = 0;
+    irq->active = 1;
+    update_ready((uint8_t)irq_num);
+    active_stack[active_depth++] = (uint8_t)irq_num;
+    nvic_stats.dispatched++;
+    if (active_depth > nvic_stats.max_depth) nvic_stats.max_depth = active_depth;
+    nvic_stats.last_latency_cycles = latency;
+    if (latency > nvic_stats.max_latency_cycles) nvic_stats.max_latency_cycles = latency;
+    
+    if (irq->handler != NULL) {
+        irq->handler();
+    } else {
+        SIM_LOG_WARN("[VirtualNVIC] WARNING: No handler for IRQ %d\n", irq_num);
+    }
+    
+    active_depth--;
+    irq->active = 0;
+    update_ready((uint8_t)irq_num);  // Handler may have re-pended its own line
+    SIM_LOG_TRACE("[VirtualNVIC] *** IRQ %d completed ***\n\n", irq_num);
+}
+
+// Exception entry: run irq_num, then tail-chain every IRQ that is still
+// eligible against the interrupted context before returning to it.
+// Cycle cost follows the Cortex-M4: full stacking on entry, a short
+// tail-chain instead of unstack/restack, and unstacking on return.
+static void exception_entry(int irq_num) {
+    int chained = 0;
+    
+    SimClock_Advance(SIM_CYCLES_IRQ_ENTRY);
+    
+    if (active_depth > 0) {
+        nvic_stats.preemptions++;
+        SIM_LOG_TRACE("[VirtualNVIC] IRQ %d preempts IRQ %d\n",
+                      irq_num, active_stack[active_depth - 1]);
+    }
+    
+    while (irq_num >= 0) {
+        run_handler(irq_num);
+        
+        irq_num = find_eligible();
+        if (irq_num >= 0) {
+            if (++chained > TAIL_CHAIN_LIMIT) {
+                SIM_LOG_WARN("[VirtualNVIC] WARNING: Tail-chain limit reached, returning\n");
+                break;
             }
+            nvic_stats.tail_chains++;
+            SimClock_Advance(SIM_CYCLES_IRQ_TAIL_CHAIN);
+            SIM_LOG_TRACE("[VirtualNVIC] Tail-chaining to IRQ %d\n", irq_num);
         }
     }
     
-    return highest_irq;
+    SimClock_Advance(SIM_CYCLES_IRQ_EXIT);
+}
+
+// Preempt the running handler if a higher preemption level became pending.
+// In thread mode, dispatch only happens through ProcessInterrupts.
+static void check_preemption(void) {
+    if (active_depth == 0) return;
+    
+    int irq_num = find_eligible();
+    if (irq_num >= 0) {
+        exception_entry(irq_num);
+    }
 }
 
-// Process pending interrupts
+// Process pending interrupts: take the highest priority eligible IRQ
+// and tail-chain any others that are pending when it returns
 void VirtualNVIC_ProcessInterrupts(void) {
     if (!nvic_initialized) VirtualNVIC_Init();
     
-    if (!global_irq_enabled) {
-        return;
-    }
-    
-    int irq_num = find_highest_priority_pending();
+    int irq_num = find_eligible();
     
     if (irq_num >= 0) {
-        VirtualIRQ *irq = &irq_lines[irq_num];
-        
-        printf("\n[VirtualNVIC] *** Processing IRQ %d (%s) Priority=%d ***\n",
-               irq_num, irq->name, irq->priority);
-        
-        irq->pending = 0;
-        irq->active = 1;
-        
-        if (irq->handler != NULL) {
-            irq->handler();
-        } else {
-            printf("[VirtualNVIC] WARNING: No handler for IRQ %d\n", irq_num);
-        }
-        
-        irq->active = 0;
-        printf("[VirtualNVIC] *** IRQ %d completed ***\n\n", irq_num);
+        exception_entry(irq_num);
     }
 }
 
@@ -282,31 +510,53 @@ void VirtualNVIC_ProcessInterrupts(void) {
 void VirtualNVIC_ProcessAllPending(void) {
     if (!nvic_initialized) VirtualNVIC_Init();
     
-    printf("[VirtualNVIC] Processing all pending interrupts...\n");
+    SIM_LOG_TRACE("[VirtualNVIC] Processing all pending interrupts...\n");
     
-    int processed = 0;
-    while (find_highest_priority_pending() >= 0) {
-        VirtualNVIC_ProcessInterrupts();
-        processed++;
-        if (processed > 100) {  // Safety limit
-            printf("[VirtualNVIC] WARNING: Too many pending interrupts, stopping\n");
+    uint32_t start = nvic_stats.dispatched;
+    int entries = 0;
+    int irq_num;
+    while ((irq_num = find_eligible()) >= 0) {
+        if (entries >= 100) {  // Safety limit
+            SIM_LOG_WARN("[VirtualNVIC] WARNING: Too many pending interrupts, stopping\n");
             break;
         }
+        exception_entry(irq_num);
+        entries++;
     }
     
+    uint32_t processed = nvic_stats.dispatched - start;
     if (processed == 0) {
-        printf("[VirtualNVIC] No pending interrupts\n");
+        SIM_LOG_TRACE("[VirtualNVIC] No pending interrupts\n");
     } else {
-        printf("[VirtualNVIC] Processed %d interrupts\n", processed);
+        SIM_LOG_TRACE("[VirtualNVIC] Processed %u interrupts\n", (unsigned)processed);
+    }
+}
+
+// Copy dispatch statistics
+void VirtualNVIC_GetStats(VirtualNVICStats *stats) {
+    if (stats != NULL) {
+        *stats = nvic_stats;
     }
 }
 
+// Reset dispatch statistics
+void VirtualNVIC_ResetStats(void) {
+    memset(&nvic_stats, 0, sizeof(nvic_stats));
+}
+
 // Print NVIC state
 void VirtualNVIC_PrintState(void) {
     if (!nvic_initialized) VirtualNVIC_Init();
     
     printf("\n=== Virtual NVIC State ===\n");
     printf("Global IRQ: %s\n", global_irq_enabled ? "ENABLED" : "DISABLED");
+    printf("Priority grouping: %d preemption / %d sub-priority bits\n",
+           preempt_bits, PRIORITY_BITS - preempt_bits);
+    printf("Active stack:");
+    for (int i = 0; i < active_depth; i++) {
+        printf(" %d", active_stack[i]);
+    }
+    printf("%s\n", active_depth ? "" : " (thread mode)");
     printf("\nActive/Pending IRQs:\n");
     printf("IRQ | Name                | En | Pend | Act | Prio\n");
     printf("----+---------------------+----+------+-----+-----\n");
@@ -345,6 +595,62 @@ void usart_irq_handler(void) {
 }
 
 #ifdef RUN_STANDALONE_TEST
+#include "sim_test.h"
+
+static unsigned long storm_count = 0;
+
+// Dispatch trace: IRQ and nesting depth of each handler entry
+static int trace_irq[16];
+static int trace_depth[16];
+static int trace_len = 0;
+
+static void trace_current(void) {
+    if (trace_len < 16) {
+        trace_irq[trace_len] = VirtualNVIC_GetActiveIRQ();
+        trace_depth[trace_len] = VirtualNVIC_GetActiveDepth();
+        trace_len++;
+    }
+}
+
+static void traced_timer_handler(void) {
+    trace_current();
+    timer_irq_handler();
+}
+
+static void traced_gpio_handler(void) {
+    trace_current();
+    gpio_irq_handler();
+}
+
+static void traced_usart_handler(void) {
+    trace_current();
+    usart_irq_handler();
+}
+
+static void storm_irq_handler(void) {
+    storm_count++;
+}
+
+// Low priority handler that raises a higher and an equal preemption level IRQ
+static void nesting_low_handler(void) {
+    trace_current();
+    printf("  [Handler] Low priority handler start (depth %d)\n", VirtualNVIC_GetActiveDepth());
+    VirtualNVIC_SetPending(61);  // Higher preemption level: nests immediately
+    VirtualNVIC_SetPending(62);  // Same preemption level: tail-chains on return
+    printf("  [Handler] Low priority handler end\n");
+}
+
+static void nesting_high_handler(void) {
+    trace_current();
+    printf("  [Handler] High priority handler (depth %d, preempted IRQ %d)\n",
+           VirtualNVIC_GetActiveDepth(), active_stack[0]);
+}
+
+static void nesting_chain_handler(void) {
+    trace_current();
+    printf("  [Handler] Tail-chained handler (depth %d)\n", VirtualNVIC_GetActiveDepth());
+}
+
 // Test function - only compiled when RUN_STANDALONE_TEST is defined
 int main(void) {
     printf("=== Virtual NVIC Test ===\n\n");
@@ -356,17 +662,18 @@ int main(void) {
     printf("--- Test 1: Basic IRQ Configuration ---\n");
     VirtualNVIC_EnableIRQ(6);   // TIM1 Update
     VirtualNVIC_SetPriority(6, 2);
-    VirtualNVIC_SetHandler(6, timer_irq_handler, "TIM1_Update");
+    VirtualNVIC_SetHandler(6, traced_timer_handler, "TIM1_Update");
+    check(VirtualNVIC_GetPriority(6) == 2, "IRQ 6 enabled at priority 2");
     
     // Test 2: Multiple IRQs with different priorities
     printf("\n--- Test 2: Multiple IRQs with Priorities ---\n");
     VirtualNVIC_EnableIRQ(23);  // EXTI9_5
     VirtualNVIC_SetPriority(23, 1);  // Higher priority (lower number)
-    VirtualNVIC_SetHandler(23, gpio_irq_handler, "EXTI9_5");
+    VirtualNVIC_SetHandler(23, traced_gpio_handler, "EXTI9_5");
     
     VirtualNVIC_EnableIRQ(37);  // USART1
     VirtualNVIC_SetPriority(37, 3);  // Lower priority
-    VirtualNVIC_SetHandler(37, usart_irq_handler, "USART1");
+    VirtualNVIC_SetHandler(37, traced_usart_handler, "USART1");
     
     // Test 3: Trigger interrupts
     printf("\n--- Test 3: Trigger and Process Interrupts ---\n");
@@ -377,35 +684,103 @@ int main(void) {
     VirtualNVIC_PrintState();
     
     printf("Processing interrupts in priority order:\n");
+    trace_len = 0;
     VirtualNVIC_ProcessAllPending();
+    check(trace_len == 3 && trace_irq[0] == 23 && trace_irq[1] == 6 && trace_irq[2] == 37,
+          "dispatched by priority: 23, 6, 37");
+    check(trace_depth[0] == 1 && trace_depth[1] == 1 && trace_depth[2] == 1,
+          "each at depth 1: tail-chained, not nested");
     
     // Test 4: Global interrupt control
     printf("\n--- Test 4: Global Interrupt Control ---\n");
     VirtualNVIC_DisableGlobalIRQ();
     VirtualNVIC_SetPending(6);
     printf("Attempting to process with global IRQ disabled:\n");
+    trace_len = 0;
     VirtualNVIC_ProcessInterrupts();  // Should not execute
+    check(trace_len == 0 && VirtualNVIC_IsPending(6), "masked: IRQ stays pending");
     
     VirtualNVIC_EnableGlobalIRQ();
     printf("Processing with global IRQ enabled:\n");
     VirtualNVIC_ProcessInterrupts();
+    check(trace_len == 1 && trace_irq[0] == 6 && !VirtualNVIC_IsPending(6), "unmasked: IRQ 6 dispatched");
     
     // Test 5: Error injection
     printf("\n--- Test 5: Error Injection ---\n");
     VirtualNVIC_SetErrorInjection(1);
+    int injected_ok = 1;
     for (int i = 0; i < 5; i++) {
         if (!VirtualNVIC_EnableIRQ(50 + i)) {
             printf("Failed to enable IRQ with error code: %d\n", 
                    VirtualNVIC_GetLastError());
+            if (VirtualNVIC_GetLastError() == 0) injected_ok = 0;
         }
     }
     VirtualNVIC_SetErrorInjection(0);
+    check(injected_ok, "every injected failure reports an error code");
     
     // Test 6: Final state
     printf("\n--- Test 6: Final State ---\n");
     VirtualNVIC_PrintState();
     
-    printf("=== All Tests Complete ===\n");
-    return 0;
+    // Test 7: Preemption and tail-chaining (2 preemption bits, 2 sub-priority bits)
+    printf("--- Test 7: Preemption and Tail-Chaining ---\n");
+    VirtualNVIC_SetPriorityGrouping(2);
+    VirtualNVIC_SetHandler(60, nesting_low_handler, "LOW_PRIO");
+    VirtualNVIC_SetPriority(60, (3 << 2) | 1);   // Preempt 3, sub 1
+    VirtualNVIC_EnableIRQ(60);
+    VirtualNVIC_SetHandler(61, nesting_high_handler, "HIGH_PRIO");
+    VirtualNVIC_SetPriority(61, (1 << 2) | 0);   // Preempt 1
+    VirtualNVIC_EnableIRQ(61);
+    VirtualNVIC_SetHandler(62, nesting_chain_handler, "CHAINED");
+    VirtualNVIC_SetPriority(62, (3 << 2) | 0);   // Preempt 3, sub 0
+    VirtualNVIC_EnableIRQ(62);
+    VirtualNVIC_ResetStats();
+    trace_len = 0;
+    VirtualNVIC_SetPending(60);
+    VirtualNVIC_ProcessInterrupts();
+    VirtualNVICStats stats;
+    VirtualNVIC_GetStats(&stats);
+    printf("Dispatched=%u Preemptions=%u TailChains=%u MaxDepth=%u\n",
+           (unsigned)stats.dispatched, (unsigned)stats.preemptions,
+           (unsigned)stats.tail_chains, (unsigned)stats.max_depth);
+    printf("Latency: last=%u max=%u cycles\n",
+           (unsigned)stats.last_latency_cycles, (unsigned)stats.max_latency_cycles);
+    check(trace_len == 3 && trace_irq[0] == 60 && trace_irq[1] == 61 && trace_irq[2] == 62,
+          "order: 60, then 61 nested, then 62");
+    check(trace_depth[0] == 1 && trace_depth[1] == 2 && trace_depth[2] == 1,
+          "61 nests at depth 2, 62 tail-chains at depth 1");
+    check(stats.dispatched == 3 && stats.preemptions == 1 && stats.tail_chains == 1 &&
+          stats.max_depth == 2, "stats: 3 dispatched, 1 preemption, 1 tail-chain, depth 2");
+    check(stats.max_latency_cycles == SIM_CYCLES_IRQ_ENTRY &&
+          stats.last_latency_cycles == SIM_CYCLES_IRQ_TAIL_CHAIN,
+          "latency: entry 12 cycles, tail-chain 6 cycles");
+    check(VirtualNVIC_GetActiveDepth() == 0, "back in thread mode");
+    printf("\n");
+    VirtualNVIC_SetPriorityGrouping(PRIORITY_BITS);
+    
+    // Test 8: Interrupt storm throughput (silent logging)
+    printf("--- Test 8: Interrupt Storm Throughput ---\n");
+    uint8_t saved_level = SimLog_GetLevel();
+    SimLog_SetLevel(SIM_LOG_LEVEL_NONE);
+    for (int i = 100; i < 200; i++) {
+        VirtualNVIC_SetHandler(i, storm_irq_handler, NULL);
+        VirtualNVIC_SetPriority(i, i % (MAX_PRIORITY + 1));
+        VirtualNVIC_EnableIRQ(i);
+    }
+    clock_t start = clock();
+    for (int round = 0; round < 10000; round++) {
+        for (int i = 100; i < 200; i++) {
+            VirtualNVIC_SetPending(i);
+        }
+        VirtualNVIC_ProcessAllPending();
+    }
+    clock_t end = clock();
+    SimLog_SetLevel(saved_level);
+    printf("%lu IRQs dispatched in %.3f ms\n", storm_count,
+           (double)(end - start) * 1000.0 / CLOCKS_PER_SEC);
+    check(storm_count == 10000UL * 100UL, "every pended storm IRQ dispatched once");
+    
+    return sim_test_result("Virtual NVIC");
 }
 #endif  // RUN_STANDALONE_TEST
@@ -0,0 +1,47 @@
+/*
+ * sim_nvic.h - Virtual NVIC interface
+ * API shared by the HAL wrapper, the virtual peripherals and user tests
+ */
+
+#ifndef SIM_NVIC_H_
+#define SIM_NVIC_H_
+
+#include <stdint.h>
+
+// Dispatch statistics (reset with VirtualNVIC_ResetStats)
+typedef struct {
+    uint32_t dispatched;   // Handlers run
+    uint32_t preemptions;  // Handlers entered on top of another active handler
+    uint32_t tail_chains;  // Handlers entered straight after another returned
+    uint8_t max_depth;     // Deepest active-handler nesting seen
+    uint32_t last_latency_cycles;  // Pend-to-handler delay of the last dispatch
+    uint32_t max_latency_cycles;   // Worst pend-to-handler delay seen
+} VirtualNVICStats;
+
+void VirtualNVIC_Init(void);
+void VirtualNVIC_SetErrorInjection(uint8_t enable);
+uint8_t VirtualNVIC_GetLastError(void);
+void VirtualNVIC_SetSeed(uint64_t seed);
+uint8_t VirtualNVIC_EnableIRQ(uint8_t irq_num);
+uint8_t VirtualNVIC_DisableIRQ(uint8_t irq_num);
+uint8_t VirtualNVIC_SetPriority(uint8_t irq_num, uint8_t priority);
+uint8_t VirtualNVIC_GetPriority(uint8_t irq_num);
+uint8_t VirtualNVIC_SetPriorityGrouping(uint8_t preempt_bits);
+uint8_t VirtualNVIC_GetPriorityGrouping(void);
+uint8_t VirtualNVIC_SetHandler(uint8_t irq_num, void (*handler)(void), const char *name);
+uint8_t VirtualNVIC_SetPending(uint8_t irq_num);
+uint8_t VirtualNVIC_ClearPending(uint8_t irq_num);
+uint8_t VirtualNVIC_IsPending(uint8_t irq_num);
+uint8_t VirtualNVIC_IsEnabled(uint8_t irq_num);
+uint8_t VirtualNVIC_IsActive(uint8_t irq_num);
+int VirtualNVIC_GetActiveIRQ(void);
+uint8_t VirtualNVIC_GetActiveDepth(void);
+void VirtualNVIC_EnableGlobalIRQ(void);
+void VirtualNVIC_DisableGlobalIRQ(void);
+void VirtualNVIC_ProcessInterrupts(void);
+void VirtualNVIC_ProcessAllPending(void);
+void VirtualNVIC_GetStats(VirtualNVICStats *stats);
+void VirtualNVIC_ResetStats(void);
+void VirtualNVIC_PrintState(void);
+
+#endif /* SIM_NVIC_H_ */
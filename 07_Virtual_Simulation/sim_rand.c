@@ -0,0 +1,133 @@
+/*
+ * sim_rand.c - Seedable pseudo-random generator for the virtual peripherals
+ * One global base seed, expanded into an independent stream per peripheral
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "sim_log.h"
+#include "sim_rand.h"
+
+// Base seed for all streams. Taken from the SIM_SEED environment variable
+// on first use if set, so a failing run can be replayed without rebuilding.
+static uint64_t base_seed = SIM_RAND_DEFAULT_SEED;
+static uint8_t seed_loaded = 0;
+
+// splitmix64 step, used to expand a 64-bit seed into generator state
+static uint64_t splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Set the base seed used by peripherals initialized from now on
+void SimRand_SetSeed(uint64_t seed) {
+    base_seed = seed;
+    seed_loaded = 1;
+    SIM_LOG_INFO("[SimRand] Seed set to 0x%016llX\n", (unsigned long long)seed);
+}
+
+// Get the base seed (print it with a failing test to replay the run)
+uint64_t SimRand_GetSeed(void) {
+    if (!seed_loaded) {
+        const char *env = getenv("SIM_SEED");
+        if (env != NULL && *env != '\0') {
+            base_seed = strtoull(env, NULL, 0);
+            SIM_LOG_INFO("[SimRand] Seed 0x%016llX from SIM_SEED\n",
+                         (unsigned long long)base_seed);
+        }
+        seed_loaded = 1;
+    }
+    return base_seed;
+}
+
+// Seed one generator instance directly
+void SimRand_Seed(SimRand *rng, uint64_t seed) {
+    uint64_t x = seed;
+    uint64_t a = splitmix64(&x);
+    uint64_t b = splitmix64(&x);
+    
+    rng->s[0] = (uint32_t)a;
+    rng->s[1] = (uint32_t)(a >> 32);
+    rng->s[2] = (uint32_t)b;
+    rng->s[3] = (uint32_t)(b >> 32);
+    if ((rng->s[0] | rng->s[1] | rng->s[2] | rng->s[3]) == 0) {
+        rng->s[0] = 1;  // All-zero state would only ever return 0
+    }
+}
+
+// Seed a generator with its own stream of the base seed
+void SimRand_SeedStream(SimRand *rng, uint32_t stream) {
+    SimRand_Seed(rng, SimRand_GetSeed() ^ ((uint64_t)stream * 0xD1B54A32D192ED03ULL));
+}
+
+#ifdef RUN_STANDALONE_TEST
+#include "sim_test.h"
+
+// Test function - only compiled when RUN_STANDALONE_TEST is defined
+int main(void) {
+    printf("=== Simulator PRNG Test ===\n\n");
+    
+    // Test 1: Same seed, same sequence
+    printf("--- Test 1: Replay ---\n");
+    SimRand a, b;
+    SimRand_Seed(&a, 42);
+    SimRand_Seed(&b, 42);
+    int same = 1;
+    for (int i = 0; i < 1000; i++) {
+        if (SimRand_Next(&a) != SimRand_Next(&b)) same = 0;
+    }
+    check(same, "seed 42 twice gives the same 1000 values");
+    
+    // Test 2: Streams of one base seed are independent
+    printf("\n--- Test 2: Per-Peripheral Streams ---\n");
+    SimRand_SetSeed(1234);
+    SimRand gpio_rng, nvic_rng;
+    SimRand_SeedStream(&gpio_rng, SIM_RAND_STREAM_GPIO);
+    SimRand_SeedStream(&nvic_rng, SIM_RAND_STREAM_NVIC);
+    int collisions = 0;
+    for (int i = 0; i < 1000; i++) {
+        uint32_t g = SimRand_Next(&gpio_rng);
+        uint32_t n = SimRand_Next(&nvic_rng);
+        if (i < 2) printf("Draw %d: GPIO stream 0x%08X, NVIC stream 0x%08X\n", i, (unsigned)g, (unsigned)n);
+        if (g == n) collisions++;
+    }
+    check(collisions == 0, "GPIO and NVIC streams of one seed differ");
+    
+    // Test 3: Bounded values are uniform
+    printf("\n--- Test 3: Uniformity of SimRand_Below(10) ---\n");
+    unsigned histogram[10] = {0};
+    for (int i = 0; i < 1000000; i++) {
+        histogram[SimRand_Below(&a, 10)]++;
+    }
+    int uniform = 1;
+    for (int i = 0; i < 10; i++) {
+        printf("%d: %u\n", i, histogram[i]);
+        // Expected 100000 each, standard deviation 300: allow 5 sigma
+        if (histogram[i] < 98500 || histogram[i] > 101500) uniform = 0;
+    }
+    check(uniform, "every bucket within 1.5% of 100000");
+    
+    // Test 4: Throughput against the C library generator
+    printf("\n--- Test 4: Throughput (10M values) ---\n");
+    uint32_t sink = 0;
+    clock_t start = clock();
+    for (int i = 0; i < 10000000; i++) {
+        sink ^= SimRand_Next(&a);
+    }
+    clock_t mid = clock();
+    for (int i = 0; i < 10000000; i++) {
+        sink ^= (uint32_t)rand();
+    }
+    clock_t end = clock();
+    printf("SimRand_Next: %.3f ms, rand(): %.3f ms (checksum 0x%08X)\n",
+           (double)(mid - start) * 1000.0 / CLOCKS_PER_SEC,
+           (double)(end - mid) * 1000.0 / CLOCKS_PER_SEC, (unsigned)sink);
+    
+    return sim_test_result("Simulator PRNG");
+}
+#endif  // RUN_STANDALONE_TEST
@@ -0,0 +1,65 @@
+/*
+ * sim_rand.h - Seedable pseudo-random generator for the virtual peripherals
+ * xoshiro128** per instance, so runs replay exactly and instances share no state
+ */
+
+#ifndef SIM_RAND_H_
+#define SIM_RAND_H_
+
+#include <stdint.h>
+
+#define SIM_RAND_DEFAULT_SEED 0x5EED5EED5EED5EEDULL
+
+// Stream IDs: each virtual peripheral draws from its own sequence
+#define SIM_RAND_STREAM_GPIO 1
+#define SIM_RAND_STREAM_NVIC 2
+#define SIM_RAND_STREAM_ADC  3
+
+// Generator state (never all zero once seeded)
+typedef struct {
+    uint32_t s[4];
+} SimRand;
+
+void SimRand_SetSeed(uint64_t seed);
+uint64_t SimRand_GetSeed(void);
+void SimRand_Seed(SimRand *rng, uint64_t seed);
+void SimRand_SeedStream(SimRand *rng, uint32_t stream);
+
+static inline uint32_t sim_rand_rotl(uint32_t x, int k) {
+    return (x << k) | (x >> (32 - k));
+}
+
+// Next 32-bit value (xoshiro128**)
+static inline uint32_t SimRand_Next(SimRand *rng) {
+    uint32_t *s = rng->s;
+    uint32_t result = sim_rand_rotl(s[1] * 5U, 7) * 9U;
+    uint32_t t = s[1] << 9;
+    
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = sim_rand_rotl(s[3], 11);
+    return result;
+}
+
+// Uniform value in [0, bound) without modulo bias (bound must be non-zero)
+static inline uint32_t SimRand_Below(SimRand *rng, uint32_t bound) {
+    uint64_t m = (uint64_t)SimRand_Next(rng) * bound;
+    
+    if ((uint32_t)m < bound) {
+        uint32_t threshold = (uint32_t)(-bound) % bound;
+        while ((uint32_t)m < threshold) {
+            m = (uint64_t)SimRand_Next(rng) * bound;
+        }
+    }
+    return (uint32_t)(m >> 32);
+}
+
+// 1 with probability 1/n
+static inline uint8_t SimRand_OneIn(SimRand *rng, uint32_t n) {
+    return SimRand_Below(rng, n) == 0;
+}
+
+#endif /* SIM_RAND_H_ */
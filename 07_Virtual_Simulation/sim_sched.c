@@ -0,0 +1,377 @@
+/*
+ * sim_sched.c - Discrete-event scheduler for the simulation framework
+ * Binary min-heap of timestamped events driving the virtual peripherals
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "sim_log.h"
+#include "sim_clock.h"
+#include "sim_nvic.h"
+#include "sim_sched.h"
+
+#define MAX_SIM_EVENTS 256  // Events that can be outstanding at once
+#define NO_HEAP_POS 0xFFFFU
+
+// Event slot. Handles carry a generation count so a stale handle
+// (event already run or cancelled) never hits a reused slot.
+typedef struct {
+    uint64_t when;      // Due cycle
+    uint32_t seq;       // Post order, keeps equal-time events FIFO
+    SimEventFn fn;
+    void *ctx;
+    uint16_t heap_pos;  // Index in event_heap, NO_HEAP_POS when free
+    uint16_t gen;
+} SimEvent;
+
+// Scheduler state
+static SimEvent events[MAX_SIM_EVENTS];
+static uint16_t event_heap[MAX_SIM_EVENTS];  // Slot indices, earliest at [0]
+static uint16_t heap_size = 0;
+static uint16_t free_slots[MAX_SIM_EVENTS];
+static uint16_t free_count = 0;
+static uint32_t next_seq = 0;
+static uint8_t sched_initialized = 0;
+
+// Heap order: earlier cycle first, then earlier post
+static inline int event_before(uint16_t a, uint16_t b) {
+    if (events[a].when != events[b].when) return events[a].when < events[b].when;
+    return (int32_t)(events[a].seq - events[b].seq) < 0;
+}
+
+static inline void heap_place(uint16_t pos, uint16_t slot) {
+    event_heap[pos] = slot;
+    events[slot].heap_pos = pos;
+}
+
+static void sift_up(uint16_t pos) {
+    uint16_t slot = event_heap[pos];
+    
+    while (pos > 0) {
+        uint16_t parent = (uint16_t)((pos - 1) / 2);
+        if (!event_before(slot, event_heap[parent])) break;
+        heap_place(pos, event_heap[parent]);
+        pos = parent;
+    }
+    heap_place(pos, slot);
+}
+
+static void sift_down(uint16_t pos) {
+    uint16_t slot = event_heap[pos];
+    
+    for (;;) {
+        uint16_t child = (uint16_t)(2 * pos + 1);
+        if (child >= heap_size) break;
+        if (child + 1 < heap_size && event_before(event_heap[child + 1], event_heap[child])) {
+            child++;
+        }
+        if (!event_before(event_heap[child], slot)) break;
+        heap_place(pos, event_heap[child]);
+        pos = child;
+    }
+    heap_place(pos, slot);
+}
+
+// Take an event out of the heap and return its slot to the free list
+static void remove_event(uint16_t slot) {
+    uint16_t pos = events[slot].heap_pos;
+    
+    heap_size--;
+    if (pos != heap_size) {
+        heap_place(pos, event_heap[heap_size]);
+        if (pos > 0 && event_before(event_heap[pos], event_heap[(pos - 1) / 2])) {
+            sift_up(pos);
+        } else {
+            sift_down(pos);
+        }
+    }
+    events[slot].heap_pos = NO_HEAP_POS;
+    events[slot].gen++;
+    free_slots[free_count++] = slot;
+}
+
+// Initialize the scheduler with an empty event queue
+void SimSched_Init(void) {
+    if (sched_initialized) return;
+    
+    for (int i = 0; i < MAX_SIM_EVENTS; i++) {
+        events[i].heap_pos = NO_HEAP_POS;
+        events[i].gen = 0;
+        free_slots[i] = (uint16_t)(MAX_SIM_EVENTS - 1 - i);
+    }
+    free_count = MAX_SIM_EVENTS;
+    heap_size = 0;
+    next_seq = 0;
+    
+    sched_initialized = 1;
+    SIM_LOG_INFO("[SimSched] Initialized with %d event slots\n", MAX_SIM_EVENTS);
+}
+
+// Drop every outstanding event (the virtual clock is not touched)
+void SimSched_Reset(void) {
+    if (!sched_initialized) SimSched_Init();
+    
+    while (heap_size > 0) {
+        remove_event(event_heap[heap_size - 1]);
+    }
+    SIM_LOG_DEBUG("[SimSched] Event queue cleared\n");
+}
+
+// Post an event at an absolute cycle (a cycle in the past runs on the next Run call)
+uint32_t SimSched_PostAt(uint64_t cycle, SimEventFn fn, void *ctx) {
+    if (!sched_initialized) SimSched_Init();
+    
+    if (fn == NULL) {
+        SIM_LOG_ERROR("[SimSched] ERROR: NULL event callback\n");
+        return SIM_EVENT_INVALID;
+    }
+    
+    if (free_count == 0) {
+        SIM_LOG_ERROR("[SimSched] ERROR: Event queue full (%d events)\n", MAX_SIM_EVENTS);
+        return SIM_EVENT_INVALID;
+    }
+    
+    uint16_t slot = free_slots[--free_count];
+    SimEvent *ev = &events[slot];
+    ev->when = cycle;
+    ev->seq = next_seq++;
+    ev->fn = fn;
+    ev->ctx = ctx;
+    
+    heap_place(heap_size, slot);
+    heap_size++;
+    sift_up(ev->heap_pos);
+    
+    SIM_LOG_TRACE("[SimSched] Event %d posted for cycle %llu\n",
+                  slot, (unsigned long long)cycle);
+    
+    // Low 16 bits: slot + 1 (never 0), high 16 bits: generation
+    return ((uint32_t)ev->gen << 16) | (uint32_t)(slot + 1);
+}
+
+// Post an event delay_cycles after the current virtual time
+uint32_t SimSched_Post(uint64_t delay_cycles, SimEventFn fn, void *ctx) {
+    return SimSched_PostAt(SimClock_GetCycles() + delay_cycles, fn, ctx);
+}
+
+// Event callback that raises an NVIC line (IRQ number carried in the context)
+static void irq_event(void *ctx) {
+    VirtualNVIC_SetPending((uint8_t)(uintptr_t)ctx);
+}
+
+// Pend an interrupt line delay_cycles from now
+uint32_t SimSched_PostIRQ(uint64_t delay_cycles, uint8_t irq_num) {
+    return SimSched_Post(delay_cycles, irq_event, (void *)(uintptr_t)irq_num);
+}
+
+// Cancel an outstanding event (returns 0 if it already ran or was cancelled)
+uint8_t SimSched_Cancel(uint32_t handle) {
+    if (!sched_initialized) SimSched_Init();
+    
+    uint32_t slot = (handle & 0xFFFFU) - 1U;
+    if (handle == SIM_EVENT_INVALID || slot >= MAX_SIM_EVENTS) {
+        return 0;
+    }
+    
+    SimEvent *ev = &events[slot];
+    if (ev->heap_pos == NO_HEAP_POS || ev->gen != (uint16_t)(handle >> 16)) {
+        return 0;
+    }
+    
+    remove_event((uint16_t)slot);
+    SIM_LOG_TRACE("[SimSched] Event %u cancelled\n", (unsigned)slot);
+    return 1;
+}
+
+// Number of outstanding events
+uint32_t SimSched_GetPendingCount(void) {
+    return heap_size;
+}
+
+// Due cycle of the earliest outstanding event (returns 0 if the queue is empty)
+uint8_t SimSched_GetNextEventCycle(uint64_t *cycle) {
+    if (heap_size == 0 || cycle == NULL) {
+        return 0;
+    }
+    
+    *cycle = events[event_heap[0]].when;
+    return 1;
+}
+
+// Jump to the earliest event, run it and let the NVIC take any IRQ it raised
+static void dispatch_next(void) {
+    uint16_t slot = event_heap[0];
+    SimEventFn fn = events[slot].fn;
+    void *ctx = events[slot].ctx;
+    uint64_t now = SimClock_GetCycles();
+    
+    // Nothing happens between events: skip straight to the due cycle.
+    // Callbacks that charged cycles may have pushed the clock past it.
+    if (events[slot].when > now) {
+        SimClock_Advance(events[slot].when - now);
+    }
+    remove_event(slot);  // Before the call, so the callback may re-post
+    
+    fn(ctx);
+    VirtualNVIC_ProcessInterrupts();
+}
+
+// Run every event due up to and including the given cycle, then
+// advance the virtual clock to it. Returns the number of events run.
+uint32_t SimSched_RunUntil(uint64_t cycle) {
+    if (!sched_initialized) SimSched_Init();
+    
+    uint32_t count = 0;
+    while (heap_size > 0 && events[event_heap[0]].when <= cycle) {
+        dispatch_next();
+        count++;
+    }
+    
+    uint64_t now = SimClock_GetCycles();
+    if (cycle > now) {
+        SimClock_Advance(cycle - now);
+    }
+    return count;
+}
+
+// Run the next cycles worth of simulated time
+uint32_t SimSched_RunFor(uint64_t cycles) {
+    return SimSched_RunUntil(SimClock_GetCycles() + cycles);
+}
+
+// Idle until the next event and run it (returns 0 if the queue is empty)
+uint8_t SimSched_RunNext(void) {
+    if (!sched_initialized) SimSched_Init();
+    
+    if (heap_size == 0) {
+        return 0;
+    }
+    
+    dispatch_next();
+    return 1;
+}
+
+#ifdef RUN_STANDALONE_TEST
+#include <string.h>
+#include "sim_test.h"
+
+static unsigned long tick_count = 0;
+static uint64_t tick_period = 0;
+static char event_order[64];
+static uint64_t rx_irq_cycle = 0;
+
+// Print an event and append its name (label up to the space) to event_order
+static void print_event(void *ctx) {
+    const char *label = (const char *)ctx;
+    size_t len = strlen(event_order);
+    
+    printf("  [Event] %s at cycle %llu\n", label,
+           (unsigned long long)SimClock_GetCycles());
+    if (len > 0 && len < sizeof(event_order) - 1) event_order[len++] = ' ';
+    while (*label && *label != ' ' && len < sizeof(event_order) - 1) event_order[len++] = *label++;
+    event_order[len] = '\0';
+}
+
+static void uart_rx_handler(void) {
+    rx_irq_cycle = SimClock_GetCycles();
+    printf("  [Handler] USART2 RX interrupt at cycle %llu\n",
+           (unsigned long long)rx_irq_cycle);
+}
+
+// Periodic 1 ms tick that re-posts itself (like SysTick)
+static void tick_event(void *ctx) {
+    (void)ctx;
+    tick_count++;
+    SimSched_Post(tick_period, tick_event, NULL);
+}
+
+// Test function - only compiled when RUN_STANDALONE_TEST is defined
+int main(void) {
+    printf("=== Virtual Event Scheduler Test ===\n\n");
+    
+    SimClock_Init();
+    VirtualNVIC_Init();
+    SimSched_Init();
+    
+    // Test 1: Events run in time order, equal times in post order
+    printf("--- Test 1: Event Ordering ---\n");
+    SimSched_Post(300, print_event, "C (+300)");
+    SimSched_Post(100, print_event, "A1 (+100)");
+    SimSched_Post(200, print_event, "B (+200)");
+    SimSched_Post(100, print_event, "A2 (+100)");
+    uint32_t ran = SimSched_RunFor(1000);
+    printf("Run for 1000 cycles: %u events\n", (unsigned)ran);
+    check(ran == 4 && strcmp(event_order, "A1 A2 B C") == 0, "time order, equal times FIFO: A1 A2 B C");
+    
+    // Test 2: Cancellation and stale handles
+    printf("\n--- Test 2: Cancel ---\n");
+    uint32_t h = SimSched_Post(50, print_event, "cancelled (must not run)");
+    SimSched_Post(60, print_event, "kept");
+    uint8_t first = SimSched_Cancel(h);
+    uint8_t second = SimSched_Cancel(h);
+    printf("Cancel: %d, cancel again: %d\n", first, second);
+    check(first == 1 && second == 0, "cancel succeeds once, stale handle rejected");
+    event_order[0] = '\0';
+    SimSched_RunFor(100);
+    check(strcmp(event_order, "kept") == 0, "cancelled event never runs");
+    
+    // Test 3: Scheduled interrupt (UART byte received after 1 byte time at 115200 baud)
+    printf("\n--- Test 3: Scheduled IRQ ---\n");
+    VirtualNVIC_SetHandler(38, uart_rx_handler, "USART2");
+    VirtualNVIC_EnableIRQ(38);
+    uint64_t byte_time = SimClock_UsToCycles(87);
+    printf("Byte posted at cycle %llu, due %llu cycles later\n",
+           (unsigned long long)SimClock_GetCycles(), (unsigned long long)byte_time);
+    uint64_t posted = SimClock_GetCycles();
+    SimSched_PostIRQ(byte_time, 38);
+    while (SimSched_RunNext()) {
+    }
+    check(rx_irq_cycle == posted + byte_time + SIM_CYCLES_IRQ_ENTRY,
+          "IRQ handler entered at due time + exception entry");
+    
+    // Test 4: Fast-forward one hour of 1 ms ticks
+    printf("\n--- Test 4: Fast-Forward 1 Hour ---\n");
+    uint8_t saved_level = SimLog_GetLevel();
+    SimLog_SetLevel(SIM_LOG_LEVEL_NONE);
+    tick_period = SimClock_MsToCycles(1);
+    SimSched_Post(tick_period, tick_event, NULL);
+    uint32_t start_ms = SimClock_GetTickMs();
+    clock_t start = clock();
+    SimSched_RunFor(SimClock_MsToCycles(3600U * 1000U));
+    clock_t end = clock();
+    SimLog_SetLevel(saved_level);
+    printf("%lu ticks, %lu ms simulated in %.3f ms host time\n", tick_count,
+           (unsigned long)(SimClock_GetTickMs() - start_ms),
+           (double)(end - start) * 1000.0 / CLOCKS_PER_SEC);
+    check(tick_count == 3600000UL && SimClock_GetTickMs() - start_ms == 3600000U,
+          "3600000 ticks in one simulated hour");
+    SimSched_Reset();
+    printf("Pending after reset: %u\n", (unsigned)SimSched_GetPendingCount());
+    check(SimSched_GetPendingCount() == 0, "reset drops the pending tick");
+    
+    // Test 5: A clock change keeps the time already elapsed
+    printf("\n--- Test 5: Frequency Change ---\n");
+    uint32_t hz = SimClock_GetFrequency();
+    SimClock_Advance(SimClock_MsToCycles(10));
+    uint64_t before_us = SimClock_GetTimeUs();
+    uint32_t before_ms = SimClock_GetTickMs();
+    SimClock_SetFrequency(hz / 2);
+    uint64_t slower_us = SimClock_GetTimeUs();
+    SimClock_SetFrequency(hz * 2);
+    uint64_t faster_us = SimClock_GetTimeUs();
+    check(slower_us == before_us && faster_us == before_us && SimClock_GetTickMs() == before_ms,
+          "halving and doubling the clock leave the time unchanged");
+    SimClock_Advance(SimClock_MsToCycles(5));
+    SimClock_SetFrequency(hz);
+    SimClock_Advance(SimClock_MsToCycles(5));
+    printf("%llu us before, %llu us after 5 ms at 2x and 5 ms at 1x\n",
+           (unsigned long long)before_us, (unsigned long long)SimClock_GetTimeUs());
+    check(SimClock_GetTimeUs() == before_us + 10000U && SimClock_GetTickMs() == before_ms + 10U,
+          "time runs on at each rate, never backwards");
+    
+    return sim_test_result("Virtual Event Scheduler");
+}
+#endif  // RUN_STANDALONE_TEST
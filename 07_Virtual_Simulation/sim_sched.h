@@ -0,0 +1,30 @@
+/*
+ * sim_sched.h - Discrete-event scheduler for the simulation framework
+ * Timestamped future events on the virtual clock, idle time is skipped
+ */
+
+#ifndef SIM_SCHED_H_
+#define SIM_SCHED_H_
+
+#include <stdint.h>
+
+#define SIM_EVENT_INVALID 0  // Handle returned when an event cannot be posted
+
+// Event callback, runs at its due cycle with the context given when posting
+typedef void (*SimEventFn)(void *ctx);
+
+void SimSched_Init(void);
+void SimSched_Reset(void);
+uint32_t SimSched_Post(uint64_t delay_cycles, SimEventFn fn, void *ctx);
+uint32_t SimSched_PostAt(uint64_t cycle, SimEventFn fn, void *ctx);
+uint32_t SimSched_PostIRQ(uint64_t delay_cycles, uint8_t irq_num);
+uint8_t SimSched_Cancel(uint32_t handle);
+uint32_t SimSched_GetPendingCount(void);
+uint8_t SimSched_GetNextEventCycle(uint64_t *cycle);
+
+// Run events in time order, jumping the virtual clock over idle gaps
+uint32_t SimSched_RunUntil(uint64_t cycle);
+uint32_t SimSched_RunFor(uint64_t cycles);
+uint8_t SimSched_RunNext(void);
+
+#endif /* SIM_SCHED_H_ */
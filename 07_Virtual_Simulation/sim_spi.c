@@ -0,0 +1,995 @@
+/*
+ * sim_spi.c - Virtual SPI Simulator
+ * SPI1-3 masters behind the shadow registers: the unmodified driver's
+ * register accesses drive a TX buffer and shift register timed from the BR
+ * prescaler and the APB clock, with TXE/RXNE/OVR/BSY as on the real
+ * peripheral. Device models on the bus are selected by the GPIO output
+ * driving their chip select.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "stm32f446re.h"
+#include "sim_log.h"
+#include "sim_clock.h"
+#include "sim_sched.h"
+#include "sim_nvic.h"
+#include "sim_gpio.h"
+#include "sim_mmio.h"
+#include "sim_spi.h"
+
+#define NEVER UINT64_MAX
+
+// Error codes
+#define VSPI_ERROR_NONE    0
+#define VSPI_ERROR_PORT    1
+#define VSPI_ERROR_MMIO    2
+#define VSPI_ERROR_DEVICE  3
+#define VSPI_ERROR_FULL    4
+
+// Device on a bus
+typedef struct {
+    uint8_t cs_port;
+    uint8_t cs_pin;
+    uint8_t modes;
+    uint8_t selected;
+    const VirtualSPIDeviceOps *ops;
+    void *ctx;
+} SPIDevice;
+
+// Virtual SPI state
+typedef struct {
+    uint32_t base;
+    uint8_t irq;
+    uint8_t apb2;
+    char name[5];
+    
+    // Registers the driver configures
+    uint32_t cr1, cr2, crcpr, i2scfgr, i2spr;
+    
+    // TX buffer and shift register
+    uint16_t txbuf;
+    uint8_t txbuf_full;
+    uint16_t shift;
+    uint8_t busy;
+    uint64_t shift_end;
+    
+    // RX buffer and status
+    uint16_t rdr;
+    uint8_t rxne;
+    uint8_t ovr;
+    uint8_t dr_read;  // DR read since the last SR read, for the DR-SR sequence
+    uint64_t rxne_at;
+    
+    // Interrupt output and scheduler events
+    uint8_t irq_level;
+    uint32_t event;
+    uint64_t event_at;
+    uint8_t check_posted;
+    
+    // Bus
+    uint8_t loopback;
+    SPIDevice devices[VSPI_MAX_DEVICES];
+    uint8_t device_count;
+    
+    VirtualSPIStats stats;
+} VirtualSPI;
+
+static VirtualSPI buses[VSPI_PORTS] = {
+    { .base = SPI1_BASEADDR, .irq = IRQ_NO_SPI1, .apb2 = 1, .name = "SPI1" },
+    { .base = SPI2_BASEADDR, .irq = IRQ_NO_SPI2, .apb2 = 0, .name = "SPI2" },
+    { .base = SPI3_BASEADDR, .irq = IRQ_NO_SPI3, .apb2 = 0, .name = "SPI3" },
+};
+static uint8_t spi_initialized = 0;
+static uint8_t last_error = VSPI_ERROR_NONE;
+
+static void spi_update(VirtualSPI *s);
+
+// Validate a bus number
+static VirtualSPI *get_bus(uint8_t spi) {
+    if (spi >= VSPI_PORTS) {
+        last_error = VSPI_ERROR_PORT;
+        SIM_LOG_ERROR("[VirtualSPI] Error: Invalid bus %d\n", spi);
+        return NULL;
+    }
+    return &buses[spi];
+}
+
+static inline uint8_t cr1_bit(const VirtualSPI *s, uint8_t bit) {
+    return (s->cr1 >> bit) & 1U;
+}
+
+static inline uint8_t frame_bits(const VirtualSPI *s) {
+    return cr1_bit(s, SPI_CR1_DFF) ? 16 : 8;
+}
+
+// Master with SPE set: frames in the TX buffer go out
+static inline uint8_t spi_running(const VirtualSPI *s) {
+    return cr1_bit(s, SPI_CR1_SPE) && cr1_bit(s, SPI_CR1_MSTR);
+}
+
+// Core cycles of one frame: 8 or 16 SCK periods of 2^(BR+1) PCLK cycles
+static uint64_t frame_cycles(const VirtualSPI *s) {
+    uint32_t sck_div = 2U << ((s->cr1 >> SPI_CR1_BR) & 7U);
+    
+    return (uint64_t)frame_bits(s) * sck_div * SimMMIO_GetAPBDivider(s->apb2);
+}
+
+// Bit order of a frame reversed (LSBFIRST; the device models are MSB first)
+static uint16_t reverse_bits(uint16_t value, uint8_t bits) {
+    uint16_t out = 0;
+    
+    for (uint8_t i = 0; i < bits; i++) {
+        out = (uint16_t)((out << 1) | ((value >> i) & 1U));
+    }
+    return out;
+}
+
+// Clock one frame through the selected devices; returns MISO. A device
+// clocked in a mode it does not accept samples one edge late: both
+// directions come out shifted by a bit.
+static uint16_t bus_exchange(VirtualSPI *s, uint16_t mosi, uint64_t cycle) {
+    uint8_t bits = frame_bits(s);
+    uint16_t mask = (uint16_t)((1U << bits) - 1);
+    uint16_t top = (uint16_t)(1U << (bits - 1));
+    uint8_t mode = (uint8_t)(cr1_bit(s, SPI_CR1_CPOL) * 2 + cr1_bit(s, SPI_CR1_CPHA));
+    uint8_t lsb_first = cr1_bit(s, SPI_CR1_LSBFIRST);
+    uint16_t miso = mask;
+    uint8_t selected = 0;
+    
+    for (uint8_t i = 0; i < s->device_count; i++) {
+        SPIDevice *d = &s->devices[i];
+        uint16_t out, in = lsb_first ? reverse_bits(mosi, bits) : (uint16_t)(mosi & mask);
+        uint8_t wrong_mode = !(d->modes & (1U << mode));
+        if (!d->selected) continue;
+    
+        if (wrong_mode) {
+            s->stats.mode_errors++;
+            in = (uint16_t)((in >> 1) | top);
+        }
+        out = (uint16_t)(d->ops->exchange(d->ctx, in, bits, cycle) & mask);
+        if (wrong_mode) {
+            out = (uint16_t)((out >> 1) | top);
+        }
+        miso &= lsb_first ? reverse_bits(out, bits) : out;  // Open MISO lines: 0 wins
+        selected++;
+    }
+    
+    if (selected == 0) {
+        s->stats.unselected++;
+        if (s->loopback) miso = (uint16_t)(mosi & mask);
+    } else if (selected > 1) {
+        s->stats.contention++;
+    }
+    return miso;
+}
+
+// Move the TX buffer into the shift register at cycle t
+static void shift_start(VirtualSPI *s, uint64_t t) {
+    uint64_t frame = frame_cycles(s);
+    
+    s->shift = s->txbuf;
+    s->txbuf_full = 0;
+    s->busy = 1;
+    s->shift_end = t + frame;
+    s->stats.busy_cycles += frame;
+}
+
+// Last SCK edge of the frame in the shift register
+static void shift_complete(VirtualSPI *s) {
+    uint64_t t = s->shift_end;
+    uint16_t miso = bus_exchange(s, s->shift, t);
+    
+    s->busy = 0;
+    s->stats.frames++;
+    if (s->rxne) {
+        s->ovr = 1;  // Received frame lost, RX buffer keeps the old one
+        s->stats.overruns++;
+    } else {
+        s->rdr = miso;
+        s->rxne = 1;
+        s->rxne_at = t;
+    }
+    
+    if (s->txbuf_full && spi_running(s)) {
+        shift_start(s, t);  // Back-to-back: no gap between frames
+    }
+}
+
+// Retire frames up to now
+static void spi_advance(VirtualSPI *s, uint64_t now) {
+    while (s->busy && s->shift_end <= now) {
+        shift_complete(s);
+    }
+}
+
+static uint32_t spi_sr(const VirtualSPI *s) {
+    uint8_t bsy = s->busy || (s->txbuf_full && spi_running(s));
+    
+    return ((uint32_t)s->rxne << SPI_SR_RXNE) | ((uint32_t)!s->txbuf_full << SPI_SR_TXE)
+         | ((uint32_t)s->ovr << SPI_SR_OVR) | ((uint32_t)bsy << SPI_SR_BSY);
+}
+
+// Interrupt output: enabled flags
+static uint8_t spi_level(const VirtualSPI *s) {
+    return ((s->cr2 & (1U << SPI_CR2_TXEIE)) && !s->txbuf_full)
+        || ((s->cr2 & (1U << SPI_CR2_RXNEIE)) && s->rxne)
+        || ((s->cr2 & (1U << SPI_CR2_ERRIE)) && s->ovr);
+}
+
+// Frame done
+static void spi_event(void *ctx) {
+    VirtualSPI *s = (VirtualSPI *)ctx;
+    
+    s->event = SIM_EVENT_INVALID;
+    spi_advance(s, SimClock_GetCycles());
+    spi_update(s);
+}
+
+// Interrupt raised during a register access, pended once the access is over
+static void spi_check(void *ctx) {
+    VirtualSPI *s = (VirtualSPI *)ctx;
+    
+    s->check_posted = 0;
+    spi_advance(s, SimClock_GetCycles());
+    if (spi_level(s)) {
+        VirtualNVIC_SetPending(s->irq);
+    }
+}
+
+// Re-arm the frame event and pend the IRQ on a rising interrupt output
+static void spi_update(VirtualSPI *s) {
+    uint64_t due = s->busy ? s->shift_end : NEVER;
+    uint8_t level = spi_level(s);
+    
+    if (s->event != SIM_EVENT_INVALID && (due == NEVER || due != s->event_at)) {
+        SimSched_Cancel(s->event);
+        s->event = SIM_EVENT_INVALID;
+    }
+    if (due != NEVER && s->event == SIM_EVENT_INVALID) {
+        s->event = SimSched_PostAt(due, spi_event, s);
+        s->event_at = due;
+    }
+    
+    if (level && !s->irq_level) {
+        if (!SimMMIO_InTrap()) {
+            VirtualNVIC_SetPending(s->irq);
+        } else if (!s->check_posted) {
+            s->check_posted = SimSched_Post(0, spi_check, s) != SIM_EVENT_INVALID;
+        }
+    }
+    s->irq_level = level;
+}
+
+// Level seen by the NVIC after the handler (re-pends while still set)
+static uint8_t spi_irq_level(void *ctx) {
+    VirtualSPI *s = (VirtualSPI *)ctx;
+    
+    spi_advance(s, SimClock_GetCycles());
+    return spi_level(s);
+}
+
+// Driver store to an SPI register
+static void spi_write_hook(void *ctx, uint32_t offset, uint32_t old_value, uint32_t new_value) {
+    VirtualSPI *s = (VirtualSPI *)ctx;
+    (void)old_value;
+    
+    SimClock_Advance(SIM_CYCLES_APB_ACCESS);
+    spi_advance(s, SimClock_GetCycles());
+    
+    switch (offset) {
+        case offsetof(SPI_RegDef_t, CR1):
+            s->cr1 = new_value & 0xFFFFU;
+            break;
+        case offsetof(SPI_RegDef_t, CR2):
+            s->cr2 = new_value & 0xF7U;
+            break;
+        case offsetof(SPI_RegDef_t, DR):
+            s->txbuf = (uint16_t)(cr1_bit(s, SPI_CR1_DFF) ? new_value : (new_value & 0xFFU));
+            s->txbuf_full = 1;
+            break;
+        case offsetof(SPI_RegDef_t, CRCPR):
+            s->crcpr = new_value & 0xFFFFU;
+            break;
+        case offsetof(SPI_RegDef_t, I2SCFGR):
+            s->i2scfgr = new_value;
+            break;
+        case offsetof(SPI_RegDef_t, I2SPR):
+            s->i2spr = new_value;
+            break;
+        default:
+            break;  // SR: CRCERR only, not modelled
+    }
+    
+    // A frame written before SPE was set goes out once it is
+    if (s->txbuf_full && !s->busy && spi_running(s)) {
+        shift_start(s, SimClock_GetCycles());
+    }
+    spi_update(s);
+}
+
+// Driver load from SR or DR: a DR read clears RXNE, DR then SR clears OVR
+static void spi_read_hook(void *ctx, uint32_t offset) {
+    VirtualSPI *s = (VirtualSPI *)ctx;
+    uint64_t now;
+    
+    SimClock_Advance(SIM_CYCLES_APB_ACCESS);
+    now = SimClock_GetCycles();
+    offset += offsetof(SPI_RegDef_t, SR);  // The trap starts at SR
+    
+    if (offset == offsetof(SPI_RegDef_t, SR)) {
+        if (s->dr_read) s->ovr = 0;
+        s->dr_read = 0;
+    } else if (offset == offsetof(SPI_RegDef_t, DR)) {
+        if (s->rxne) {
+            uint64_t latency = now - s->rxne_at;
+            uint32_t lat = latency > UINT32_MAX ? UINT32_MAX : (uint32_t)latency;
+            s->stats.rx_reads++;
+            s->stats.rx_latency_sum += latency;
+            if (lat < s->stats.rx_latency_min) s->stats.rx_latency_min = lat;
+            if (lat > s->stats.rx_latency_max) s->stats.rx_latency_max = lat;
+        }
+        s->rxne = 0;
+        s->dr_read = 1;
+    }
+    
+    spi_advance(s, now);
+    spi_update(s);
+}
+
+// Copy the SPI state into the shadow registers
+static void spi_refresh(void *ctx, volatile uint32_t *regs) {
+    VirtualSPI *s = (VirtualSPI *)ctx;
+    
+    spi_advance(s, SimClock_GetCycles());
+    spi_update(s);
+    regs[offsetof(SPI_RegDef_t, CR1) / 4] = s->cr1;
+    regs[offsetof(SPI_RegDef_t, CR2) / 4] = s->cr2;
+    regs[offsetof(SPI_RegDef_t, SR) / 4] = spi_sr(s);
+    regs[offsetof(SPI_RegDef_t, DR) / 4] = s->rdr;
+    regs[offsetof(SPI_RegDef_t, CRCPR) / 4] = s->crcpr;
+    regs[offsetof(SPI_RegDef_t, I2SCFGR) / 4] = s->i2scfgr;
+    regs[offsetof(SPI_RegDef_t, I2SPR) / 4] = s->i2spr;
+}
+
+// Chip select edges: frames clocked before the edge finish with the old
+// selection, then the device sees select/deselect
+static void cs_listener(void *ctx, uint8_t port, uint16_t old_odr, uint16_t new_odr) {
+    uint16_t changed = old_odr ^ new_odr;
+    uint64_t now = SimClock_GetCycles();
+    (void)ctx;
+    
+    for (uint8_t b = 0; b < VSPI_PORTS; b++) {
+        VirtualSPI *s = &buses[b];
+        uint8_t advanced = 0;
+    
+        for (uint8_t i = 0; i < s->device_count; i++) {
+            SPIDevice *d = &s->devices[i];
+            if (d->cs_port != port || !(changed & (1U << d->cs_pin))) continue;
+    
+            if (!advanced) {
+                spi_advance(s, now);
+                advanced = 1;
+            }
+            if (!(new_odr & (1U << d->cs_pin))) {
+                d->selected = 1;
+                s->stats.selects++;
+                if (d->ops->select != NULL) d->ops->select(d->ctx, now);
+            } else if (d->selected) {
+                d->selected = 0;
+                if (d->ops->deselect != NULL) d->ops->deselect(d->ctx, now);
+            }
+        }
+        if (advanced) spi_update(s);
+    }
+}
+
+// Attach SPI1-3 to the shadow registers. Needs write trapping (Linux
+// x86-64): DR and SR loads must reach the model to clear RXNE and OVR.
+uint8_t VirtualSPI_Init(void) {
+    if (spi_initialized) return 1;
+    
+    SimClock_Init();
+    SimSched_Init();
+    VirtualNVIC_Init();
+    VirtualGPIO_Init();
+    
+    for (uint8_t i = 0; i < VSPI_PORTS; i++) {
+        VirtualSPI *s = &buses[i];
+        s->crcpr = 7;  // Reset value
+        s->event = SIM_EVENT_INVALID;
+        s->stats.rx_latency_min = UINT32_MAX;
+    
+        if (!SimMMIO_AddRegion(s->base, sizeof(SPI_RegDef_t), spi_write_hook, spi_refresh, s) ||
+            !SimMMIO_AddReadTrap(s->base + offsetof(SPI_RegDef_t, SR), 8, spi_read_hook, s)) {
+            last_error = VSPI_ERROR_MMIO;
+            SIM_LOG_ERROR("[VirtualSPI] Error: Cannot attach %s to the shadow registers\n", s->name);
+            return 0;
+        }
+        SimMMIO_SetIRQLevel(s->irq, spi_irq_level, s);
+    }
+    if (!VirtualGPIO_AddOutputListener(cs_listener, NULL)) {
+        last_error = VSPI_ERROR_MMIO;
+        return 0;
+    }
+    
+    spi_initialized = 1;
+    SIM_LOG_INFO("[VirtualSPI] Initialized %d buses\n", VSPI_PORTS);
+    last_error = VSPI_ERROR_NONE;
+    return 1;
+}
+
+// Get last error code
+uint8_t VirtualSPI_GetLastError(void) {
+    return last_error;
+}
+
+// Core clock cycles of one frame with the bus's current configuration
+uint64_t VirtualSPI_GetFrameCycles(uint8_t spi) {
+    VirtualSPI *s = get_bus(spi);
+    
+    return s != NULL ? frame_cycles(s) : 0;
+}
+
+// Put a device model on a bus. It is selected while its chip select
+// output is low, from the next falling edge on.
+uint8_t VirtualSPI_AttachDevice(uint8_t spi, uint8_t cs_port, uint8_t cs_pin, uint8_t modes,
+                                const VirtualSPIDeviceOps *ops, void *ctx) {
+    VirtualSPI *s = get_bus(spi);
+    
+    if (s == NULL) return 0;
+    if (ops == NULL || ops->exchange == NULL || cs_pin > 15 || (modes & VSPI_MODE_ANY) == 0) {
+        last_error = VSPI_ERROR_DEVICE;
+        return 0;
+    }
+    if (s->device_count == VSPI_MAX_DEVICES) {
+        last_error = VSPI_ERROR_FULL;
+        SIM_LOG_ERROR("[VirtualSPI] Error: %s has %d devices already\n", s->name, VSPI_MAX_DEVICES);
+        return 0;
+    }
+    
+    SPIDevice *d = &s->devices[s->device_count++];
+    d->cs_port = cs_port;
+    d->cs_pin = cs_pin;
+    d->modes = modes;
+    d->selected = 0;
+    d->ops = ops;
+    d->ctx = ctx;
+    SIM_LOG_INFO("[VirtualSPI] %s: device on chip select P%c%d\n", s->name, 'A' + cs_port, cs_pin);
+    last_error = VSPI_ERROR_NONE;
+    return 1;
+}
+
+// Remove every device from a bus
+void VirtualSPI_DetachDevices(uint8_t spi) {
+    VirtualSPI *s = get_bus(spi);
+    
+    if (s == NULL) return;
+    spi_advance(s, SimClock_GetCycles());
+    s->device_count = 0;
+}
+
+// MOSI wired to MISO for frames clocked with nothing selected (MISO
+// floats high otherwise)
+uint8_t VirtualSPI_SetLoopback(uint8_t spi, uint8_t enable) {
+    VirtualSPI *s = get_bus(spi);
+    
+    if (s == NULL) return 0;
+    spi_advance(s, SimClock_GetCycles());
+    s->loopback = enable ? 1 : 0;
+    last_error = VSPI_ERROR_NONE;
+    return 1;
+}
+
+// Copy the bus counters
+void VirtualSPI_GetStats(uint8_t spi, VirtualSPIStats *stats) {
+    VirtualSPI *s = get_bus(spi);
+    
+    if (s != NULL && stats != NULL) {
+        spi_advance(s, SimClock_GetCycles());
+        *stats = s->stats;
+    }
+}
+
+void VirtualSPI_ResetStats(uint8_t spi) {
+    VirtualSPI *s = get_bus(spi);
+    
+    if (s != NULL) {
+        memset(&s->stats, 0, sizeof(s->stats));
+        s->stats.rx_latency_min = UINT32_MAX;
+    }
+}
+
+// SPI NOR flash device model
+
+#define FLASH_CMD_NONE       0x00
+#define FLASH_CMD_PP         0x02
+#define FLASH_CMD_READ       0x03
+#define FLASH_CMD_WRDI       0x04
+#define FLASH_CMD_RDSR       0x05
+#define FLASH_CMD_WREN       0x06
+#define FLASH_CMD_FAST_READ  0x0B
+#define FLASH_CMD_SE         0x20
+#define FLASH_CMD_RDID       0x9F
+
+#define FLASH_SR_BUSY  0x01U
+#define FLASH_SR_WEL   0x02U
+
+#define FLASH_PAGE     256U
+#define FLASH_SECTOR   4096U
+
+// Blank (erased) flash of size bytes backed by mem, W25Q typical timings
+void VirtualSPIFlash_Init(VirtualSPIFlash *flash, uint8_t *mem, uint32_t size) {
+    memset(flash, 0, sizeof(*flash));
+    flash->mem = mem;
+    flash->size = size;
+    flash->program_us = 700;
+    flash->erase_us = 45000;
+    memset(mem, 0xFF, size);
+}
+
+static void flash_poll(VirtualSPIFlash *f, uint64_t cycle) {
+    if ((f->status & FLASH_SR_BUSY) && cycle >= f->busy_until) {
+        f->status &= (uint8_t)~FLASH_SR_BUSY;
+    }
+}
+
+// One byte of a command; returns the byte driven on MISO
+static uint8_t flash_byte(VirtualSPIFlash *f, uint8_t mosi, uint64_t cycle) {
+    uint32_t n = f->count++;
+    uint32_t mask = f->size - 1;
+    
+    flash_poll(f, cycle);
+    if (n == 0) {
+        f->cmd = mosi;
+        f->addr = 0;
+        if ((f->status & FLASH_SR_BUSY) && mosi != FLASH_CMD_RDSR) {
+            f->cmd = FLASH_CMD_NONE;  // Only the status can be read while busy
+            f->ignored++;
+        }
+        return 0xFF;
+    }
+    
+    switch (f->cmd) {
+        case FLASH_CMD_RDID: {
+            static const uint8_t id[2] = {0xEF, 0x40};  // Winbond, SPI NOR
+            if (n <= 2) return id[n - 1];
+            return n == 3 ? (uint8_t)__builtin_ctz(f->size) : 0xFF;
+        }
+        case FLASH_CMD_RDSR:
+            return f->status;
+        case FLASH_CMD_READ:
+        case FLASH_CMD_FAST_READ:
+            if (n <= 3) {
+                f->addr = (f->addr << 8) | mosi;
+                return 0xFF;
+            }
+            if (f->cmd == FLASH_CMD_FAST_READ && n == 4) return 0xFF;  // Dummy byte
+            return f->mem[f->addr++ & mask];
+        case FLASH_CMD_PP:
+            if (n <= 3) {
+                f->addr = (f->addr << 8) | mosi;
+                if (n == 3) memset(f->page_valid, 0, sizeof(f->page_valid));
+            } else {
+                uint32_t off = (f->addr + n - 4) & (FLASH_PAGE - 1);  // Wraps within the page
+                f->page[off] = mosi;
+                f->page_valid[off] = 1;
+            }
+            return 0xFF;
+        case FLASH_CMD_SE:
+            if (n <= 3) f->addr = (f->addr << 8) | mosi;
+            return 0xFF;
+        default:
+            return 0xFF;
+    }
+}
+
+static void flash_select(void *ctx, uint64_t cycle) {
+    VirtualSPIFlash *f = (VirtualSPIFlash *)ctx;
+    
+    f->count = 0;
+    f->cmd = FLASH_CMD_NONE;
+    flash_poll(f, cycle);
+}
+
+static uint16_t flash_exchange(void *ctx, uint16_t mosi, uint8_t bits, uint64_t cycle) {
+    VirtualSPIFlash *f = (VirtualSPIFlash *)ctx;
+    
+    if (bits == 16) {
+        uint8_t hi = flash_byte(f, (uint8_t)(mosi >> 8), cycle);
+        return (uint16_t)((hi << 8) | flash_byte(f, (uint8_t)mosi, cycle));
+    }
+    return flash_byte(f, (uint8_t)mosi, cycle);
+}
+
+// Write commands take effect on chip select rise, if complete and enabled
+static void flash_deselect(void *ctx, uint64_t cycle) {
+    VirtualSPIFlash *f = (VirtualSPIFlash *)ctx;
+    uint32_t mask = f->size - 1;
+    
+    switch (f->cmd) {
+        case FLASH_CMD_WREN:
+            f->status |= FLASH_SR_WEL;
+            break;
+        case FLASH_CMD_WRDI:
+            f->status &= (uint8_t)~FLASH_SR_WEL;
+            break;
+        case FLASH_CMD_PP:
+            if (!(f->status & FLASH_SR_WEL) || f->count <= 4) break;
+            for (uint32_t off = 0; off < FLASH_PAGE; off++) {
+                if (f->page_valid[off]) {
+                    f->mem[((f->addr & ~(FLASH_PAGE - 1)) + off) & mask] &= f->page[off];  // Bits only go 1 -> 0
+                }
+            }
+            f->programs++;
+            f->status = FLASH_SR_BUSY;
+            f->busy_until = cycle + SimClock_UsToCycles(f->program_us);
+            break;
+        case FLASH_CMD_SE: {
+            uint32_t sector = FLASH_SECTOR < f->size ? FLASH_SECTOR : f->size;
+            if (!(f->status & FLASH_SR_WEL) || f->count != 4) break;
+            memset(f->mem + (f->addr & mask & ~(sector - 1)), 0xFF, sector);
+            f->erases++;
+            f->status = FLASH_SR_BUSY;
+            f->busy_until = cycle + SimClock_UsToCycles(f->erase_us);
+            break;
+        }
+        default:
+            break;
+    }
+    f->cmd = FLASH_CMD_NONE;
+}
+
+const VirtualSPIDeviceOps VirtualSPIFlash_Ops = { flash_select, flash_exchange, flash_deselect };
+
+// Register file sensor device model
+
+void VirtualSPISensor_Init(VirtualSPISensor *sensor) {
+    memset(sensor, 0, sizeof(*sensor));
+}
+
+static uint8_t sensor_byte(VirtualSPISensor *s, uint8_t mosi, uint64_t cycle) {
+    uint8_t miso = 0xFF;
+    
+    if (s->count++ == 0) {
+        s->read = (mosi >> 7) & 1U;
+        s->addr = mosi & 0x7FU;
+        if (s->read && s->on_read != NULL) s->on_read(s->on_read_ctx, s->addr, cycle);
+        return miso;
+    }
+    
+    if (s->read) {
+        miso = s->regs[s->addr];
+    } else {
+        s->regs[s->addr] = mosi;
+    }
+    s->addr = (s->addr + 1) & 0x7FU;
+    return miso;
+}
+
+static void sensor_select(void *ctx, uint64_t cycle) {
+    (void)cycle;
+    ((VirtualSPISensor *)ctx)->count = 0;
+}
+
+static uint16_t sensor_exchange(void *ctx, uint16_t mosi, uint8_t bits, uint64_t cycle) {
+    VirtualSPISensor *s = (VirtualSPISensor *)ctx;
+    
+    if (bits == 16) {
+        uint8_t hi = sensor_byte(s, (uint8_t)(mosi >> 8), cycle);
+        return (uint16_t)((hi << 8) | sensor_byte(s, (uint8_t)mosi, cycle));
+    }
+    return sensor_byte(s, (uint8_t)mosi, cycle);
+}
+
+const VirtualSPIDeviceOps VirtualSPISensor_Ops = { sensor_select, sensor_exchange, NULL };
+
+#ifdef RUN_STANDALONE_TEST
+#include <time.h>
+#include "stm32f446re_spi_driver.h"
+#include "stm32f446re_gpio_drivers.h"
+#include "stm32f446re_rcc_driver.h"
+#include "sim_test.h"
+
+#define GPIOB_PORT 1
+
+static SPI_Handle_t hspi1;
+static SPI_Handle_t hspi2;
+static SPI_Transaction_t *queue_storage[8];
+static uint64_t idle_cycles = 0;
+
+static void SPI2_IRQHandler(void) {
+    SPI_IRQHandling(&hspi2);
+}
+
+static void spi_config(SPI_Handle_t *h, SPI_RegDef_t *spi, uint8_t speed) {
+    memset(h, 0, sizeof(*h));
+    h->pSPIx = spi;
+    h->SPIConfig.SPI_DeviceMode = SPI_DEVICE_MODE_MASTER;
+    h->SPIConfig.SPI_BusConfig = SPI_BUS_CONFIG_FD;
+    h->SPIConfig.SPI_SclkSpeed = speed;
+    h->SPIConfig.SPI_DFF = SPI_DFF_8BITS;
+    h->SPIConfig.SPI_SSM = SPI_SSM_EN;
+}
+
+// Application main loop: run events until the queue is idle (or max_cycles
+// have passed), counting the time between events as idle (WFI)
+static void run_queue(uint64_t max_cycles) {
+    uint64_t end = SimClock_GetCycles() + max_cycles;
+    uint64_t next;
+    
+    while (!SPI_QueueIdle(&hspi2) && SimSched_GetNextEventCycle(&next) && next <= end) {
+        uint64_t now = SimClock_GetCycles();
+        if (next > now) idle_cycles += next - now;
+        SimSched_RunNext();
+    }
+}
+
+// Submit one transaction and run the bus until it is done
+static uint8_t xact(const SPI_Device_t *dev, const uint8_t *tx, uint8_t *rx, uint32_t len) {
+    SPI_Transaction_t t = { .pDevice = dev, .pTxBuffer = tx, .pRxBuffer = rx, .Len = len };
+    
+    if (!SPI_Submit(&hspi2, &t)) return SPI_XACT_ERROR;
+    run_queue(SimClock_MsToCycles(100));
+    return t.Status;
+}
+
+// Sensor samples latched when a read burst starts at the data registers
+static uint32_t sensor_samples = 0;
+static void sensor_latch(void *ctx, uint8_t reg, uint64_t cycle) {
+    VirtualSPISensor *s = (VirtualSPISensor *)ctx;
+    (void)cycle;
+    
+    if (reg != 0x28) return;
+    sensor_samples++;
+    for (uint8_t i = 0; i < 6; i++) {
+        s->regs[0x28 + i] = (uint8_t)(sensor_samples * 16 + i);
+    }
+}
+
+// Queue benchmark: transaction latency from submit to Done
+static uint64_t submit_at[8];
+static uint64_t xact_latency_sum = 0;
+static uint64_t xact_latency_max = 0;
+static uint32_t xact_done = 0;
+static void on_xact_done(SPI_Transaction_t *pXact, uint8_t event) {
+    uint64_t latency = SimClock_GetCycles() - *(uint64_t *)pXact->pContext;
+    
+    if (event != SPI_EVENT_XFER_CMPLT) return;
+    xact_done++;
+    xact_latency_sum += latency;
+    if (latency > xact_latency_max) xact_latency_max = latency;
+}
+
+// Test function - only compiled when RUN_STANDALONE_TEST is defined
+// (built with USE_HOST_MMIO and linked with the SPI, RCC and GPIO drivers)
+int main(void) {
+    VirtualSPIStats st;
+    static uint8_t flash_mem[64 * 1024];
+    static VirtualSPIFlash flash;
+    static VirtualSPISensor sensor;
+    static VirtualSPISensor fussy;
+    uint8_t tx[64], rx[64];
+    
+    printf("=== Virtual SPI Test ===\n\n");
+    
+    if (!SimMMIO_Init() || !VirtualSPI_Init()) {
+        printf("Virtual SPI needs write trapping (Linux x86-64)\n");
+        return 1;
+    }
+    SimClock_SetFrequency(RCC_GetHCLKValue());  // Shadow RCC at reset: HSI 16 MHz
+    SimMMIO_AttachIRQ(IRQ_NO_SPI2, SPI2_IRQHandler, "SPI2");
+    SimLog_SetLevel(SIM_LOG_LEVEL_WARN);  // Per-frame IRQ and event traces would swamp the benchmark
+    
+    // Test 1: Frame time from BR, DFF and the APB prescaler
+    printf("--- Test 1: Frame Timing ---\n");
+    spi_config(&hspi1, SPI1, SPI_SCLK_SPEED_DIV8);
+    check(SPI_Init(&hspi1), "SPI1 master, PCLK/8, 8-bit");
+    check(VirtualSPI_GetFrameCycles(VSPI_SPI1) == 8 * 8, "frame = 8 bits x 8 cycles");
+    hspi1.SPIConfig.SPI_DFF = SPI_DFF_16BITS;
+    SPI_Init(&hspi1);
+    check(VirtualSPI_GetFrameCycles(VSPI_SPI1) == 16 * 8, "16-bit frames take twice as long");
+    RCC->CFGR = 4U << RCC_CFGR_PPRE2;  // APB2 = HCLK / 2
+    check(VirtualSPI_GetFrameCycles(VSPI_SPI1) == 2 * 16 * 8, "PPRE2 /2 doubles the frame in core cycles");
+    check(VirtualSPI_GetFrameCycles(VSPI_SPI2) == 8 * 2, "SPI2 (APB1) unaffected by PPRE2");
+    RCC->CFGR = 0;
+    
+    // Test 2: Blocking transfers, pipelined against one frame at a time
+    printf("\n--- Test 2: Pipelined Blocking Transfer (Loopback) ---\n");
+    static uint8_t block_tx[512], block_rx[512];
+    for (uint32_t i = 0; i < sizeof(block_tx); i++) block_tx[i] = (uint8_t)(i * 13 + 1);
+    spi_config(&hspi1, SPI1, SPI_SCLK_SPEED_DIV4);
+    SPI_Init(&hspi1);
+    VirtualSPI_SetLoopback(VSPI_SPI1, 1);
+    uint64_t frame = VirtualSPI_GetFrameCycles(VSPI_SPI1);
+    
+    VirtualSPI_ResetStats(VSPI_SPI1);
+    uint64_t t0 = SimClock_GetCycles();
+    clock_t host0 = clock();
+    SPI_TransferData(&hspi1, block_tx, block_rx, sizeof(block_tx));
+    uint64_t piped = SimClock_GetCycles() - t0;
+    double host_s = (double)(clock() - host0) / CLOCKS_PER_SEC;
+    VirtualSPI_GetStats(VSPI_SPI1, &st);
+    check(memcmp(block_rx, block_tx, sizeof(block_tx)) == 0, "512 bytes looped back in order");
+    check(st.frames == sizeof(block_tx) && st.overruns == 0, "512 frames, no overrun");
+    double util_piped = 100.0 * (double)st.busy_cycles / (double)piped;
+    
+    VirtualSPI_ResetStats(VSPI_SPI1);
+    t0 = SimClock_GetCycles();
+    for (uint32_t i = 0; i < sizeof(block_tx); i++) {
+        SPI1->DR = block_tx[i];
+        while (!(SPI1->SR & (1U << SPI_SR_RXNE)))
+            ;
+        block_rx[i] = (uint8_t)SPI1->DR;
+    }
+    uint64_t naive = SimClock_GetCycles() - t0;
+    VirtualSPI_GetStats(VSPI_SPI1, &st);
+    double util_naive = 100.0 * (double)st.busy_cycles / (double)naive;
+    printf("  SCK 4 MHz, frame %llu cycles\n", (unsigned long long)frame);
+    printf("  Pipelined:  %llu cycles, bus busy %.1f%%\n", (unsigned long long)piped, util_piped);
+    printf("  One by one: %llu cycles, bus busy %.1f%%\n", (unsigned long long)naive, util_naive);
+    check(piped < sizeof(block_tx) * frame + 4 * frame, "pipelined transfer is back-to-back frames");
+    check(naive > piped, "one frame at a time leaves gaps on the bus");
+    printf("  Host: %.0f ns per frame\n", host_s * 1e9 / sizeof(block_tx));
+    
+    // Test 3: Overrun and the DR-SR clear sequence
+    printf("\n--- Test 3: Overrun ---\n");
+    VirtualSPI_ResetStats(VSPI_SPI1);
+    for (uint8_t i = 0; i < 3; i++) {
+        while (!(SPI1->SR & (1U << SPI_SR_TXE)))
+            ;
+        SPI1->DR = 0xA0U + i;
+    }
+    while (SPI1->SR & (1U << SPI_SR_BSY))
+        ;
+    VirtualSPI_GetStats(VSPI_SPI1, &st);
+    uint32_t sr = SPI1->SR;
+    check(st.overruns == 2 && (sr & (1U << SPI_SR_OVR)) && (sr & (1U << SPI_SR_RXNE)), "3 frames unread: OVR, 2 frames lost");
+    check(SPI1->DR == 0xA0U, "RX buffer kept the first frame");
+    check((SPI1->SR & (1U << SPI_SR_OVR)) != 0, "SR read after DR still shows OVR...");
+    check(!(SPI1->SR & ((1U << SPI_SR_OVR) | (1U << SPI_SR_RXNE))), "...and clears it: DR then SR sequence");
+    VirtualSPI_SetLoopback(VSPI_SPI1, 0);
+    
+    // Test 4: SPI flash on SPI2 through the transaction queue
+    printf("\n--- Test 4: SPI Flash (Queued, Interrupt-Driven) ---\n");
+    const SPI_Device_t flash_dev = { SPI_SCLK_SPEED_DIV2, SPI_DFF_8BITS, SPI_CPOL_LOW, SPI_CPHA_LOW, GPIOB, 12 };
+    const SPI_Device_t sensor_dev = { SPI_SCLK_SPEED_DIV8, SPI_DFF_8BITS, SPI_CPOL_HIGH, SPI_CPHA_HIGH, GPIOB, 1 };
+    const SPI_Device_t fussy_dev = { SPI_SCLK_SPEED_DIV8, SPI_DFF_8BITS, SPI_CPOL_HIGH, SPI_CPHA_HIGH, GPIOB, 2 };
+    VirtualSPIFlash_Init(&flash, flash_mem, sizeof(flash_mem));
+    VirtualSPISensor_Init(&sensor);
+    VirtualSPISensor_Init(&fussy);
+    VirtualSPI_AttachDevice(VSPI_SPI2, GPIOB_PORT, 12, VSPI_MODE0 | VSPI_MODE3, &VirtualSPIFlash_Ops, &flash);
+    VirtualSPI_AttachDevice(VSPI_SPI2, GPIOB_PORT, 1, VSPI_MODE0 | VSPI_MODE3, &VirtualSPISensor_Ops, &sensor);
+    VirtualSPI_AttachDevice(VSPI_SPI2, GPIOB_PORT, 2, VSPI_MODE0, &VirtualSPISensor_Ops, &fussy);
+    spi_config(&hspi2, SPI2, SPI_SCLK_SPEED_DIV2);
+    check(SPI_Init(&hspi2) && SPI_QueueInit(&hspi2, queue_storage, 8), "SPI2 master with an 8-slot transaction queue");
+    SPI_DeviceInit(&flash_dev);
+    SPI_DeviceInit(&sensor_dev);
+    SPI_DeviceInit(&fussy_dev);
+    SPI_IRQConfig(IRQ_NO_SPI2, 5, ENABLE);
+    VirtualSPI_ResetStats(VSPI_SPI2);
+    
+    memset(tx, 0, sizeof(tx));
+    tx[0] = 0x9F;
+    check(xact(&flash_dev, tx, rx, 4) == SPI_XACT_DONE && rx[1] == 0xEF && rx[2] == 0x40 && rx[3] == 16,
+          "RDID: EF 40 10 (64 KB)");
+    
+    tx[0] = 0x02; tx[1] = 0x00; tx[2] = 0x01; tx[3] = 0x00;
+    for (uint8_t i = 0; i < 16; i++) tx[4 + i] = (uint8_t)(0x30 + i);
+    xact(&flash_dev, tx, NULL, 20);
+    check(flash.programs == 0 && flash_mem[0x100] == 0xFF, "page program without WREN ignored");
+    
+    tx[0] = 0x06;
+    xact(&flash_dev, tx, NULL, 1);
+    tx[0] = 0x02;
+    t0 = SimClock_GetCycles();
+    xact(&flash_dev, tx, NULL, 20);
+    check(flash.programs == 1 && memcmp(&flash_mem[0x100], &tx[4], 16) == 0, "WREN + page program: 16 bytes written");
+    uint32_t polls = 0;
+    uint8_t rdsr[2] = {0x05, 0};
+    do {
+        xact(&flash_dev, rdsr, rx, 2);
+        polls++;
+    } while ((rx[1] & 0x01) && polls < 10000);
+    uint64_t busy = SimClock_GetCycles() - t0;
+    printf("  Program busy for %llu us (%lu RDSR polls)\n",
+           (unsigned long long)(busy * 1000000ULL / SimClock_GetFrequency()), (unsigned long)polls);
+    check(busy >= SimClock_UsToCycles(700) && !(rx[1] & 0x03), "RDSR: BUSY for 700 us, then WEL clear");
+    
+    memset(tx, 0, sizeof(tx));
+    tx[0] = 0x03; tx[2] = 0x01;
+    check(xact(&flash_dev, tx, rx, 20) == SPI_XACT_DONE && memcmp(&rx[4], &flash_mem[0x100], 16) == 0,
+          "READ returns the programmed page");
+    
+    // Test 5: Sensor in mode 3 at a different speed, device switching
+    printf("\n--- Test 5: Sensor (Mode 3) ---\n");
+    sensor.regs[0x0F] = 0x6B;
+    sensor.on_read = sensor_latch;
+    sensor.on_read_ctx = &sensor;
+    uint32_t reconfigs = hspi2.Reconfigs;
+    tx[0] = 0x80 | 0x0F; tx[1] = 0;
+    check(xact(&sensor_dev, tx, rx, 2) == SPI_XACT_DONE && rx[1] == 0x6B, "WHO_AM_I = 0x6B");
+    check(hspi2.Reconfigs == reconfigs + 1 && VirtualSPI_GetFrameCycles(VSPI_SPI2) == 8 * 8,
+          "CR1 switched to mode 3, PCLK/8");
+    tx[0] = 0x20; tx[1] = 0x67;
+    xact(&sensor_dev, tx, NULL, 2);
+    check(sensor.regs[0x20] == 0x67, "register write");
+    memset(tx, 0, sizeof(tx));
+    tx[0] = 0x80 | 0x28;
+    xact(&sensor_dev, tx, rx, 7);
+    check(sensor_samples == 1 && rx[1] == 0x10 && rx[6] == 0x15, "6-byte burst read, auto-increment");
+    VirtualSPI_GetStats(VSPI_SPI2, &st);
+    check(st.mode_errors == 0 && st.contention == 0 && st.unselected == 0, "no mode errors, contention or unselected frames");
+    
+    // Test 6: Device clocked in a mode it does not support
+    printf("\n--- Test 6: Mode Mismatch ---\n");
+    fussy.regs[0x0F] = 0x6B;
+    tx[0] = 0x80 | 0x0F; tx[1] = 0;
+    xact(&fussy_dev, tx, rx, 2);
+    VirtualSPI_GetStats(VSPI_SPI2, &st);
+    printf("  Mode-0 device read in mode 3: 0x%02X\n", rx[1]);
+    check(st.mode_errors == 2 && rx[1] != 0x6B, "frames shifted by a bit, mode errors counted");
+    
+    // Test 7: Queue throughput and latency, transactions kept back-to-back
+    printf("\n--- Test 7: Queue Throughput (Flash Reads) ---\n");
+    static SPI_Transaction_t reads[8];
+    static uint8_t read_cmd[36] = {0x03, 0x00, 0x01, 0x00};
+    static uint8_t read_buf[8][36];
+    uint32_t submitted = 0, total = 200;
+    VirtualNVICStats nst;
+    for (uint8_t i = 0; i < 8; i++) {
+        reads[i].pDevice = &flash_dev;
+        reads[i].pTxBuffer = read_cmd;
+        reads[i].pRxBuffer = read_buf[i];
+        reads[i].Len = sizeof(read_cmd);
+        reads[i].Done = on_xact_done;
+        reads[i].pContext = &submit_at[i];
+    }
+    VirtualSPI_ResetStats(VSPI_SPI2);
+    VirtualNVIC_ResetStats();
+    idle_cycles = 0;
+    t0 = SimClock_GetCycles();
+    host0 = clock();
+    while (xact_done < total) {
+        uint64_t next;
+        for (uint8_t i = 0; i < 8 && submitted < total; i++) {
+            if (reads[i].Status == SPI_XACT_QUEUED || reads[i].Status == SPI_XACT_ACTIVE) continue;
+            submit_at[i] = SimClock_GetCycles();
+            if (SPI_Submit(&hspi2, &reads[i])) submitted++;
+        }
+        if (!SimSched_GetNextEventCycle(&next)) break;
+        if (next > SimClock_GetCycles()) idle_cycles += next - SimClock_GetCycles();
+        SimSched_RunNext();
+    }
+    uint64_t elapsed = SimClock_GetCycles() - t0;
+    host_s = (double)(clock() - host0) / CLOCKS_PER_SEC;
+    VirtualSPI_GetStats(VSPI_SPI2, &st);
+    VirtualNVIC_GetStats(&nst);
+    double secs = (double)elapsed / SimClock_GetFrequency();
+    double rate = total * sizeof(read_cmd) / secs;
+    double line = (double)SimClock_GetFrequency() / (double)VirtualSPI_GetFrameCycles(VSPI_SPI2);
+    check(xact_done == total && memcmp(read_buf[7] + 4, &flash_mem[0x100], 16) == 0, "200 queued reads completed with the right data");
+    check(st.overruns == 0 && st.selects == total, "no overruns, one chip select per transaction");
+    printf("  Throughput: %.0f bytes/s of %.0f (SCK 8 MHz), bus busy %.1f%%\n", rate, line,
+           100.0 * (double)st.busy_cycles / (double)elapsed);
+    printf("  Interrupts: %lu, CPU load %.1f%%\n", (unsigned long)nst.dispatched,
+           100.0 * (double)(elapsed - idle_cycles) / (double)elapsed);
+    printf("  Transaction latency (submit -> Done): avg %.0f, max %llu cycles\n",
+           (double)xact_latency_sum / total, (unsigned long long)xact_latency_max);
+    printf("  RX latency (RXNE -> DR read): min %lu, avg %.1f, max %lu cycles\n",
+           (unsigned long)st.rx_latency_min, (double)st.rx_latency_sum / (st.rx_reads ? st.rx_reads : 1),
+           (unsigned long)st.rx_latency_max);
+    printf("  Host: %.0f ns per byte\n", host_s * 1e9 / (total * sizeof(read_cmd)));
+    check(rate > 0.25 * line, "queue keeps the bus above 25% at PCLK/2");
+    
+    SimMMIOStats mst;
+    SimMMIO_GetStats(&mst);
+    printf("\nShadow registers: %lu write traps, %lu read traps\n", (unsigned long)mst.traps,
+           (unsigned long)mst.read_traps);
+    return sim_test_result("Virtual SPI");
+}
+#endif  // RUN_STANDALONE_TEST
@@ -0,0 +1,104 @@
+/*
+ * sim_spi.h - Virtual SPI interface
+ * SPI1-3 masters on the shadow registers: frames shifted at the BR
+ * prescaler rate, TXE/RXNE/OVR interrupts through the virtual NVIC, and
+ * devices selected by their GPIO chip select (SPI NOR flash and register
+ * file sensor models included)
+ */
+
+#ifndef SIM_SPI_H_
+#define SIM_SPI_H_
+
+#include <stdint.h>
+
+// Bus numbers
+#define VSPI_SPI1  0
+#define VSPI_SPI2  1
+#define VSPI_SPI3  2
+#define VSPI_PORTS 3
+
+#define VSPI_MAX_DEVICES 4  // Devices per bus
+
+// SPI modes a device accepts (bit CPOL * 2 + CPHA)
+#define VSPI_MODE0    0x1U
+#define VSPI_MODE1    0x2U
+#define VSPI_MODE2    0x4U
+#define VSPI_MODE3    0x8U
+#define VSPI_MODE_ANY 0xFU
+
+// Device model. exchange gets each frame clocked while the device is
+// selected, MSB first, and returns what it drove on MISO during it; cycle
+// is the core cycle of the edge.
+typedef struct {
+    void (*select)(void *ctx, uint64_t cycle);
+    uint16_t (*exchange)(void *ctx, uint16_t mosi, uint8_t bits, uint64_t cycle);
+    void (*deselect)(void *ctx, uint64_t cycle);
+} VirtualSPIDeviceOps;
+
+// Bus counters (reset with VirtualSPI_ResetStats)
+typedef struct {
+    uint32_t frames;
+    uint32_t overruns;        // Frames lost because RXNE was still set (OVR)
+    uint32_t selects;         // Chip select falling edges
+    uint32_t unselected;      // Frames clocked with no device selected
+    uint32_t contention;      // Frames clocked with several devices selected
+    uint32_t mode_errors;     // Frames clocked in a mode the device does not accept
+    uint32_t rx_reads;        // Frames taken out of DR
+    uint32_t rx_latency_min;  // Cycles from RXNE to the DR read
+    uint32_t rx_latency_max;
+    uint64_t rx_latency_sum;
+    uint64_t busy_cycles;     // Cycles the shift register was running
+} VirtualSPIStats;
+
+uint8_t VirtualSPI_Init(void);
+uint8_t VirtualSPI_GetLastError(void);
+uint64_t VirtualSPI_GetFrameCycles(uint8_t spi);
+
+// Devices: cs_port/cs_pin is the GPIO (port 0 = GPIOA) driving the
+// device's active-low chip select
+uint8_t VirtualSPI_AttachDevice(uint8_t spi, uint8_t cs_port, uint8_t cs_pin, uint8_t modes,
+                                const VirtualSPIDeviceOps *ops, void *ctx);
+void VirtualSPI_DetachDevices(uint8_t spi);
+uint8_t VirtualSPI_SetLoopback(uint8_t spi, uint8_t enable);  // MOSI to MISO when nothing is selected
+
+void VirtualSPI_GetStats(uint8_t spi, VirtualSPIStats *stats);
+void VirtualSPI_ResetStats(uint8_t spi);
+
+// SPI NOR flash (W25Q-style): RDID, RDSR, WREN, WRDI, READ, FAST_READ,
+// page program and 4 KB sector erase, with program/erase busy time
+typedef struct {
+    uint8_t *mem;
+    uint32_t size;           // Power of two
+    uint32_t program_us;     // Page program time
+    uint32_t erase_us;       // Sector erase time
+    uint8_t status;          // BUSY (bit 0) and WEL (bit 1)
+    uint64_t busy_until;
+    uint8_t cmd;
+    uint32_t count;          // Bytes since chip select
+    uint32_t addr;
+    uint8_t page[256];       // Page program data, written on chip select rise
+    uint8_t page_valid[256];
+    uint32_t programs;
+    uint32_t erases;
+    uint32_t ignored;        // Commands dropped while busy
+} VirtualSPIFlash;
+
+void VirtualSPIFlash_Init(VirtualSPIFlash *flash, uint8_t *mem, uint32_t size);
+extern const VirtualSPIDeviceOps VirtualSPIFlash_Ops;
+
+// Sensor register file: the first byte is the register address, bit 7
+// set for a read; the address increments over the rest of the burst.
+// on_read runs when a read burst starts (latch new samples into regs).
+typedef struct {
+    uint8_t regs[128];
+    uint8_t addr;
+    uint8_t read;
+    uint32_t count;
+    void (*on_read)(void *ctx, uint8_t reg, uint64_t cycle);
+    void *on_read_ctx;
+} VirtualSPISensor;
+
+void VirtualSPISensor_Init(VirtualSPISensor *sensor);
+extern const VirtualSPIDeviceOps VirtualSPISensor_Ops;
+
+#endif /* SIM_SPI_H_ */
@@ -0,0 +1,32 @@
+/*
+ * sim_test.h - Check helpers shared by the host tests
+ * Each check prints one PASS/FAIL line; the test exits nonzero if any
+ * failed, so `make test` stops on the first broken test binary
+ */
+
+#ifndef SIM_TEST_H_
+#define SIM_TEST_H_
+
+#include <stdio.h>
+
+// Failed checks of this test binary
+static int sim_test_failures = 0;
+
+static inline void check(int ok, const char *what) {
+    printf("  %-58s %s\n", what, ok ? "PASS" : "FAIL");
+    if (!ok) sim_test_failures++;
+}
+
+// Failure outside a check (e.g. a model guard tripping)
+static inline void sim_test_fail(const char *what) {
+    printf("  %s\n", what);
+    sim_test_failures++;
+}
+
+// Closing line and exit status for main
+static inline int sim_test_result(const char *name) {
+    printf("\n=== %s Test %s ===\n", name, sim_test_failures ? "FAILED" : "PASSED");
+    return sim_test_failures ? 1 : 0;
+}
+
+#endif /* SIM_TEST_H_ */
@@ -0,0 +1,907 @@
+/*
+ * sim_usart.c - Virtual USART Simulator
+ * USART1-6 behind the shadow registers: the unmodified driver's register
+ * accesses drive a transmitter and receiver timed from BRR and the APB
+ * prescaler, with the flags and interrupts of the real peripheral
+ */
+
+#define _GNU_SOURCE  // posix_openpt, cfmakeraw
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+
+// <termios.h> defines CR1-CR3 (carriage return delays), which clash with the
+// register names in USART_RegDef_t
+#undef CR1
+#undef CR2
+#undef CR3
+
+#include "stm32f446re.h"
+#include "sim_log.h"
+#include "sim_clock.h"
+#include "sim_sched.h"
+#include "sim_nvic.h"
+#include "sim_mmio.h"
+#include "sim_usart.h"
+
+#define NEVER UINT64_MAX
+
+// Error codes
+#define VUSART_ERROR_NONE    0
+#define VUSART_ERROR_PORT    1
+#define VUSART_ERROR_MMIO    2
+#define VUSART_ERROR_PARTNER 3
+#define VUSART_ERROR_FULL    4
+
+// Line partner of a port
+#define PARTNER_NONE     0
+#define PARTNER_LOOPBACK 1
+#define PARTNER_PEER     2
+#define PARTNER_SCRIPT   3
+#define PARTNER_PTY      4
+
+// SR bits cleared by writing 0, and by an SR read followed by a DR read
+#define SR_RC_W0     ((1U << USART_SR_RXNE) | (1U << USART_SR_TC))
+#define SR_READ_SEQ  ((1U << USART_SR_IDLE) | (1U << USART_SR_ORE) | (1U << USART_SR_NF) \
+                      | (1U << USART_SR_FE) | (1U << USART_SR_PE))
+
+// Frame on its way to the receiver
+typedef struct {
+    uint16_t data;
+    uint64_t start;  // Start bit
+    uint64_t rxne;   // Middle of the first stop bit, RXNE
+    uint64_t done;   // End of the stop bits, line free
+} RxFrame;
+
+// Virtual USART state
+typedef struct {
+    uint32_t base;
+    uint8_t irq;
+    uint8_t apb2;
+    char name[7];
+    
+    // Registers the driver configures
+    uint32_t brr, cr1, cr2, cr3, gtpr;
+    
+    // Transmitter: TDR and the shift register
+    uint32_t sr;
+    uint16_t tdr;
+    uint8_t tdr_full;
+    uint8_t tx_busy;
+    uint16_t tx_shift;
+    uint64_t tx_end;
+    
+    // Receiver: RDR and the frames still on the line
+    uint16_t rdr;
+    uint64_t rxne_at;
+    RxFrame rx_line[VUSART_RX_LINE_DEPTH];
+    uint16_t rx_head;
+    uint16_t rx_count;
+    uint64_t rx_line_end;
+    uint8_t idle_pending;
+    uint64_t idle_at;
+    uint32_t sr_latched;  // SR value seen by the last SR read, for the SR-DR sequence
+    uint8_t sr_read;
+    
+    // Interrupt output and scheduler events
+    uint8_t irq_level;
+    uint32_t event;
+    uint64_t event_at;
+    uint8_t check_posted;
+    
+    // Line partner
+    uint8_t partner;
+    VirtualUSARTPeerFn peer_fn;
+    void *peer_ctx;
+    const VirtualUSARTStep *script;
+    uint32_t script_len;
+    uint32_t script_step;
+    uint32_t script_pos;
+    int pty_fd;
+    
+    VirtualUSARTStats stats;
+} VirtualUSART;
+
+static VirtualUSART ports[VUSART_PORTS] = {
+    { .base = USART1_BASEADDR, .irq = IRQ_NO_USART1, .apb2 = 1, .name = "USART1" },
+    { .base = USART2_BASEADDR, .irq = IRQ_NO_USART2, .apb2 = 0, .name = "USART2" },
+    { .base = USART3_BASEADDR, .irq = IRQ_NO_USART3, .apb2 = 0, .name = "USART3" },
+    { .base = UART4_BASEADDR,  .irq = IRQ_NO_UART4,  .apb2 = 0, .name = "UART4" },
+    { .base = UART5_BASEADDR,  .irq = IRQ_NO_UART5,  .apb2 = 0, .name = "UART5" },
+    { .base = USART6_BASEADDR, .irq = IRQ_NO_USART6, .apb2 = 1, .name = "USART6" },
+};
+static uint8_t usart_initialized = 0;
+static uint8_t last_error = VUSART_ERROR_NONE;
+
+static void usart_update(VirtualUSART *u);
+
+// Validate a port number
+static VirtualUSART *get_port(uint8_t port) {
+    if (port >= VUSART_PORTS) {
+        last_error = VUSART_ERROR_PORT;
+        SIM_LOG_ERROR("[VirtualUSART] Error: Invalid port %d\n", port);
+        return NULL;
+    }
+    return &ports[port];
+}
+
+static inline uint8_t cr1_bit(const VirtualUSART *u, uint8_t bit) {
+    return (u->cr1 >> bit) & 1U;
+}
+
+// Core cycles of a number of half bit times, each bit USARTDIV PCLK cycles
+static uint64_t half_bit_cycles(const VirtualUSART *u, uint32_t half_bits) {
+    uint32_t div = cr1_bit(u, USART_CR1_OVER8) ? (((u->brr >> 4) << 3) | (u->brr & 0x7U)) : (u->brr & 0xFFFFU);
+    
+    if (div == 0) div = 1;
+    return (uint64_t)half_bits * div * SimMMIO_GetAPBDivider(u->apb2) / 2;
+}
+
+// Core cycles of one frame: start bit, 8 or 9 data bits (parity included)
+// and the CR2 stop bits
+static uint64_t frame_cycles(const VirtualUSART *u) {
+    static const uint8_t stop_half_bits[4] = {2, 1, 4, 3};  // 1, 0.5, 2, 1.5
+    uint32_t half_bits = 2 + 2 * (cr1_bit(u, USART_CR1_M) ? 9 : 8) + stop_half_bits[(u->cr2 >> USART_CR2_STOP) & 3U];
+    
+    return half_bit_cycles(u, half_bits);
+}
+
+// Core cycles from the start bit to the sample point of the first stop
+// bit, where the receiver moves the frame to DR and sets RXNE
+static uint64_t rxne_cycles(const VirtualUSART *u) {
+    return half_bit_cycles(u, 2 + 2 * (cr1_bit(u, USART_CR1_M) ? 9 : 8) + 1);
+}
+
+// Data bits of a frame without the parity bit
+static inline uint16_t data_mask(const VirtualUSART *u) {
+    uint8_t bits = (uint8_t)((cr1_bit(u, USART_CR1_M) ? 9 : 8) - cr1_bit(u, USART_CR1_PCE));
+    return (uint16_t)((1U << bits) - 1);
+}
+
+// Frame as received: payload plus the parity bit in the MSB when PCE is set
+static uint16_t add_parity(const VirtualUSART *u, uint16_t data) {
+    uint16_t mask = data_mask(u);
+    
+    data &= mask;
+    if (!cr1_bit(u, USART_CR1_PCE)) return data;
+    
+    uint16_t parity = (uint16_t)(__builtin_popcount(data) & 1U) ^ cr1_bit(u, USART_CR1_PS);
+    return (uint16_t)(data | (parity << __builtin_popcount(mask)));
+}
+
+static inline uint8_t receiver_on(const VirtualUSART *u) {
+    return cr1_bit(u, USART_CR1_UE) && cr1_bit(u, USART_CR1_RE);
+}
+
+// Queue a frame for the receiver; it starts at start or once the line is
+// free, whichever is later
+static uint8_t rx_push(VirtualUSART *u, uint16_t data, uint64_t start) {
+    if (u->rx_count == VUSART_RX_LINE_DEPTH) {
+        SIM_LOG_WARN("[VirtualUSART] %s: RX line full, frame dropped\n", u->name);
+        return 0;
+    }
+    
+    RxFrame *f = &u->rx_line[(u->rx_head + u->rx_count) % VUSART_RX_LINE_DEPTH];
+    f->data = data;
+    f->start = start > u->rx_line_end ? start : u->rx_line_end;
+    f->rxne = f->start + rxne_cycles(u);
+    f->done = f->start + frame_cycles(u);
+    u->rx_line_end = f->done;
+    u->rx_count++;
+    return 1;
+}
+
+// Queue a string for the receiver
+static void rx_push_string(VirtualUSART *u, const char *s, uint64_t start) {
+    for (; s != NULL && *s != '\0'; s++) {
+        rx_push(u, (uint8_t)*s, start);
+    }
+}
+
+// Fire script steps whose expect has been matched (or is empty)
+static void script_fire(VirtualUSART *u, uint64_t now) {
+    while (u->script_step < u->script_len) {
+        const VirtualUSARTStep *step = &u->script[u->script_step];
+        if (step->expect != NULL && step->expect[u->script_pos] != '\0') break;
+    
+        rx_push_string(u, step->reply, now + SimClock_UsToCycles(step->delay_us));
+        if (step->reply != NULL && step->reply[0] != '\0') {
+            now = u->rx_line_end;
+        }
+        u->script_step++;
+        u->script_pos = 0;
+    }
+}
+
+// Scripted device sees one transmitted byte
+static void script_feed(VirtualUSART *u, uint8_t data, uint64_t now) {
+    if (u->script_step >= u->script_len) return;
+    
+    const char *expect = u->script[u->script_step].expect;
+    if ((uint8_t)expect[u->script_pos] == data) {
+        u->script_pos++;
+    } else {
+        u->script_pos = ((uint8_t)expect[0] == data) ? 1 : 0;
+    }
+    script_fire(u, now);
+}
+
+// Start shifting out the TDR at cycle t
+static void tx_start(VirtualUSART *u, uint64_t t) {
+    uint64_t frame = frame_cycles(u);
+    
+    u->tx_shift = u->tdr;
+    u->tdr_full = 0;
+    u->tx_busy = 1;
+    u->tx_end = t + frame;
+    u->stats.tx_busy_cycles += frame;
+    
+    if (u->partner == PARTNER_LOOPBACK) {
+        rx_push(u, add_parity(u, u->tx_shift), t);
+    }
+}
+
+// Stop bit of the frame in the shift register has gone out
+static void tx_complete(VirtualUSART *u) {
+    uint16_t data = (uint16_t)(u->tx_shift & data_mask(u));
+    uint64_t t = u->tx_end;
+    
+    u->tx_busy = 0;
+    u->stats.tx_frames++;
+    
+    switch (u->partner) {
+        case PARTNER_PEER:
+            u->peer_fn(u->peer_ctx, (uint8_t)(u - ports), data);
+            break;
+        case PARTNER_SCRIPT:
+            script_feed(u, (uint8_t)data, t);
+            break;
+        case PARTNER_PTY: {
+            uint8_t byte = (uint8_t)data;
+            if (write(u->pty_fd, &byte, 1) != 1) {
+                SIM_LOG_WARN("[VirtualUSART] %s: PTY write failed\n", u->name);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    
+    if (u->tdr_full) {
+        tx_start(u, t);
+    } else {
+        u->sr |= (1U << USART_SR_TC);
+    }
+}
+
+// Frame at the head of the RX line has reached its stop bit sample point
+static void rx_complete(VirtualUSART *u) {
+    RxFrame *f = &u->rx_line[u->rx_head];
+    
+    u->rx_head = (uint16_t)((u->rx_head + 1) % VUSART_RX_LINE_DEPTH);
+    u->rx_count--;
+    if (!receiver_on(u)) return;
+    
+    u->stats.rx_frames++;
+    if (u->sr & (1U << USART_SR_RXNE)) {
+        u->sr |= (1U << USART_SR_ORE);  // Shift register content lost
+        u->stats.overruns++;
+    } else {
+        u->rdr = f->data;
+        u->rxne_at = f->rxne;
+        u->sr |= (1U << USART_SR_RXNE);
+    }
+    u->idle_pending = 1;
+    u->idle_at = f->done + (f->done - f->start);
+}
+
+// Cycle of the next IDLE detection (NEVER if a frame starts before it)
+static uint64_t idle_due(const VirtualUSART *u) {
+    if (!u->idle_pending) return NEVER;
+    if (u->rx_count != 0 && u->rx_line[u->rx_head].start < u->idle_at) return NEVER;
+    return u->idle_at;
+}
+
+// Cycle of the next line event (NEVER if the line is quiet)
+static uint64_t next_due(const VirtualUSART *u) {
+    uint64_t t = u->tx_busy ? u->tx_end : NEVER;
+    uint64_t idle = idle_due(u);
+    
+    if (u->rx_count != 0 && u->rx_line[u->rx_head].rxne < t) t = u->rx_line[u->rx_head].rxne;
+    return idle < t ? idle : t;
+}
+
+// Retire line events up to now, in time order
+static void usart_advance(VirtualUSART *u, uint64_t now) {
+    for (;;) {
+        uint64_t t_tx = u->tx_busy ? u->tx_end : NEVER;
+        uint64_t t_rx = u->rx_count != 0 ? u->rx_line[u->rx_head].rxne : NEVER;
+        uint64_t t_idle = idle_due(u);
+    
+        if (t_tx <= now && t_tx <= t_rx && t_tx <= t_idle) {
+            tx_complete(u);
+        } else if (t_rx <= now && t_rx <= t_idle) {
+            rx_complete(u);
+        } else if (t_idle <= now) {
+            u->idle_pending = 0;
+            if (receiver_on(u)) {
+                u->sr |= (1U << USART_SR_IDLE);
+                u->stats.idle_lines++;
+            }
+        } else {
+            break;
+        }
+    }
+}
+
+// Interrupt output: enabled flags
+static uint8_t usart_level(const VirtualUSART *u) {
+    uint32_t sr = u->sr | (u->tdr_full ? 0U : (1U << USART_SR_TXE));
+    
+    return ((u->cr1 & (1U << USART_CR1_TXEIE)) && (sr & (1U << USART_SR_TXE)))
+        || ((u->cr1 & (1U << USART_CR1_TCIE)) && (sr & (1U << USART_SR_TC)))
+        || ((u->cr1 & (1U << USART_CR1_RXNEIE)) && (sr & ((1U << USART_SR_RXNE) | (1U << USART_SR_ORE))))
+        || ((u->cr1 & (1U << USART_CR1_IDLEIE)) && (sr & (1U << USART_SR_IDLE)));
+}
+
+// Line event due
+static void usart_event(void *ctx) {
+    VirtualUSART *u = (VirtualUSART *)ctx;
+    
+    u->event = SIM_EVENT_INVALID;
+    usart_advance(u, SimClock_GetCycles());
+    usart_update(u);
+}
+
+// Interrupt raised during a register access, pended once the access is over
+static void usart_check(void *ctx) {
+    VirtualUSART *u = (VirtualUSART *)ctx;
+    
+    u->check_posted = 0;
+    usart_advance(u, SimClock_GetCycles());
+    if (usart_level(u)) {
+        VirtualNVIC_SetPending(u->irq);
+    }
+}
+
+// Re-arm the line event and pend the IRQ on a rising interrupt output
+static void usart_update(VirtualUSART *u) {
+    uint64_t due = next_due(u);
+    uint8_t level = usart_level(u);
+    
+    if (u->event != SIM_EVENT_INVALID && (due == NEVER || due != u->event_at)) {
+        SimSched_Cancel(u->event);
+        u->event = SIM_EVENT_INVALID;
+    }
+    if (due != NEVER && u->event == SIM_EVENT_INVALID) {
+        u->event = SimSched_PostAt(due, usart_event, u);
+        u->event_at = due;
+    }
+    
+    if (level && !u->irq_level) {
+        if (!SimMMIO_InTrap()) {
+            VirtualNVIC_SetPending(u->irq);
+        } else if (!u->check_posted) {
+            u->check_posted = SimSched_Post(0, usart_check, u) != SIM_EVENT_INVALID;
+        }
+    }
+    u->irq_level = level;
+}
+
+// Level seen by the NVIC after the handler (re-pends while still set)
+static uint8_t usart_irq_level(void *ctx) {
+    VirtualUSART *u = (VirtualUSART *)ctx;
+    
+    usart_advance(u, SimClock_GetCycles());
+    return usart_level(u);
+}
+
+// Driver store to a USART register
+static void usart_write_hook(void *ctx, uint32_t offset, uint32_t old_value, uint32_t new_value) {
+    VirtualUSART *u = (VirtualUSART *)ctx;
+    (void)old_value;
+    
+    SimClock_Advance(SIM_CYCLES_APB_ACCESS);
+    usart_advance(u, SimClock_GetCycles());
+    
+    switch (offset) {
+        case offsetof(USART_RegDef_t, SR):
+            u->sr &= new_value | ~SR_RC_W0;
+            break;
+        case offsetof(USART_RegDef_t, DR):
+            if (!cr1_bit(u, USART_CR1_UE) || !cr1_bit(u, USART_CR1_TE)) break;
+            u->tdr = (uint16_t)(new_value & 0x1FFU);
+            u->tdr_full = 1;
+            u->sr &= ~(1U << USART_SR_TC);
+            if (!u->tx_busy) {
+                tx_start(u, SimClock_GetCycles());
+            }
+            break;
+        case offsetof(USART_RegDef_t, BRR):
+            u->brr = new_value & 0xFFFFU;
+            break;
+        case offsetof(USART_RegDef_t, CR1):
+            u->cr1 = new_value;
+            if (!cr1_bit(u, USART_CR1_UE)) {
+                u->sr = (1U << USART_SR_TC);  // Reset value, TXE from tdr_full
+                u->tdr_full = 0;
+            }
+            break;
+        case offsetof(USART_RegDef_t, CR2):
+            u->cr2 = new_value;
+            break;
+        case offsetof(USART_RegDef_t, CR3):
+            u->cr3 = new_value;
+            break;
+        case offsetof(USART_RegDef_t, GTPR):
+            u->gtpr = new_value;
+            break;
+        default:
+            break;
+    }
+    usart_update(u);
+}
+
+// Driver load from SR or DR: the SR-then-DR sequence clears IDLE and the
+// error flags, any DR read clears RXNE
+static void usart_read_hook(void *ctx, uint32_t offset) {
+    VirtualUSART *u = (VirtualUSART *)ctx;
+    uint64_t now;
+    
+    SimClock_Advance(SIM_CYCLES_APB_ACCESS);
+    now = SimClock_GetCycles();
+    
+    if (offset == offsetof(USART_RegDef_t, SR)) {
+        u->sr_latched = u->sr;
+        u->sr_read = 1;
+    } else if (offset == offsetof(USART_RegDef_t, DR)) {
+        if (u->sr & (1U << USART_SR_RXNE)) {
+            uint64_t latency = now - u->rxne_at;
+            uint32_t lat = latency > UINT32_MAX ? UINT32_MAX : (uint32_t)latency;
+            u->stats.rx_reads++;
+            u->stats.rx_latency_sum += latency;
+            if (lat < u->stats.rx_latency_min) u->stats.rx_latency_min = lat;
+            if (lat > u->stats.rx_latency_max) u->stats.rx_latency_max = lat;
+        }
+        u->sr &= ~(1U << USART_SR_RXNE);
+        if (u->sr_read) {
+            u->sr &= ~(u->sr_latched & SR_READ_SEQ);
+        }
+        u->sr_read = 0;
+    }
+    
+    usart_advance(u, now);
+    usart_update(u);
+}
+
+// Copy the USART state into the shadow registers
+static void usart_refresh(void *ctx, volatile uint32_t *regs) {
+    VirtualUSART *u = (VirtualUSART *)ctx;
+    
+    usart_advance(u, SimClock_GetCycles());
+    usart_update(u);
+    regs[offsetof(USART_RegDef_t, SR) / 4] = u->sr | (u->tdr_full ? 0U : (1U << USART_SR_TXE));
+    regs[offsetof(USART_RegDef_t, DR) / 4] = u->rdr;
+    regs[offsetof(USART_RegDef_t, BRR) / 4] = u->brr;
+    regs[offsetof(USART_RegDef_t, CR1) / 4] = u->cr1;
+    regs[offsetof(USART_RegDef_t, CR2) / 4] = u->cr2;
+    regs[offsetof(USART_RegDef_t, CR3) / 4] = u->cr3;
+    regs[offsetof(USART_RegDef_t, GTPR) / 4] = u->gtpr;
+}
+
+// Attach USART1-6 to the shadow registers. Needs write trapping (Linux
+// x86-64): DR and SR loads must reach the model to clear RXNE and IDLE.
+uint8_t VirtualUSART_Init(void) {
+    if (usart_initialized) return 1;
+    
+    SimClock_Init();
+    SimSched_Init();
+    VirtualNVIC_Init();
+    
+    for (uint8_t i = 0; i < VUSART_PORTS; i++) {
+        VirtualUSART *u = &ports[i];
+        u->sr = (1U << USART_SR_TC);
+        u->event = SIM_EVENT_INVALID;
+        u->pty_fd = -1;
+        u->stats.rx_latency_min = UINT32_MAX;
+    
+        if (!SimMMIO_AddRegion(u->base, sizeof(USART_RegDef_t), usart_write_hook, usart_refresh, u) ||
+            !SimMMIO_AddReadTrap(u->base + offsetof(USART_RegDef_t, SR), 8, usart_read_hook, u)) {
+            last_error = VUSART_ERROR_MMIO;
+            SIM_LOG_ERROR("[VirtualUSART] Error: Cannot attach %s to the shadow registers\n", u->name);
+            return 0;
+        }
+        SimMMIO_SetIRQLevel(u->irq, usart_irq_level, u);
+    }
+    
+    usart_initialized = 1;
+    SIM_LOG_INFO("[VirtualUSART] Initialized %d ports\n", VUSART_PORTS);
+    last_error = VUSART_ERROR_NONE;
+    return 1;
+}
+
+// Get last error code
+uint8_t VirtualUSART_GetLastError(void) {
+    return last_error;
+}
+
+// Core clock cycles of one frame with the port's current configuration
+uint64_t VirtualUSART_GetFrameCycles(uint8_t port) {
+    VirtualUSART *u = get_port(port);
+    
+    return u != NULL ? frame_cycles(u) : 0;
+}
+
+// Drop the port's partner (closes a PTY)
+void VirtualUSART_Detach(uint8_t port) {
+    VirtualUSART *u = get_port(port);
+    
+    if (u == NULL) return;
+    if (u->pty_fd >= 0) {
+        close(u->pty_fd);
+        u->pty_fd = -1;
+    }
+    u->partner = PARTNER_NONE;
+}
+
+// TX wired to RX: every frame sent is received one frame time later
+uint8_t VirtualUSART_SetLoopback(uint8_t port) {
+    if (get_port(port) == NULL) return 0;
+    
+    VirtualUSART_Detach(port);
+    ports[port].partner = PARTNER_LOOPBACK;
+    last_error = VUSART_ERROR_NONE;
+    return 1;
+}
+
+// Device model in C: fn gets every frame sent and answers with
+// VirtualUSART_Inject
+uint8_t VirtualUSART_AttachPeer(uint8_t port, VirtualUSARTPeerFn fn, void *ctx) {
+    if (get_port(port) == NULL) return 0;
+    if (fn == NULL) {
+        last_error = VUSART_ERROR_PARTNER;
+        return 0;
+    }
+    
+    VirtualUSART_Detach(port);
+    ports[port].partner = PARTNER_PEER;
+    ports[port].peer_fn = fn;
+    ports[port].peer_ctx = ctx;
+    last_error = VUSART_ERROR_NONE;
+    return 1;
+}
+
+// Scripted device (modem, GPS...): steps run in order, each waiting for
+// its expect string. steps must stay valid while the script runs.
+uint8_t VirtualUSART_LoadScript(uint8_t port, const VirtualUSARTStep *steps, uint32_t count) {
+    if (get_port(port) == NULL) return 0;
+    if (steps == NULL || count == 0) {
+        last_error = VUSART_ERROR_PARTNER;
+        return 0;
+    }
+    
+    VirtualUSART *u = &ports[port];
+    VirtualUSART_Detach(port);
+    u->partner = PARTNER_SCRIPT;
+    u->script = steps;
+    u->script_len = count;
+    u->script_step = 0;
+    u->script_pos = 0;
+    script_fire(u, SimClock_GetCycles());
+    usart_update(u);
+    last_error = VUSART_ERROR_NONE;
+    return 1;
+}
+
+// 1 once every step of the script has fired
+uint8_t VirtualUSART_ScriptDone(uint8_t port) {
+    VirtualUSART *u = get_port(port);
+    
+    return u != NULL && u->partner == PARTNER_SCRIPT && u->script_step >= u->script_len;
+}
+
+// Connect the port to a new pseudo-terminal; its slave path (for a
+// terminal program: screen, picocom, python) is copied to path. Bytes sent
+// appear on the terminal, and VirtualUSART_PollPTY feeds typed bytes in.
+uint8_t VirtualUSART_OpenPTY(uint8_t port, char *path, uint32_t path_len) {
+    if (get_port(port) == NULL) return 0;
+    
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    struct termios tio;
+    
+    if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0 || ptsname(fd) == NULL) {
+        if (fd >= 0) close(fd);
+        last_error = VUSART_ERROR_PARTNER;
+        SIM_LOG_ERROR("[VirtualUSART] Error: Cannot open a PTY\n");
+        return 0;
+    }
+    
+    // Raw line discipline: bytes pass unchanged, no echo
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    
+    if (path != NULL && path_len != 0) {
+        snprintf(path, path_len, "%s", ptsname(fd));
+    }
+    
+    VirtualUSART_Detach(port);
+    ports[port].partner = PARTNER_PTY;
+    ports[port].pty_fd = fd;
+    SIM_LOG_INFO("[VirtualUSART] %s on %s\n", ports[port].name, ptsname(fd));
+    last_error = VUSART_ERROR_NONE;
+    return 1;
+}
+
+// Wait up to timeout_ms (0: just check) for bytes typed on the PTY and
+// send them to the receiver. Returns the number of bytes injected.
+uint32_t VirtualUSART_PollPTY(uint8_t port, uint32_t timeout_ms) {
+    VirtualUSART *u = get_port(port);
+    uint8_t buf[64];
+    
+    if (u == NULL || u->partner != PARTNER_PTY) return 0;
+    
+    struct pollfd pfd = { .fd = u->pty_fd, .events = POLLIN, .revents = 0 };
+    if (poll(&pfd, 1, (int)timeout_ms) <= 0 || !(pfd.revents & POLLIN)) return 0;
+    
+    ssize_t n = read(u->pty_fd, buf, sizeof(buf));
+    return n > 0 ? VirtualUSART_Inject(port, buf, (uint32_t)n) : 0;
+}
+
+// Frames arriving delay_cycles from now, back-to-back at the port's frame
+// time. Returns the number accepted (the line holds VUSART_RX_LINE_DEPTH).
+uint32_t VirtualUSART_InjectAfter(uint8_t port, const uint8_t *data, uint32_t len, uint64_t delay_cycles) {
+    VirtualUSART *u = get_port(port);
+    uint64_t start = SimClock_GetCycles() + delay_cycles;
+    uint32_t n = 0;
+    
+    if (u == NULL || data == NULL) return 0;
+    
+    usart_advance(u, SimClock_GetCycles());
+    while (n < len && rx_push(u, add_parity(u, data[n]), start)) {
+        n++;
+    }
+    usart_update(u);
+    
+    last_error = n == len ? VUSART_ERROR_NONE : VUSART_ERROR_FULL;
+    return n;
+}
+
+// Frames arriving from now on
+uint32_t VirtualUSART_Inject(uint8_t port, const uint8_t *data, uint32_t len) {
+    return VirtualUSART_InjectAfter(port, data, len, 0);
+}
+
+// Copy the line counters of a port
+void VirtualUSART_GetStats(uint8_t port, VirtualUSARTStats *stats) {
+    VirtualUSART *u = get_port(port);
+    
+    if (u != NULL && stats != NULL) {
+        *stats = u->stats;
+    }
+}
+
+void VirtualUSART_ResetStats(uint8_t port) {
+    VirtualUSART *u = get_port(port);
+    
+    if (u != NULL) {
+        memset(&u->stats, 0, sizeof(u->stats));
+        u->stats.rx_latency_min = UINT32_MAX;
+    }
+}
+
+#ifdef RUN_STANDALONE_TEST
+#include <time.h>
+#include <sys/types.h>
+#include "stm32f446re_usart_driver.h"
+#include "stm32f446re_rcc_driver.h"
+#include "sim_test.h"
+
+static USART_Handle_t husart;
+static uint8_t tx_storage[1024];
+static uint8_t rx_storage[1024];
+static uint8_t rx_data[2048];
+static uint32_t rx_len = 0;
+static uint64_t idle_cycles = 0;
+static uint32_t tx_done = 0;
+
+static void USART2_IRQHandler(void) {
+    USART_IRQHandling(&husart);
+}
+
+static void on_usart_event(USART_Handle_t *pUSARTHandle, uint8_t event) {
+    (void)pUSARTHandle;
+    if (event == USART_EVENT_TX_CMPLT) tx_done++;
+}
+
+static void usart2_config(uint8_t tx_mode, uint8_t rx_mode) {
+    memset(&husart, 0, sizeof(husart));
+    husart.pUSARTx = USART2;
+    husart.Callback = on_usart_event;
+    husart.USART_Config.USART_Mode = USART_MODE_TXRX;
+    husart.USART_Config.USART_Baud = 115200;
+    husart.USART_Config.USART_TxMode = tx_mode;
+    husart.USART_Config.USART_RxMode = rx_mode;
+    husart.USART_Config.pTxStorage = tx_storage;
+    husart.USART_Config.TxStorageSize = sizeof(tx_storage);
+    husart.USART_Config.pRxStorage = rx_storage;
+    husart.USART_Config.RxStorageSize = sizeof(rx_storage);
+}
+
+// Application main loop: run events until want bytes have been read from
+// the driver (or max_cycles have passed). Time between events is idle,
+// where the firmware would sleep in WFI.
+static void run_main_loop(uint32_t want, uint64_t max_cycles) {
+    uint64_t end = SimClock_GetCycles() + max_cycles;
+    uint64_t next;
+    
+    while (rx_len < want && SimSched_GetNextEventCycle(&next) && next <= end) {
+        uint64_t now = SimClock_GetCycles();
+        if (next > now) idle_cycles += next - now;
+        SimSched_RunNext();
+        rx_len += USART_Receive(&husart, rx_data + rx_len, sizeof(rx_data) - rx_len);
+    }
+}
+
+// Test function - only compiled when RUN_STANDALONE_TEST is defined
+// (built with USE_HOST_MMIO and linked with the USART, RCC and GPIO drivers)
+int main(void) {
+    VirtualUSARTStats st;
+    
+    printf("=== Virtual USART Test ===\n\n");
+    
+    if (!SimMMIO_Init() || !VirtualUSART_Init()) {
+        printf("Virtual USART needs write trapping (Linux x86-64)\n");
+        return 1;
+    }
+    SimClock_SetFrequency(RCC_GetHCLKValue());  // Shadow RCC at reset: HSI 16 MHz
+    SimMMIO_AttachIRQ(IRQ_NO_USART2, USART2_IRQHandler, "USART2");
+    SimLog_SetLevel(SIM_LOG_LEVEL_WARN);  // Per-frame IRQ and event traces would swamp the benchmark
+    
+    // Test 1: Frame time from BRR, word length, stop bits and APB prescaler
+    printf("--- Test 1: Frame Timing ---\n");
+    usart2_config(USART_XFER_POLL, USART_XFER_POLL);
+    check(USART_Init(&husart), "USART2 115200 8N1 from HSI");
+    uint32_t brr = USART2->BRR;
+    uint64_t frame = VirtualUSART_GetFrameCycles(VUSART_USART2);
+    check(brr == 139 && frame == 10 * 139, "BRR 139, frame = 10 bits x 139 cycles");
+    husart.USART_Config.USART_WordLength = USART_WORDLEN_9BITS;
+    husart.USART_Config.USART_NoOfStopBits = USART_STOPBITS_2;
+    USART_Init(&husart);
+    check(VirtualUSART_GetFrameCycles(VUSART_USART2) == 12 * 139, "9 data bits, 2 stop bits: 12 bit times");
+    husart.USART_Config.USART_WordLength = USART_WORDLEN_8BITS;
+    husart.USART_Config.USART_NoOfStopBits = USART_STOPBITS_1;
+    husart.USART_Config.USART_Oversampling = USART_OVERSAMPLING_8;
+    USART_Init(&husart);
+    check(VirtualUSART_GetFrameCycles(VUSART_USART2) == 10 * 139, "OVER8: same bit time from the 3-bit fraction");
+    RCC->CFGR = 4U << RCC_CFGR_PPRE1;  // APB1 = HCLK / 2, BRR unchanged
+    check(VirtualUSART_GetFrameCycles(VUSART_USART2) == 2 * 10 * 139, "PPRE1 /2 doubles the frame in core cycles");
+    RCC->CFGR = 0;
+    
+    // Test 2: Polled send on a loopback wire, overrun and the SR-DR sequence
+    printf("\n--- Test 2: Polled Send, Loopback, Overrun ---\n");
+    usart2_config(USART_XFER_POLL, USART_XFER_POLL);
+    USART_Init(&husart);
+    VirtualUSART_SetLoopback(VUSART_USART2);
+    VirtualUSART_ResetStats(VUSART_USART2);
+    uint64_t t0 = SimClock_GetCycles();
+    USART_SendData(&husart, (const uint8_t *)"hello", 5);
+    uint64_t elapsed = SimClock_GetCycles() - t0;
+    VirtualUSART_GetStats(VUSART_USART2, &st);
+    printf("  5 bytes in %llu cycles (5 frames = %llu)\n", (unsigned long long)elapsed,
+           (unsigned long long)(5 * frame));
+    check(elapsed >= 5 * frame && elapsed < 5 * frame + frame / 4, "USART_SendData takes 5 frame times (TXE/TC polled)");
+    check(st.tx_frames == 5 && st.rx_frames == 5 && st.overruns == 4, "nothing read: 4 of 5 looped-back frames overrun");
+    uint32_t sr = USART2->SR;
+    check((sr & (1U << USART_SR_RXNE)) && (sr & (1U << USART_SR_ORE)), "SR: RXNE and ORE");
+    check((USART2->DR & 0xFFU) == 'h', "RDR kept the first byte");
+    check(!(USART2->SR & ((1U << USART_SR_RXNE) | (1U << USART_SR_ORE))), "SR then DR read cleared RXNE and ORE");
+    
+    // Test 3: Interrupt-driven TX and RX through the NVIC, loopback
+    printf("\n--- Test 3: IT Transmit + IT Receive (Loopback) ---\n");
+    static uint8_t msg[1000];
+    for (uint32_t i = 0; i < sizeof(msg); i++) msg[i] = (uint8_t)(i * 7 + 3);
+    usart2_config(USART_XFER_IT, USART_XFER_IT);
+    check(USART_Init(&husart), "USART2 IT TX + IT RX");
+    USART_IRQConfig(IRQ_NO_USART2, 5, ENABLE);
+    VirtualNVIC_ResetStats();
+    VirtualUSART_ResetStats(VUSART_USART2);
+    rx_len = 0;
+    idle_cycles = 0;
+    tx_done = 0;
+    t0 = SimClock_GetCycles();
+    clock_t host0 = clock();
+    check(USART_Send(&husart, msg, sizeof(msg)) == sizeof(msg), "1000 bytes queued, USART_Send returned at once");
+    run_main_loop(sizeof(msg), 2 * sizeof(msg) * frame);
+    elapsed = SimClock_GetCycles() - t0;
+    double host_s = (double)(clock() - host0) / CLOCKS_PER_SEC;
+    run_main_loop(sizeof(msg) + 1, 4 * frame);  // TC interrupt
+    VirtualUSART_GetStats(VUSART_USART2, &st);
+    VirtualNVICStats nst;
+    VirtualNVIC_GetStats(&nst);
+    double secs = (double)elapsed / SimClock_GetFrequency();
+    double rate = sizeof(msg) / secs;
+    double load = 100.0 * (double)(elapsed - idle_cycles) / (double)elapsed;
+    check(rx_len == sizeof(msg) && memcmp(rx_data, msg, sizeof(msg)) == 0, "all 1000 bytes received in order");
+    check(st.overruns == 0 && husart.RxOverruns == 0, "no overruns");
+    check(tx_done == 1, "one TX complete callback (TC)");
+    printf("  Throughput: %.0f bytes/s (line limit 115200/10 = 11520)\n", rate);
+    check(rate > 11520 * 0.99 && rate < 11520 * 1.01, "throughput within 1% of the line rate");
+    printf("  Interrupts: %lu, CPU load %.2f%% at 16 MHz\n", (unsigned long)nst.dispatched, load);
+    printf("  RX latency (RXNE -> DR read): min %lu, avg %.1f, max %lu cycles\n",
+           (unsigned long)st.rx_latency_min, (double)st.rx_latency_sum / (st.rx_reads ? st.rx_reads : 1),
+           (unsigned long)st.rx_latency_max);
+    check(st.rx_reads == sizeof(msg) && st.rx_latency_max < frame, "every byte read within a frame time");
+    printf("  Host: %.0f ns per byte (%.2fx real time)\n", host_s * 1e9 / sizeof(msg), secs / (host_s > 0 ? host_s : 1e-9));
+    
+    // Test 4: Scripted AT device, IDLE flag
+    printf("\n--- Test 4: Scripted Device (AT Commands) ---\n");
+    static const VirtualUSARTStep at_script[] = {
+        { "AT\r\n", "\r\nOK\r\n", 500 },
+        { "AT+GMR\r\n", "\r\nv1.2\r\n\r\nOK\r\n", 2000 },
+        { "", "\r\n+READY\r\n", 10000 },
+    };
+    VirtualUSART_LoadScript(VUSART_USART2, at_script, 3);
+    rx_len = 0;
+    t0 = SimClock_GetCycles();
+    USART_Send(&husart, (const uint8_t *)"AT\r\n", 4);
+    run_main_loop(6, SimClock_MsToCycles(10));
+    elapsed = SimClock_GetCycles() - t0;
+    check(rx_len == 6 && memcmp(rx_data, "\r\nOK\r\n", 6) == 0, "AT -> OK");
+    // Last RXNE comes half a bit (frame / 20 at 8N1) before the end of the reply
+    check(elapsed >= 4 * frame + SimClock_UsToCycles(500) + 6 * frame - frame / 20, "reply after the 500 us response time");
+    SimSched_RunFor(2 * frame);
+    check((USART2->SR & (1U << USART_SR_IDLE)) != 0, "IDLE one frame after the reply");
+    (void)USART2->DR;
+    check(!(USART2->SR & (1U << USART_SR_IDLE)), "IDLE cleared by the SR-DR read sequence");
+    rx_len = 0;
+    USART_Send(&husart, (const uint8_t *)"AT+GMR\r\n", 8);
+    run_main_loop(14 + 10, SimClock_MsToCycles(50));
+    check(rx_len == 24 && memcmp(rx_data, "\r\nv1.2\r\n\r\nOK\r\n\r\n+READY\r\n", 24) == 0,
+          "AT+GMR -> version, OK, then unsolicited +READY");
+    check(VirtualUSART_ScriptDone(VUSART_USART2), "script finished");
+    
+    // Test 5: PTY partner, echo through a terminal
+    printf("\n--- Test 5: PTY-Backed Port ---\n");
+    char pty_path[64];
+    if (VirtualUSART_OpenPTY(VUSART_USART2, pty_path, sizeof(pty_path))) {
+        int term = open(pty_path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+        struct termios tio;
+        char echo[8] = {0};
+        if (term >= 0 && tcgetattr(term, &tio) == 0) {
+            cfmakeraw(&tio);
+            tcsetattr(term, TCSANOW, &tio);
+        }
+        printf("  USART2 on %s\n", pty_path);
+        check(term >= 0 && write(term, "ping", 4) == 4, "terminal wrote \"ping\"");
+        rx_len = 0;
+        check(VirtualUSART_PollPTY(VUSART_USART2, 1000) == 4, "4 bytes injected into the receiver");
+        run_main_loop(4, 10 * frame);
+        check(rx_len == 4 && memcmp(rx_data, "ping", 4) == 0, "driver received \"ping\"");
+        USART_Send(&husart, rx_data, 4);
+        SimSched_RunFor(6 * frame);
+        struct pollfd pfd = { .fd = term, .events = POLLIN, .revents = 0 };
+        ssize_t n = (poll(&pfd, 1, 1000) > 0) ? read(term, echo, 4) : -1;
+        check(n == 4 && memcmp(echo, "ping", 4) == 0, "echo arrived on the terminal");
+        if (term >= 0) close(term);
+        VirtualUSART_Detach(VUSART_USART2);
+    } else {
+        printf("  (no PTY available on this host, skipped)\n");
+    }
+    
+    SimMMIOStats mst;
+    SimMMIO_GetStats(&mst);
+    printf("\nShadow registers: %lu write traps, %lu read traps\n", (unsigned long)mst.traps,
+           (unsigned long)mst.read_traps);
+    return sim_test_result("Virtual USART");
+}
+#endif  // RUN_STANDALONE_TEST
@@ -0,0 +1,69 @@
+/*
+ * sim_usart.h - Virtual USART interface
+ * USART1-6 on the shadow registers: frames shifted at the BRR baud rate,
+ * TXE/TC/RXNE/IDLE interrupts through the virtual NVIC, and a partner on
+ * the line (loopback, scripted device, callback or Linux PTY)
+ */
+
+#ifndef SIM_USART_H_
+#define SIM_USART_H_
+
+#include <stdint.h>
+
+// Port numbers (index of the USART, same order as the driver's port table)
+#define VUSART_USART1 0
+#define VUSART_USART2 1
+#define VUSART_USART3 2
+#define VUSART_UART4  3
+#define VUSART_UART5  4
+#define VUSART_USART6 5
+#define VUSART_PORTS  6
+
+#define VUSART_RX_LINE_DEPTH 256  // Frames that can be on their way to the receiver
+
+// One exchange of a scripted device: once the transmitter has sent expect,
+// reply comes back delay_us later. An empty expect fires as soon as the
+// previous step is done (unsolicited output).
+typedef struct {
+    const char *expect;
+    const char *reply;  // NULL: nothing sent back
+    uint32_t delay_us;
+} VirtualUSARTStep;
+
+// Frame sent by the port, called when its stop bit has gone out
+typedef void (*VirtualUSARTPeerFn)(void *ctx, uint8_t port, uint16_t data);
+
+// Line counters (reset with VirtualUSART_ResetStats)
+typedef struct {
+    uint32_t tx_frames;
+    uint32_t rx_frames;       // Frames that reached an enabled receiver
+    uint32_t overruns;        // Frames lost because RXNE was still set (ORE)
+    uint32_t idle_lines;      // IDLE flags raised
+    uint32_t rx_reads;        // Frames taken out of DR
+    uint32_t rx_latency_min;  // Cycles from RXNE to the DR read
+    uint32_t rx_latency_max;
+    uint64_t rx_latency_sum;
+    uint64_t tx_busy_cycles;  // Cycles the transmitter was shifting
+} VirtualUSARTStats;
+
+uint8_t VirtualUSART_Init(void);
+uint8_t VirtualUSART_GetLastError(void);
+uint64_t VirtualUSART_GetFrameCycles(uint8_t port);
+
+// Line partner (each call replaces the previous one)
+uint8_t VirtualUSART_SetLoopback(uint8_t port);
+uint8_t VirtualUSART_AttachPeer(uint8_t port, VirtualUSARTPeerFn fn, void *ctx);
+uint8_t VirtualUSART_LoadScript(uint8_t port, const VirtualUSARTStep *steps, uint32_t count);
+uint8_t VirtualUSART_ScriptDone(uint8_t port);
+uint8_t VirtualUSART_OpenPTY(uint8_t port, char *path, uint32_t path_len);
+uint32_t VirtualUSART_PollPTY(uint8_t port, uint32_t timeout_ms);
+void VirtualUSART_Detach(uint8_t port);
+
+// Frames arriving at the receiver, back-to-back from now (+ delay)
+uint32_t VirtualUSART_Inject(uint8_t port, const uint8_t *data, uint32_t len);
+uint32_t VirtualUSART_InjectAfter(uint8_t port, const uint8_t *data, uint32_t len, uint64_t delay_cycles);
+
+void VirtualUSART_GetStats(uint8_t port, VirtualUSARTStats *stats);
+void VirtualUSART_ResetStats(uint8_t port);
+
+#endif /* SIM_USART_H_ */
@@ -0,0 +1,119 @@
+/*
+ * test_gpio_pin.cpp - Host test of the C++ pin layer (stm32f446re_gpio_pin.hpp)
+ * Built with USE_HOST_MMIO, so gpio::Pin<> writes land in the shadow
+ * registers and reach the virtual GPIO ports
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#include "stm32f446re_gpio_pin.hpp"
+
+extern "C" {
+#include "sim_log.h"
+#include "sim_gpio.h"
+#include "sim_exti.h"
+#include "sim_nvic.h"
+#include "sim_mmio.h"
+#include "sim_test.h"
+}
+
+using Led = gpio::Pin<gpio::PortA, 5>;
+using Button = gpio::Pin<gpio::PortC, 13>;
+using Bus = gpio::Pins<gpio::PortB, 0x00FF>;
+using UartPins = gpio::Pins<gpio::PortA, (1U << 2) | (1U << 3)>;
+
+static_assert(Led::mask == 0x0020, "Pin mask folded at compile time");
+static_assert(Led::port::baseaddr == GPIOA_BASEADDR, "Pin port folded at compile time");
+static_assert(Button::irq == IRQ_NO_EXTI15_10, "PC13 is served by EXTI15_10");
+static_assert(gpio::spread_mask2(0x8001) == 0xC0000003U, "spread_mask2");
+
+static int button_presses = 0;
+
+static void on_button(uint8_t pin) {
+    (void)pin;
+    button_presses++;
+}
+
+int main(void) {
+    printf("=== C++ Pin Layer Test ===\n\n");
+    
+    if (!SimMMIO_Init()) return 1;
+    
+    VirtualGPIORegs *pa = VirtualGPIO_GetRegs(0);
+    VirtualGPIORegs *pb = VirtualGPIO_GetRegs(1);
+    uint8_t level = 0;
+    
+    // Test 1: Compile-time configuration
+    printf("--- Test 1: Pin::init / Pins::init (PA5 output, PA2/PA3 AF7) ---\n");
+    Led::init<GPIO_MODE_OUT, GPIO_SPEED_HIGH>();
+    UartPins::init<GPIO_MODE_ALTFN, GPIO_SPEED_HIGH, GPIO_PIN_PU, GPIO_OP_TYPE_PP, 7>();
+    SimMMIO_Sync();
+    printf("GPIOA MODER=0x%08X OSPEEDR=0x%08X AFR[0]=0x%08X\n",
+           (unsigned)pa->MODER, (unsigned)pa->OSPEEDR, (unsigned)pa->AFR[0]);
+    check(pa->MODER == 0x000004A0U, "MODER: PA5 output, PA2/PA3 alternate function");
+    check(pa->OSPEEDR == 0x00000CF0U, "OSPEEDR: PA2/PA3/PA5 high speed");
+    check(pa->AFR[0] == 0x00007700U, "AFR[0]: PA2/PA3 on AF7");
+    
+    // Test 2: Single-store writes
+    printf("\n--- Test 2: Pin::set / reset / write / toggle ---\n");
+    Led::set();
+    SimMMIO_Sync();
+    VirtualGPIO_ReadPin(0, 5, &level);
+    check(level == 1, "set: PA5 = 1");
+    Led::write(false);
+    SimMMIO_Sync();
+    VirtualGPIO_ReadPin(0, 5, &level);
+    check(level == 0, "write(false): PA5 = 0");
+    Led::toggle();
+    SimMMIO_Sync();
+    VirtualGPIO_ReadPin(0, 5, &level);
+    check(level == 1, "toggle: PA5 = 1");
+    
+    // Test 3: Masked group
+    printf("\n--- Test 3: Pins<PortB, 0x00FF>::write ---\n");
+    Bus::init<GPIO_MODE_OUT>();
+    GPIO_WriteToOutputPort(GPIOB, 0xA5FF);
+    Bus::write(0x5A);
+    SimMMIO_Sync();
+    check(pb->ODR == 0xA55AU, "masked write: GPIOB ODR = 0xA55A");
+    
+    // Test 4: Interrupt mode goes through the C driver's EXTI engine
+    printf("\n--- Test 4: Pin::init<GPIO_MODE_IT_FT> / on_interrupt ---\n");
+    Button::init<GPIO_MODE_IT_FT, GPIO_SPEED_LOW, GPIO_PIN_PU>();
+    Button::on_interrupt(on_button, 5);
+    SimMMIO_AttachIRQ(Button::irq, EXTI15_10_IRQHandler, "EXTI15_10");
+    SimMMIO_Sync();
+    check(Button::read() == 1, "PC13 reads 1 with pull-up");
+    VirtualGPIO_SimulateInterrupt(2, 13, 0);
+    check(button_presses == 1, "falling edge: one callback");
+    
+    // Test 5: Toggle loop against the C API
+    printf("\n--- Test 5: Toggle Benchmark (sync mode) ---\n");
+    const uint32_t toggles = 10000000;
+    uint8_t saved_level = SimLog_GetLevel();
+    SimLog_SetLevel(SIM_LOG_LEVEL_NONE);
+    SimMMIO_SetWriteTrap(0);
+    
+    clock_t start = clock();
+    for (uint32_t i = 0; i < toggles; i++) {
+        GPIO_ToggleOutputPin(GPIOA, GPIO_PIN_NO_5);
+    }
+    clock_t mid = clock();
+    for (uint32_t i = 0; i < toggles; i++) {
+        Led::toggle();
+    }
+    clock_t end = clock();
+    
+    Led::set();
+    SimMMIO_Sync();
+    SimLog_SetLevel(saved_level);
+    VirtualGPIO_ReadPin(0, 5, &level);
+    printf("C API: %.2f ns per toggle, Pin<PortA, 5>: %.2f ns per toggle\n",
+           (double)(mid - start) * 1e9 / CLOCKS_PER_SEC / toggles,
+           (double)(end - mid) * 1e9 / CLOCKS_PER_SEC / toggles);
+    check(level == 1, "PA5 = 1 after sync");
+    
+    return sim_test_result("C++ Pin Layer");
+}
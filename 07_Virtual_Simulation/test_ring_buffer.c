@@ -0,0 +1,183 @@
+/*
+ * test_ring_buffer.c - Host test of the SPSC ring buffer (drivers/src/ring_buffer.c)
+ * Unit checks plus a two-thread stress test: one producer and one consumer
+ * hammer the buffer with single and bulk transfers while the consumer
+ * verifies the byte sequence
+ */
+
+#define _POSIX_C_SOURCE 200809L  // pthreads, clock_gettime
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "ring_buffer.h"
+#include "sim_rand.h"
+#include "sim_test.h"
+
+#define STRESS_BYTES  (16U * 1024U * 1024U)
+#define STRESS_SIZE   256U   // Small buffer: constant wrap-around and full/empty races
+#define MAX_CHUNK     96U
+
+static uint8_t stress_storage[STRESS_SIZE];
+static RingBuffer_t stress_rb;
+static uint32_t stress_errors = 0;
+static uint32_t full_spins = 0;
+static uint32_t empty_spins = 0;
+
+// Byte n of the stream; 251 is prime, so a dropped or repeated block of any
+// buffer-related length shows up as a mismatch
+static inline uint8_t stream_byte(uint32_t n) {
+    return (uint8_t)(n % 251U);
+}
+
+static void *producer(void *arg) {
+    SimRand rng;
+    uint8_t chunk[MAX_CHUNK];
+    uint32_t sent = 0;
+    (void)arg;
+    
+    SimRand_Seed(&rng, 1);
+    while (sent < STRESS_BYTES) {
+        uint32_t len = 1 + SimRand_Below(&rng, MAX_CHUNK);
+        if (len > STRESS_BYTES - sent) len = STRESS_BYTES - sent;
+    
+        if (len == 1) {
+            if (RingBuffer_Put(&stress_rb, stream_byte(sent))) {
+                sent++;
+            } else {
+                full_spins++;
+                sched_yield();  // Let the consumer run on single-core hosts
+            }
+            continue;
+        }
+    
+        for (uint32_t i = 0; i < len; i++) {
+            chunk[i] = stream_byte(sent + i);
+        }
+        uint32_t done = RingBuffer_PutBulk(&stress_rb, chunk, len);
+        if (done == 0) {
+            full_spins++;
+            sched_yield();
+        }
+        sent += done;
+    }
+    return NULL;
+}
+
+static void *consumer(void *arg) {
+    SimRand rng;
+    uint8_t chunk[MAX_CHUNK];
+    uint32_t received = 0;
+    (void)arg;
+    
+    SimRand_Seed(&rng, 2);
+    while (received < STRESS_BYTES) {
+        uint32_t len = 1 + SimRand_Below(&rng, MAX_CHUNK);
+        uint32_t done;
+    
+        if (len == 1) {
+            done = RingBuffer_Get(&stress_rb, chunk);
+        } else {
+            done = RingBuffer_GetBulk(&stress_rb, chunk, len);
+        }
+        if (done == 0) {
+            empty_spins++;
+            sched_yield();
+            continue;
+        }
+    
+        for (uint32_t i = 0; i < done; i++) {
+            if (chunk[i] != stream_byte(received + i)) {
+                stress_errors++;
+            }
+        }
+        received += done;
+    }
+    return NULL;
+}
+
+int main(void) {
+    uint8_t storage[16];
+    uint8_t data[32];
+    uint8_t byte = 0;
+    RingBuffer_t rb;
+    
+    printf("=== SPSC Ring Buffer Test ===\n\n");
+    
+    // Test 1: Setup
+    printf("--- Test 1: RingBuffer_Init ---\n");
+    check(!RingBuffer_Init(&rb, storage, 12), "size 12 rejected (not a power of two)");
+    check(!RingBuffer_Init(&rb, storage, 0), "size 0 rejected");
+    check(RingBuffer_Init(&rb, storage, sizeof(storage)), "size 16 accepted");
+    check(RingBuffer_Count(&rb) == 0 && RingBuffer_Free(&rb) == 16, "empty: count 0, free 16");
+    
+    // Test 2: Single-byte put/get, full and empty
+    printf("\n--- Test 2: Put / Get ---\n");
+    uint8_t ok = 1;
+    for (uint8_t i = 0; i < 16; i++) {
+        ok &= RingBuffer_Put(&rb, i);
+    }
+    check(ok, "16 puts into a 16-byte buffer (all slots usable)");
+    check(!RingBuffer_Put(&rb, 99), "17th put rejected when full");
+    ok = 1;
+    for (uint8_t i = 0; i < 16; i++) {
+        ok &= RingBuffer_Get(&rb, &byte) && byte == i;
+    }
+    check(ok, "16 gets return 0..15 in order");
+    check(!RingBuffer_Get(&rb, &byte), "get rejected when empty");
+    
+    // Test 3: Bulk transfers across the wrap point
+    printf("\n--- Test 3: PutBulk / GetBulk ---\n");
+    for (uint8_t i = 0; i < sizeof(data); i++) data[i] = (uint8_t)(0xA0 + i);
+    uint8_t out[32];
+    RingBuffer_PutBulk(&rb, data, 10);
+    check(RingBuffer_GetBulk(&rb, out, 0) == 0, "zero-length get is a no-op");
+    RingBuffer_GetBulk(&rb, out, 10);  // Head and tail now at slot 10
+    check(RingBuffer_PutBulk(&rb, data, 20) == 16, "bulk put of 20 stores 16 (wraps at slot 16)");
+    check(RingBuffer_GetBulk(&rb, out, 32) == 16 && memcmp(out, data, 16) == 0,
+          "bulk get returns the 16 bytes in order");
+    
+    // Test 4: Free-running indices wrapping past 2^32
+    printf("\n--- Test 4: Index wrap-around ---\n");
+    rb.Head = rb.Tail = 0xFFFFFFF8U;
+    check(RingBuffer_PutBulk(&rb, data, 16) == 16 && RingBuffer_Count(&rb) == 16,
+          "16 bytes stored across the 32-bit index wrap");
+    check(RingBuffer_GetBulk(&rb, out, 16) == 16 && memcmp(out, data, 16) == 0,
+          "16 bytes read back across the wrap");
+    
+    // Test 5: Zero-copy producer (circular DMA style)
+    printf("\n--- Test 5: RingBuffer_Commit ---\n");
+    RingBuffer_Init(&rb, storage, sizeof(storage));
+    memcpy(storage, data, 10);
+    check(RingBuffer_Commit(&rb, 10) && RingBuffer_Count(&rb) == 10, "10 bytes written in place and committed");
+    check(RingBuffer_GetBulk(&rb, out, 4) == 4 && memcmp(out, data, 4) == 0, "consumer reads them in order");
+    for (uint32_t i = 10; i < 24; i++) storage[i & 15] = data[i];  // Writer laps the reader
+    check(!RingBuffer_Commit(&rb, 14), "commit past unread bytes reports overrun");
+    check(RingBuffer_Count(&rb) == 16 && RingBuffer_Free(&rb) == 0, "count clamped to 16, free 0");
+    check(RingBuffer_GetBulk(&rb, out, 32) == 16 && memcmp(out, &data[8], 16) == 0,
+          "consumer skips to the oldest byte still stored");
+    
+    // Test 6: Producer and consumer threads
+    printf("\n--- Test 6: Two-thread stress (%u MiB through %u bytes) ---\n",
+           STRESS_BYTES >> 20, STRESS_SIZE);
+    RingBuffer_Init(&stress_rb, stress_storage, STRESS_SIZE);
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_t prod, cons;
+    pthread_create(&cons, NULL, consumer, NULL);
+    pthread_create(&prod, NULL, producer, NULL);
+    pthread_join(prod, NULL);
+    pthread_join(cons, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double secs = (double)(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("  %.2f s, %.0f MB/s, %u full / %u empty retries\n", secs,
+           STRESS_BYTES / secs / 1e6, full_spins, empty_spins);
+    check(stress_errors == 0, "consumer saw the exact byte sequence");
+    check(RingBuffer_Count(&stress_rb) == 0, "buffer empty at the end");
+    
+    return sim_test_result("Ring Buffer");
+}
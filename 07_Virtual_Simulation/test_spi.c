@@ -0,0 +1,392 @@
+/*
+ * test_spi.c - Host test of the SPI driver (drivers/src/stm32f446re_spi_driver.c)
+ * on the shadow registers. SPI1's SR is held at TXE|RXNE with BSY clear
+ * and DR is plain memory, so the bus behaves as MOSI looped back to MISO:
+ * every frame read back is the frame last written. For DMA transfers the
+ * test plays DMA2 streams 0 (RX) and 3 (TX): it copies the block the
+ * driver handed over and raises TCIF0 (or TEIF3). The transaction queue
+ * runs against a bus model that calls SPI_IRQHandling whenever an enabled
+ * TXE/RXNE condition holds and logs every frame with the chip selects and
+ * CR1 it went out with.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "stm32f446re_spi_driver.h"
+#include "stm32f446re_gpio_drivers.h"
+#include "sim_mmio.h"
+#include "sim_test.h"
+
+#define SPI_SR_IDLE  ((1U << SPI_SR_TXE) | (1U << SPI_SR_RXNE))
+
+static SPI_Handle_t hspi;
+static uint32_t xfer_cmplt = 0;
+static uint32_t xfer_errors = 0;
+
+static void on_spi_event(SPI_Handle_t *pSPIHandle, uint8_t event) {
+    (void)pSPIHandle;
+    if (event == SPI_EVENT_XFER_CMPLT) xfer_cmplt++;
+    if (event == SPI_EVENT_XFER_ERROR) xfer_errors++;
+}
+
+static void spi_config(SPI_Handle_t *h, SPI_RegDef_t *spi, uint8_t dff) {
+    memset(h, 0, sizeof(*h));
+    h->pSPIx = spi;
+    h->Callback = on_spi_event;
+    h->SPIConfig.SPI_DeviceMode = SPI_DEVICE_MODE_MASTER;
+    h->SPIConfig.SPI_BusConfig = SPI_BUS_CONFIG_FD;
+    h->SPIConfig.SPI_SclkSpeed = SPI_SCLK_SPEED_DIV8;
+    h->SPIConfig.SPI_DFF = dff;
+    h->SPIConfig.SPI_CPOL = SPI_CPOL_LOW;
+    h->SPIConfig.SPI_CPHA = SPI_CPHA_LOW;
+    h->SPIConfig.SPI_SSM = SPI_SSM_EN;
+}
+
+// DMA2 streams 0 and 3: loop the TX block back into the RX block (or the
+// dummy frames into the dummy sink), then raise the RX transfer complete
+// or a TX transfer error
+static void run_spi_dma(uint8_t fail) {
+    DMA_Stream_RegDef_t *rx = &DMA2->S[0];
+    DMA_Stream_RegDef_t *tx = &DMA2->S[3];
+    uint32_t frame = hspi.SPIConfig.SPI_DFF == SPI_DFF_16BITS ? 2 : 1;
+    
+    if (!(rx->CR & tx->CR & (1U << DMA_SCR_EN))) return;
+    
+    if (fail) {
+        DMA2->ISR[0] = (1U << DMA_FLAG_TEIF) << DMA_FLAG_SHIFT(3);
+    } else {
+        if (hspi.pRxData != NULL && hspi.pTxData != NULL) {
+            memcpy(hspi.pRxData, hspi.pTxData, hspi.Len * frame);
+        } else if (hspi.pRxData != NULL) {
+            memset(hspi.pRxData, 0xFF, hspi.Len * frame);
+        }
+        rx->NDTR = 0;
+        tx->NDTR = 0;
+        DMA2->ISR[0] = (1U << DMA_FLAG_TCIF) << DMA_FLAG_SHIFT(0);
+    }
+    SPI_DMAIRQHandling(&hspi);
+    DMA2->ISR[0] = 0;  // IFCR write-1-to-clear is not modelled
+}
+
+// Three devices on SPI1 (set up in main, the GPIO pointers are not
+// constants on the host): A and C share mode 0, PCLK/8, 8-bit; B is
+// mode 3, PCLK/32, 16-bit
+static SPI_Device_t devs[3];
+
+typedef struct {
+    uint32_t frame;
+    uint8_t cs_low;   // Bit i: devs[i] selected
+    uint32_t cr1;
+} wire_frame_t;
+
+static wire_frame_t wire[512];
+static uint32_t wire_len = 0;
+static SPI_Transaction_t *done_order[16];
+static uint32_t done_count = 0;
+static uint32_t spi_irqs = 0;
+static uint8_t inject_ovr = 0;
+
+// Each CS is alone on its port and the driver drives it through BSRR only,
+// so the last BSRR write is the pin level (the shadow does not fold BSRR
+// into ODR with the write trap off)
+static uint8_t cs_state(void) {
+    uint8_t low = 0;
+    for (int i = 0; i < 3; i++) {
+        if (devs[i].pCSPort->BSRR == (1U << (devs[i].CSPin + 16U))) low |= (uint8_t)(1U << i);
+    }
+    return low;
+}
+
+static void on_xact_done(SPI_Transaction_t *pXact, uint8_t event) {
+    (void)event;
+    if (done_count < 16) done_order[done_count++] = pXact;
+    pXact->pNext = (SPI_Transaction_t *)pXact->pContext;  // Chained follow-up, NULL for none
+}
+
+// SPI1 as a loopback wire. A frame written to DR is logged and comes back
+// with RXNE on the next interrupt; TXE is always set. DMA blocks are moved
+// in one go. Runs until no interrupt is enabled and no DMA is running.
+static void run_spi_bus(void) {
+    uint32_t in_flight[2];
+    uint32_t n_flight = 0;
+    
+    for (uint32_t guard = 0; guard < 100000; guard++) {
+        SPI_Transaction_t *active = hspi.pActive;
+        uint32_t tx_before = hspi.XferTx;
+        uint32_t cr2 = SPI1->CR2;
+    
+        if (DMA2->S[0].CR & (1U << DMA_SCR_EN)) {
+            for (uint32_t i = 0; i < hspi.Len && wire_len < 512; i++) {
+                uint32_t f = hspi.pTxData ? hspi.pTxData[i] : 0xFFU;
+                wire[wire_len++] = (wire_frame_t){ f, cs_state(), SPI1->CR1 };
+            }
+            run_spi_dma(0);
+            continue;
+        }
+        if (!(cr2 & ((1U << SPI_CR2_TXEIE) | (1U << SPI_CR2_RXNEIE)))) break;
+    
+        SPI1->SR = (1U << SPI_SR_TXE);
+        if (n_flight != 0 && (cr2 & (1U << SPI_CR2_RXNEIE))) {
+            SPI1->SR |= (1U << SPI_SR_RXNE) | (inject_ovr ? (1U << SPI_SR_OVR) : 0U);
+            SPI1->DR = in_flight[0];
+            in_flight[0] = in_flight[1];
+            n_flight--;
+            inject_ovr = 0;
+        } else if (!(cr2 & (1U << SPI_CR2_TXEIE))) {
+            break;  // RXNEIE alone with nothing in flight: stuck
+        }
+        spi_irqs++;
+        SPI_IRQHandling(&hspi);
+    
+        if (hspi.pActive == NULL || hspi.pActive != active) {
+            n_flight = 0;  // Transaction ended; a new one has written nothing yet
+        }
+        if (hspi.pActive == active && active != NULL && hspi.XferTx == tx_before + 1) {
+            in_flight[n_flight++] = SPI1->DR;
+            if (wire_len < 512) wire[wire_len++] = (wire_frame_t){ SPI1->DR, cs_state(), SPI1->CR1 };
+        }
+    }
+    SPI1->SR = SPI_SR_IDLE;
+}
+
+static void xact_init(SPI_Transaction_t *x, const SPI_Device_t *dev, const uint8_t *tx, uint8_t *rx, uint32_t len) {
+    memset(x, 0, sizeof(*x));
+    x->pDevice = dev;
+    x->pTxBuffer = tx;
+    x->pRxBuffer = rx;
+    x->Len = len;
+    x->Done = on_xact_done;
+}
+
+int main(void) {
+    static uint8_t tx[300];
+    static uint8_t rx[300];
+    static uint16_t tx16[64];
+    static uint16_t rx16[64];
+    
+    printf("=== SPI Driver Test ===\n\n");
+    
+    if (!SimMMIO_Init()) return 1;
+    SimMMIO_SetWriteTrap(0);  // SPI/DMA are plain shadow memory here
+    
+    for (uint32_t i = 0; i < sizeof(tx); i++) tx[i] = (uint8_t)(i * 13 + 1);
+    for (uint32_t i = 0; i < 64; i++) tx16[i] = (uint16_t)(0xA000U + i * 257U);
+    
+    // Test 1: Init from the config and the port table
+    printf("--- Test 1: SPI_Init ---\n");
+    spi_config(&hspi, SPI1, SPI_DFF_8BITS);
+    hspi.SPIConfig.SPI_SclkSpeed = 8;
+    check(!SPI_Init(&hspi), "baud rate divider out of range rejected");
+    spi_config(&hspi, (SPI_RegDef_t *)USART2, SPI_DFF_8BITS);
+    check(!SPI_Init(&hspi), "non-SPI base address rejected");
+    spi_config(&hspi, SPI1, SPI_DFF_8BITS);
+    check(SPI_Init(&hspi), "SPI1 master, mode 0, PCLK/8, software NSS");
+    check((RCC->APB2ENR >> 12) & 1U, "SPI1 clock enabled on APB2");
+    check(SPI1->CR1 == ((1U << SPI_CR1_MSTR) | (2U << SPI_CR1_BR) | (1U << SPI_CR1_SSM)
+                      | (1U << SPI_CR1_SSI) | (1U << SPI_CR1_SPE)),
+          "CR1 = MSTR | BR=2 | SSM | SSI | SPE");
+    check(SPI1->CR2 == 0, "CR2 clear (no SSOE with software NSS)");
+    check(((GPIOA->MODER >> 10) & 0x3FU) == 0x2AU && ((GPIOA->AFR[0] >> 20) & 0xFFFU) == 0x555U,
+          "PA5/PA6/PA7 in alternate function 5");
+    check(hspi.SclkHz == 2000000U, "SCK = 16 MHz HSI / 8 = 2 MHz");
+    check(hspi.pDMA == DMA2 && hspi.RxStream == 0 && hspi.TxStream == 3 && hspi.DMAChannel == 3,
+          "SPI1 mapped to DMA2 streams 0 (RX) / 3 (TX), channel 3");
+    
+    spi_config(&hspi, SPI2, SPI_DFF_16BITS);
+    hspi.SPIConfig.SPI_CPOL = SPI_CPOL_HIGH;
+    hspi.SPIConfig.SPI_CPHA = SPI_CPHA_HIGH;
+    hspi.SPIConfig.SPI_SSM = SPI_SSM_DI;
+    check(SPI_Init(&hspi), "SPI2 master, mode 3, 16-bit, hardware NSS");
+    check(SPI2->CR1 == ((1U << SPI_CR1_MSTR) | (2U << SPI_CR1_BR) | (1U << SPI_CR1_CPOL)
+                      | (1U << SPI_CR1_CPHA) | (1U << SPI_CR1_DFF) | (1U << SPI_CR1_SPE))
+          && SPI2->CR2 == (1U << SPI_CR2_SSOE),
+          "CR1 = MSTR | BR=2 | CPOL | CPHA | DFF | SPE, CR2 = SSOE");
+    check(((RCC->APB1ENR >> 14) & 1U) && ((GPIOB->AFR[1] >> 20) & 0xFFFU) == 0x555U,
+          "SPI2 clock on APB1, PB13/PB14/PB15 in AF5");
+    check(hspi.pDMA == NULL, "SPI2 has no DMA mapping");
+    check(!SPI_TransferDMA(&hspi, (const uint8_t *)tx16, (uint8_t *)rx16, 8),
+          "SPI_TransferDMA refused without DMA");
+    
+    // Test 2: Blocking full-duplex transfer, 8-bit frames
+    printf("\n--- Test 2: SPI_TransferData (8-bit) ---\n");
+    spi_config(&hspi, SPI1, SPI_DFF_8BITS);
+    SPI_Init(&hspi);
+    SPI1->SR = SPI_SR_IDLE;
+    memset(rx, 0, sizeof(rx));
+    SPI_TransferData(&hspi, tx, rx, sizeof(tx));
+    check(memcmp(rx, tx, sizeof(tx)) == 0, "300 bytes looped back in order");
+    check(SPI1->DR == tx[sizeof(tx) - 1], "last frame written is the last byte");
+    
+    memset(rx, 0, sizeof(rx));
+    SPI_ReceiveData(&hspi, rx, 16);
+    check(rx[0] == 0xFF && rx[15] == 0xFF && rx[16] == 0, "SPI_ReceiveData clocks out 0xFF dummies");
+    
+    SPI1->DR = 0;
+    SPI_SendData(&hspi, tx, 40);
+    check(SPI1->DR == tx[39], "SPI_SendData writes every byte, RX discarded");
+    SPI_TransferData(&hspi, tx, NULL, 10);
+    check(SPI1->DR == tx[9], "SPI_TransferData with no RX buffer sends only");
+    
+    // Test 3: Blocking full-duplex transfer, 16-bit frames
+    printf("\n--- Test 3: SPI_TransferData (16-bit) ---\n");
+    spi_config(&hspi, SPI1, SPI_DFF_16BITS);
+    SPI_Init(&hspi);
+    SPI1->SR = SPI_SR_IDLE;
+    memset(rx16, 0, sizeof(rx16));
+    SPI_TransferData(&hspi, (const uint8_t *)tx16, (uint8_t *)rx16, sizeof(tx16));
+    check(memcmp(rx16, tx16, sizeof(tx16)) == 0, "64 half-words looped back in order");
+    check(SPI1->DR == tx16[63], "DR holds whole 16-bit frames");
+    memset(rx16, 0, sizeof(rx16));
+    SPI_ReceiveData(&hspi, (uint8_t *)rx16, 7);
+    check(rx16[0] == 0xFFFFU && rx16[2] == 0xFFFFU && rx16[3] == 0,
+          "odd byte count: 3 frames, trailing byte ignored");
+    
+    // Test 4: DMA transfer
+    printf("\n--- Test 4: SPI_TransferDMA ---\n");
+    spi_config(&hspi, SPI1, SPI_DFF_8BITS);
+    SPI_Init(&hspi);
+    SPI1->SR = SPI_SR_IDLE;
+    memset(rx, 0, sizeof(rx));
+    check(!SPI_TransferDMA(&hspi, tx, rx, 0), "empty block refused");
+    check(SPI_TransferDMA(&hspi, tx, rx, 200), "200-byte block started");
+    check(SPI_Busy(&hspi) && !SPI_TransferDMA(&hspi, tx, rx, 10), "busy, second block refused");
+    check(SPI1->CR2 == ((1U << SPI_CR2_RXDMAEN) | (1U << SPI_CR2_TXDMAEN)), "RXDMAEN and TXDMAEN set");
+    check(DMA2->S[0].PAR == SPI1_BASEADDR + 0x0C && DMA2->S[3].PAR == SPI1_BASEADDR + 0x0C,
+          "both streams point at SPI1->DR");
+    check(DMA2->S[0].NDTR == 200 && DMA2->S[3].NDTR == 200, "NDTR = 200 frames on both streams");
+    check((DMA2->S[0].CR >> DMA_SCR_CHSEL) == 3 && ((DMA2->S[0].CR >> DMA_SCR_DIR) & 3U) == 0
+          && ((DMA2->S[0].CR >> DMA_SCR_PL) & 3U) == 2 && (DMA2->S[0].CR & (1U << DMA_SCR_TCIE)),
+          "RX stream: channel 3, periph-to-mem, high priority, TCIE");
+    check(((DMA2->S[3].CR >> DMA_SCR_DIR) & 3U) == 1 && (DMA2->S[3].CR & (1U << DMA_SCR_MINC))
+          && !(DMA2->S[3].CR & (1U << DMA_SCR_TCIE)),
+          "TX stream: mem-to-periph, MINC, no TCIE");
+    run_spi_dma(0);
+    check(memcmp(rx, tx, 200) == 0 && xfer_cmplt == 1, "block looped back, one completion callback");
+    check(!SPI_Busy(&hspi) && SPI1->CR2 == 0 && DMA2->S[0].CR == 0 && DMA2->S[3].CR == 0,
+          "idle, DMA requests and streams off");
+    
+    check(SPI_TransferDMA(&hspi, tx, NULL, 50), "transmit-only block started");
+    check(!(DMA2->S[0].CR & (1U << DMA_SCR_MINC)) && DMA2->S[0].NDTR == 50,
+          "RX stream still runs, into a fixed dummy sink");
+    run_spi_dma(0);
+    check(xfer_cmplt == 2, "completion after the last frame is received");
+    
+    check(SPI_TransferDMA(&hspi, tx, rx, 64), "block started");
+    run_spi_dma(1);
+    check(xfer_errors == 1 && !SPI_Busy(&hspi) && SPI1->CR2 == 0, "TX transfer error aborts the block");
+    
+    spi_config(&hspi, SPI1, SPI_DFF_16BITS);
+    SPI_Init(&hspi);
+    SPI1->SR = SPI_SR_IDLE;
+    memset(rx16, 0, sizeof(rx16));
+    check(SPI_TransferDMA(&hspi, NULL, (uint8_t *)rx16, 20), "16-bit receive-only block started");
+    check(DMA2->S[3].NDTR == 10 && !(DMA2->S[3].CR & (1U << DMA_SCR_MINC))
+          && ((DMA2->S[3].CR >> DMA_SCR_PSIZE) & 3U) == 1 && ((DMA2->S[3].CR >> DMA_SCR_MSIZE) & 3U) == 1,
+          "10 half-word dummy frames from a fixed source");
+    run_spi_dma(0);
+    check(rx16[0] == 0xFFFFU && rx16[9] == 0xFFFFU && rx16[10] == 0 && xfer_cmplt == 3,
+          "10 frames received");
+    
+    // Test 5: Devices and queue setup
+    printf("\n--- Test 5: SPI_DeviceInit / SPI_QueueInit ---\n");
+    static SPI_Transaction_t *queue_slots[8];
+    static SPI_Transaction_t x1, x2, x3, x4, x5, extra[8];
+    static uint8_t rx1[4], rx2[2], rx4[2], rx5[32];
+    static uint16_t tx3[2] = { 0x1234, 0xBEEF }, rx3[2];
+    devs[0] = (SPI_Device_t){ SPI_SCLK_SPEED_DIV8, SPI_DFF_8BITS, SPI_CPOL_LOW, SPI_CPHA_LOW, GPIOB, 6 };
+    devs[1] = (SPI_Device_t){ SPI_SCLK_SPEED_DIV32, SPI_DFF_16BITS, SPI_CPOL_HIGH, SPI_CPHA_HIGH, GPIOC, 7 };
+    devs[2] = (SPI_Device_t){ SPI_SCLK_SPEED_DIV8, SPI_DFF_8BITS, SPI_CPOL_LOW, SPI_CPHA_LOW, GPIOA, 9 };
+    for (int i = 0; i < 3; i++) SPI_DeviceInit(&devs[i]);
+    check(((GPIOB->MODER >> 12) & 3U) == 1 && ((GPIOC->MODER >> 14) & 3U) == 1 && ((GPIOA->MODER >> 18) & 3U) == 1,
+          "CS pins PB6, PC7, PA9 are outputs");
+    check(cs_state() == 0, "all chip selects high (deselected)");
+    spi_config(&hspi, SPI1, SPI_DFF_8BITS);
+    SPI_Init(&hspi);
+    SPI1->SR = SPI_SR_IDLE;
+    check(!SPI_QueueInit(&hspi, queue_slots, 6), "6 slots rejected (not a power of two)");
+    check(SPI_QueueInit(&hspi, queue_slots, 8), "8 slots accepted");
+    check(SPI_QueueIdle(&hspi), "queue idle");
+    
+    // Test 6: Back-to-back transactions on three devices
+    printf("\n--- Test 6: SPI_Submit, several devices ---\n");
+    xact_init(&x1, &devs[0], tx, rx1, 3);
+    xact_init(&x2, &devs[0], tx + 3, rx2, 2);
+    xact_init(&x3, &devs[1], (const uint8_t *)tx3, (uint8_t *)rx3, 4);
+    xact_init(&x4, &devs[2], tx + 5, rx4, 2);
+    xact_init(&x5, &devs[0], tx + 7, rx5, 32);
+    check(SPI_Submit(&hspi, &x1) && SPI_Submit(&hspi, &x2) && SPI_Submit(&hspi, &x3)
+          && SPI_Submit(&hspi, &x4) && SPI_Submit(&hspi, &x5), "five transactions submitted");
+    check(wire_len == 0 && x1.Status == SPI_XACT_QUEUED && x5.Status == SPI_XACT_QUEUED,
+          "SPI_Submit returns before anything is on the bus");
+    check(SPI1->CR2 & (1U << SPI_CR2_TXEIE), "TXEIE set to kick the SPI interrupt");
+    check(!SPI_Submit(&hspi, &x3), "descriptor still queued: resubmit refused");
+    run_spi_bus();
+    check(done_count == 5 && done_order[0] == &x1 && done_order[1] == &x2 && done_order[2] == &x3
+          && done_order[3] == &x4 && done_order[4] == &x5, "all done, in submission order");
+    check(x1.Status == SPI_XACT_DONE && x5.Status == SPI_XACT_DONE, "status DONE");
+    check(memcmp(rx1, tx, 3) == 0 && memcmp(rx2, tx + 3, 2) == 0 && memcmp(rx3, tx3, 4) == 0
+          && memcmp(rx4, tx + 5, 2) == 0 && memcmp(rx5, tx + 7, 32) == 0, "every transaction looped back");
+    check(wire_len == 3 + 2 + 2 + 2 + 32, "41 frames on the wire (x3: two 16-bit frames)");
+    check(hspi.Reconfigs == 2, "CR1 rewritten twice: A->B and B->C; A->A and C->A skipped");
+    uint8_t cs_ok = 1, cr1_ok = 1;
+    for (uint32_t i = 0; i < wire_len; i++) {
+        uint8_t want = (i < 5 || i >= 9) ? 1U : (i < 7 ? 2U : 4U);
+        if (wire[i].cs_low != want) cs_ok = 0;
+        if (want == 2U && (wire[i].cr1 & 0x0FFFU) != ((1U << SPI_CR1_DFF) | (4U << SPI_CR1_BR) | (1U << SPI_CR1_CPOL)
+                                                       | (1U << SPI_CR1_CPHA) | (1U << SPI_CR1_MSTR)
+                                                       | (1U << SPI_CR1_SSM) | (1U << SPI_CR1_SSI) | (1U << SPI_CR1_SPE)))
+            cr1_ok = 0;
+        if (want != 2U && (wire[i].cr1 & ((1U << SPI_CR1_DFF) | (7U << SPI_CR1_BR) | 3U)) != (2U << SPI_CR1_BR))
+            cr1_ok = 0;
+    }
+    check(cs_ok, "each frame sent with only its device's CS low");
+    check(cr1_ok, "each frame sent with its device's BR/CPOL/CPHA/DFF");
+    check(wire[9].frame == tx[7] && wire[40].frame == tx[38], "32-byte transaction went by DMA");
+    check(cs_state() == 0 && SPI_QueueIdle(&hspi) && SPI1->CR2 == 0, "idle: CS high, interrupts off");
+    check(hspi.SPIConfig.SPI_DFF == SPI_DFF_8BITS && hspi.SclkHz == 2000000U, "SPIConfig/SclkHz follow device A");
+    
+    // Test 7: Full queue, chained submission and overrun
+    printf("\n--- Test 7: Queue full, chaining, overrun ---\n");
+    done_count = 0;
+    wire_len = 0;
+    uint32_t queued = 0;
+    for (int i = 0; i < 8; i++) {
+        xact_init(&extra[i], &devs[i % 3], tx + i, NULL, 2);
+        queued += SPI_Submit(&hspi, &extra[i]);
+    }
+    xact_init(&x1, &devs[0], tx, rx1, 1);
+    check(queued == 8 && !SPI_Submit(&hspi, &x1), "8 queued, 9th refused (queue full)");
+    run_spi_bus();
+    check(done_count == 8 && wire_len == 13 && SPI_QueueIdle(&hspi),
+          "8 transmit-only transactions, 13 frames (B: one 16-bit)");
+    
+    done_count = 0;
+    xact_init(&x1, &devs[1], NULL, (uint8_t *)rx3, 4);
+    xact_init(&x2, &devs[0], tx, rx2, 2);
+    xact_init(&x5, &devs[2], tx, NULL, 3);
+    x1.pContext = &x2;  // x1's callback chains x2
+    memset(rx3, 0, sizeof(rx3));
+    check(SPI_Submit(&hspi, &x1) && SPI_Submit(&hspi, &x5), "transaction with a chained follow-up, then another");
+    run_spi_bus();
+    check(done_count == 3 && done_order[1] == &x2 && done_order[2] == &x5 && x2.Status == SPI_XACT_DONE,
+          "chained follow-up runs ahead of the queued transaction");
+    check(x1.pNext == NULL && SPI_QueueIdle(&hspi), "chain link consumed by the driver");
+    check(rx3[0] == 0xFFFFU && rx3[1] == 0xFFFFU, "receive-only: 16-bit dummy frames clocked out");
+    
+    done_count = 0;
+    xact_init(&x3, &devs[0], tx, rx1, 4);
+    xact_init(&x4, &devs[2], tx, rx4, 2);
+    SPI_Submit(&hspi, &x3);
+    SPI_Submit(&hspi, &x4);
+    inject_ovr = 1;
+    run_spi_bus();
+    check(x3.Status == SPI_XACT_ERROR && x4.Status == SPI_XACT_DONE && done_count == 2,
+          "overrun aborts one transaction, the next still runs");
+    check(cs_state() == 0 && SPI_QueueIdle(&hspi), "CS released after the error");
+    printf("  (%lu SPI interrupts in total)\n", (unsigned long)spi_irqs);
+    
+    return sim_test_result("SPI Driver");
+}
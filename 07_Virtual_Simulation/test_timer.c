@@ -0,0 +1,455 @@
+/*
+ * test_timer.c - Host test of the timer driver (drivers/src/stm32f446re_timer_driver.c)
+ * on the shadow registers. A counter model stands in for TIM2-TIM5: it
+ * advances CNT event by event, raises UIF at the wrap (and stops a
+ * one-pulse counter there) and CCxIF on compare matches, applies EGR
+ * (UG, CCxG), and calls TIM_IRQHandling whenever an enabled flag is set.
+ * SR is write-0-to-clear through a write hook, so the driver sees the
+ * same flags it would on the chip. The software timer tests check
+ * expiry order and exact deadlines across 16-bit counter wraps, and count
+ * the interrupts the tickless service takes against a 1 ms tick.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "stm32f446re_timer_driver.h"
+#include "sim_mmio.h"
+#include "sim_test.h"
+
+// Counter model of one timer
+typedef struct {
+    TIM_Handle_t *h;
+    uint32_t sr;      // Flags, cleared only by writing 0
+    uint32_t cnt;
+    uint32_t ug_writes;
+    uint64_t ticks;   // Counter ticks since the test started
+    uint32_t irqs;    // TIM_IRQHandling calls
+} tim_model_t;
+
+static TIM_Handle_t htim[4];
+static tim_model_t models[4];
+
+static uint32_t events[5];  // Callback events, by TIM_EVENT_*
+static uint32_t event_cnt[5];
+
+static void on_tim_event(TIM_Handle_t *pTIMHandle, uint8_t event) {
+    if (event < 5) {
+        events[event]++;
+        event_cnt[event] = pTIMHandle->pTIMx->CNT;
+    }
+}
+
+// Driver store to a timer register: SR bits written 0 clear, EGR.UG
+// restarts the counter, EGR.CCxG raises CCxIF; everything else is plain
+// memory
+static void tim_write_hook(void *ctx, uint32_t offset, uint32_t old_value, uint32_t new_value) {
+    tim_model_t *m = (tim_model_t *)ctx;
+    (void)old_value;
+    
+    switch (offset) {
+        case offsetof(TIM_RegDef_t, SR):
+            m->sr &= new_value;
+            break;
+        case offsetof(TIM_RegDef_t, EGR):
+            if (new_value & (1U << TIM_EGR_UG)) {
+                m->cnt = 0;  // URS: no UIF
+                m->ug_writes++;
+            }
+            m->sr |= new_value & 0x1EU;
+            break;
+        case offsetof(TIM_RegDef_t, CNT):
+            m->cnt = new_value;
+            break;
+        default:
+            break;
+    }
+}
+
+static void tim_refresh(void *ctx, volatile uint32_t *regs) {
+    tim_model_t *m = (tim_model_t *)ctx;
+    
+    regs[offsetof(TIM_RegDef_t, SR) / 4] = m->sr;
+    regs[offsetof(TIM_RegDef_t, EGR) / 4] = 0;
+    regs[offsetof(TIM_RegDef_t, CNT) / 4] = m->cnt;
+}
+
+static uint8_t channel_is_output(TIM_RegDef_t *t, uint32_t ch) {
+    uint32_t ccmr = ch < 2 ? t->CCMR1 : t->CCMR2;
+    return ((ccmr >> ((ch & 1U) * 8U)) & 3U) == 0;
+}
+
+// Run the handler while an enabled flag is set
+static void tim_poll(tim_model_t *m) {
+    TIM_RegDef_t *t = m->h->pTIMx;
+    
+    for (uint32_t guard = 0; guard < 1000; guard++) {
+        if (!(m->sr & t->DIER & 0x1FU)) return;
+        m->irqs++;
+        TIM_IRQHandling(m->h);
+    }
+    sim_test_fail("tim_poll: interrupt storm");
+}
+
+// Let the counter run for n ticks (while CEN is set)
+static void tim_run(tim_model_t *m, uint64_t n) {
+    TIM_RegDef_t *t = m->h->pTIMx;
+    
+    tim_poll(m);
+    while (n > 0 && (t->CR1 & (1U << TIM_CR1_CEN))) {
+        uint32_t arr = t->ARR;
+        uint64_t step = (uint64_t)arr - m->cnt + 1U;  // To the wrap
+        uint64_t c;
+    
+        for (uint32_t ch = 0; ch < 4; ch++) {
+            uint32_t ccr = t->CCR[ch];
+            uint64_t d;
+            if (!channel_is_output(t, ch) || ccr > arr) continue;
+            d = ccr > m->cnt ? (uint64_t)ccr - m->cnt : (uint64_t)arr + 1U - m->cnt + ccr;
+            if (d < step) step = d;
+        }
+        if (n < step) step = n;
+        n -= step;
+        m->ticks += step;
+        c = m->cnt + step;
+        if (c > arr) {
+            c = 0;
+            m->sr |= (1U << TIM_SR_UIF);
+            if (t->CR1 & (1U << TIM_CR1_OPM)) t->CR1 &= ~(1U << TIM_CR1_CEN);
+        }
+        m->cnt = (uint32_t)c;
+        for (uint32_t ch = 0; ch < 4; ch++) {
+            if (channel_is_output(t, ch) && t->CCR[ch] == m->cnt) m->sr |= (1U << (TIM_SR_CC1IF + ch));
+        }
+        SimMMIO_Sync();
+        tim_poll(m);
+    }
+}
+
+static tim_model_t *tim_setup(uint32_t i, TIM_RegDef_t *t, uint32_t period_us, uint32_t tick_hz, uint8_t one_pulse,
+                              uint8_t update_it) {
+    TIM_Handle_t *h = &htim[i];
+    
+    memset(h, 0, sizeof(*h));
+    h->pTIMx = t;
+    h->Callback = on_tim_event;
+    h->TIMConfig.TIM_PeriodUs = period_us;
+    h->TIMConfig.TIM_TickHz = tick_hz;
+    h->TIMConfig.TIM_OnePulse = one_pulse;
+    h->TIMConfig.TIM_UpdateIT = update_it;
+    models[i].h = h;
+    return &models[i];
+}
+
+// Software timers: each expiry is logged with the counter tick it ran at
+typedef struct {
+    TIM_SoftTimer_t timer;
+    uint32_t id;
+    uint32_t fired;
+    uint64_t last_tick;
+    uint64_t start_tick;
+    uint64_t max_error;
+    TIM_SoftTimer_t *stop_other;  // Stopped from this timer's callback
+} soft_t;
+
+static tim_model_t *soft_model;
+static uint32_t fire_order[16];
+static uint32_t fire_count = 0;
+
+static void on_soft_timer(TIM_SoftTimer_t *pTimer) {
+    soft_t *s = (soft_t *)pTimer->pContext;
+    uint64_t expected;
+    
+    s->fired++;
+    s->last_tick = soft_model->ticks;
+    if (s->timer.PeriodTicks != 0) {
+        expected = s->start_tick + (uint64_t)s->fired * s->timer.PeriodTicks;
+        uint64_t err = s->last_tick > expected ? s->last_tick - expected : expected - s->last_tick;
+        if (err > s->max_error) s->max_error = err;
+    }
+    if (fire_count < 16) fire_order[fire_count++] = s->id;
+    if (s->stop_other != NULL) TIM_SoftTimerStop(soft_model->h, s->stop_other);
+}
+
+static void soft_init(soft_t *s, uint32_t id) {
+    memset(s, 0, sizeof(*s));
+    s->id = id;
+    s->timer.Fn = on_soft_timer;
+    s->timer.pContext = s;
+}
+
+int main(void) {
+    tim_model_t *m;
+    TIM_Handle_t *h;
+    
+    printf("=== Timer Driver Test ===\n\n");
+    
+    if (!SimMMIO_Init()) return 1;
+    {
+        TIM_RegDef_t *regs[4] = { TIM2, TIM3, TIM4, TIM5 };
+        for (uint32_t i = 0; i < 4; i++) {
+            models[i].h = &htim[i];
+            SimMMIO_AddRegion(MMIO_DEV_ADDR(regs[i]), sizeof(TIM_RegDef_t), tim_write_hook, tim_refresh, &models[i]);
+        }
+    }
+    
+    // Test 1: PSC/ARR from the period and the clock tree (HSI 16 MHz)
+    printf("--- Test 1: TIM_Init ---\n");
+    m = tim_setup(0, TIM2, 1000, 0, TIM_ONE_PULSE_DI, DISABLE);
+    h = m->h;
+    check(TIM_Init(h), "TIM2, 1 ms period");
+    check(TIM2->PSC == 0 && TIM2->ARR == 15999 && h->ClockHz == 16000000U,
+          "1 ms at 16 MHz: PSC 0, ARR 15999");
+    check(RCC->APB1ENR & 1U, "TIM2 clock enabled on APB1");
+    check(TIM2->CR1 == ((1U << TIM_CR1_URS) | (1U << TIM_CR1_ARPE)), "CR1 = URS | ARPE, counter stopped");
+    check(m->ug_writes == 1 && TIM2->SR == 0 && TIM2->DIER == 0, "UG loads PSC, no flag left, no interrupt");
+    
+    m = tim_setup(1, TIM3, 1000000, 0, TIM_ONE_PULSE_DI, DISABLE);
+    check(TIM_Init(m->h) && TIM3->PSC == 249 && TIM3->ARR == 63999,
+          "TIM3 (16-bit), 1 s: exact 250 x 64000, not 245 x 65306");
+    check(m->h->CounterMask == 0xFFFFU && m->h->IRQNumber == IRQ_NO_TIM3, "TIM3 16-bit counter, IRQ 29");
+    m = tim_setup(1, TIM3, 65567, 0, TIM_ONE_PULSE_DI, DISABLE);
+    check(TIM_Init(m->h) && TIM3->PSC == 16 && TIM3->ARR == 61709,
+          "TIM3, 65567 us: 17 x 61710 (2 ticks off), not 173 x 6064");
+    m = tim_setup(3, TIM5, 1000000, 0, TIM_ONE_PULSE_DI, DISABLE);
+    check(TIM_Init(m->h) && TIM5->PSC == 0 && TIM5->ARR == 15999999U, "TIM5 (32-bit), 1 s: PSC 0, ARR 15999999");
+    m = tim_setup(1, TIM3, 0, 1000000, TIM_ONE_PULSE_DI, DISABLE);
+    check(TIM_Init(m->h) && TIM3->PSC == 15 && TIM3->ARR == 0xFFFFU, "TIM3 free-running at 1 MHz: PSC 15, ARR 0xFFFF");
+    check(TIM_UsToTicks(m->h, 1500) == 1500, "TIM_UsToTicks: 1500 us = 1500 ticks at 1 MHz");
+    m = tim_setup(2, TIM4, 300000000U, 0, TIM_ONE_PULSE_DI, DISABLE);
+    check(!TIM_Init(m->h), "TIM4, 300 s period rejected (PSC would exceed 65536)");
+    m = tim_setup(2, TIM4, 0, 40000000U, TIM_ONE_PULSE_DI, DISABLE);
+    check(!TIM_Init(m->h), "tick rate above TIMxCLK rejected");
+    m = tim_setup(2, TIM4, 1000, 1000, TIM_ONE_PULSE_DI, DISABLE);
+    check(!TIM_Init(m->h), "period of one tick rejected");
+    m = tim_setup(2, (TIM_RegDef_t *)USART2, 1000, 0, TIM_ONE_PULSE_DI, DISABLE);
+    check(!TIM_Init(m->h), "non-timer base address rejected");
+    
+    RCC->CFGR |= (4U << RCC_CFGR_PPRE1);  // APB1 = HCLK / 2: TIMxCLK stays 2 x PCLK1
+    m = tim_setup(0, TIM2, 1000, 0, TIM_ONE_PULSE_DI, DISABLE);
+    check(TIM_Init(m->h) && m->h->ClockHz == 16000000U && TIM2->ARR == 15999,
+          "APB1 /2: TIMxCLK = 2 x 8 MHz, same PSC/ARR");
+    RCC->CFGR = (RCC->CFGR & ~(7U << RCC_CFGR_PPRE1)) | (5U << RCC_CFGR_PPRE1);
+    check(TIM_Init(m->h) && m->h->ClockHz == 8000000U && TIM2->ARR == 7999, "APB1 /4: TIMxCLK = 8 MHz, ARR 7999");
+    RCC->CFGR &= ~(7U << RCC_CFGR_PPRE1);
+    
+    // Test 2: periodic and one-pulse update events
+    printf("\n--- Test 2: Update interrupt ---\n");
+    m = tim_setup(0, TIM2, 1000, 0, TIM_ONE_PULSE_DI, ENABLE);
+    TIM_Init(m->h);
+    check(TIM2->DIER == (1U << TIM_DIER_UIE), "UIE enabled by TIM_UpdateIT");
+    memset(events, 0, sizeof(events));
+    TIM_Start(m->h);
+    tim_run(m, 168000);  // 10.5 ms
+    check(events[TIM_EVENT_UPDATE] == 10 && m->irqs == 10, "10 update events in 10.5 ms");
+    check(!(m->sr & (1U << TIM_SR_UIF)), "UIF cleared by the handler each time");
+    TIM_Stop(m->h);
+    
+    m = tim_setup(0, TIM2, 1000, 0, TIM_ONE_PULSE_EN, ENABLE);
+    TIM_Init(m->h);
+    check(TIM2->CR1 & (1U << TIM_CR1_OPM), "one-pulse: OPM set");
+    memset(events, 0, sizeof(events));
+    m->irqs = 0;
+    TIM_Start(m->h);
+    tim_run(m, 80000);  // 5 ms
+    check(events[TIM_EVENT_UPDATE] == 1 && !(TIM2->CR1 & (1U << TIM_CR1_CEN)) && TIM_GetCounter(m->h) == 0,
+          "one update, counter stopped at 0");
+    TIM_Start(m->h);
+    tim_run(m, 80000);
+    check(events[TIM_EVENT_UPDATE] == 2, "TIM_Start gives the next pulse");
+    
+    // Test 3: output compare and PWM
+    printf("\n--- Test 3: Output compare ---\n");
+    m = tim_setup(1, TIM3, 1000, 0, TIM_ONE_PULSE_DI, DISABLE);
+    TIM_Init(m->h);
+    check(TIM_OCConfig(m->h, TIM_CHANNEL_1, TIM_OC_MODE_TOGGLE, 4000), "channel 1 toggle on match at 4000");
+    check(TIM_OCConfig(m->h, TIM_CHANNEL_3, TIM_OC_MODE_PWM1, 8000), "channel 3 PWM1, 50% duty");
+    check(TIM_OCConfig(m->h, TIM_CHANNEL_2, TIM_OC_MODE_TIMING, 12000), "channel 2 compare only");
+    check((TIM3->CCMR1 & 0xFFFFU) == 0x0030U && (TIM3->CCMR2 & 0xFFU) == 0x68U,
+          "CCMR: OC1M toggle, OC2 frozen, OC3M PWM1 + preload");
+    check(TIM3->CCER == ((1U << 0) | (1U << 8)) && TIM3->CCR[0] == 4000 && TIM3->CCR[2] == 8000,
+          "CCER: outputs 1 and 3 enabled, CCR1/CCR3 set");
+    check(!TIM_OCConfig(m->h, 5, TIM_OC_MODE_TOGGLE, 0) && !TIM_OCConfig(m->h, TIM_CHANNEL_4, 8, 0),
+          "bad channel and mode rejected");
+    TIM_ChannelITConfig(m->h, TIM_CHANNEL_1, ENABLE);
+    check(TIM3->DIER == (1U << TIM_DIER_CC1IE), "CC1IE enabled");
+    memset(events, 0, sizeof(events));
+    m->irqs = 0;
+    TIM_Start(m->h);
+    tim_run(m, 48000);  // 3 ms
+    check(events[TIM_EVENT_CC1] == 3 && event_cnt[TIM_EVENT_CC1] == 4000 && m->irqs == 3,
+          "3 CC1 events at CNT 4000, no others enabled");
+    TIM_SetCompare(m->h, TIM_CHANNEL_1, 10000);
+    tim_run(m, 16000);
+    check(events[TIM_EVENT_CC1] == 4 && event_cnt[TIM_EVENT_CC1] == 10000, "TIM_SetCompare moves the match");
+    TIM_Stop(m->h);
+    
+    m = tim_setup(2, TIM4, 1000, 0, TIM_ONE_PULSE_EN, DISABLE);
+    TIM_Init(m->h);
+    check(TIM_OCConfig(m->h, TIM_CHANNEL_1, TIM_OC_MODE_PWM2, 4000) && (TIM4->CCMR1 & 0xFFU) == 0x78U,
+          "one-pulse + PWM2: 750 us pulse after 250 us");
+    
+    // Test 4: input capture
+    printf("\n--- Test 4: Input capture ---\n");
+    m = tim_setup(3, TIM5, 0, 1000000, TIM_ONE_PULSE_DI, DISABLE);
+    TIM_Init(m->h);
+    check(TIM_ICConfig(m->h, TIM_CHANNEL_1, TIM_IC_EDGE_RISING, 0), "channel 1 rising edge");
+    check(TIM_ICConfig(m->h, TIM_CHANNEL_2, TIM_IC_EDGE_BOTH, 3), "channel 2 both edges, filter 3");
+    check(TIM_ICConfig(m->h, TIM_CHANNEL_3, TIM_IC_EDGE_FALLING, 15), "channel 3 falling edge, filter 15");
+    check((TIM5->CCMR1 & 0xFFFFU) == 0x3101U && (TIM5->CCMR2 & 0xFFU) == 0xF1U, "CCMR: CCxS = TIx, ICxF");
+    check((TIM5->CCER & 0xFFFU) == 0x3B1U, "CCER: CC1E, CC2E|CC2P|CC2NP, CC3E|CC3P");
+    check(!TIM_ICConfig(m->h, TIM_CHANNEL_4, 2, 0) && !TIM_ICConfig(m->h, TIM_CHANNEL_4, TIM_IC_EDGE_RISING, 16),
+          "bad edge and filter rejected");
+    TIM_ChannelITConfig(m->h, TIM_CHANNEL_2, ENABLE);
+    memset(events, 0, sizeof(events));
+    TIM5->CCR[1] = 1000;  // Rising edge
+    m->sr |= (1U << (TIM_SR_CC1IF + 1));
+    SimMMIO_Sync();
+    tim_poll(m);
+    check(events[TIM_EVENT_CC2] == 1 && m->h->Capture[1] == 1000, "capture 1000 stored, CC2 event");
+    TIM5->CCR[1] = 1250;  // Falling edge
+    m->sr |= (1U << (TIM_SR_CC1IF + 1));
+    SimMMIO_Sync();
+    tim_poll(m);
+    check(m->h->Capture[1] - 1000 == 250 && m->h->Overcaptures == 0, "pulse width 250 us from two captures");
+    TIM5->CCR[1] = 5678;
+    m->sr |= (1U << (TIM_SR_CC1IF + 1)) | (1U << (TIM_SR_CC1OF + 1));
+    SimMMIO_Sync();
+    tim_poll(m);
+    check(m->h->Overcaptures == 1 && m->sr == 0 && m->h->Capture[1] == 5678, "overcapture counted, CC2OF cleared");
+    
+    // Test 5: software timers on TIM3 channel 4, 1 MHz, 16-bit
+    printf("\n--- Test 5: Software timers (tickless) ---\n");
+    {
+        static soft_t st[8];
+        TIM_SoftTimer_t orphan;
+        uint32_t want[5] = { 2, 4, 3, 1, 5 };
+        uint8_t order_ok = 1;
+    
+        m = tim_setup(1, TIM3, 1000, 0, TIM_ONE_PULSE_DI, DISABLE);
+        TIM_Init(m->h);
+        check(!TIM_SoftTimerInit(m->h, TIM_CHANNEL_4), "timer with a 1 ms period rejected");
+        m = tim_setup(1, TIM3, 0, 1000000, TIM_ONE_PULSE_DI, DISABLE);
+        TIM_Init(m->h);
+        h = m->h;
+        soft_model = m;
+        check(TIM_SoftTimerInit(h, TIM_CHANNEL_4) && !(TIM3->DIER & (1U << (TIM_DIER_CC1IE + 3))),
+              "channel 4 compare-only, interrupt off while idle");
+        check(TIM_SoftTimerMaxTicks(h) == 16383 && TIM_SoftTimerNextTicks(h) == 0xFFFFFFFFU,
+              "max delay a quarter of the 16-bit range, none armed");
+    
+        m->ticks = 0;
+        m->irqs = 0;
+        TIM_Start(h);
+        for (uint32_t i = 0; i < 8; i++) soft_init(&st[i], i + 1);
+        TIM_SoftTimerStart(h, &st[0].timer, 9000, 0);
+        TIM_SoftTimerStart(h, &st[1].timer, 1500, 0);
+        TIM_SoftTimerStart(h, &st[2].timer, 4000, 0);
+        TIM_SoftTimerStart(h, &st[3].timer, 1500, 0);
+        TIM_SoftTimerStart(h, &st[4].timer, 12000, 0);
+        check(TIM3->CCR[3] == 1500 && (TIM3->DIER & (1U << (TIM_DIER_CC1IE + 3))),
+              "5 started out of order: CCR4 = earliest (1500)");
+        check(TIM_SoftTimerNextTicks(h) == 1500, "next expiry in 1500 ticks");
+        memset(&orphan, 0, sizeof(orphan));
+        check(!TIM_SoftTimerStart(h, &orphan, 100, 0), "timer without Fn rejected");
+        check(!TIM_SoftTimerStart(h, &st[5].timer, 16384, 0), "delay beyond the max rejected");
+        fire_count = 0;
+        tim_run(m, 20000);
+        for (uint32_t i = 0; i < 5; i++) {
+            if (fire_order[i] != want[i]) order_ok = 0;
+        }
+        check(fire_count == 5 && order_ok, "expiry order 2, 4 (same deadline, start order), 3, 1, 5");
+        check(st[1].last_tick == 1500 && st[2].last_tick == 4000 && st[0].last_tick == 9000 && st[4].last_tick == 12000,
+              "each expired exactly at its deadline");
+        check(h->SoftIRQs == 4 && m->irqs == 4, "4 compare interrupts for 5 timers (4 deadlines)");
+        check(!(TIM3->DIER & (1U << (TIM_DIER_CC1IE + 3))) && !st[0].timer.Active, "channel interrupt off again");
+    
+        // Periodic across wraps of the 16-bit counter
+        soft_init(&st[0], 1);
+        st[0].start_tick = m->ticks;
+        TIM_SoftTimerStart(h, &st[0].timer, 2500, 2500);
+        soft_init(&st[1], 2);
+        TIM_SoftTimerStart(h, &st[1].timer, 15000, 0);
+        check(TIM_SoftTimerStop(h, &st[1].timer) && !TIM_SoftTimerStop(h, &st[1].timer),
+              "stop a one-shot, second stop returns 0");
+        tim_run(m, 200000);
+        check(st[0].fired == 80 && st[0].max_error == 0, "2.5 ms periodic: 80 expiries over 3 wraps, 0 drift");
+        check(st[1].fired == 0, "stopped timer never runs");
+        TIM_SoftTimerStop(h, &st[0].timer);
+    
+        // Restart moves an armed timer; delay 0 expires without the counter moving
+        soft_init(&st[2], 3);
+        TIM_SoftTimerStart(h, &st[2].timer, 3000, 0);
+        TIM_SoftTimerStart(h, &st[2].timer, 6000, 0);
+        soft_init(&st[3], 4);
+        TIM_SoftTimerStart(h, &st[3].timer, 0, 0);
+        tim_poll(m);
+        check(st[3].fired == 1 && st[3].last_tick == m->ticks, "delay 0: forced compare event (CCxG), runs at once");
+        {
+            uint64_t t0 = m->ticks;
+            tim_run(m, 7000);
+            check(st[2].fired == 1 && st[2].last_tick == t0 + 6000, "restarted timer expires at the new deadline only");
+            check(!TIM_SoftTimerStop(h, &st[2].timer), "stop after a one-shot fired returns 0");
+        }
+    
+        // A callback stopping another timer due at the same time
+        soft_init(&st[4], 5);
+        soft_init(&st[5], 6);
+        st[4].stop_other = &st[5].timer;
+        TIM_SoftTimerStart(h, &st[4].timer, 1000, 0);
+        TIM_SoftTimerStart(h, &st[5].timer, 1000, 0);
+        tim_run(m, 2000);
+        check(st[4].fired == 1 && st[5].fired == 0, "timer stopped from a callback in the same interrupt");
+        TIM_Stop(h);
+    }
+    
+    // Test 6: tickless against a 1 ms tick, TIM2 at 1 MHz (32-bit)
+    printf("\n--- Test 6: Interrupts, tickless vs 1 ms tick ---\n");
+    {
+        static const uint32_t periods_ms[8] = { 7, 11, 13, 17, 19, 23, 29, 31 };
+        static soft_t st[8];
+        uint32_t expiries = 0, instants = 0, fired = 0;
+        uint64_t worst = 0;
+    
+        for (uint32_t ms = 1; ms <= 1000; ms++) {
+            uint8_t any = 0;
+            for (uint32_t i = 0; i < 8; i++) {
+                if (ms % periods_ms[i] == 0) {
+                    expiries++;
+                    any = 1;
+                }
+            }
+            instants += any;
+        }
+    
+        m = tim_setup(0, TIM2, 0, 1000000, TIM_ONE_PULSE_DI, DISABLE);
+        TIM_Init(m->h);
+        h = m->h;
+        soft_model = m;
+        TIM_SoftTimerInit(h, TIM_CHANNEL_1);
+        m->ticks = 0;
+        m->irqs = 0;
+        TIM_Start(h);
+        for (uint32_t i = 0; i < 8; i++) {
+            soft_init(&st[i], i + 1);
+            st[i].start_tick = 0;
+            TIM_SoftTimerStart(h, &st[i].timer, TIM_UsToTicks(h, periods_ms[i] * 1000U),
+                               TIM_UsToTicks(h, periods_ms[i] * 1000U));
+        }
+        tim_run(m, 1000000);
+        for (uint32_t i = 0; i < 8; i++) {
+            fired += st[i].fired;
+            if (st[i].max_error > worst) worst = st[i].max_error;
+        }
+        printf("  8 periodic timers (7-31 ms) for 1 s: %lu expiries at %lu instants\n",
+               (unsigned long)expiries, (unsigned long)instants);
+        printf("  1 ms tick: 1000 interrupts; tickless: %lu interrupts\n", (unsigned long)m->irqs);
+        check(fired == expiries && worst == 0, "every expiry ran, exactly on its deadline");
+        check(h->SoftIRQs == instants && m->irqs == instants, "one interrupt per distinct deadline");
+        check(m->irqs * 2 < 1000, "fewer than half the interrupts of a 1 ms tick");
+    }
+    
+    return sim_test_result("Timer Driver");
+}
@@ -0,0 +1,409 @@
+/*
+ * test_timer_wheel.c - Host test and benchmark of the hierarchical timing
+ * wheel (drivers/src/timer_wheel.c). Unit checks of exact expiry ticks on
+ * every level and across the 32-bit tick wrap, stop/restart from
+ * callbacks, periodic reload and catch-up after missed ticks; a thread
+ * standing in for the tick interrupt; and a benchmark that starts and
+ * expires 100k timers, with the polled pattern of simple_delay.c for
+ * comparison
+ */
+
+#define _POSIX_C_SOURCE 200809L  // pthreads, clock_gettime
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "timer_wheel.h"
+#include "sim_rand.h"
+#include "sim_test.h"
+
+#define BENCH_MAX      100000U
+#define BENCH_SPAN     65536U    // Delays 1..65535 ticks: levels 0-2
+#define POLL_TICKS     200U      // Ticks of the polled-pattern comparison
+#define THREAD_TICKS   200000U
+
+// Timer plus what the test expects of it
+typedef struct {
+    WheelTimer_t timer;
+    uint32_t start;      // Tick it was started at
+    uint32_t due;        // Next expected expiry tick
+    uint32_t fired;
+    uint32_t late;       // Expiries not at the expected tick
+} test_timer_t;
+
+static TimerWheel_t tw;
+static test_timer_t tt[16];
+static double elapsed_ns(const struct timespec *start, const struct timespec *end) {
+    return (double)(end->tv_sec - start->tv_sec) * 1e9 + (double)(end->tv_nsec - start->tv_nsec);
+}
+
+// Expiry: compare the tick being processed with the expected one
+static void on_expire(WheelTimer_t *pTimer) {
+    test_timer_t *t = (test_timer_t *)pTimer;
+    
+    if (tw.Now != t->due) t->late++;
+    t->fired++;
+    t->due += pTimer->PeriodTicks;
+}
+
+static void start(test_timer_t *t, uint32_t delay, uint32_t period) {
+    t->timer.Fn = on_expire;
+    t->start = tw.Ticks;
+    t->due = tw.Ticks + (delay ? delay : 1);
+    TimerWheel_Start(&tw, &t->timer, delay, period);
+}
+
+// Count n ticks, processing after each
+static void run(uint32_t n) {
+    while (n--) {
+        TimerWheel_Tick(&tw);
+        TimerWheel_Process(&tw);
+    }
+}
+
+// Jump the tick count (as if the main loop had been away), then catch up
+static void skip_to(uint32_t tick) {
+    tw.Ticks = tick;
+    TimerWheel_Process(&tw);
+}
+
+// Cascades a timer can take: one per level above 0
+static uint32_t levels_above_root(uint32_t delay) {
+    if (delay < TW_ROOT_SIZE) return 0;
+    return (31U - (uint32_t)__builtin_clz(delay) - TW_ROOT_BITS) / TW_LEVEL_BITS + 1U;
+}
+
+// Callbacks that act on timers: pContext is the partner to stop
+static void on_expire_stop_partner(WheelTimer_t *pTimer) {
+    on_expire(pTimer);
+    TimerWheel_Stop(&tw, (WheelTimer_t *)pTimer->pContext);
+}
+
+static void on_expire_restart(WheelTimer_t *pTimer) {
+    test_timer_t *t = (test_timer_t *)pTimer;
+    
+    on_expire(pTimer);
+    if (t->fired < 3) {
+        t->due = tw.Ticks + 5;
+        TimerWheel_Start(&tw, pTimer, 5, 0);
+    }
+}
+
+static void on_expire_stop_self(WheelTimer_t *pTimer) {
+    test_timer_t *t = (test_timer_t *)pTimer;
+    
+    on_expire(pTimer);
+    if (t->fired == 3) TimerWheel_Stop(&tw, pTimer);
+}
+
+// Timers restarted while the tick thread runs: expiry tick set by the wheel
+static uint32_t churn_fired, churn_late, churn_early;
+static void on_churn_expire(WheelTimer_t *pTimer) {
+    if (tw.Now != pTimer->Expires) churn_late++;
+    churn_fired++;
+}
+
+// Tick "interrupt" on its own thread
+static volatile int tick_thread_done = 0;
+static void *tick_thread(void *arg) {
+    (void)arg;
+    for (uint32_t i = 0; i < THREAD_TICKS; i++) {
+        TimerWheel_Tick(&tw);
+        if ((i & 63U) == 0) sched_yield();
+    }
+    __atomic_store_n(&tick_thread_done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+// Benchmark timers
+static test_timer_t *bench;
+static uint32_t bench_late;
+static void on_bench_expire(WheelTimer_t *pTimer) {
+    test_timer_t *t = (test_timer_t *)pTimer;
+    
+    if (tw.Now != t->due) bench_late++;
+    t->fired++;
+    t->due += pTimer->PeriodTicks;
+}
+
+int main(void) {
+    printf("=== Timing Wheel Test ===\n");
+    
+    // Test 1: One-shot timers
+    printf("\n--- Test 1: One-shot start, expiry tick, stop ---\n");
+    TimerWheel_Init(&tw);
+    memset(tt, 0, sizeof(tt));
+    start(&tt[0], 10, 0);
+    check(TimerWheel_IsActive(&tt[0].timer) && tw.Active == 1, "started timer is active");
+    check(TimerWheel_Process(&tw) == 0 && TimerWheel_Pending(&tw) == 0, "nothing to do without a tick");
+    run(9);
+    check(tt[0].fired == 0, "not expired after 9 ticks");
+    run(1);
+    check(tt[0].fired == 1 && tt[0].late == 0, "expired at tick 10");
+    check(!TimerWheel_IsActive(&tt[0].timer) && tw.Active == 0, "one-shot inactive after expiry");
+    check(!TimerWheel_Stop(&tw, &tt[0].timer), "stop after expiry reports not running");
+    start(&tt[1], 0, 0);
+    run(1);
+    check(tt[1].fired == 1 && tt[1].late == 0, "delay 0 expires at the next tick");
+    start(&tt[2], 20, 0);
+    run(5);
+    check(TimerWheel_Stop(&tw, &tt[2].timer) && tw.Active == 0, "stop of a running timer");
+    run(30);
+    check(tt[2].fired == 0, "stopped timer never fires");
+    start(&tt[3], 50, 0);
+    run(10);
+    start(&tt[3], 50, 0);
+    run(45);
+    check(tt[3].fired == 0 && tw.Active == 1, "restart pushes the expiry back");
+    run(5);
+    check(tt[3].fired == 1 && tt[3].late == 0, "restarted timer fires 50 ticks after restart");
+    tt[4].timer.Fn = NULL;
+    check(!TimerWheel_Start(&tw, &tt[4].timer, 10, 0), "timer without callback rejected");
+    tt[4].timer.Fn = on_expire;
+    check(!TimerWheel_Start(&tw, &tt[4].timer, TW_MAX_DELAY + 1U, 0), "delay above TW_MAX_DELAY rejected");
+    check(tw.Expired == 3, "Expired counts callbacks");
+    
+    // Test 2: Every level
+    printf("\n--- Test 2: Exact expiry on every level ---\n");
+    {
+        static const uint32_t delays[] = { 1, 255, 256, 257, 16383, 16384, 16385, 20000,
+                                           1U << 20, (1U << 20) + 123, (1U << 26) + 77 };
+        const uint32_t n = sizeof(delays) / sizeof(delays[0]);
+        uint32_t late = 0, fired = 0, bound = 0;
+    
+        TimerWheel_Init(&tw);
+        memset(tt, 0, sizeof(tt));
+        for (uint32_t i = 0; i < n; i++) {
+            start(&tt[i], delays[i], 0);
+            bound += levels_above_root(delays[i]);
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            // Up to just before the expiry, then onto it
+            skip_to(tt[i].due - 1U);
+            if (tt[i].fired != 0) late++;
+            run(1);
+            fired += tt[i].fired;
+            late += tt[i].late;
+        }
+        printf("  %lu timers from 1 to %lu ticks, %lu cascades\n", (unsigned long)n,
+               (unsigned long)delays[n - 1], (unsigned long)tw.Cascaded);
+        check(fired == n && late == 0, "each fired exactly at its tick, none early");
+        check(tw.Cascaded <= bound, "each timer moved at most once per level");
+    }
+    
+    // Test 3: Tick counter wrap
+    printf("\n--- Test 3: Across the 32-bit tick wrap ---\n");
+    {
+        static const uint32_t delays[] = { 0x80, 0x100, 0x200, 0x10000, 0x123456 };
+        uint32_t late = 0, fired = 0;
+    
+        TimerWheel_Init(&tw);
+        tw.Ticks = tw.Now = 0xFFFFFF00U;
+        memset(tt, 0, sizeof(tt));
+        for (uint32_t i = 0; i < 5; i++) start(&tt[i], delays[i], 0);
+        start(&tt[5], 0x90, 0x90);
+        skip_to(0xFFFFFF00U + 0x123456U);
+        for (uint32_t i = 0; i < 5; i++) {
+            fired += tt[i].fired;
+            late += tt[i].late;
+        }
+        check(fired == 5 && late == 0, "one-shots exact across the wrap");
+        check(tt[5].fired == 0x123456U / 0x90U && tt[5].late == 0, "periodic timer exact across the wrap");
+    }
+    
+    // Test 4: Periodic
+    printf("\n--- Test 4: Periodic reload ---\n");
+    TimerWheel_Init(&tw);
+    memset(tt, 0, sizeof(tt));
+    start(&tt[0], 7, 7);
+    start(&tt[1], 3, 1000);
+    start(&tt[2], 300, 300);
+    tt[3].timer.Fn = on_expire_stop_self;
+    tt[3].due = 11;
+    TimerWheel_Start(&tw, &tt[3].timer, 11, 11);
+    run(10000);
+    check(tt[0].fired == 1428 && tt[0].late == 0, "period 7: 1428 expiries in 10000 ticks, no drift");
+    check(tt[1].fired == 10 && tt[1].late == 0, "delay 3, period 1000: first after 3 ticks");
+    check(tt[2].fired == 33 && tt[2].late == 0, "period 300 (level 1) reloads exactly");
+    check(tt[3].fired == 3 && !TimerWheel_IsActive(&tt[3].timer), "periodic timer stopped from its callback");
+    check(tw.Active == 3, "Active counts the periodic timers still running");
+    
+    // Test 5: Callbacks acting on timers
+    printf("\n--- Test 5: Stop and restart from callbacks ---\n");
+    TimerWheel_Init(&tw);
+    memset(tt, 0, sizeof(tt));
+    // Same tick, each stops the other: whichever runs first wins
+    tt[0].timer.Fn = tt[1].timer.Fn = on_expire_stop_partner;
+    tt[0].timer.pContext = &tt[1].timer;
+    tt[1].timer.pContext = &tt[0].timer;
+    tt[0].due = tt[1].due = 40;
+    TimerWheel_Start(&tw, &tt[0].timer, 40, 0);
+    TimerWheel_Start(&tw, &tt[1].timer, 40, 0);
+    run(40);
+    check(tt[0].fired + tt[1].fired == 1, "timer stopped by a same-tick timer does not fire");
+    check(tw.Active == 0, "both inactive afterwards");
+    tt[2].timer.Fn = on_expire_restart;
+    tt[2].due = tw.Ticks + 5;
+    TimerWheel_Start(&tw, &tt[2].timer, 5, 0);
+    run(100);
+    check(tt[2].fired == 3 && tt[2].late == 0, "one-shot restarted from its callback, 3 times");
+    
+    // Test 6: Catch-up
+    printf("\n--- Test 6: Catch-up after missed ticks ---\n");
+    TimerWheel_Init(&tw);
+    memset(tt, 0, sizeof(tt));
+    for (uint32_t i = 0; i < 8; i++) start(&tt[i], 1 + i * 45, 0);
+    start(&tt[8], 4, 4);
+    for (uint32_t i = 0; i < 400; i++) TimerWheel_Tick(&tw);
+    check(TimerWheel_Pending(&tw) == 400 && tt[0].fired == 0, "ticks only counted until Process");
+    {
+        uint32_t ran = TimerWheel_Process(&tw);
+        uint32_t late = 0;
+        for (uint32_t i = 0; i < 9; i++) late += tt[i].late;
+        check(ran == 8 + 100 && late == 0, "Process replays 400 ticks, each expiry at its own tick");
+    }
+    check(TimerWheel_Pending(&tw) == 0, "nothing pending afterwards");
+    start(&tt[0], 10, 0);
+    for (uint32_t i = 0; i < 3; i++) TimerWheel_Tick(&tw);
+    tt[0].due = tw.Ticks + 10;
+    TimerWheel_Start(&tw, &tt[0].timer, 10, 0);
+    run(10);
+    check(tt[0].fired == 2 && tt[0].late == 0, "delay counts from the latest tick, not the processed one");
+    
+    // Test 7: Tick on another thread
+    printf("\n--- Test 7: Tick from a second thread (%u ticks) ---\n", THREAD_TICKS);
+    {
+        static const uint32_t periods[] = { 1, 3, 17, 256, 1000, 4099 };
+        SimRand rng;
+        uint32_t late = 0, churn = 0;
+        pthread_t tick;
+    
+        TimerWheel_Init(&tw);
+        memset(tt, 0, sizeof(tt));
+        SimRand_Seed(&rng, 7);
+        for (uint32_t i = 0; i < 6; i++) start(&tt[i], periods[i], periods[i]);
+        pthread_create(&tick, NULL, tick_thread, NULL);
+        while (!__atomic_load_n(&tick_thread_done, __ATOMIC_ACQUIRE) || TimerWheel_Pending(&tw)) {
+            if (TimerWheel_Pending(&tw) == 0) {
+                sched_yield();
+                continue;
+            }
+            TimerWheel_Process(&tw);
+            // Churn: restart or stop a one-shot while ticks keep arriving
+            test_timer_t *t = &tt[6 + SimRand_Below(&rng, 10)];
+            if (SimRand_Below(&rng, 4) == 0) {
+                TimerWheel_Stop(&tw, &t->timer);
+            } else {
+                uint32_t before = __atomic_load_n(&tw.Ticks, __ATOMIC_ACQUIRE);
+                uint32_t delay = 1U + SimRand_Below(&rng, 500);
+                t->timer.Fn = on_churn_expire;
+                TimerWheel_Start(&tw, &t->timer, delay, 0);
+                if (t->timer.Expires - before < delay) churn_early++;
+                churn++;
+            }
+        }
+        pthread_join(tick, NULL);
+        for (uint32_t i = 0; i < 6; i++) late += tt[i].late;
+        printf("  %lu restarts and stops from the main loop, %lu churn expiries\n",
+               (unsigned long)churn, (unsigned long)churn_fired);
+        check(tw.Now == THREAD_TICKS, "every tick processed");
+        check(tt[0].fired == THREAD_TICKS && tt[5].fired == THREAD_TICKS / 4099U,
+              "periodic expiry counts exact");
+        check(late == 0 && churn_late == 0, "no expiry off its tick");
+        check(churn_early == 0, "delays count from the tick current at start");
+    }
+    
+    // Test 8: Benchmark
+    printf("\n--- Test 8: Benchmark, random delays 1-%u ticks ---\n", BENCH_SPAN - 1U);
+    bench = calloc(BENCH_MAX, sizeof(*bench));
+    if (bench == NULL) return 1;
+    printf("  expire ns: all %u ticks processed, per timer fired; cascades per timer\n", BENCH_SPAN);
+    printf("  %8s %12s %12s %14s %12s\n", "timers", "start ns", "stop ns", "expire ns", "cascades");
+    for (uint32_t n = 1000; n <= BENCH_MAX; n *= 10) {
+        SimRand rng;
+        struct timespec t0, t1, t2, t3;
+        uint32_t fired = 0, stopped = 0;
+    
+        TimerWheel_Init(&tw);
+        memset(bench, 0, n * sizeof(*bench));
+        SimRand_Seed(&rng, n);
+        for (uint32_t i = 0; i < n; i++) {
+            bench[i].timer.Fn = on_bench_expire;
+            bench[i].due = 1U + SimRand_Below(&rng, BENCH_SPAN - 1U);
+        }
+        bench_late = 0;
+    
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (uint32_t i = 0; i < n; i++)
+            TimerWheel_Start(&tw, &bench[i].timer, bench[i].due, 0);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        // Stop every tenth: a response arrived before its timeout
+        for (uint32_t i = 0; i < n; i += 10)
+            stopped += TimerWheel_Stop(&tw, &bench[i].timer);
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+        for (uint32_t i = 0; i < BENCH_SPAN; i++) {
+            TimerWheel_Tick(&tw);
+            TimerWheel_Process(&tw);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t3);
+    
+        for (uint32_t i = 0; i < n; i++) fired += bench[i].fired;
+        printf("  %8lu %12.1f %12.1f %14.1f %12.2f\n", (unsigned long)n,
+               elapsed_ns(&t0, &t1) / n, elapsed_ns(&t1, &t2) / stopped,
+               elapsed_ns(&t2, &t3) / (n - stopped), (double)tw.Cascaded / n);
+        if (n == BENCH_MAX) {
+            check(fired == n - stopped && bench_late == 0, "100k timers: all but the stopped fired, on their tick");
+            check(tw.Active == 0 && tw.Expired == n - stopped, "wheel empty afterwards");
+            check(tw.Cascaded <= 2U * n, "at most 2 cascades per timer (delays below 2^16)");
+        }
+    }
+    
+    // The polled pattern of demonstrate_non_blocking_delay: every timer checked every tick
+    {
+        struct timespec t0, t1, t2;
+        uint32_t hits = 0;
+    
+        for (uint32_t i = 0; i < BENCH_MAX; i++) bench[i].start = 0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (uint32_t now = 1; now <= POLL_TICKS; now++) {
+            for (uint32_t i = 0; i < BENCH_MAX; i++) {
+                if (now - bench[i].start >= bench[i].due) {
+                    bench[i].start = now;
+                    hits++;
+                }
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+    
+        TimerWheel_Init(&tw);
+        for (uint32_t i = 0; i < BENCH_MAX; i++) {
+            bench[i].fired = 0;
+            TimerWheel_Start(&tw, &bench[i].timer, bench[i].due, bench[i].due);
+        }
+        bench_late = 0;
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        for (uint32_t i = 0; i < POLL_TICKS; i++) {
+            TimerWheel_Tick(&tw);
+            TimerWheel_Process(&tw);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+    
+        double poll_us = elapsed_ns(&t0, &t1) / POLL_TICKS / 1000.0;
+        double wheel_us = elapsed_ns(&t1, &t2) / POLL_TICKS / 1000.0;
+        uint32_t fired = 0;
+        for (uint32_t i = 0; i < BENCH_MAX; i++) fired += bench[i].fired;
+        printf("\n  100k periodic timers for %u ticks (%lu expiries):\n", POLL_TICKS, (unsigned long)fired);
+        printf("  polled (simple_delay.c pattern) %8.1f us/tick\n", poll_us);
+        printf("  timing wheel                    %8.2f us/tick\n", wheel_us);
+        check(fired == hits && bench_late == 0, "wheel and polling agree on every expiry");
+        check(wheel_us < poll_us, "wheel tick cheaper than polling every timer");
+    }
+    free(bench);
+    
+    return sim_test_result("Timing Wheel");
+}
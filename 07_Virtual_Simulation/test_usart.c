@@ -0,0 +1,374 @@
+/*
+ * test_usart.c - Host test of the USART driver's non-blocking transmit
+ * and circular DMA reception (drivers/src/stm32f446re_usart_driver.c) on
+ * the shadow registers. The test stands in for the USART2 transmitter and
+ * DMA1 stream 6: bytes written to DR or handed to the stream appear on a
+ * captured "wire". On the RX side it plays DMA1 stream 5 and the receiver,
+ * writing bytes into the ring storage and raising HT/TC/IDLE. The last
+ * tests cover USART_Init: clock tree readout, BRR rounding and OVER8, the
+ * port table, and the polling/IT/DMA modes behind USART_Send/USART_Receive.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "stm32f446re_usart_driver.h"
+#include "stm32f446re_rcc_driver.h"
+#include "sim_nvic.h"
+#include "sim_mmio.h"
+#include "sim_test.h"
+
+#define TX_RING_SIZE  256U
+#define RX_RING_SIZE  64U
+#define DR_IDLE       0xFFFFFFFFU  // Never a data value: DR untouched by the handler
+
+static uint8_t tx_storage[TX_RING_SIZE];
+static uint8_t rx_storage[RX_RING_SIZE];
+static USART_Handle_t huart;
+
+static uint8_t wire[4096];
+static uint32_t wire_len = 0;
+static uint32_t usart_irqs = 0;
+static uint32_t dma_irqs = 0;
+static uint32_t tx_cmplt = 0;
+static uint32_t tx_errors = 0;
+static uint32_t rx_irqs = 0;
+static uint32_t rx_data_events = 0;
+static uint32_t rx_idle_events = 0;
+static uint32_t rx_overrun_events = 0;
+static uint32_t rx_errors = 0;
+
+static void on_usart_event(USART_Handle_t *pUSARTHandle, uint8_t event) {
+    (void)pUSARTHandle;
+    if (event == USART_EVENT_TX_CMPLT) tx_cmplt++;
+    if (event == USART_EVENT_TX_ERROR) tx_errors++;
+    if (event == USART_EVENT_RX_DATA) rx_data_events++;
+    if (event == USART_EVENT_RX_IDLE) rx_idle_events++;
+    if (event == USART_EVENT_RX_OVERRUN) rx_overrun_events++;
+    if (event == USART_EVENT_RX_ERROR) rx_errors++;
+}
+
+// Transmitter: every byte written to DR is on the wire at once, so TXE and
+// TC read 1 whenever the handler runs. Runs until the driver has masked
+// both TX interrupts.
+static void run_tx_line(void) {
+    while (USART2->CR1 & ((1U << USART_CR1_TXEIE) | (1U << USART_CR1_TCIE))) {
+        USART2->SR = (1U << USART_SR_TXE) | (1U << USART_SR_TC);
+        USART2->DR = DR_IDLE;
+        usart_irqs++;
+        USART_IRQHandling(&huart);
+        if (USART2->DR != DR_IDLE && wire_len < sizeof(wire)) {
+            wire[wire_len++] = (uint8_t)USART2->DR;
+        }
+    }
+}
+
+// DMA1 stream 6: moves the whole block, then raises TCIF6 (or TEIF6)
+static void run_tx_dma(uint8_t fail) {
+    DMA_Stream_RegDef_t *stream = &DMA1->S[6];
+    uint32_t shift = DMA_FLAG_SHIFT(6);
+    
+    if (!(stream->CR & (1U << DMA_SCR_EN))) return;
+    
+    if (!fail) {
+        memcpy(&wire[wire_len], huart.pTxData, stream->NDTR);
+        wire_len += stream->NDTR;
+        stream->NDTR = 0;
+    }
+    stream->CR &= ~(1U << DMA_SCR_EN);
+    DMA1->ISR[1] = 1U << ((fail ? DMA_FLAG_TEIF : DMA_FLAG_TCIF) + shift);
+    DMA1->IFCR[1] = 0;
+    dma_irqs++;
+    USART_TxDMAIRQHandling(&huart);
+    DMA1->ISR[1] &= ~DMA1->IFCR[1];
+}
+
+// DMA1 stream 5 interrupt with the given HISR flag raised
+static void rx_dma_irq(uint32_t flag) {
+    uint32_t shift = DMA_FLAG_SHIFT(5);
+    
+    DMA1->ISR[1] = 1U << (flag + shift);
+    DMA1->IFCR[1] = 0;
+    rx_irqs++;
+    USART_RxDMAIRQHandling(&huart);
+    DMA1->ISR[1] &= ~DMA1->IFCR[1];
+}
+
+// Receiver plus DMA1 stream 5: each byte lands at offset Size - NDTR,
+// HT fires at half buffer, TC at the end, where circular mode reloads NDTR
+static void rx_feed(const uint8_t *data, uint32_t len) {
+    DMA_Stream_RegDef_t *stream = &DMA1->S[5];
+    
+    for (uint32_t i = 0; i < len; i++) {
+        if (!(stream->CR & (1U << DMA_SCR_EN))) return;
+        rx_storage[RX_RING_SIZE - stream->NDTR] = data[i];
+        stream->NDTR--;
+        if (stream->NDTR == RX_RING_SIZE / 2) {
+            rx_dma_irq(DMA_FLAG_HTIF);
+        } else if (stream->NDTR == 0) {
+            stream->NDTR = RX_RING_SIZE;
+            rx_dma_irq(DMA_FLAG_TCIF);
+        }
+    }
+}
+
+// One character time without a start bit: IDLE interrupt
+static void rx_idle(void) {
+    USART2->SR = 1U << USART_SR_IDLE;
+    rx_irqs++;
+    USART_IRQHandling(&huart);
+    USART2->SR = 0;
+}
+
+int main(void) {
+    static uint8_t block[1000];
+    const char *hello = "Hello, non-blocking UART\r\n";
+    
+    printf("=== USART Non-blocking TX Test ===\n\n");
+    
+    if (!SimMMIO_Init()) return 1;
+    SimMMIO_SetWriteTrap(0);  // USART/DMA are plain shadow memory here
+    
+    // Test 1: Handle setup and NVIC lines
+    printf("--- Test 1: USART_TxInit / USART_IRQConfig ---\n");
+    memset(&huart, 0, sizeof(huart));
+    huart.pUSARTx = USART2;
+    huart.Callback = on_usart_event;
+    check(!USART_TxInit(&huart, tx_storage, 100), "TX ring of 100 bytes rejected (not a power of two)");
+    check(USART_TxInit(&huart, tx_storage, TX_RING_SIZE), "TX ring of 256 bytes accepted");
+    check(huart.pTxDMA == DMA1 && huart.TxStream == 6 && huart.TxChannel == 4,
+          "USART2 TX mapped to DMA1 stream 6, channel 4");
+    check((RCC->AHB1ENR >> 21) & 1U, "DMA1 clock enabled");
+    USART2->CR1 = (1U << USART_CR1_TE) | (1U << USART_CR1_UE);
+    USART_IRQConfig(IRQ_NO_USART2, 3, ENABLE);
+    USART_IRQConfig(IRQ_NO_DMA1_STREAM6, 4, ENABLE);
+    SimMMIO_Sync();
+    check(VirtualNVIC_IsEnabled(IRQ_NO_USART2) && VirtualNVIC_IsEnabled(IRQ_NO_DMA1_STREAM6),
+          "USART2 and DMA1 stream 6 IRQs enabled in the NVIC");
+    
+    // Test 2: Interrupt-driven transmit
+    printf("\n--- Test 2: USART_SendIT ---\n");
+    uint32_t len = (uint32_t)strlen(hello);
+    check(USART_SendIT(&huart, (const uint8_t *)hello, len) == len, "whole string queued");
+    check(wire_len == 0 && (USART2->CR1 & (1U << USART_CR1_TXEIE)),
+          "returns before any byte is sent, TXEIE enabled");
+    check(USART_TxBusy(&huart), "USART_TxBusy while queued");
+    run_tx_line();
+    check(wire_len == len && memcmp(wire, hello, len) == 0, "TXE interrupt sends the string in order");
+    check(tx_cmplt == 1 && !USART_TxBusy(&huart), "one completion callback after TC, then idle");
+    
+    // Test 3: Full ring buffer
+    printf("\n--- Test 3: Ring buffer full ---\n");
+    for (uint32_t i = 0; i < sizeof(block); i++) block[i] = (uint8_t)(i * 7);
+    wire_len = 0;
+    check(USART_SendIT(&huart, block, 300) == TX_RING_SIZE, "300 bytes offered, 256 queued");
+    check(USART_SendIT(&huart, block, 1) == 0, "further bytes refused until TXE drains");
+    run_tx_line();
+    check(wire_len == TX_RING_SIZE && memcmp(wire, block, TX_RING_SIZE) == 0, "queued bytes sent");
+    
+    // Test 4: DMA block transfer
+    printf("\n--- Test 4: USART_SendDMA (1000 bytes) ---\n");
+    DMA_Stream_RegDef_t *stream = &DMA1->S[6];
+    wire_len = 0;
+    tx_cmplt = 0;
+    usart_irqs = 0;
+    check(USART_SendDMA(&huart, block, sizeof(block)), "transfer started");
+    check((stream->CR >> DMA_SCR_CHSEL) == 4 && ((stream->CR >> DMA_SCR_DIR) & 3U) == 1 &&
+          (stream->CR & (1U << DMA_SCR_MINC)) && (stream->CR & (1U << DMA_SCR_EN)),
+          "stream 6: channel 4, memory-to-peripheral, MINC, enabled");
+    check(stream->PAR == USART2_BASEADDR + offsetof(USART_RegDef_t, DR) && stream->NDTR == sizeof(block),
+          "PAR = USART2->DR bus address, NDTR = 1000");
+    check(USART2->CR3 & (1U << USART_CR3_DMAT), "USART2 DMAT set");
+    check(!USART_SendDMA(&huart, block, 10), "second DMA block refused while busy");
+    check(USART_SendIT(&huart, (const uint8_t *)"END", 3) == 3 &&
+          !(USART2->CR1 & (1U << USART_CR1_TXEIE)), "bytes queued during DMA wait, TXEIE off");
+    run_tx_dma(0);
+    check(DMA1->IFCR[1] == (1U << (DMA_FLAG_TCIF + DMA_FLAG_SHIFT(6))), "TCIF6 cleared through HIFCR");
+    check(!(USART2->CR3 & (1U << USART_CR3_DMAT)) && !huart.TxDMABusy, "DMAT cleared, DMA idle");
+    run_tx_line();
+    check(wire_len == sizeof(block) + 3 && memcmp(wire, block, sizeof(block)) == 0 &&
+          memcmp(&wire[sizeof(block)], "END", 3) == 0, "wire: DMA block, then the queued bytes");
+    check(tx_cmplt == 1, "one completion callback for block and queued bytes");
+    printf("  Interrupts: %lu DMA + %lu USART for %lu bytes (IT only: %lu USART)\n",
+           (unsigned long)dma_irqs, (unsigned long)usart_irqs,
+           (unsigned long)wire_len, (unsigned long)wire_len + 2);
+    
+    // Test 5: DMA transfer error
+    printf("\n--- Test 5: DMA transfer error ---\n");
+    wire_len = 0;
+    tx_cmplt = 0;
+    check(USART_SendDMA(&huart, block, 64), "transfer started");
+    run_tx_dma(1);
+    check(tx_errors == 1 && tx_cmplt == 0, "TEIF6 reported as USART_EVENT_TX_ERROR");
+    check(!USART_TxBusy(&huart), "port idle again after the error");
+    
+    // Test 6: Circular RX DMA setup
+    printf("\n--- Test 6: USART_ReceiveDMAStart ---\n");
+    DMA_Stream_RegDef_t *rx_stream = &DMA1->S[5];
+    USART2->CR1 = (1U << USART_CR1_TE) | (1U << USART_CR1_RE) | (1U << USART_CR1_UE);
+    check(!USART_ReceiveDMAStart(&huart, rx_storage, 48), "RX buffer of 48 bytes rejected (not a power of two)");
+    check(USART_ReceiveDMAStart(&huart, rx_storage, RX_RING_SIZE), "RX buffer of 64 bytes accepted");
+    check(huart.pRxDMA == DMA1 && huart.RxStream == 5 && huart.RxChannel == 4,
+          "USART2 RX mapped to DMA1 stream 5, channel 4");
+    check((rx_stream->CR >> DMA_SCR_CHSEL) == 4 && ((rx_stream->CR >> DMA_SCR_DIR) & 3U) == 0 &&
+          (rx_stream->CR & (1U << DMA_SCR_CIRC)) && (rx_stream->CR & (1U << DMA_SCR_MINC)) &&
+          (rx_stream->CR & (1U << DMA_SCR_EN)),
+          "stream 5: channel 4, periph-to-memory, circular, enabled");
+    check((rx_stream->CR & (1U << DMA_SCR_HTIE)) && (rx_stream->CR & (1U << DMA_SCR_TCIE)) &&
+          (rx_stream->CR & (1U << DMA_SCR_TEIE)), "HT, TC and TE interrupts enabled");
+    check(rx_stream->PAR == USART2_BASEADDR + offsetof(USART_RegDef_t, DR) &&
+          rx_stream->M0AR == (uint32_t)(uintptr_t)rx_storage && rx_stream->NDTR == RX_RING_SIZE,
+          "PAR = USART2->DR, M0AR = ring storage, NDTR = 64");
+    check((USART2->CR3 & (1U << USART_CR3_DMAR)) && (USART2->CR1 & (1U << USART_CR1_IDLEIE)),
+          "USART2 DMAR and IDLEIE set");
+    
+    // Test 7: Short frame ended by an idle line
+    printf("\n--- Test 7: Frame shorter than half the buffer ---\n");
+    uint8_t rx_out[RX_RING_SIZE];
+    const char *cmd = "GET status";
+    rx_irqs = 0;
+    rx_feed((const uint8_t *)cmd, 10);
+    check(rx_irqs == 0 && RingBuffer_Count(&huart.RxBuffer) == 0, "no interrupt and nothing published mid-burst");
+    rx_idle();
+    check(rx_idle_events == 1 && huart.RxFrameLen == 10, "IDLE publishes the frame: RX_IDLE, RxFrameLen 10");
+    check(RingBuffer_GetBulk(&huart.RxBuffer, rx_out, sizeof(rx_out)) == 10 && memcmp(rx_out, cmd, 10) == 0,
+          "frame read from the ring in order");
+    rx_idle();
+    check(rx_idle_events == 1, "idle line with no new bytes raises no event");
+    
+    // Test 8: Burst across the half and full buffer points
+    printf("\n--- Test 8: 60-byte burst across HT and TC ---\n");
+    rx_irqs = 0;
+    rx_feed(block, 60);
+    check(rx_data_events == 2, "HT and TC each publish the bytes so far (RX_DATA)");
+    rx_idle();
+    check(rx_idle_events == 2 && huart.RxFrameLen == 60, "IDLE ends the burst: RxFrameLen 60");
+    check(RingBuffer_GetBulk(&huart.RxBuffer, rx_out, sizeof(rx_out)) == 60 && memcmp(rx_out, block, 60) == 0,
+          "60 bytes read across the buffer wrap");
+    check(rx_overrun_events == 0 && huart.RxOverruns == 0, "no overrun");
+    printf("  Interrupts: %lu for %u bytes (RXNE per byte: %u)\n", (unsigned long)rx_irqs, 60U, 60U);
+    
+    // Test 9: Reader too slow
+    printf("\n--- Test 9: RX overrun ---\n");
+    rx_feed(&block[100], 100);
+    rx_idle();
+    check(rx_overrun_events != 0 && huart.RxOverruns == rx_overrun_events,
+          "each lap over unread bytes reported as RX_OVERRUN");
+    check(huart.RxFrameLen == 100, "burst length still counts every byte");
+    check(RingBuffer_GetBulk(&huart.RxBuffer, rx_out, sizeof(rx_out)) == RX_RING_SIZE &&
+          memcmp(rx_out, &block[200 - RX_RING_SIZE], RX_RING_SIZE) == 0,
+          "reader gets the newest 64 bytes, no stale ones");
+    
+    // Test 10: RX DMA transfer error
+    printf("\n--- Test 10: RX DMA transfer error ---\n");
+    rx_dma_irq(DMA_FLAG_TEIF);
+    check(rx_errors == 1, "TEIF5 reported as USART_EVENT_RX_ERROR");
+    check(!(rx_stream->CR & (1U << DMA_SCR_EN)) && !(USART2->CR3 & (1U << USART_CR3_DMAR)) &&
+          !(USART2->CR1 & (1U << USART_CR1_IDLEIE)), "stream disabled, DMAR and IDLEIE cleared");
+    
+    // Test 11: Clock tree readout
+    printf("\n--- Test 11: RCC_GetPCLK1Value / RCC_GetPCLK2Value ---\n");
+    check(RCC_GetPCLK1Value() == HSI_VALUE && RCC_GetPCLK2Value() == HSI_VALUE,
+          "reset state: HSI, no prescalers, PCLK1 = PCLK2 = 16 MHz");
+    // HSI / 8 * 168 / 4 = 84 MHz on PLL_P, APB1 /2
+    RCC->PLLCFGR = (8U << RCC_PLLCFGR_PLLM) | (168U << RCC_PLLCFGR_PLLN) | (1U << RCC_PLLCFGR_PLLP);
+    RCC->CFGR = (2U << RCC_CFGR_SWS) | (4U << RCC_CFGR_PPRE1);
+    check(RCC_GetSYSCLKValue() == 84000000U, "PLL: SYSCLK 84 MHz");
+    check(RCC_GetPCLK1Value() == 42000000U && RCC_GetPCLK2Value() == 84000000U,
+          "APB1 /2: PCLK1 42 MHz, PCLK2 84 MHz");
+    
+    // Test 12: Baud rate divider
+    printf("\n--- Test 12: USART_ComputeBRR ---\n");
+    int32_t error = 0;
+    check(USART_ComputeBRR(42000000U, 115200U, 0, &error) == 0x16DU && error == -1141,
+          "115200 at 42 MHz: BRR 0x16D, -1141 ppm");
+    check(USART_ComputeBRR(16000000U, 115200U, 0, &error) == 0x8BU && error == -799,
+          "115200 at 16 MHz (HSI): BRR 0x8B, -799 ppm");
+    check(USART_ComputeBRR(42000000U, 3000000U, 0, NULL) == 0, "3 Mbaud at 42 MHz unreachable with 16x");
+    check(USART_ComputeBRR(42000000U, 3000000U, 1, &error) == 0x16U && error == 0,
+          "3 Mbaud at 42 MHz with 8x: BRR 0x16 (fraction 3 bits)");
+    
+    // Test 13: USART_Init from the port table
+    printf("\n--- Test 13: USART_Init (USART6, 10.5 Mbaud, DMA) ---\n");
+    static uint8_t u6_tx[64], u6_rx[64];
+    static USART_Handle_t hu6;
+    memset(&hu6, 0, sizeof(hu6));
+    hu6.pUSARTx = USART6;
+    hu6.USART_Config.USART_Mode = USART_MODE_TXRX;
+    hu6.USART_Config.USART_Baud = 10500000U;
+    hu6.USART_Config.USART_Oversampling = USART_OVERSAMPLING_16;
+    hu6.USART_Config.USART_TxMode = USART_XFER_DMA;
+    hu6.USART_Config.USART_RxMode = USART_XFER_DMA;
+    hu6.USART_Config.pTxStorage = u6_tx;
+    hu6.USART_Config.TxStorageSize = sizeof(u6_tx);
+    hu6.USART_Config.pRxStorage = u6_rx;
+    hu6.USART_Config.RxStorageSize = sizeof(u6_rx);
+    check(!USART_Init(&hu6), "10.5 Mbaud refused with forced 16x oversampling");
+    hu6.USART_Config.USART_Oversampling = USART_OVERSAMPLING_AUTO;
+    check(USART_Init(&hu6), "accepted with AUTO oversampling");
+    check(USART6->BRR == 0x10U && (USART6->CR1 & (1U << USART_CR1_OVER8)) &&
+          hu6.BaudActual == 10500000U && hu6.BaudErrorPpm == 0,
+          "PCLK2 84 MHz: OVER8, BRR 0x10, exact baud");
+    check((USART6->CR1 & (1U << USART_CR1_TE)) && (USART6->CR1 & (1U << USART_CR1_RE)) &&
+          (USART6->CR1 & (1U << USART_CR1_UE)) && !(USART6->CR1 & (1U << USART_CR1_PCE)),
+          "CR1: TE, RE, UE, no parity");
+    check((RCC->APB2ENR >> 5) & 1U, "USART6 clock enabled on APB2");
+    check(((GPIOC->MODER >> 12) & 0xFU) == 0xAU && ((GPIOC->AFR[0] >> 24) & 0xFFU) == 0x88U,
+          "PC6/PC7 in alternate function 8");
+    check(hu6.pTxDMA == DMA2 && hu6.TxStream == 6 && hu6.TxChannel == 5 &&
+          hu6.pRxDMA == DMA2 && hu6.RxStream == 1 && hu6.RxChannel == 5 && ((RCC->AHB1ENR >> 22) & 1U),
+          "DMA2: TX stream 6, RX stream 1, channel 5, clock on");
+    check((DMA2->S[1].CR & (1U << DMA_SCR_CIRC)) && (DMA2->S[1].CR & (1U << DMA_SCR_EN)),
+          "circular RX DMA running");
+    
+    USART_Handle_t hu4;
+    memset(&hu4, 0, sizeof(hu4));
+    hu4.pUSARTx = UART4;
+    hu4.USART_Config.USART_Baud = 115200U;
+    hu4.USART_Config.USART_HWFlowControl = USART_HW_FLOW_CTRL_CTS_RTS;
+    check(!USART_Init(&hu4), "CTS/RTS refused on UART4");
+    
+    // Test 14: One API, three modes
+    printf("\n--- Test 14: USART_Send / USART_Receive modes ---\n");
+    static uint8_t u1_rx[16];
+    static USART_Handle_t hu1;
+    uint8_t rx_byte = 0;
+    memset(&hu1, 0, sizeof(hu1));
+    hu1.pUSARTx = USART1;
+    hu1.USART_Config.USART_Mode = USART_MODE_TXRX;
+    hu1.USART_Config.USART_Baud = 115200U;
+    hu1.USART_Config.USART_WordLength = USART_WORDLEN_9BITS;
+    hu1.USART_Config.USART_ParityControl = USART_PARITY_EN_ODD;
+    hu1.USART_Config.USART_NoOfStopBits = USART_STOPBITS_2;
+    hu1.USART_Config.USART_TxMode = USART_XFER_POLL;
+    hu1.USART_Config.USART_RxMode = USART_XFER_IT;
+    hu1.USART_Config.pRxStorage = u1_rx;
+    hu1.USART_Config.RxStorageSize = sizeof(u1_rx);
+    check(USART_Init(&hu1) && USART1->BRR == 0x2D9U && hu1.BaudErrorPpm == 228,
+          "USART1 at PCLK2 84 MHz: BRR 0x2D9, +228 ppm");
+    check((USART1->CR1 & (1U << USART_CR1_M)) && (USART1->CR1 & (1U << USART_CR1_PS)) &&
+          ((USART1->CR2 >> USART_CR2_STOP) & 3U) == 2U, "9-bit word, odd parity, 2 stop bits");
+    USART1->SR = (1U << USART_SR_TXE) | (1U << USART_SR_TC);
+    check(USART_Send(&hu1, (const uint8_t *)"ok", 2) == 2 && USART1->DR == 'k', "POLL: sent, returns when TC is set");
+    check(USART1->CR1 & (1U << USART_CR1_RXNEIE), "IT receive: RXNEIE set");
+    for (uint32_t i = 0; i < sizeof(u1_rx) + 1; i++) {
+        USART1->SR = 1U << USART_SR_RXNE;
+        USART1->DR = 'a' + i;
+        USART_IRQHandling(&hu1);
+    }
+    check(USART_Receive(&hu1, &rx_byte, 1) == 1 && rx_byte == 'a', "RXNE bytes read back through USART_Receive");
+    check(hu1.RxOverruns == 1, "byte arriving into a full buffer counted as overrun");
+    
+    huart.USART_Config.USART_TxMode = USART_XFER_DMA;
+    wire_len = 0;
+    check(USART_Send(&huart, (const uint8_t *)"hi", 2) == 2 && !huart.TxDMABusy, "DMA mode: short block copied, TXE path");
+    run_tx_line();
+    check(USART_Send(&huart, block, 100) == 100 && huart.TxDMABusy, "DMA mode: 100-byte block sent by DMA");
+    run_tx_dma(0);
+    check(wire_len == 102 && memcmp(wire, "hi", 2) == 0 && memcmp(&wire[2], block, 100) == 0,
+          "wire: both blocks in order");
+    
+    return sim_test_result("USART Driver");
+}
@@ -0,0 +1,49 @@
+/*
+ * ring_buffer.h
+ *
+ * Lock-free single-producer/single-consumer byte ring buffer
+ * One side (e.g. a UART RX ISR) only puts, the other (the main loop) only
+ * gets; neither needs to mask interrupts.
+ */
+
+#ifndef INC_RING_BUFFER_H_
+#define INC_RING_BUFFER_H_
+
+#include <stdint.h>
+
+/*
+ * head and tail are free-running: head - tail is the fill level, and
+ * index & mask the slot, so all Size bytes are usable and no modulo is
+ * needed. head is written only by the producer, tail only by the
+ * consumer; both are accessed through RingBuffer_* only.
+ *
+ * A producer that writes the storage itself (circular DMA) publishes with
+ * RingBuffer_Commit and cannot be stopped when the buffer is full. If it
+ * laps the consumer, the consumer skips to the oldest byte still stored.
+ */
+typedef struct
+{
+	uint8_t  *pBuffer;
+	uint32_t Size;			// Power of two
+	uint32_t Mask;			// Size - 1
+	uint32_t Head;			// Producer index (next slot to write)
+	uint32_t Tail;			// Consumer index (next slot to read)
+
+} RingBuffer_t;
+
+// Setup (not thread safe: call before producer and consumer start)
+uint8_t  RingBuffer_Init(RingBuffer_t *pRB, uint8_t *pStorage, uint32_t Size);
+void     RingBuffer_Reset(RingBuffer_t *pRB);
+
+// Producer side
+uint8_t  RingBuffer_Put(RingBuffer_t *pRB, uint8_t Data);
+uint32_t RingBuffer_PutBulk(RingBuffer_t *pRB, const uint8_t *pData, uint32_t Len);
+uint32_t RingBuffer_Free(RingBuffer_t *pRB);
+uint8_t  RingBuffer_Commit(RingBuffer_t *pRB, uint32_t Len);
+
+// Consumer side
+uint8_t  RingBuffer_Get(RingBuffer_t *pRB, uint8_t *pData);
+uint32_t RingBuffer_GetBulk(RingBuffer_t *pRB, uint8_t *pData, uint32_t Len);
+uint32_t RingBuffer_Count(RingBuffer_t *pRB);
+
+#endif /* INC_RING_BUFFER_H_ */
@@ -28,19 +28,26 @@
 
 
 #define GPIOA_BASEADDR  ( AHB1_PERIPH_BASEADDR + 0x0000 )
-#define GPIOB_BASEADDR  ( AHB1_PERIPH_BASEADDR + 0x4000 )
-#define GPIOC_BASEADDR  ( AHB1_PERIPH_BASEADDR + 0x8000 )
-#define GPIOD_BASEADDR  ( AHB1_PERIPH_BASEADDR + 0xC000 )
+#define GPIOB_BASEADDR  ( AHB1_PERIPH_BASEADDR + 0x0400 )
+#define GPIOC_BASEADDR  ( AHB1_PERIPH_BASEADDR + 0x0800 )
+#define GPIOD_BASEADDR  ( AHB1_PERIPH_BASEADDR + 0x0C00 )
 #define GPIOE_BASEADDR  ( AHB1_PERIPH_BASEADDR + 0x1000 )
 #define GPIOF_BASEADDR  ( AHB1_PERIPH_BASEADDR + 0x1400 )
 #define GPIOG_BASEADDR  ( AHB1_PERIPH_BASEADDR + 0x1800 )
 #define GPIOH_BASEADDR  ( AHB1_PERIPH_BASEADDR + 0x1C00 )
 #define GPIOI_BASEADDR  ( AHB1_PERIPH_BASEADDR + 0x2000 )
 #define RCC_BASEADDR    ( AHB1_PERIPH_BASEADDR + 0x3800 )
+#define DMA1_BASEADDR   ( AHB1_PERIPH_BASEADDR + 0x6000 )
+#define DMA2_BASEADDR   ( AHB1_PERIPH_BASEADDR + 0x6400 )
 
 
 
 
+#define TIM2_BASEADDR   ( APB1_PERIPH_BASEADDR + 0x0000 )
+#define TIM3_BASEADDR   ( APB1_PERIPH_BASEADDR + 0x0400 )
+#define TIM4_BASEADDR   ( APB1_PERIPH_BASEADDR + 0x0800 )
+#define TIM5_BASEADDR   ( APB1_PERIPH_BASEADDR + 0x0C00 )
+
 #define I2C1_BASEADDR   ( APB1_PERIPH_BASEADDR + 0x5400 )
 #define I2C2_BASEADDR   ( APB1_PERIPH_BASEADDR + 0x5800 )
 #define I2C3_BASEADDR   ( APB1_PERIPH_BASEADDR + 0x5C00 )
@@ -57,8 +64,20 @@
 #define SPI1_BASEADDR   ( APB2_PERIPH_BASEADDR + 0x3000 )
 #define USART1_BASEADDR ( APB2_PERIPH_BASEADDR + 0x1000 )
 #define USART6_BASEADDR ( APB2_PERIPH_BASEADDR + 0x1400 )
-#define EXT1_BASEADDR   ( APB2_PERIPH_BASEADDR + 0x3C00 )
-#define SYSCFC_BASEADDR ( APB2_PERIPH_BASEADDR + 0x3800 )
+#define EXTI_BASEADDR   ( APB2_PERIPH_BASEADDR + 0x3C00 )
+#define SYSCFG_BASEADDR ( APB2_PERIPH_BASEADDR + 0x3800 )
+#define EXT1_BASEADDR   EXTI_BASEADDR		// Old spellings, kept for the examples
+#define SYSCFC_BASEADDR SYSCFG_BASEADDR
+
+// Cortex-M4 private peripherals (System Control Space)
+#define SCS_BASEADDR    0xE000E000U
+#define NVIC_BASEADDR   ( SCS_BASEADDR + 0x0100 )
+
+// Cortex-M4 peripheral bit-band alias: one word per register bit, so a
+// single store sets or clears a bit without a read-modify-write that an
+// interrupt could split (not available in the host shadow window)
+#define PERIPH_BB_BASEADDR			0x42000000U
+#define BITBAND_PERIPH(addr, bit)	( *(__VO uint32_t *)(PERIPH_BB_BASEADDR + ((addr) - PERIPH_BASEADDR) * 32U + (bit) * 4U) )
 
 // #define 	   			( GPIOA_BASEADDR + 0x00 )
 
@@ -70,8 +89,15 @@ typedef struct
 	__VO uint32_t PUPDR;
 	__VO uint32_t IDR;
 	__VO uint32_t ODR;
-	__VO uint32_t BSRRL;
-	__VO uint32_t BSRRH;
+	union
+	{
+		__VO uint32_t BSRR;		// One write sets (15:0) and resets (31:16) pins
+		struct
+		{
+			__VO uint16_t BSRRL;	// BSRR bits 15:0, set
+			__VO uint16_t BSRRH;	// BSRR bits 31:16, reset
+		};
+	};
 	__VO uint32_t LCKR;
 	__VO uint32_t AFR[2];
 
@@ -103,8 +129,8 @@ typedef struct
 	 __VO uint32_t AHB2LPENR;
 	 __VO uint32_t AHB3LPENR;
 	 __VO uint32_t RESERVED7;
-	 __VO uint32_t PB1LPENR;
-	 __VO uint32_t PB2LPENR;
+	 __VO uint32_t APB1LPENR;
+	 __VO uint32_t APB2LPENR;
 	 __VO uint32_t RESERVED8;
 	 __VO uint32_t RESERVED9;
 	 __VO uint32_t BDCR;
@@ -120,22 +146,178 @@ typedef struct
 
  } RCC__RegDef_t;
 
+ typedef struct
+ {
+	 __VO uint32_t IMR;
+	 __VO uint32_t EMR;
+	 __VO uint32_t RTSR;
+	 __VO uint32_t FTSR;
+	 __VO uint32_t SWIER;
+	 __VO uint32_t PR;		// Pending, write 1 to clear
 
+ } EXTI_RegDef_t;
 
- // GPIO_RegDef_t *pGPIOA = GPIOA;
+ typedef struct
+ {
+	 __VO uint32_t MEMRMP;
+	 __VO uint32_t PMC;
+	 __VO uint32_t EXTICR[4];	// 4 bits per EXTI line: source port (GPIO_PORT_INDEX)
+	 uint32_t RESERVED1[2];
+	 __VO uint32_t CMPCR;
+
+ } SYSCFG_RegDef_t;
+
+ typedef struct
+ {
+	 __VO uint32_t ISER[8];		// Set-enable, one bit per IRQ, write 1 to enable
+	 uint32_t RESERVED0[24];
+	 __VO uint32_t ICER[8];		// Clear-enable, write 1 to disable
+	 uint32_t RESERVED1[24];
+	 __VO uint32_t ISPR[8];
+	 uint32_t RESERVED2[24];
+	 __VO uint32_t ICPR[8];
+	 uint32_t RESERVED3[24];
+	 __VO uint32_t IABR[8];
+	 uint32_t RESERVED4[56];
+	 __VO uint8_t  IPR[240];	// One priority byte per IRQ, upper bits used
+
+ } NVIC_RegDef_t;
 
-#define GPIOA ((GPIO_RegDef_t*)GPIOA_BASEADDR )
-#define GPIOB ((GPIO_RegDef_t*)GPIOB_BASEADDR )
-#define GPIOC ((GPIO_RegDef_t*)GPIOC_BASEADDR )
-#define GPIOD ((GPIO_RegDef_t*)GPIOD_BASEADDR )
-#define GPIOE ((GPIO_RegDef_t*)GPIOE_BASEADDR )
-#define GPIOF ((GPIO_RegDef_t*)GPIOF_BASEADDR )
-#define GPIOG ((GPIO_RegDef_t*)GPIOG_BASEADDR )
-#define GPIOH ((GPIO_RegDef_t*)GPIOH_BASEADDR )
-#define GPIOI ((GPIO_RegDef_t*)GPIOI_BASEADDR )
+ typedef struct
+ {
+	 __VO uint32_t SR;			// Status; TC, RXNE cleared by writing 0
+	 __VO uint32_t DR;
+	 __VO uint32_t BRR;
+	 __VO uint32_t CR1;
+	 __VO uint32_t CR2;
+	 __VO uint32_t CR3;
+	 __VO uint32_t GTPR;
+
+ } USART_RegDef_t;
+
+ typedef struct
+ {
+	 __VO uint32_t CR1;
+	 __VO uint32_t CR2;
+	 __VO uint32_t SR;			// OVR cleared by reading DR then SR
+	 __VO uint32_t DR;			// 8 or 16 bits wide depending on CR1.DFF
+	 __VO uint32_t CRCPR;
+	 __VO uint32_t RXCRCR;
+	 __VO uint32_t TXCRCR;
+	 __VO uint32_t I2SCFGR;
+	 __VO uint32_t I2SPR;
+
+ } SPI_RegDef_t;
 
+ typedef struct
+ {
+	 __VO uint32_t CR;
+	 __VO uint32_t NDTR;		// Items left; reload value in circular mode
+	 __VO uint32_t PAR;
+	 __VO uint32_t M0AR;
+	 __VO uint32_t M1AR;
+	 __VO uint32_t FCR;
 
-#define RCC ((RCC__RegDef_t*)RCC_BASEADDR )
+ } DMA_Stream_RegDef_t;
+
+ typedef struct
+ {
+	 __VO uint32_t ISR[2];		// LISR (streams 0-3), HISR (streams 4-7)
+	 __VO uint32_t IFCR[2];		// LIFCR, HIFCR: write 1 to clear
+	 DMA_Stream_RegDef_t S[8];
+
+ } DMA_RegDef_t;
+
+ // General-purpose timers TIM2-TIM5 (CNT, ARR and CCRx are 32 bits on
+ // TIM2/TIM5, 16 bits on TIM3/TIM4)
+ typedef struct
+ {
+	 __VO uint32_t CR1;
+	 __VO uint32_t CR2;
+	 __VO uint32_t SMCR;
+	 __VO uint32_t DIER;
+	 __VO uint32_t SR;			// Flags cleared by writing 0, writing 1 has no effect
+	 __VO uint32_t EGR;
+	 __VO uint32_t CCMR1;		// Channels 1 and 2, one byte each
+	 __VO uint32_t CCMR2;		// Channels 3 and 4
+	 __VO uint32_t CCER;		// 4 bits per channel
+	 __VO uint32_t CNT;
+	 __VO uint32_t PSC;			// Counter clock = TIMxCLK / (PSC + 1), loaded at the update event
+	 __VO uint32_t ARR;
+	 uint32_t RESERVED1;
+	 __VO uint32_t CCR[4];
+	 uint32_t RESERVED2;
+	 __VO uint32_t DCR;
+	 __VO uint32_t DMAR;
+	 __VO uint32_t OR;
+
+ } TIM_RegDef_t;
+
+
+
+ // GPIO_RegDef_t *pGPIOA = GPIOA;
+
+// Host build (USE_HOST_MMIO): peripheral addresses resolve into the shadow
+// register file of 07_Virtual_Simulation/sim_mmio.c, so the drivers run
+// unmodified against the virtual peripherals
+#ifdef USE_HOST_MMIO
+extern uint8_t *sim_mmio_shadow;
+extern uint8_t *sim_mmio_scs;
+#define MMIO_ADDR(addr)  ( (uintptr_t)sim_mmio_shadow + ((addr) - PERIPH_BASEADDR) )
+#define SCS_ADDR(addr)   ( (uintptr_t)sim_mmio_scs + ((addr) - SCS_BASEADDR) )
+#define MMIO_DEV_ADDR(ptr)  ( (uint32_t)((uintptr_t)(ptr) - (uintptr_t)sim_mmio_shadow) + PERIPH_BASEADDR )
+#else
+#define MMIO_ADDR(addr)  ( addr )
+#define SCS_ADDR(addr)   ( addr )
+#define MMIO_DEV_ADDR(ptr)  ( (uint32_t)(uintptr_t)(ptr) )	// Bus address of a register, for DMA
+#endif
+
+// Set or clear one register bit that both thread and interrupt context
+// change: one store to the bit-band alias on the target. The host shadow
+// window has no alias; host tests run the handlers in the calling thread,
+// so read-modify-write is safe there.
+#ifdef USE_HOST_MMIO
+#define REG_WRITE_BIT(Reg, Bit, Value) \
+	((Reg) = ((Reg) & ~(1U << (Bit))) | ((uint32_t)(Value) << (Bit)))
+#else
+#define REG_WRITE_BIT(Reg, Bit, Value) \
+	(BITBAND_PERIPH((uint32_t)(uintptr_t)&(Reg), (Bit)) = (Value))
+#endif
+
+#define GPIOA ((GPIO_RegDef_t*)MMIO_ADDR(GPIOA_BASEADDR) )
+#define GPIOB ((GPIO_RegDef_t*)MMIO_ADDR(GPIOB_BASEADDR) )
+#define GPIOC ((GPIO_RegDef_t*)MMIO_ADDR(GPIOC_BASEADDR) )
+#define GPIOD ((GPIO_RegDef_t*)MMIO_ADDR(GPIOD_BASEADDR) )
+#define GPIOE ((GPIO_RegDef_t*)MMIO_ADDR(GPIOE_BASEADDR) )
+#define GPIOF ((GPIO_RegDef_t*)MMIO_ADDR(GPIOF_BASEADDR) )
+#define GPIOG ((GPIO_RegDef_t*)MMIO_ADDR(GPIOG_BASEADDR) )
+#define GPIOH ((GPIO_RegDef_t*)MMIO_ADDR(GPIOH_BASEADDR) )
+#define GPIOI ((GPIO_RegDef_t*)MMIO_ADDR(GPIOI_BASEADDR) )
+
+
+#define RCC ((RCC__RegDef_t*)MMIO_ADDR(RCC_BASEADDR) )
+#define EXTI ((EXTI_RegDef_t*)MMIO_ADDR(EXTI_BASEADDR) )
+#define SYSCFG ((SYSCFG_RegDef_t*)MMIO_ADDR(SYSCFG_BASEADDR) )
+#define NVIC ((NVIC_RegDef_t*)SCS_ADDR(NVIC_BASEADDR) )
+
+#define USART1 ((USART_RegDef_t*)MMIO_ADDR(USART1_BASEADDR) )
+#define USART2 ((USART_RegDef_t*)MMIO_ADDR(USART2_BASEADDR) )
+#define USART3 ((USART_RegDef_t*)MMIO_ADDR(USART3_BASEADDR) )
+#define UART4  ((USART_RegDef_t*)MMIO_ADDR(UART4_BASEADDR) )
+#define UART5  ((USART_RegDef_t*)MMIO_ADDR(UART5_BASEADDR) )
+#define USART6 ((USART_RegDef_t*)MMIO_ADDR(USART6_BASEADDR) )
+
+#define SPI1 ((SPI_RegDef_t*)MMIO_ADDR(SPI1_BASEADDR) )
+#define SPI2 ((SPI_RegDef_t*)MMIO_ADDR(SPI2_BASEADDR) )
+#define SPI3 ((SPI_RegDef_t*)MMIO_ADDR(SPI3_BASEADDR) )
+
+#define DMA1 ((DMA_RegDef_t*)MMIO_ADDR(DMA1_BASEADDR) )
+#define DMA2 ((DMA_RegDef_t*)MMIO_ADDR(DMA2_BASEADDR) )
+
+#define TIM2 ((TIM_RegDef_t*)MMIO_ADDR(TIM2_BASEADDR) )
+#define TIM3 ((TIM_RegDef_t*)MMIO_ADDR(TIM3_BASEADDR) )
+#define TIM4 ((TIM_RegDef_t*)MMIO_ADDR(TIM4_BASEADDR) )
+#define TIM5 ((TIM_RegDef_t*)MMIO_ADDR(TIM5_BASEADDR) )
 
 
 #define GPIOA_PCLK_EN()  (RCC->AHB1ENR |= (1 << 0) )
@@ -147,76 +329,273 @@ typedef struct
 #define GPIOG_PCLK_EN()  (RCC->AHB1ENR |= (1 << 6) )
 #define GPIOH_PCLK_EN()  (RCC->AHB1ENR |= (1 << 7) )
 #define GPIOI_PCLK_EN()  (RCC->AHB1ENR |= (1 << 8) )
+#define DMA1_PCLK_EN()   (RCC->AHB1ENR |= (1 << 21) )
+#define DMA2_PCLK_EN()   (RCC->AHB1ENR |= (1 << 22) )
 
 
  // SET PERIPHERALS
 
-#define I2C1_PCLK_EN ()  (RCC->AHB1ENR |= (1 << 21) )
-#define I2C2_PCLK_EN ()  (RCC->AHB1ENR |= (1 << 22) )
-#define I2C3_PCLK_EN ()  (RCC->AHB1ENR |= (1 << 23) )
+#define I2C1_PCLK_EN()   (RCC->APB1ENR |= (1 << 21) )
+#define I2C2_PCLK_EN()   (RCC->APB1ENR |= (1 << 22) )
+#define I2C3_PCLK_EN()   (RCC->APB1ENR |= (1 << 23) )
 
 
-#define SPI1_PCLK_EN ()  (RCC->AHB2ENR   |= (1 << 12) )
-#define SPI2_PCLK_EN ()  (RCC->APB1LPENR |= (1 << 14) )
-#define SPI3_PCLK_EN ()  (RCC->APB1LPENR |= (1 << 15) )
+#define TIM2_PCLK_EN()   (RCC->APB1ENR |= (1 << 0) )
+#define TIM3_PCLK_EN()   (RCC->APB1ENR |= (1 << 1) )
+#define TIM4_PCLK_EN()   (RCC->APB1ENR |= (1 << 2) )
+#define TIM5_PCLK_EN()   (RCC->APB1ENR |= (1 << 3) )
 
-#define USART1_PCLK_EN() (RCC->APB2LPENR |= (1 << 4 ) )
-#define USART2_PCLK_EN() (RCC->APB1LPENR |= (1 << 17) )
-#define USART3_PCLK_EN() (RCC->APB1LPENR |= (1 << 18) )
-#define UART4_PCLK_EN()  (RCC->APB1LPENR |= (1 << 19) )
-#define UART5_PCLK_EN()  (RCC->APB1LPENR |= (1 << 20) )
-#define USART6_PCLK_EN() (RCC->APB2LPENR |= (1 << 5 ) )
 
+#define SPI1_PCLK_EN()   (RCC->APB2ENR |= (1 << 12) )
+#define SPI2_PCLK_EN()   (RCC->APB1ENR |= (1 << 14) )
+#define SPI3_PCLK_EN()   (RCC->APB1ENR |= (1 << 15) )
 
-#define SYSCFG_PCLK_EN() (RCC->APB2LPENR |= (1 << 14) )
+#define USART1_PCLK_EN() (RCC->APB2ENR |= (1 << 4 ) )
+#define USART2_PCLK_EN() (RCC->APB1ENR |= (1 << 17) )
+#define USART3_PCLK_EN() (RCC->APB1ENR |= (1 << 18) )
+#define UART4_PCLK_EN()  (RCC->APB1ENR |= (1 << 19) )
+#define UART5_PCLK_EN()  (RCC->APB1ENR |= (1 << 20) )
+#define USART6_PCLK_EN() (RCC->APB2ENR |= (1 << 5 ) )
 
 
+#define SYSCFG_PCLK_EN() (RCC->APB2ENR |= (1 << 14) )
 
-// CLEAR PERIPHERALS
-
-
-//#define GPIOA_PCLK_DI()  (RCC->AHB1ENR &= (1 << 0) )
-//#define GPIOB_PCLK_DI()  (RCC->AHB1ENR &= (1 << 1) )
-//#define GPIOC_PCLK_DI()  (RCC->AHB1ENR &= (1 << 2) )
-//#define GPIOD_PCLK_DI()  (RCC->AHB1ENR &= (1 << 3) )
-//#define GPIOE_PCLK_DI()  (RCC->AHB1ENR &= (1 << 4) )
-//#define GPIOF_PCLK_DI()  (RCC->AHB1ENR &= (1 << 5) )
-//#define GPIOG_PCLK_DI()  (RCC->AHB1ENR &= (1 << 6) )
-//#define GPIOH_PCLK_DI()  (RCC->AHB1ENR &= (1 << 7) )
-//#define GPIOI_PCLK_DI()  (RCC->AHB1ENR &= (1 << 8) )
 
 
+// CLEAR PERIPHERALS
 
 
-#define I2C1_PCLK_DE ()  	(RCC->AHB1ENR &= (1 << 21) )
-#define I2C2_PCLK_DE ()  	(RCC->AHB1ENR &= (1 << 22) )
-#define I2C3_PCLK_DE ()  	(RCC->AHB1ENR &= (1 << 23) )
-
-
-#define SPI1_PCLK_DE ()  	(RCC->AHB2ENR   &= (1 << 12) )
-#define SPI2_PCLK_DE ()  	(RCC->APB1LPENR &= (1 << 14) )
-#define SPI3_PCLK_DE ()  	(RCC->APB1LPENR &= (1 << 15) )
-
-#define USART1_PCLK_DE() 	(RCC->APB2LPENR &= (1 << 4 ) )
-#define USART2_PCLK_DE() 	(RCC->APB1LPENR &= (1 << 17) )
-#define USART3_PCLK_DE() 	(RCC->APB1LPENR &= (1 << 18) )
-#define UART4_PCLK_DE () 	(RCC->APB1LPENR &= (1 << 19) )
-#define UART5_PCLK_DE () 	(RCC->APB1LPENR &= (1 << 20) )
-#define USART6_PCLK_DE() 	(RCC->APB2LPENR &= (1 << 5 ) )
-
-
-#define SYSCFG_PCLK_DE() 	(RCC->APB2LPENR &= (1 << 14) )
-
-#define GPIOI_PCLK_DI()
-#define GPIOA_REG_RESET()	do { (RCC->AHB1RSTR   |= (1 << 0) );(RCC->AHB1RSTR   &= ~(1 << 0) );}while(0)
-#define GPIOB_REG_RESET()	do { (RCC->AHB1RSTR   |= (1 << 1) );(RCC->AHB1RSTR   &= ~(1 << 1) );}while(0)
-#define GPIOC_REG_RESET()	do { (RCC->AHB1RSTR   |= (1 << 2) );(RCC->AHB1RSTR   &= ~(1 << 2) );}while(0)
-#define GPIOD_REG_RESET()	do { (RCC->AHB1RSTR   |= (1 << 3) );(RCC->AHB1RSTR   &= ~(1 << 3) );}while(0)
-#define GPIOE_REG_RESET()	do { (RCC->AHB1RSTR   |= (1 << 4) );(RCC->AHB1RSTR   &= ~(1 << 4) );}while(0)
-#define GPIOF_REG_RESET()	do { (RCC->AHB1RSTR   |= (1 << 5) );(RCC->AHB1RSTR   &= ~(1 << 5) );}while(0)
-#define GPIOG_REG_RESET()	do { (RCC->AHB1RSTR   |= (1 << 6) );(RCC->AHB1RSTR   &= ~(1 << 6) );}while(0)
-#define GPIOH_REG_RESET()	do { (RCC->AHB1RSTR   |= (1 << 7) );(RCC->AHB1RSTR   &= ~(1 << 7) );}while(0)
-#define GPIOI_REG_RESET()	do { (RCC->AHB1RSTR   |= (1 << 8) );(RCC->AHB1RSTR   &= ~(1 << 8) );}while(0)
+#define GPIOA_PCLK_DI()  (RCC->AHB1ENR &= ~(1 << 0) )
+#define GPIOB_PCLK_DI()  (RCC->AHB1ENR &= ~(1 << 1) )
+#define GPIOC_PCLK_DI()  (RCC->AHB1ENR &= ~(1 << 2) )
+#define GPIOD_PCLK_DI()  (RCC->AHB1ENR &= ~(1 << 3) )
+#define GPIOE_PCLK_DI()  (RCC->AHB1ENR &= ~(1 << 4) )
+#define GPIOF_PCLK_DI()  (RCC->AHB1ENR &= ~(1 << 5) )
+#define GPIOG_PCLK_DI()  (RCC->AHB1ENR &= ~(1 << 6) )
+#define GPIOH_PCLK_DI()  (RCC->AHB1ENR &= ~(1 << 7) )
+#define GPIOI_PCLK_DI()  (RCC->AHB1ENR &= ~(1 << 8) )
+
+
+
+
+#define I2C1_PCLK_DE()  	(RCC->APB1ENR &= ~(1 << 21) )
+#define I2C2_PCLK_DE()  	(RCC->APB1ENR &= ~(1 << 22) )
+#define I2C3_PCLK_DE()  	(RCC->APB1ENR &= ~(1 << 23) )
+
+
+#define TIM2_PCLK_DE()  	(RCC->APB1ENR &= ~(1 << 0) )
+#define TIM3_PCLK_DE()  	(RCC->APB1ENR &= ~(1 << 1) )
+#define TIM4_PCLK_DE()  	(RCC->APB1ENR &= ~(1 << 2) )
+#define TIM5_PCLK_DE()  	(RCC->APB1ENR &= ~(1 << 3) )
+
+
+#define SPI1_PCLK_DE()  	(RCC->APB2ENR &= ~(1 << 12) )
+#define SPI2_PCLK_DE()  	(RCC->APB1ENR &= ~(1 << 14) )
+#define SPI3_PCLK_DE()  	(RCC->APB1ENR &= ~(1 << 15) )
+
+#define USART1_PCLK_DE() 	(RCC->APB2ENR &= ~(1 << 4 ) )
+#define USART2_PCLK_DE() 	(RCC->APB1ENR &= ~(1 << 17) )
+#define USART3_PCLK_DE() 	(RCC->APB1ENR &= ~(1 << 18) )
+#define UART4_PCLK_DE() 	(RCC->APB1ENR &= ~(1 << 19) )
+#define UART5_PCLK_DE() 	(RCC->APB1ENR &= ~(1 << 20) )
+#define USART6_PCLK_DE() 	(RCC->APB2ENR &= ~(1 << 5 ) )
+
+
+#define SYSCFG_PCLK_DE() 	(RCC->APB2ENR &= ~(1 << 14) )
+
+
+// GPIO ports are 0x400 apart from GPIOA, so the port index (A = 0 ... I = 8)
+// is also the port's bit in RCC AHB1ENR/AHB1RSTR
+#define GPIO_PORT_COUNT			9
+#define GPIO_PORT_INDEX(pGPIOx)	( (uint32_t)(((uintptr_t)(pGPIOx) - (uintptr_t)GPIOA) / 0x400U) )
+#define GPIO_PORT_BIT(pGPIOx)	( 1U << GPIO_PORT_INDEX(pGPIOx) )
+#define GPIO_PORT_FROM_INDEX(index)	( (GPIO_RegDef_t*)((uintptr_t)GPIOA + (index) * 0x400U) )
+
+#define GPIO_PCLK_EN(index)		(RCC->AHB1ENR |= (1U << (index)) )
+#define GPIO_PCLK_DI(index)		(RCC->AHB1ENR &= ~(1U << (index)) )
+#define GPIO_REG_RESET(index)	do { (RCC->AHB1RSTR   |= (1U << (index)) );(RCC->AHB1RSTR   &= ~(1U << (index)) );}while(0)
+
+#define GPIOA_REG_RESET()	GPIO_REG_RESET(0)
+#define GPIOB_REG_RESET()	GPIO_REG_RESET(1)
+#define GPIOC_REG_RESET()	GPIO_REG_RESET(2)
+#define GPIOD_REG_RESET()	GPIO_REG_RESET(3)
+#define GPIOE_REG_RESET()	GPIO_REG_RESET(4)
+#define GPIOF_REG_RESET()	GPIO_REG_RESET(5)
+#define GPIOG_REG_RESET()	GPIO_REG_RESET(6)
+#define GPIOH_REG_RESET()	GPIO_REG_RESET(7)
+#define GPIOI_REG_RESET()	GPIO_REG_RESET(8)
+
+
+// IRQ numbers of the EXTI lines that come from GPIO pins
+#define IRQ_NO_EXTI0		6
+#define IRQ_NO_EXTI1		7
+#define IRQ_NO_EXTI2		8
+#define IRQ_NO_EXTI3		9
+#define IRQ_NO_EXTI4		10
+#define IRQ_NO_EXTI9_5		23
+#define IRQ_NO_EXTI15_10	40
+
+#define IRQ_NO_DMA1_STREAM0	11
+#define IRQ_NO_DMA1_STREAM1	12
+#define IRQ_NO_DMA1_STREAM2	13
+#define IRQ_NO_DMA1_STREAM3	14
+#define IRQ_NO_DMA1_STREAM4	15
+#define IRQ_NO_DMA1_STREAM5	16
+#define IRQ_NO_DMA1_STREAM6	17
+#define IRQ_NO_DMA1_STREAM7	47
+#define IRQ_NO_DMA2_STREAM0	56
+#define IRQ_NO_DMA2_STREAM1	57
+#define IRQ_NO_DMA2_STREAM2	58
+#define IRQ_NO_DMA2_STREAM3	59
+#define IRQ_NO_DMA2_STREAM4	60
+#define IRQ_NO_DMA2_STREAM5	68
+#define IRQ_NO_DMA2_STREAM6	69
+#define IRQ_NO_DMA2_STREAM7	70
+
+#define IRQ_NO_USART1		37
+#define IRQ_NO_USART2		38
+#define IRQ_NO_USART3		39
+#define IRQ_NO_UART4		52
+#define IRQ_NO_UART5		53
+#define IRQ_NO_USART6		71
+
+#define IRQ_NO_SPI1			35
+#define IRQ_NO_SPI2			36
+#define IRQ_NO_SPI3			51
+
+#define IRQ_NO_TIM2			28
+#define IRQ_NO_TIM3			29
+#define IRQ_NO_TIM4			30
+#define IRQ_NO_TIM5			50
+
+#define NO_PR_BITS_IMPLEMENTED	4	// STM32F4: priority in IPR bits 7:4
+
+
+// Bit positions of the RCC clock configuration registers
+#define RCC_CFGR_SWS		2	// 2 bits: 00 HSI, 01 HSE, 10 PLL_P, 11 PLL_R
+#define RCC_CFGR_HPRE		4	// 4 bits: 0xxx /1, 1000-1111 /2 ... /512 (no /32)
+#define RCC_CFGR_PPRE1		10	// 3 bits: 0xx /1, 100-111 /2 ... /16
+#define RCC_CFGR_PPRE2		13
+
+#define RCC_PLLCFGR_PLLM	0	// 6 bits
+#define RCC_PLLCFGR_PLLN	6	// 9 bits
+#define RCC_PLLCFGR_PLLP	16	// 2 bits: /2, /4, /6, /8
+#define RCC_PLLCFGR_PLLSRC	22	// 0 HSI, 1 HSE
+#define RCC_PLLCFGR_PLLR	28	// 3 bits
+
+// Bit positions of the USART registers
+#define USART_SR_PE			0
+#define USART_SR_FE			1
+#define USART_SR_NF			2
+#define USART_SR_ORE		3
+#define USART_SR_IDLE		4
+#define USART_SR_RXNE		5
+#define USART_SR_TC			6
+#define USART_SR_TXE		7
+
+#define USART_CR1_RE		2
+#define USART_CR1_TE		3
+#define USART_CR1_IDLEIE	4
+#define USART_CR1_RXNEIE	5
+#define USART_CR1_TCIE		6
+#define USART_CR1_TXEIE		7
+#define USART_CR1_PS		9
+#define USART_CR1_PCE		10
+#define USART_CR1_M			12
+#define USART_CR1_UE		13
+#define USART_CR1_OVER8		15
+
+#define USART_CR2_STOP		12	// 2 bits: 00 1, 10 2 stop bits
+
+#define USART_CR3_EIE		0
+#define USART_CR3_DMAR		6
+#define USART_CR3_DMAT		7
+#define USART_CR3_RTSE		8
+#define USART_CR3_CTSE		9
+
+// Bit positions of the SPI registers
+#define SPI_CR1_CPHA		0
+#define SPI_CR1_CPOL		1
+#define SPI_CR1_MSTR		2
+#define SPI_CR1_BR			3	// 3 bits: PCLK / 2^(BR+1)
+#define SPI_CR1_SPE			6
+#define SPI_CR1_LSBFIRST	7
+#define SPI_CR1_SSI			8
+#define SPI_CR1_SSM			9
+#define SPI_CR1_RXONLY		10
+#define SPI_CR1_DFF			11
+#define SPI_CR1_BIDIOE		14
+#define SPI_CR1_BIDIMODE	15
+
+#define SPI_CR2_RXDMAEN		0
+#define SPI_CR2_TXDMAEN		1
+#define SPI_CR2_SSOE		2
+#define SPI_CR2_ERRIE		5
+#define SPI_CR2_RXNEIE		6
+#define SPI_CR2_TXEIE		7
+
+#define SPI_SR_RXNE			0
+#define SPI_SR_TXE			1
+#define SPI_SR_MODF			5
+#define SPI_SR_OVR			6
+#define SPI_SR_BSY			7
+
+// Bit positions of the TIM2-TIM5 registers
+#define TIM_CR1_CEN			0
+#define TIM_CR1_UDIS		1
+#define TIM_CR1_URS			2	// Only counter overflow raises UIF, not UG
+#define TIM_CR1_OPM			3
+#define TIM_CR1_DIR			4
+#define TIM_CR1_ARPE		7
+
+#define TIM_DIER_UIE		0
+#define TIM_DIER_CC1IE		1	// CCxIE = CC1IE + (x - 1)
+
+#define TIM_SR_UIF			0
+#define TIM_SR_CC1IF		1	// CCxIF = CC1IF + (x - 1)
+#define TIM_SR_CC1OF		9	// CCxOF = CC1OF + (x - 1), input capture overrun
+
+#define TIM_EGR_UG			0
+#define TIM_EGR_CC1G		1	// CCxG = CC1G + (x - 1)
+
+// Per-channel byte of CCMR1 (channels 1, 2) and CCMR2 (channels 3, 4)
+#define TIM_CCMR_CCS		0	// 2 bits: 00 output, 01 input on TIx
+#define TIM_CCMR_OCPE		3
+#define TIM_CCMR_OCM		4	// 3 bits: output compare mode
+#define TIM_CCMR_ICF		4	// 4 bits: input filter
+
+// Per-channel nibble of CCER
+#define TIM_CCER_CCE		0
+#define TIM_CCER_CCP		1
+#define TIM_CCER_CCNP		3
+
+// Bit positions of a DMA stream's SxCR
+#define DMA_SCR_EN			0
+#define DMA_SCR_DMEIE		1
+#define DMA_SCR_TEIE		2
+#define DMA_SCR_HTIE		3
+#define DMA_SCR_TCIE		4
+#define DMA_SCR_DIR			6	// 2 bits: 00 periph-to-mem, 01 mem-to-periph
+#define DMA_SCR_CIRC		8
+#define DMA_SCR_PINC		9
+#define DMA_SCR_MINC		10
+#define DMA_SCR_PSIZE		11	// 2 bits: 00 byte, 01 half-word
+#define DMA_SCR_MSIZE		13
+#define DMA_SCR_PL			16	// 2 bits
+#define DMA_SCR_CHSEL		25	// 3 bits
+
+// Stream interrupt flags in ISR/IFCR, relative to the stream's field
+// (streams 0/4 at bit 0, 1/5 at 6, 2/6 at 16, 3/7 at 22)
+#define DMA_FLAG_FEIF		0
+#define DMA_FLAG_DMEIF		2
+#define DMA_FLAG_TEIF		3
+#define DMA_FLAG_HTIF		4
+#define DMA_FLAG_TCIF		5
+#define DMA_FLAG_SHIFT(stream)	( ((stream) & 1U) * 6U + ((stream) & 2U) * 8U )
+
+// All status flags of a stream, relative to its field
+#define DMA_STREAM_FLAGS	( (1U << DMA_FLAG_FEIF) | (1U << DMA_FLAG_DMEIF) | (1U << DMA_FLAG_TEIF) \
+							| (1U << DMA_FLAG_HTIF) | (1U << DMA_FLAG_TCIF) )
 
 
 #define ENABLE 			1
@@ -226,6 +605,39 @@ typedef struct
 #define GPIO_PIN_SET 	SET
 #define GPIO_PIN_RESET	RESET
 
+/*
+ * Helpers shared by the peripheral drivers
+ */
+
+// Stop a DMA stream and clear its flags; EN reads 1 until the stream has
+// actually stopped
+static inline void DMA_StreamDisable(DMA_RegDef_t *pDMA, uint8_t Stream)
+{
+    pDMA->S[Stream].CR = 0;
+    while (pDMA->S[Stream].CR & (1U << DMA_SCR_EN))
+        ;
+    pDMA->IFCR[Stream >> 2] = DMA_STREAM_FLAGS << DMA_FLAG_SHIFT(Stream);
+}
+
+// Enable (with a priority, 0 highest to 15) or disable an interrupt in the
+// NVIC. ISER/ICER are write-1 registers, so each path is a single store;
+// the priority is written before the enable so the first interrupt
+// already uses it.
+static inline void NVIC_IRQConfig(uint8_t IRQNumber, uint8_t IRQPriority, uint8_t EnorDi)
+{
+    uint32_t bit = 1U << (IRQNumber & 0x1FU);
+
+    if (EnorDi == ENABLE)
+    {
+        NVIC->IPR[IRQNumber] = (uint8_t)(IRQPriority << (8 - NO_PR_BITS_IMPLEMENTED));
+        NVIC->ISER[IRQNumber >> 5] = bit;
+    }
+    else
+    {
+        NVIC->ICER[IRQNumber >> 5] = bit;
+    }
+}
+
 
 
 
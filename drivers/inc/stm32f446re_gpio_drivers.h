@@ -30,6 +30,36 @@ GPIO_pinconfig_t GPIO_PINConfig;
 
 } GPIO_Handle_t;
 
+// Configuration applied to every pin in GPIO_PinMask (bit n = pin n),
+// like HAL's GPIO_InitTypeDef.Pin
+typedef struct
+{
+uint16_t GPIO_PinMask ;
+uint8_t GPIO_PinMode ;
+uint8_t GPIO_PinSpeed ;
+uint8_t GPIO_PinPupdControl ;
+uint8_t GPIO_PinOPType ;
+uint8_t GPIO_PinAltFunMode ;
+
+} GPIO_PinMaskConfig_t;
+
+// Complete register image of one port, for const boot tables
+typedef struct
+{
+uint8_t  Port ;			// GPIO_PORT_INDEX value: 0 = GPIOA ... 8 = GPIOI
+uint32_t MODER ;
+uint32_t OTYPER ;
+uint32_t OSPEEDR ;
+uint32_t PUPDR ;
+uint32_t ODR ;			// Initial output levels, loaded before MODER
+uint32_t AFR[2] ;
+
+} GPIO_PortConfig_t;
+
+// EXTI line callback, run from the driver's EXTI IRQ handlers after the
+// line's pending bit has been cleared
+typedef void (*GPIO_EXTICallback_t)(uint8_t PinNumber);
+
 #define GPIO_MODE_IN     	0
 #define GPIO_MODE_OUT  		1
 #define GPIO_MODE_ALTFN		2
@@ -74,9 +104,12 @@ GPIO_pinconfig_t GPIO_PINConfig;
 
 // Peripheral Clock Setup
 void GPIO_PeriClockControl(GPIO_RegDef_t *pGPIOx, uint8_t EnorDi);
+void GPIO_PeriClockControlPorts(uint16_t PortMask, uint8_t EnorDi);
 
 // Init and De-init
 void GPIO_Init(GPIO_Handle_t *pGPIOHandle);
+void GPIO_InitPins(GPIO_RegDef_t *pGPIOx, const GPIO_PinMaskConfig_t *pConfig);
+void GPIO_ApplyPortConfig(const GPIO_PortConfig_t *pConfig, uint8_t Count);
 void GPIO_DeInit(GPIO_RegDef_t *pGPIOx);
 
 // Data read and write
@@ -86,8 +119,24 @@ void GPIO_WriteToOutputPin(GPIO_RegDef_t *pGPIOx, uint8_t PinNumber, uint8_t Val
 void GPIO_WriteToOutputPort(GPIO_RegDef_t *pGPIOx, uint16_t Value);
 void GPIO_ToggleOutputPin(GPIO_RegDef_t *pGPIOx, uint8_t PinNumber);
 
+// Masked writes (single BSRR write, interrupt safe)
+void GPIO_WriteMaskedPort(GPIO_RegDef_t *pGPIOx, uint16_t PinMask, uint16_t Value);
+void GPIO_ToggleOutputPins(GPIO_RegDef_t *pGPIOx, uint16_t PinMask);
+
 // IRQ Configuration and Handling
 void GPIO_IRQConfig(uint8_t IRQNumber, uint8_t IRQPriority, uint8_t EnorDi);
 void GPIO_IRQHandling(uint8_t PinNumber);
+uint8_t GPIO_PinToIRQ(uint8_t PinNumber);
+void GPIO_RegisterCallback(uint8_t PinNumber, GPIO_EXTICallback_t Callback);
+void GPIO_EXTIDispatch(uint32_t LineMask);
+
+// Shared EXTI vectors. Build with GPIO_NO_EXTI_HANDLERS to supply your own.
+void EXTI0_IRQHandler(void);
+void EXTI1_IRQHandler(void);
+void EXTI2_IRQHandler(void);
+void EXTI3_IRQHandler(void);
+void EXTI4_IRQHandler(void);
+void EXTI9_5_IRQHandler(void);
+void EXTI15_10_IRQHandler(void);
 
 #endif /* INC_STM32F446RE_GPIO_DRIVERS_H_ */
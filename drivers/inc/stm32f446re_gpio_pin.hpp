@@ -0,0 +1,226 @@
+/*
+ * stm32f446re_gpio_pin.hpp
+ *
+ * Optional header-only C++ layer over the GPIO driver. A pin is a type
+ * (gpio::Pin<gpio::PortA, 5>), so its port address, mask and mode are
+ * compile-time constants: set()/reset()/write() are one store to BSRR
+ * with no shifts or table lookups left at run time. The C API in
+ * stm32f446re_gpio_drivers.h is unchanged and can be mixed freely.
+ *
+ * Needs C++14 (relaxed constexpr).
+ */
+
+#ifndef INC_STM32F446RE_GPIO_PIN_HPP_
+#define INC_STM32F446RE_GPIO_PIN_HPP_
+
+#if __cplusplus < 201402L
+#error "stm32f446re_gpio_pin.hpp needs C++14 or later"
+#endif
+
+extern "C" {
+#include "stm32f446re_gpio_drivers.h"
+}
+
+namespace gpio
+{
+
+/*********************************************************************
+ * @fn      		- spread_mask2
+ * @brief           - Widen a 16-bit pin mask to one 2-bit field per pin
+ * @param[in]       - PinMask: bit n = pin n
+ * @return          - Mask with bits 2n+1:2n set for each selected pin
+ * @Note            - constexpr twin of the driver's MODER/OSPEEDR/PUPDR helper
+ *********************************************************************/
+constexpr uint32_t spread_mask2(uint16_t PinMask)
+{
+    uint32_t mask = 0;
+
+    for (uint8_t pin = 0; pin < 16; pin++)
+    {
+        if (PinMask & (1U << pin))
+            mask |= 0x3U << (2 * pin);
+    }
+    return mask;
+}
+
+/*********************************************************************
+ * @fn      		- spread_mask4
+ * @brief           - Widen an 8-bit pin mask to one 4-bit field per pin
+ * @param[in]       - PinMask: bit n = pin n of one AFR half
+ * @return          - Mask with bits 4n+3:4n set for each selected pin
+ * @Note            - constexpr twin of the driver's AFR helper
+ *********************************************************************/
+constexpr uint32_t spread_mask4(uint8_t PinMask)
+{
+    uint32_t mask = 0;
+
+    for (uint8_t pin = 0; pin < 8; pin++)
+    {
+        if (PinMask & (1U << pin))
+            mask |= 0xFU << (4 * pin);
+    }
+    return mask;
+}
+
+/*********************************************************************
+ * @struct          - Port
+ * @brief           - GPIO port chosen at compile time
+ * @tparam          - Index: GPIO_PORT_INDEX value, 0 = GPIOA ... 8 = GPIOI
+ * @Note            - regs() is a constant address on the target (the
+ *                    shadow register file with USE_HOST_MMIO)
+ *********************************************************************/
+template <uint8_t Index>
+struct Port
+{
+    static_assert(Index < GPIO_PORT_COUNT, "GPIO port index out of range");
+
+    static constexpr uint8_t  index = Index;
+    static constexpr uint32_t baseaddr = GPIOA_BASEADDR + Index * 0x400U;
+    static constexpr uint32_t clock_bit = 1U << Index;
+
+    static GPIO_RegDef_t *regs()
+    {
+        return reinterpret_cast<GPIO_RegDef_t *>(MMIO_ADDR(baseaddr));
+    }
+
+    static void enable_clock()
+    {
+        RCC->AHB1ENR = RCC->AHB1ENR | clock_bit;
+    }
+};
+
+using PortA = Port<0>;
+using PortB = Port<1>;
+using PortC = Port<2>;
+using PortD = Port<3>;
+using PortE = Port<4>;
+using PortF = Port<5>;
+using PortG = Port<6>;
+using PortH = Port<7>;
+using PortI = Port<8>;
+
+/*********************************************************************
+ * @struct          - Pins
+ * @brief           - Group of pins of one port, selected by a mask
+ * @tparam          - P: Port<> type
+ * @tparam          - Mask: bit n = pin n
+ * @Note            - Same register sequences as GPIO_InitPins,
+ *                    GPIO_WriteMaskedPort and GPIO_ToggleOutputPins, with
+ *                    every mask folded by the compiler
+ *********************************************************************/
+template <typename P, uint16_t Mask>
+struct Pins
+{
+    static_assert(Mask != 0, "empty pin mask");
+
+    using port = P;
+    static constexpr uint16_t mask = Mask;
+
+    // Configure every pin in the mask. Interrupt modes go through
+    // GPIO_InitPins, which also routes the EXTI lines.
+    template <uint8_t Mode, uint8_t Speed = GPIO_SPEED_LOW, uint8_t Pupd = GPIO_NO_PUPD,
+              uint8_t OPType = GPIO_OP_TYPE_PP, uint8_t AltFn = 0>
+    static void init()
+    {
+        static_assert(Mode <= GPIO_MODE_IT_RFT, "invalid GPIO mode");
+        static_assert(Speed <= GPIO_SPEED_HIGH, "invalid GPIO speed");
+        static_assert(Pupd <= GPIO_PIN_PD, "invalid pull-up/pull-down");
+        static_assert(OPType <= GPIO_OP_TYPE_OD, "invalid output type");
+        static_assert(AltFn <= 15, "alternate function is AF0-AF15");
+
+        constexpr uint32_t mask2 = spread_mask2(Mask);
+        constexpr uint32_t afr_mask[2] = { spread_mask4(Mask & 0xFFU), spread_mask4(Mask >> 8) };
+        GPIO_RegDef_t *regs = P::regs();
+
+        if (Mode > GPIO_MODE_ANALOG)
+        {
+            const GPIO_PinMaskConfig_t config = { Mask, Mode, Speed, Pupd, OPType, AltFn };
+            GPIO_InitPins(regs, &config);
+            return;
+        }
+
+        P::enable_clock();
+        regs->MODER = (regs->MODER & ~mask2) | (mask2 & (Mode * 0x55555555U));
+        regs->OSPEEDR = (regs->OSPEEDR & ~mask2) | (mask2 & (Speed * 0x55555555U));
+        regs->PUPDR = (regs->PUPDR & ~mask2) | (mask2 & (Pupd * 0x55555555U));
+        regs->OTYPER = (regs->OTYPER & ~uint32_t(Mask)) | (OPType ? Mask : 0U);
+
+        if (Mode == GPIO_MODE_ALTFN)
+        {
+            for (uint8_t half = 0; half < 2; half++)
+            {
+                if (afr_mask[half])
+                    regs->AFR[half] = (regs->AFR[half] & ~afr_mask[half]) | (AltFn * 0x11111111U & afr_mask[half]);
+            }
+        }
+    }
+
+    static void set()
+    {
+        P::regs()->BSRR = Mask;
+    }
+
+    static void reset()
+    {
+        P::regs()->BSRR = uint32_t(Mask) << 16;
+    }
+
+    // Masked pins take the matching bits of Value, in one BSRR store
+    static void write(uint16_t Value)
+    {
+        P::regs()->BSRR = (uint32_t(~Value & Mask) << 16) | (Value & Mask);
+    }
+
+    static void toggle()
+    {
+        uint32_t odr = P::regs()->ODR;
+
+        P::regs()->BSRR = ((odr & Mask) << 16) | (~odr & Mask);
+    }
+
+    static uint16_t read()
+    {
+        return uint16_t(P::regs()->IDR & Mask);
+    }
+};
+
+/*********************************************************************
+ * @struct          - Pin
+ * @brief           - Single pin chosen at compile time
+ * @tparam          - P: Port<> type
+ * @tparam          - Number: pin number (0-15)
+ * @Note            - e.g. using Led = gpio::Pin<gpio::PortA, 5>;
+ *                    Led::init<GPIO_MODE_OUT>(); Led::set();
+ *********************************************************************/
+template <typename P, uint8_t Number>
+struct Pin : Pins<P, uint16_t(1U << (Number & 0xFU))>
+{
+    static_assert(Number < 16, "GPIO pin number is 0-15");
+
+    using base = Pins<P, uint16_t(1U << (Number & 0xFU))>;
+    static constexpr uint8_t number = Number;
+    static constexpr uint8_t irq = Number <= 4 ? IRQ_NO_EXTI0 + Number
+                                 : Number <= 9 ? IRQ_NO_EXTI9_5 : IRQ_NO_EXTI15_10;
+
+    // One BSRR store: the level only picks the set or reset half
+    static void write(bool Level)
+    {
+        P::regs()->BSRR = uint32_t(base::mask) << (Level ? 0 : 16);
+    }
+
+    static bool read()
+    {
+        return (P::regs()->IDR >> Number) & 1U;
+    }
+
+    // EXTI callback and NVIC line, for pins initialised in a GPIO_MODE_IT_* mode
+    static void on_interrupt(GPIO_EXTICallback_t Callback, uint8_t Priority)
+    {
+        GPIO_RegisterCallback(Number, Callback);
+        GPIO_IRQConfig(irq, Priority, ENABLE);
+    }
+};
+
+} // namespace gpio
+
+#endif /* INC_STM32F446RE_GPIO_PIN_HPP_ */
@@ -0,0 +1,25 @@
+/*
+ * stm32f446re_rcc_driver.h
+ *
+ * Clock tree queries for STM32F446RE: the bus frequencies the RCC is
+ * actually running, read back from CFGR and PLLCFGR
+ */
+
+#ifndef INC_STM32F446RE_RCC_DRIVER_H_
+#define INC_STM32F446RE_RCC_DRIVER_H_
+
+#include "stm32f446re.h"
+
+#define HSI_VALUE		16000000U	// Internal RC oscillator
+
+#ifndef HSE_VALUE
+#define HSE_VALUE		8000000U	// Nucleo-64: ST-LINK MCO, override for a crystal
+#endif
+
+// API Prototypes
+uint32_t RCC_GetSYSCLKValue(void);
+uint32_t RCC_GetHCLKValue(void);
+uint32_t RCC_GetPCLK1Value(void);
+uint32_t RCC_GetPCLK2Value(void);
+
+#endif /* INC_STM32F446RE_RCC_DRIVER_H_ */
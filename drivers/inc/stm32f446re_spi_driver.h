@@ -0,0 +1,170 @@
+/*
+ * stm32f446re_spi_driver.h
+ *
+ * SPI driver for STM32F446RE, SPI1-3: clock, pin and frame setup from a
+ * config, blocking block transfers that keep the shift register fed
+ * (full duplex, or transmit-only with the received frames discarded),
+ * 8- or 16-bit frames, DMA block transfers on SPI1 (DMA2), and a
+ * non-blocking transaction queue for several devices on one bus, each
+ * with its own mode, speed, frame size and chip select
+ */
+
+#ifndef INC_STM32F446RE_SPI_DRIVER_H_
+#define INC_STM32F446RE_SPI_DRIVER_H_
+
+#include "stm32f446re.h"
+#include "ring_buffer.h"
+
+typedef struct SPI_Handle SPI_Handle_t;
+typedef struct SPI_Transaction SPI_Transaction_t;
+
+// Driver event callback for SPI_TransferDMA, run from SPI_DMAIRQHandling
+typedef void (*SPI_Callback_t)(SPI_Handle_t *pSPIHandle, uint8_t Event);
+
+// Transaction done callback, run from SPI_IRQHandling / SPI_DMAIRQHandling;
+// it must not call SPI_Submit, but may set pXact->pNext
+typedef void (*SPI_XactCallback_t)(SPI_Transaction_t *pXact, uint8_t Event);
+
+typedef struct
+{
+uint8_t SPI_DeviceMode ;		// SPI_DEVICE_MODE_*
+uint8_t SPI_BusConfig ;			// SPI_BUS_CONFIG_*
+uint8_t SPI_SclkSpeed ;			// SPI_SCLK_SPEED_DIV*
+uint8_t SPI_DFF ;				// SPI_DFF_*
+uint8_t SPI_CPOL ;				// SPI_CPOL_*
+uint8_t SPI_CPHA ;				// SPI_CPHA_*
+uint8_t SPI_SSM ;				// SPI_SSM_*
+
+} SPI_Config_t;
+
+// One device on a shared bus: its CR1 settings and chip select
+typedef struct
+{
+uint8_t SPI_SclkSpeed ;			// SPI_SCLK_SPEED_DIV*
+uint8_t SPI_DFF ;				// SPI_DFF_*
+uint8_t SPI_CPOL ;				// SPI_CPOL_*
+uint8_t SPI_CPHA ;				// SPI_CPHA_*
+GPIO_RegDef_t *pCSPort ;		// Chip select, active low; NULL if the device has none
+uint8_t CSPin ;
+
+} SPI_Device_t;
+
+// Queued transfer; owned by the driver from SPI_Submit until Done returns
+struct SPI_Transaction
+{
+const SPI_Device_t *pDevice ;
+const uint8_t *pTxBuffer ;		// NULL to send SPI_DUMMY_FRAME
+uint8_t *pRxBuffer ;			// NULL to discard the received frames
+uint32_t Len ;					// Bytes (two per 16-bit frame)
+SPI_XactCallback_t Done ;		// Optional
+void *pContext ;				// For the Done callback
+volatile uint8_t Status ;		// SPI_XACT_*
+SPI_Transaction_t *pNext ;		// Started right after this one, ahead of the queue;
+								// set before SPI_Submit or from Done, cleared by the driver
+
+};
+
+struct SPI_Handle
+{
+SPI_RegDef_t *pSPIx ;
+SPI_Config_t SPIConfig ;		// Read by SPI_Init
+SPI_Callback_t Callback ;		// Optional, set before SPI_TransferDMA
+uint32_t SclkHz ;				// SCK frequency from the live PCLK and SPI_SclkSpeed
+DMA_RegDef_t *pDMA ;			// NULL if the port has no DMA mapping
+uint8_t TxStream ;
+uint8_t RxStream ;
+uint8_t DMAChannel ;
+volatile uint8_t DMABusy ;		// Set by SPI_TransferDMA, cleared on completion
+const uint8_t *pTxData ;		// Block being transferred by DMA, NULL for dummy frames
+uint8_t *pRxData ;				// NULL if the received frames are discarded
+uint32_t Len ;					// Frames in the DMA block
+RingBuffer_t Queue ;			// SPI_Transaction_t pointers, filled by SPI_Submit
+SPI_Transaction_t *volatile pActive ;	// Transaction on the bus, NULL when idle
+const SPI_Device_t *pCurDevice ;	// Device CR1 is set up for, NULL after SPI_Init
+uint32_t XferCount ;			// Frames of an interrupt-driven transaction
+uint32_t XferTx ;				// Frames written to DR
+uint32_t XferRx ;				// Frames read from DR
+uint32_t Reconfigs ;			// CR1 rewrites for a change of device
+
+};
+
+// @SPI_DeviceMode
+#define SPI_DEVICE_MODE_SLAVE		0
+#define SPI_DEVICE_MODE_MASTER		1
+
+// @SPI_BusConfig
+#define SPI_BUS_CONFIG_FD				1	// Full duplex, MOSI and MISO
+#define SPI_BUS_CONFIG_HD				2	// Bidirectional on one data line
+#define SPI_BUS_CONFIG_SIMPLEX_RXONLY	3
+
+// @SPI_SclkSpeed: SCK = PCLK / 2^(value + 1)
+#define SPI_SCLK_SPEED_DIV2		0
+#define SPI_SCLK_SPEED_DIV4		1
+#define SPI_SCLK_SPEED_DIV8		2
+#define SPI_SCLK_SPEED_DIV16	3
+#define SPI_SCLK_SPEED_DIV32	4
+#define SPI_SCLK_SPEED_DIV64	5
+#define SPI_SCLK_SPEED_DIV128	6
+#define SPI_SCLK_SPEED_DIV256	7
+
+// @SPI_DFF: 16-bit frames take two buffer bytes each, half-word aligned
+#define SPI_DFF_8BITS			0
+#define SPI_DFF_16BITS			1
+
+// @SPI_CPOL
+#define SPI_CPOL_LOW			0	// SCK idles low
+#define SPI_CPOL_HIGH			1
+
+// @SPI_CPHA
+#define SPI_CPHA_LOW			0	// Data sampled on the first edge
+#define SPI_CPHA_HIGH			1
+
+// @SPI_SSM
+#define SPI_SSM_DI				0	// NSS pin driven/read by hardware
+#define SPI_SSM_EN				1	// NSS internal, chip select left to the application
+
+// Callback events
+#define SPI_EVENT_XFER_CMPLT	0	// DMA block sent and received
+#define SPI_EVENT_XFER_ERROR	1	// DMA transfer error or RX overrun, block aborted
+
+// @Status of a queued transaction
+#define SPI_XACT_IDLE			0	// Never submitted
+#define SPI_XACT_QUEUED			1
+#define SPI_XACT_ACTIVE			2
+#define SPI_XACT_DONE			3
+#define SPI_XACT_ERROR			4
+
+#define SPI_DUMMY_FRAME			0xFFFFU	// Sent when there is no TX data (MOSI held high)
+#define SPI_DMA_MAX_FRAMES		0xFFFFU	// NDTR is 16 bits
+#define SPI_DMA_MIN_LEN			16U		// Shorter queued transactions run by interrupt
+
+// API Prototypes
+
+// Peripheral Clock Setup
+void SPI_PeriClockControl(SPI_RegDef_t *pSPIx, uint8_t EnorDi);
+
+// Init and De-init
+uint8_t SPI_Init(SPI_Handle_t *pSPIHandle);
+void    SPI_DeInit(SPI_RegDef_t *pSPIx);
+
+// Blocking transfers, Len in bytes
+void SPI_TransferData(SPI_Handle_t *pSPIHandle, const uint8_t *pTxBuffer, uint8_t *pRxBuffer, uint32_t Len);
+void SPI_SendData(SPI_Handle_t *pSPIHandle, const uint8_t *pTxBuffer, uint32_t Len);
+void SPI_ReceiveData(SPI_Handle_t *pSPIHandle, uint8_t *pRxBuffer, uint32_t Len);
+
+// Non-blocking DMA transfer
+uint8_t SPI_TransferDMA(SPI_Handle_t *pSPIHandle, const uint8_t *pTxBuffer, uint8_t *pRxBuffer, uint32_t Len);
+uint8_t SPI_Busy(SPI_Handle_t *pSPIHandle);
+
+// Transaction queue
+void    SPI_DeviceInit(const SPI_Device_t *pDevice);
+uint8_t SPI_QueueInit(SPI_Handle_t *pSPIHandle, SPI_Transaction_t **pStorage, uint32_t Slots);
+uint8_t SPI_Submit(SPI_Handle_t *pSPIHandle, SPI_Transaction_t *pXact);
+uint8_t SPI_QueueIdle(SPI_Handle_t *pSPIHandle);
+
+// IRQ Configuration and Handling
+void SPI_IRQConfig(uint8_t IRQNumber, uint8_t IRQPriority, uint8_t EnorDi);
+void SPI_IRQHandling(SPI_Handle_t *pSPIHandle);
+void SPI_DMAIRQHandling(SPI_Handle_t *pSPIHandle);
+
+#endif /* INC_STM32F446RE_SPI_DRIVER_H_ */
@@ -0,0 +1,131 @@
+/*
+ * stm32f446re_timer_driver.h
+ *
+ * Timer driver for STM32F446RE, general-purpose timers TIM2-TIM5:
+ * prescaler and auto-reload worked out from a period in microseconds and
+ * the live clock tree, periodic or one-pulse update events, output
+ * compare, input capture, and a software timer service that runs any
+ * number of deadlines off one compare channel of a free-running counter
+ * (tickless: the channel interrupt fires only when a deadline is due)
+ */
+
+#ifndef INC_STM32F446RE_TIMER_DRIVER_H_
+#define INC_STM32F446RE_TIMER_DRIVER_H_
+
+#include "stm32f446re.h"
+
+typedef struct TIM_Handle TIM_Handle_t;
+typedef struct TIM_SoftTimer TIM_SoftTimer_t;
+
+// Driver event callback, run from TIM_IRQHandling
+typedef void (*TIM_Callback_t)(TIM_Handle_t *pTIMHandle, uint8_t Event);
+
+// Software timer expiry, run from TIM_IRQHandling
+typedef void (*TIM_SoftTimerFn_t)(TIM_SoftTimer_t *pTimer);
+
+typedef struct
+{
+uint32_t TIM_PeriodUs ;			// Update period; 0 = full counter range (free-running)
+uint32_t TIM_TickHz ;			// Counter clock; 0 = the finest that fits TIM_PeriodUs
+								// (or up to 1/16 coarser for an exact period)
+uint8_t TIM_OnePulse ;			// TIM_ONE_PULSE_*
+uint8_t TIM_UpdateIT ;			// ENABLE: TIM_EVENT_UPDATE at every update event
+
+} TIM_Config_t;
+
+// Software timer; owned by the driver from TIM_SoftTimerStart until it
+// expires (one-shot) or is stopped
+struct TIM_SoftTimer
+{
+TIM_SoftTimer_t *pNext ;		// Next deadline, driver use
+uint32_t Deadline ;				// Counter value it expires at, driver use
+uint32_t PeriodTicks ;			// Reload after expiry; 0 = one-shot
+TIM_SoftTimerFn_t Fn ;
+void *pContext ;				// For Fn
+volatile uint8_t Active ;
+
+};
+
+struct TIM_Handle
+{
+TIM_RegDef_t *pTIMx ;
+TIM_Config_t TIMConfig ;		// Read by TIM_Init
+TIM_Callback_t Callback ;		// Optional, set before enabling interrupts
+uint32_t ClockHz ;				// TIMxCLK from the live PCLK1 and APB1 prescaler
+uint32_t Prescaler ;			// PSC + 1
+uint32_t AutoReload ;			// ARR: period in ticks - 1
+uint32_t CounterMask ;			// 0xFFFF (TIM3/TIM4) or 0xFFFFFFFF (TIM2/TIM5)
+uint8_t IRQNumber ;
+uint32_t Capture[4] ;			// Last value captured on each input capture channel
+uint32_t Overcaptures ;			// Captures lost before the previous one was read
+uint8_t SoftChannel ;			// Compare channel of the software timers, 0 if none
+TIM_SoftTimer_t *pSoftHead ;	// Armed software timers, earliest deadline first
+uint32_t SoftExpired ;			// Software timer expiries
+uint32_t SoftIRQs ;				// Compare interrupts taken for them
+
+};
+
+// @TIM_OnePulse
+#define TIM_ONE_PULSE_DI		0	// Counter keeps running (periodic)
+#define TIM_ONE_PULSE_EN		1	// Counter stops at the update event (OPM)
+
+// @Channel: 1-4
+#define TIM_CHANNEL_1			1
+#define TIM_CHANNEL_2			2
+#define TIM_CHANNEL_3			3
+#define TIM_CHANNEL_4			4
+
+// @OCMode: OCxM values
+#define TIM_OC_MODE_TIMING		0	// Compare flag/interrupt only, pin untouched
+#define TIM_OC_MODE_ACTIVE		1	// Pin set on match
+#define TIM_OC_MODE_INACTIVE	2	// Pin cleared on match
+#define TIM_OC_MODE_TOGGLE		3
+#define TIM_OC_MODE_PWM1		6	// Active while CNT < CCR
+#define TIM_OC_MODE_PWM2		7	// Active from CCR on (one-pulse delay)
+
+// @ICEdge
+#define TIM_IC_EDGE_RISING		0
+#define TIM_IC_EDGE_FALLING		1
+#define TIM_IC_EDGE_BOTH		3
+
+// Callback events
+#define TIM_EVENT_UPDATE		0	// Counter overflow (one-pulse: end of the pulse)
+#define TIM_EVENT_CC1			1	// Compare match or capture on channel x: TIM_EVENT_CC1 + (x - 1)
+#define TIM_EVENT_CC2			2
+#define TIM_EVENT_CC3			3
+#define TIM_EVENT_CC4			4
+
+// API Prototypes
+
+// Peripheral Clock Setup
+void TIM_PeriClockControl(TIM_RegDef_t *pTIMx, uint8_t EnorDi);
+
+// Init and De-init
+uint8_t TIM_Init(TIM_Handle_t *pTIMHandle);
+void    TIM_DeInit(TIM_RegDef_t *pTIMx);
+
+// Counter
+void     TIM_Start(TIM_Handle_t *pTIMHandle);
+void     TIM_Stop(TIM_Handle_t *pTIMHandle);
+uint32_t TIM_GetCounter(TIM_Handle_t *pTIMHandle);
+uint32_t TIM_UsToTicks(TIM_Handle_t *pTIMHandle, uint32_t Us);
+
+// Channels
+uint8_t  TIM_OCConfig(TIM_Handle_t *pTIMHandle, uint8_t Channel, uint8_t OCMode, uint32_t Compare);
+uint8_t  TIM_ICConfig(TIM_Handle_t *pTIMHandle, uint8_t Channel, uint8_t ICEdge, uint8_t ICFilter);
+void     TIM_SetCompare(TIM_Handle_t *pTIMHandle, uint8_t Channel, uint32_t Compare);
+uint32_t TIM_GetCapture(TIM_Handle_t *pTIMHandle, uint8_t Channel);
+void     TIM_ChannelITConfig(TIM_Handle_t *pTIMHandle, uint8_t Channel, uint8_t EnorDi);
+
+// Software timers on a compare channel
+uint8_t  TIM_SoftTimerInit(TIM_Handle_t *pTIMHandle, uint8_t Channel);
+uint8_t  TIM_SoftTimerStart(TIM_Handle_t *pTIMHandle, TIM_SoftTimer_t *pTimer, uint32_t DelayTicks, uint32_t PeriodTicks);
+uint8_t  TIM_SoftTimerStop(TIM_Handle_t *pTIMHandle, TIM_SoftTimer_t *pTimer);
+uint32_t TIM_SoftTimerMaxTicks(TIM_Handle_t *pTIMHandle);
+uint32_t TIM_SoftTimerNextTicks(TIM_Handle_t *pTIMHandle);
+
+// IRQ Configuration and Handling
+void TIM_IRQConfig(uint8_t IRQNumber, uint8_t IRQPriority, uint8_t EnorDi);
+void TIM_IRQHandling(TIM_Handle_t *pTIMHandle);
+
+#endif /* INC_STM32F446RE_TIMER_DRIVER_H_ */
@@ -0,0 +1,146 @@
+/*
+ * stm32f446re_usart_driver.h
+ *
+ * USART driver for STM32F446RE, all six ports (USART1/2/3/6, UART4/5):
+ * clock, pin and baud rate setup from the live clock tree, polling,
+ * interrupt or DMA transfers behind USART_Send/USART_Receive, non-blocking
+ * transmit through a TX ring buffer drained by the TXE interrupt or by DMA,
+ * and circular DMA reception with idle-line detection
+ */
+
+#ifndef INC_STM32F446RE_USART_DRIVER_H_
+#define INC_STM32F446RE_USART_DRIVER_H_
+
+#include "stm32f446re.h"
+#include "ring_buffer.h"
+
+typedef struct USART_Handle USART_Handle_t;
+
+// Driver event callback, run from USART_IRQHandling and the DMA IRQ handlers
+typedef void (*USART_Callback_t)(USART_Handle_t *pUSARTHandle, uint8_t Event);
+
+typedef struct
+{
+uint8_t USART_Mode ;			// USART_MODE_*
+uint32_t USART_Baud ;			// Bits per second
+uint8_t USART_NoOfStopBits ;	// USART_STOPBITS_*
+uint8_t USART_WordLength ;		// USART_WORDLEN_*
+uint8_t USART_ParityControl ;	// USART_PARITY_*
+uint8_t USART_HWFlowControl ;	// USART_HW_FLOW_CTRL_*
+uint8_t USART_Oversampling ;	// USART_OVERSAMPLING_*
+uint8_t USART_TxMode ;			// USART_XFER_*
+uint8_t USART_RxMode ;			// USART_XFER_*
+uint8_t *pTxStorage ;			// TX ring buffer, power of two (IT and DMA TX)
+uint32_t TxStorageSize ;
+uint8_t *pRxStorage ;			// RX ring buffer, power of two (IT and DMA RX)
+uint32_t RxStorageSize ;
+
+} USART_Config_t;
+
+struct USART_Handle
+{
+USART_RegDef_t *pUSARTx ;
+USART_Config_t USART_Config ;	// Read by USART_Init
+USART_Callback_t Callback ;		// Optional, set before USART_Init / USART_TxInit
+uint32_t BaudActual ;			// Baud rate the programmed BRR gives
+int32_t BaudErrorPpm ;			// (BaudActual - USART_Baud) / USART_Baud, in ppm
+RingBuffer_t TxBuffer ;			// Filled by USART_SendIT, drained by TXE
+DMA_RegDef_t *pTxDMA ;			// NULL if the port has no TX DMA mapping
+uint8_t TxStream ;
+uint8_t TxChannel ;
+volatile uint8_t TxDMABusy ;	// Set by USART_SendDMA, cleared on DMA transfer complete
+const uint8_t *pTxData ;		// Block being sent by DMA
+uint32_t TxLen ;
+RingBuffer_t RxBuffer ;			// Filled by RXNE or circular DMA, read with RingBuffer_Get*
+DMA_RegDef_t *pRxDMA ;			// NULL if the port has no RX DMA mapping
+uint8_t RxStream ;
+uint8_t RxChannel ;
+uint32_t RxPos ;				// DMA write offset at the last HT/TC/IDLE
+uint32_t RxBurstLen ;			// Bytes received since the last idle line
+uint32_t RxFrameLen ;			// Bytes of the burst that ended, for USART_EVENT_RX_IDLE
+volatile uint32_t RxOverruns ;	// Bytes lost (RXNE) or times the DMA overwrote unread bytes
+
+};
+
+// @USART_Mode
+#define USART_MODE_ONLY_TX		0
+#define USART_MODE_ONLY_RX		1
+#define USART_MODE_TXRX			2
+
+// @USART_NoOfStopBits
+#define USART_STOPBITS_1		0
+#define USART_STOPBITS_2		2
+
+// @USART_WordLength: 9 bits carries 8 data bits plus parity
+#define USART_WORDLEN_8BITS		0
+#define USART_WORDLEN_9BITS		1
+
+// @USART_ParityControl
+#define USART_PARITY_DISABLE	0
+#define USART_PARITY_EN_EVEN	1
+#define USART_PARITY_EN_ODD		2
+
+// @USART_HWFlowControl (USART1/2/3/6 only)
+#define USART_HW_FLOW_CTRL_NONE		0
+#define USART_HW_FLOW_CTRL_CTS		1
+#define USART_HW_FLOW_CTRL_RTS		2
+#define USART_HW_FLOW_CTRL_CTS_RTS	3
+
+// @USART_Oversampling
+#define USART_OVERSAMPLING_16	0	// Best noise tolerance, baud up to PCLK/16
+#define USART_OVERSAMPLING_8	1	// Baud up to PCLK/8
+#define USART_OVERSAMPLING_AUTO	2	// 16, or 8 where 16 cannot reach the baud rate
+
+// @USART_TxMode / @USART_RxMode
+#define USART_XFER_POLL			0	// Busy-wait on TXE / RXNE
+#define USART_XFER_IT			1	// Ring buffer and TXE / RXNE interrupts
+#define USART_XFER_DMA			2	// TX: DMA for blocks, RX: circular DMA
+
+// Callback events
+#define USART_EVENT_TX_CMPLT	0	// Everything queued so far has left the shift register
+#define USART_EVENT_TX_ERROR	1	// DMA transfer error, block aborted
+#define USART_EVENT_RX_DATA		2	// Half or full RX buffer received (HT/TC)
+#define USART_EVENT_RX_IDLE		3	// Line idle after a burst of RxFrameLen bytes
+#define USART_EVENT_RX_OVERRUN	4	// Received bytes were lost or overwritten
+#define USART_EVENT_RX_ERROR	5	// RX DMA transfer error, reception stopped
+
+#define USART_DMA_MAX_LEN		0xFFFFU	// NDTR is 16 bits
+#define USART_DMA_MIN_LEN		16U		// Shorter blocks are copied: cheaper than a DMA setup
+#define USART_BAUD_MAX_ERROR_PPM	20000	// 2%: within the receiver tolerance with margin
+
+// API Prototypes
+
+// Peripheral Clock Setup
+void USART_PeriClockControl(USART_RegDef_t *pUSARTx, uint8_t EnorDi);
+
+// Init and De-init
+uint8_t  USART_Init(USART_Handle_t *pUSARTHandle);
+void     USART_DeInit(USART_RegDef_t *pUSARTx);
+uint32_t USART_ComputeBRR(uint32_t PClk, uint32_t Baud, uint8_t Over8, int32_t *pErrorPpm);
+uint8_t  USART_TxInit(USART_Handle_t *pUSARTHandle, uint8_t *pTxStorage, uint32_t Size);
+
+// Transfers in the handle's USART_TxMode / USART_RxMode
+uint32_t USART_Send(USART_Handle_t *pUSARTHandle, const uint8_t *pTxBuffer, uint32_t Len);
+uint32_t USART_Receive(USART_Handle_t *pUSARTHandle, uint8_t *pRxBuffer, uint32_t Len);
+
+// Blocking transfers
+void USART_SendData(USART_Handle_t *pUSARTHandle, const uint8_t *pTxBuffer, uint32_t Len);
+void USART_ReceiveData(USART_Handle_t *pUSARTHandle, uint8_t *pRxBuffer, uint32_t Len);
+
+// Non-blocking transmit
+uint32_t USART_SendIT(USART_Handle_t *pUSARTHandle, const uint8_t *pTxBuffer, uint32_t Len);
+uint8_t  USART_SendDMA(USART_Handle_t *pUSARTHandle, const uint8_t *pTxBuffer, uint32_t Len);
+uint8_t  USART_TxBusy(USART_Handle_t *pUSARTHandle);
+
+// Interrupt reception (RXNE) and circular DMA reception into pUSARTHandle->RxBuffer
+uint8_t USART_ReceiveITStart(USART_Handle_t *pUSARTHandle, uint8_t *pRxStorage, uint32_t Size);
+uint8_t USART_ReceiveDMAStart(USART_Handle_t *pUSARTHandle, uint8_t *pRxStorage, uint32_t Size);
+void    USART_ReceiveDMAStop(USART_Handle_t *pUSARTHandle);
+
+// IRQ Configuration and Handling
+void USART_IRQConfig(uint8_t IRQNumber, uint8_t IRQPriority, uint8_t EnorDi);
+void USART_IRQHandling(USART_Handle_t *pUSARTHandle);
+void USART_TxDMAIRQHandling(USART_Handle_t *pUSARTHandle);
+void USART_RxDMAIRQHandling(USART_Handle_t *pUSARTHandle);
+
+#endif /* INC_STM32F446RE_USART_DRIVER_H_ */
@@ -0,0 +1,82 @@
+/*
+ * timer_wheel.h
+ *
+ * Hierarchical timing wheel for large numbers of software timers
+ * A periodic interrupt (SysTick, a TIM update event) only counts ticks;
+ * the main loop advances the wheel and runs the expiry callbacks, so no
+ * callback runs in interrupt context and the wheel lists need no locking.
+ */
+
+#ifndef INC_TIMER_WHEEL_H_
+#define INC_TIMER_WHEEL_H_
+
+#include <stdint.h>
+
+/*
+ * Level 0 has one slot per tick for the next 256 ticks. Each further
+ * level has 64 slots, each covering a whole turn of the level below, so
+ * four of them reach 2^32 ticks. A timer is linked into the slot its
+ * expiry falls in; when a level wraps, the next slot up is emptied into
+ * the finer levels (cascading). Start and stop are O(1), each tick
+ * looks at one level-0 slot, and a timer is moved at most once per level.
+ */
+#define TW_ROOT_BITS			8
+#define TW_ROOT_SIZE			(1U << TW_ROOT_BITS)
+#define TW_ROOT_MASK			(TW_ROOT_SIZE - 1U)
+#define TW_LEVEL_BITS			6
+#define TW_LEVEL_SIZE			(1U << TW_LEVEL_BITS)
+#define TW_LEVEL_MASK			(TW_LEVEL_SIZE - 1U)
+#define TW_LEVELS				4
+
+// Longest delay: about 24 days at a 1 ms tick
+#define TW_MAX_DELAY			0x7FFFFFFFU
+
+typedef struct WheelTimer WheelTimer_t;
+
+// Expiry callback, run from TimerWheel_Process
+typedef void (*WheelTimerFn_t)(WheelTimer_t *pTimer);
+
+// Software timer; owned by the wheel from TimerWheel_Start until it
+// expires (one-shot) or is stopped
+struct WheelTimer
+{
+	WheelTimer_t  *pNext;		// Next timer in the slot, wheel use
+	WheelTimer_t **ppPrev;		// Link pointing at this timer, NULL while idle
+	uint32_t       Expires;		// Tick it expires at, wheel use
+	uint32_t       PeriodTicks;	// Reload after expiry; 0 = one-shot
+	WheelTimerFn_t Fn;
+	void          *pContext;	// For Fn
+
+};
+
+/*
+ * Ticks is written only by TimerWheel_Tick (the interrupt), everything
+ * else only by the thread that calls TimerWheel_Start/Stop/Process.
+ */
+typedef struct
+{
+	WheelTimer_t *pRoot[TW_ROOT_SIZE];
+	WheelTimer_t *pLevel[TW_LEVELS][TW_LEVEL_SIZE];
+	WheelTimer_t *pExpiring;	// Timers of the slot being expired
+	uint32_t Ticks;				// Ticks counted by the interrupt
+	uint32_t Now;				// Last tick processed
+	uint32_t Active;			// Timers started and not yet expired or stopped
+	uint32_t Expired;			// Callbacks run
+	uint32_t Cascaded;			// Timers moved down a level
+
+} TimerWheel_t;
+
+// Setup (before the tick interrupt is enabled)
+void     TimerWheel_Init(TimerWheel_t *pTW);
+
+// Interrupt side
+void     TimerWheel_Tick(TimerWheel_t *pTW);
+
+// Thread side
+uint8_t  TimerWheel_Start(TimerWheel_t *pTW, WheelTimer_t *pTimer, uint32_t DelayTicks, uint32_t PeriodTicks);
+uint8_t  TimerWheel_Stop(TimerWheel_t *pTW, WheelTimer_t *pTimer);
+uint8_t  TimerWheel_IsActive(const WheelTimer_t *pTimer);
+uint32_t TimerWheel_Pending(TimerWheel_t *pTW);
+uint32_t TimerWheel_Process(TimerWheel_t *pTW);
+
+#endif /* INC_TIMER_WHEEL_H_ */
@@ -0,0 +1,210 @@
+/*
+ * ring_buffer.c
+ *
+ * Lock-free single-producer/single-consumer byte ring buffer
+ */
+
+#include <string.h>
+#include "ring_buffer.h"
+
+/*
+ * Index hand-over between producer and consumer. The release store
+ * publishes the data copied before it; the acquire load makes that data
+ * visible before it is read. On Cortex-M4 these emit DMB, on the host the
+ * matching fences.
+ */
+#define RB_LOAD_ACQUIRE(p)		__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define RB_STORE_RELEASE(p, v)	__atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define RB_LOAD_OWN(p)			__atomic_load_n((p), __ATOMIC_RELAXED)
+
+/*********************************************************************
+ * @fn      		- RingBuffer_Init
+ * @brief           - Attach storage to a ring buffer and empty it
+ * @param[in]       - pRB: ring buffer
+ * @param[in]       - pStorage: Size bytes of storage
+ * @param[in]       - Size: buffer size, a power of two
+ * @return          - 1 on success, 0 if Size is not a power of two
+ * @Note            - All Size bytes are usable
+ *********************************************************************/
+uint8_t RingBuffer_Init(RingBuffer_t *pRB, uint8_t *pStorage, uint32_t Size)
+{
+    if (pStorage == NULL || Size == 0 || (Size & (Size - 1)) != 0 || Size > 0x80000000U)
+        return 0;
+
+    pRB->pBuffer = pStorage;
+    pRB->Size = Size;
+    pRB->Mask = Size - 1;
+    RingBuffer_Reset(pRB);
+    return 1;
+}
+
+/*********************************************************************
+ * @fn      		- RingBuffer_Reset
+ * @brief           - Discard the buffer contents
+ * @param[in]       - pRB: ring buffer
+ * @return          - None
+ * @Note            - Only while neither side is running
+ *********************************************************************/
+void RingBuffer_Reset(RingBuffer_t *pRB)
+{
+    RB_STORE_RELEASE(&pRB->Head, 0U);
+    RB_STORE_RELEASE(&pRB->Tail, 0U);
+}
+
+/*********************************************************************
+ * @fn      		- RingBuffer_Put
+ * @brief           - Append one byte (producer)
+ * @param[in]       - pRB: ring buffer
+ * @param[in]       - Data: byte to store
+ * @return          - 1 if stored, 0 if the buffer was full
+ * @Note            - Safe against a concurrent consumer, ISR or thread
+ *********************************************************************/
+uint8_t RingBuffer_Put(RingBuffer_t *pRB, uint8_t Data)
+{
+    uint32_t head = RB_LOAD_OWN(&pRB->Head);
+
+    if (head - RB_LOAD_ACQUIRE(&pRB->Tail) == pRB->Size)
+        return 0;
+
+    pRB->pBuffer[head & pRB->Mask] = Data;
+    RB_STORE_RELEASE(&pRB->Head, head + 1);
+    return 1;
+}
+
+/*********************************************************************
+ * @fn      		- RingBuffer_PutBulk
+ * @brief           - Append up to Len bytes (producer)
+ * @param[in]       - pRB: ring buffer
+ * @param[in]       - pData: bytes to store
+ * @param[in]       - Len: number of bytes
+ * @return          - Number of bytes stored (less than Len if full)
+ * @Note            - At most two memcpy calls and one index update,
+ *                    so the consumer sees the whole block at once
+ *********************************************************************/
+uint32_t RingBuffer_PutBulk(RingBuffer_t *pRB, const uint8_t *pData, uint32_t Len)
+{
+    uint32_t head = RB_LOAD_OWN(&pRB->Head);
+    uint32_t space = pRB->Size - (head - RB_LOAD_ACQUIRE(&pRB->Tail));
+    uint32_t offset = head & pRB->Mask;
+    uint32_t first;
+
+    if (Len > space)
+        Len = space;
+    if (Len == 0)
+        return 0;
+
+    first = pRB->Size - offset;
+    if (first > Len)
+        first = Len;
+
+    memcpy(&pRB->pBuffer[offset], pData, first);
+    memcpy(pRB->pBuffer, pData + first, Len - first);
+    RB_STORE_RELEASE(&pRB->Head, head + Len);
+    return Len;
+}
+
+/*********************************************************************
+ * @fn      		- RingBuffer_Free
+ * @brief           - Bytes that can be put without overflow (producer)
+ * @param[in]       - pRB: ring buffer
+ * @return          - Free space; may only grow until the next put
+ *********************************************************************/
+uint32_t RingBuffer_Free(RingBuffer_t *pRB)
+{
+    uint32_t used = RB_LOAD_OWN(&pRB->Head) - RB_LOAD_ACQUIRE(&pRB->Tail);
+
+    return used < pRB->Size ? pRB->Size - used : 0;
+}
+
+/*********************************************************************
+ * @fn      		- RingBuffer_Commit
+ * @brief           - Publish Len bytes written straight into the storage
+ *                    (producer)
+ * @param[in]       - pRB: ring buffer
+ * @param[in]       - Len: bytes written at slot Head & Mask onwards
+ * @return          - 1, or 0 if they overwrote bytes not yet read
+ * @Note            - For producers that cannot wait, e.g. circular DMA
+ *                    into pBuffer. After an overrun the consumer loses
+ *                    the oldest bytes, never reads stale ones.
+ *********************************************************************/
+uint8_t RingBuffer_Commit(RingBuffer_t *pRB, uint32_t Len)
+{
+    uint32_t head = RB_LOAD_OWN(&pRB->Head) + Len;
+
+    RB_STORE_RELEASE(&pRB->Head, head);
+    return head - RB_LOAD_ACQUIRE(&pRB->Tail) <= pRB->Size;
+}
+
+/*********************************************************************
+ * @fn      		- RingBuffer_Get
+ * @brief           - Remove the oldest byte (consumer)
+ * @param[in]       - pRB: ring buffer
+ * @param[out]      - pData: byte read
+ * @return          - 1 if a byte was read, 0 if the buffer was empty
+ * @Note            - Safe against a concurrent producer, ISR or thread
+ *********************************************************************/
+uint8_t RingBuffer_Get(RingBuffer_t *pRB, uint8_t *pData)
+{
+    uint32_t tail = RB_LOAD_OWN(&pRB->Tail);
+    uint32_t head = RB_LOAD_ACQUIRE(&pRB->Head);
+
+    if (head == tail)
+        return 0;
+    if (head - tail > pRB->Size)
+        tail = head - pRB->Size;	// Overrun by RingBuffer_Commit
+
+    *pData = pRB->pBuffer[tail & pRB->Mask];
+    RB_STORE_RELEASE(&pRB->Tail, tail + 1);
+    return 1;
+}
+
+/*********************************************************************
+ * @fn      		- RingBuffer_GetBulk
+ * @brief           - Remove up to Len bytes (consumer)
+ * @param[in]       - pRB: ring buffer
+ * @param[out]      - pData: destination
+ * @param[in]       - Len: maximum number of bytes
+ * @return          - Number of bytes read
+ * @Note            - At most two memcpy calls and one index update
+ *********************************************************************/
+uint32_t RingBuffer_GetBulk(RingBuffer_t *pRB, uint8_t *pData, uint32_t Len)
+{
+    uint32_t tail = RB_LOAD_OWN(&pRB->Tail);
+    uint32_t count = RB_LOAD_ACQUIRE(&pRB->Head) - tail;
+    uint32_t offset;
+    uint32_t first;
+
+    if (count > pRB->Size)
+    {
+        tail += count - pRB->Size;	// Overrun by RingBuffer_Commit
+        count = pRB->Size;
+    }
+    offset = tail & pRB->Mask;
+
+    if (Len > count)
+        Len = count;
+    if (Len == 0)
+        return 0;
+
+    first = pRB->Size - offset;
+    if (first > Len)
+        first = Len;
+
+    memcpy(pData, &pRB->pBuffer[offset], first);
+    memcpy(pData + first, pRB->pBuffer, Len - first);
+    RB_STORE_RELEASE(&pRB->Tail, tail + Len);
+    return Len;
+}
+
+/*********************************************************************
+ * @fn      		- RingBuffer_Count
+ * @brief           - Bytes waiting to be read (consumer)
+ * @param[in]       - pRB: ring buffer
+ * @return          - Fill level; may only grow until the next get
+ *********************************************************************/
+uint32_t RingBuffer_Count(RingBuffer_t *pRB)
+{
+    uint32_t count = RB_LOAD_ACQUIRE(&pRB->Head) - RB_LOAD_OWN(&pRB->Tail);
+
+    return count < pRB->Size ? count : pRB->Size;
+}
@@ -5,61 +5,86 @@
  * This file provides full GPIO functionality with proper error handling
  */
 
+#include <stddef.h>
 #include "stm32f446re_gpio_drivers.h"
 
+// Per-line EXTI callbacks, indexed by pin number (= EXTI line)
+static GPIO_EXTICallback_t exti_callbacks[16];
+
 /*********************************************************************
  * @fn      		- GPIO_PeriClockControl
  * @brief           - Enable or disable peripheral clock for GPIO port
  * @param[in]       - pGPIOx: Base address of the GPIO peripheral
  * @param[in]       - EnorDi: ENABLE or DISABLE macro
  * @return          - None
- * @Note            - None
+ * @Note            - The port index comes from the base address, so
+ *                    each path is one indexed bit operation
  *********************************************************************/
 void GPIO_PeriClockControl(GPIO_RegDef_t *pGPIOx, uint8_t EnorDi)
 {
+    uint32_t port = GPIO_PORT_INDEX(pGPIOx);
+
+    if (port >= GPIO_PORT_COUNT)
+        return;
+
     if (EnorDi == ENABLE)
-    {
-        if (pGPIOx == GPIOA)
-            GPIOA_PCLK_EN();
-        else if (pGPIOx == GPIOB)
-            GPIOB_PCLK_EN();
-        else if (pGPIOx == GPIOC)
-            GPIOC_PCLK_EN();
-        else if (pGPIOx == GPIOD)
-            GPIOD_PCLK_EN();
-        else if (pGPIOx == GPIOE)
-            GPIOE_PCLK_EN();
-        else if (pGPIOx == GPIOF)
-            GPIOF_PCLK_EN();
-        else if (pGPIOx == GPIOG)
-            GPIOG_PCLK_EN();
-        else if (pGPIOx == GPIOH)
-            GPIOH_PCLK_EN();
-        else if (pGPIOx == GPIOI)
-            GPIOI_PCLK_EN();
-    }
+        GPIO_PCLK_EN(port);
     else
-    {
-        // Disable clock if needed (optional for power saving)
-        if (pGPIOx == GPIOA)
-            RCC->AHB1ENR &= ~(1 << 0);
-        else if (pGPIOx == GPIOB)
-            RCC->AHB1ENR &= ~(1 << 1);
-        else if (pGPIOx == GPIOC)
-            RCC->AHB1ENR &= ~(1 << 2);
-        else if (pGPIOx == GPIOD)
-            RCC->AHB1ENR &= ~(1 << 3);
-        else if (pGPIOx == GPIOE)
-            RCC->AHB1ENR &= ~(1 << 4);
-        else if (pGPIOx == GPIOF)
-            RCC->AHB1ENR &= ~(1 << 5);
-        else if (pGPIOx == GPIOG)
-            RCC->AHB1ENR &= ~(1 << 6);
-        else if (pGPIOx == GPIOH)
-            RCC->AHB1ENR &= ~(1 << 7);
-        else if (pGPIOx == GPIOI)
-            RCC->AHB1ENR &= ~(1 << 8);
-    }
+        GPIO_PCLK_DI(port); // Optional, for power saving
+}
+
+/*********************************************************************
+ * @fn      		- GPIO_PeriClockControlPorts
+ * @brief           - Enable or disable the clocks of several ports at once
+ * @param[in]       - PortMask: GPIO_PORT_BIT(GPIOx) values ORed together
+ * @param[in]       - EnorDi: ENABLE or DISABLE macro
+ * @return          - None
+ * @Note            - One AHB1ENR read-modify-write for all ports, e.g.
+ *                    GPIO_PORT_BIT(GPIOA) | GPIO_PORT_BIT(GPIOC) at startup
+ *********************************************************************/
+void GPIO_PeriClockControlPorts(uint16_t PortMask, uint8_t EnorDi)
+{
+    uint32_t mask = PortMask & ((1U << GPIO_PORT_COUNT) - 1);
+
+    if (EnorDi == ENABLE)
+        RCC->AHB1ENR |= mask;
+    else
+        RCC->AHB1ENR &= ~mask;
+}
+
+/*********************************************************************
+ * @fn      		- spread_mask2
+ * @brief           - Widen a 16-bit pin mask to one 2-bit field per pin
+ * @param[in]       - PinMask: bit n = pin n
+ * @return          - Mask with bits 2n+1:2n set for each selected pin
+ * @Note            - Field layout of MODER, OSPEEDR and PUPDR
+ *********************************************************************/
+static uint32_t spread_mask2(uint16_t PinMask)
+{
+    uint32_t x = PinMask;
+
+    x = (x | (x << 8)) & 0x00FF00FFU;
+    x = (x | (x << 4)) & 0x0F0F0F0FU;
+    x = (x | (x << 2)) & 0x33333333U;
+    x = (x | (x << 1)) & 0x55555555U;
+    return x * 0x3U;
+}
+
+/*********************************************************************
+ * @fn      		- spread_mask4
+ * @brief           - Widen an 8-bit pin mask to one 4-bit field per pin
+ * @param[in]       - PinMask: bit n = pin n of one AFR half
+ * @return          - Mask with bits 4n+3:4n set for each selected pin
+ * @Note            - Field layout of AFR[0] / AFR[1]
+ *********************************************************************/
+static uint32_t spread_mask4(uint8_t PinMask)
+{
+    uint32_t x = PinMask;
+
+    x = (x | (x << 12)) & 0x000F000FU;
+    x = (x | (x << 6)) & 0x03030303U;
+    x = (x | (x << 3)) & 0x11111111U;
+    return x * 0xFU;
 }
 
 /*********************************************************************
@@ -71,48 +96,134 @@ void GPIO_PeriClockControl(GPIO_RegDef_t *pGPIOx, uint8_t EnorDi)
  *********************************************************************/
 void GPIO_Init(GPIO_Handle_t *pGPIOHandle)
 {
-    uint32_t temp = 0;
+    GPIO_PinMaskConfig_t config;
+
+    config.GPIO_PinMask = (uint16_t)(1U << pGPIOHandle->GPIO_PINConfig.GPIO_PinNumber);
+    config.GPIO_PinMode = pGPIOHandle->GPIO_PINConfig.GPIO_PinMode;
+    config.GPIO_PinSpeed = pGPIOHandle->GPIO_PINConfig.GPIO_PinSpeed;
+    config.GPIO_PinPupdControl = pGPIOHandle->GPIO_PINConfig.GPIO_PinPupdCpntrol;
+    config.GPIO_PinOPType = pGPIOHandle->GPIO_PINConfig.GPIO_PinOPType;
+    config.GPIO_PinAltFunMode = pGPIOHandle->GPIO_PINConfig.GPIO_PinAltFunMode;
+
+    GPIO_InitPins(pGPIOHandle->pGPIOx, &config);
+}
+
+/*********************************************************************
+ * @fn      		- GPIO_InitPins
+ * @brief           - Initialize every pin in a mask with one configuration
+ * @param[in]       - pGPIOx: Base address of the GPIO peripheral
+ * @param[in]       - pConfig: pin mask and configuration
+ * @return          - None
+ * @Note            - Each register is read once and written once, whatever
+ *                    the number of pins (a 16-bit bus is 8-12 accesses
+ *                    instead of ~160)
+ *********************************************************************/
+void GPIO_InitPins(GPIO_RegDef_t *pGPIOx, const GPIO_PinMaskConfig_t *pConfig)
+{
+    uint16_t pins = pConfig->GPIO_PinMask;
+    uint32_t mask2 = spread_mask2(pins);
 
     // Enable peripheral clock
-    GPIO_PeriClockControl(pGPIOHandle->pGPIOx, ENABLE);
+    GPIO_PeriClockControl(pGPIOx, ENABLE);
 
     // 1. Configure GPIO pin mode
-    if (pGPIOHandle->GPIO_PINConfig.GPIO_PinMode <= GPIO_MODE_ANALOG)
+    if (pConfig->GPIO_PinMode <= GPIO_MODE_ANALOG)
     {
         // Non-interrupt mode
-        temp = (pGPIOHandle->GPIO_PINConfig.GPIO_PinMode << (2 * pGPIOHandle->GPIO_PINConfig.GPIO_PinNumber));
-        pGPIOHandle->pGPIOx->MODER &= ~(0x3 << (2 * pGPIOHandle->GPIO_PINConfig.GPIO_PinNumber)); // Clear
-        pGPIOHandle->pGPIOx->MODER |= temp; // Set
+        pGPIOx->MODER = (pGPIOx->MODER & ~mask2) | (mask2 & (pConfig->GPIO_PinMode * 0x55555555U));
     }
     else
     {
-        // Interrupt mode configuration
-        // This will be implemented in interrupt handling module
+        // Interrupt mode: the pins are inputs routed to their EXTI lines
+        uint32_t port_code = GPIO_PORT_INDEX(pGPIOx) * 0x1111U;
+
+        pGPIOx->MODER &= ~mask2;
+
+        // Trigger selection
+        if (pConfig->GPIO_PinMode == GPIO_MODE_IT_RT)
+            EXTI->FTSR &= ~(uint32_t)pins;
+        else
+            EXTI->FTSR |= pins;
+
+        if (pConfig->GPIO_PinMode == GPIO_MODE_IT_FT)
+            EXTI->RTSR &= ~(uint32_t)pins;
+        else
+            EXTI->RTSR |= pins;
+
+        // Port selection, one EXTICR write per register holding selected lines
+        SYSCFG_PCLK_EN();
+        for (uint8_t reg = 0; reg < 4; reg++)
+        {
+            uint32_t mask4 = spread_mask4((uint8_t)((pins >> (4 * reg)) & 0xFU));
+            if (mask4)
+                SYSCFG->EXTICR[reg] = (SYSCFG->EXTICR[reg] & ~mask4) | (port_code & mask4);
+        }
+
+        // Unmask last, once the line is fully routed
+        EXTI->IMR |= pins;
     }
 
     // 2. Configure GPIO pin speed
-    temp = (pGPIOHandle->GPIO_PINConfig.GPIO_PinSpeed << (2 * pGPIOHandle->GPIO_PINConfig.GPIO_PinNumber));
-    pGPIOHandle->pGPIOx->OSPEEDR &= ~(0x3 << (2 * pGPIOHandle->GPIO_PINConfig.GPIO_PinNumber));
-    pGPIOHandle->pGPIOx->OSPEEDR |= temp;
+    pGPIOx->OSPEEDR = (pGPIOx->OSPEEDR & ~mask2) | (mask2 & (pConfig->GPIO_PinSpeed * 0x55555555U));
 
     // 3. Configure pull-up/pull-down
-    temp = (pGPIOHandle->GPIO_PINConfig.GPIO_PinPupdCpntrol << (2 * pGPIOHandle->GPIO_PINConfig.GPIO_PinNumber));
-    pGPIOHandle->pGPIOx->PUPDR &= ~(0x3 << (2 * pGPIOHandle->GPIO_PINConfig.GPIO_PinNumber));
-    pGPIOHandle->pGPIOx->PUPDR |= temp;
+    pGPIOx->PUPDR = (pGPIOx->PUPDR & ~mask2) | (mask2 & (pConfig->GPIO_PinPupdControl * 0x55555555U));
 
     // 4. Configure output type
-    temp = (pGPIOHandle->GPIO_PINConfig.GPIO_PinOPType << pGPIOHandle->GPIO_PINConfig.GPIO_PinNumber);
-    pGPIOHandle->pGPIOx->OTYPER &= ~(0x1 << pGPIOHandle->GPIO_PINConfig.GPIO_PinNumber);
-    pGPIOHandle->pGPIOx->OTYPER |= temp;
+    pGPIOx->OTYPER = (pGPIOx->OTYPER & ~(uint32_t)pins) | (pConfig->GPIO_PinOPType ? pins : 0U);
 
-    // 5. Configure alternate function
-    if (pGPIOHandle->GPIO_PINConfig.GPIO_PinMode == GPIO_MODE_ALTFN)
+    // 5. Configure alternate function (only the AFR halves that hold selected pins)
+    if (pConfig->GPIO_PinMode == GPIO_MODE_ALTFN)
     {
-        uint8_t temp1, temp2;
-        temp1 = pGPIOHandle->GPIO_PINConfig.GPIO_PinNumber / 8;
-        temp2 = pGPIOHandle->GPIO_PINConfig.GPIO_PinNumber % 8;
-        pGPIOHandle->pGPIOx->AFR[temp1] &= ~(0xF << (4 * temp2));
-        pGPIOHandle->pGPIOx->AFR[temp1] |= (pGPIOHandle->GPIO_PINConfig.GPIO_PinAltFunMode << (4 * temp2));
+        uint32_t af = (pConfig->GPIO_PinAltFunMode & 0xFU) * 0x11111111U;
+
+        for (uint8_t half = 0; half < 2; half++)
+        {
+            uint32_t mask4 = spread_mask4((uint8_t)(pins >> (8 * half)));
+            if (mask4)
+                pGPIOx->AFR[half] = (pGPIOx->AFR[half] & ~mask4) | (af & mask4);
+        }
+    }
+}
+
+/*********************************************************************
+ * @fn      		- GPIO_ApplyPortConfig
+ * @brief           - Load complete port configurations from a const table
+ * @param[in]       - pConfig: table of port register images
+ * @param[in]       - Count: number of table entries
+ * @return          - None
+ * @Note            - For boot: one AHB1ENR write enables every listed port,
+ *                    then each register is written once without reading
+ *                    it. ODR is loaded before MODER so outputs start at
+ *                    their initial level without a glitch.
+ *********************************************************************/
+void GPIO_ApplyPortConfig(const GPIO_PortConfig_t *pConfig, uint8_t Count)
+{
+    uint16_t ports = 0;
+
+    for (uint8_t i = 0; i < Count; i++)
+    {
+        if (pConfig[i].Port < GPIO_PORT_COUNT)
+            ports |= (uint16_t)(1U << pConfig[i].Port);
+    }
+    GPIO_PeriClockControlPorts(ports, ENABLE);
+
+    for (uint8_t i = 0; i < Count; i++)
+    {
+        const GPIO_PortConfig_t *cfg = &pConfig[i];
+        GPIO_RegDef_t *pGPIOx;
+
+        if (cfg->Port >= GPIO_PORT_COUNT)
+            continue;
+
+        pGPIOx = GPIO_PORT_FROM_INDEX(cfg->Port);
+        pGPIOx->ODR = cfg->ODR;
+        pGPIOx->OTYPER = cfg->OTYPER;
+        pGPIOx->OSPEEDR = cfg->OSPEEDR;
+        pGPIOx->PUPDR = cfg->PUPDR;
+        pGPIOx->AFR[0] = cfg->AFR[0];
+        pGPIOx->AFR[1] = cfg->AFR[1];
+        pGPIOx->MODER = cfg->MODER;
     }
 }
 
@@ -125,24 +236,10 @@ void GPIO_Init(GPIO_Handle_t *pGPIOHandle)
  *********************************************************************/
 void GPIO_DeInit(GPIO_RegDef_t *pGPIOx)
 {
-    if (pGPIOx == GPIOA)
-        GPIOA_REG_RESET();
-    else if (pGPIOx == GPIOB)
-        GPIOB_REG_RESET();
-    else if (pGPIOx == GPIOC)
-        GPIOC_REG_RESET();
-    else if (pGPIOx == GPIOD)
-        GPIOD_REG_RESET();
-    else if (pGPIOx == GPIOE)
-        GPIOE_REG_RESET();
-    else if (pGPIOx == GPIOF)
-        GPIOF_REG_RESET();
-    else if (pGPIOx == GPIOG)
-        GPIOG_REG_RESET();
-    else if (pGPIOx == GPIOH)
-        GPIOH_REG_RESET();
-    else if (pGPIOx == GPIOI)
-        GPIOI_REG_RESET();
+    uint32_t port = GPIO_PORT_INDEX(pGPIOx);
+
+    if (port < GPIO_PORT_COUNT)
+        GPIO_REG_RESET(port);
 }
 
 /*********************************************************************
@@ -181,19 +278,20 @@ uint16_t GPIO_ReadFromInputPort(GPIO_RegDef_t *pGPIOx)
  * @param[in]       - PinNumber: Pin number (0-15)
  * @param[in]       - Value: GPIO_PIN_SET or GPIO_PIN_RESET
  * @return          - None
- * @Note            - None
+ * @Note            - Single store to BSRR, no read-modify-write of ODR,
+ *                    so it cannot race with an ISR writing the same port
  *********************************************************************/
 void GPIO_WriteToOutputPin(GPIO_RegDef_t *pGPIOx, uint8_t PinNumber, uint8_t Value)
 {
     if (Value == GPIO_PIN_SET)
     {
         // Set pin
-        pGPIOx->ODR |= (1 << PinNumber);
+        pGPIOx->BSRRL = (uint16_t)(1U << PinNumber);
     }
     else
     {
         // Reset pin
-        pGPIOx->ODR &= ~(1 << PinNumber);
+        pGPIOx->BSRRH = (uint16_t)(1U << PinNumber);
     }
 }
 
@@ -216,41 +314,169 @@ void GPIO_WriteToOutputPort(GPIO_RegDef_t *pGPIOx, uint16_t Value)
  * @param[in]       - pGPIOx: Base address of the GPIO peripheral
  * @param[in]       - PinNumber: Pin number (0-15)
  * @return          - None
- * @Note            - Uses XOR operation for atomic toggle
+ * @Note            - Reads ODR once and writes set and reset masks to
+ *                    BSRR in one store; other pins are never rewritten
  *********************************************************************/
 void GPIO_ToggleOutputPin(GPIO_RegDef_t *pGPIOx, uint8_t PinNumber)
 {
-    pGPIOx->ODR ^= (1 << PinNumber);
+    GPIO_ToggleOutputPins(pGPIOx, (uint16_t)(1U << PinNumber));
+}
+
+/*********************************************************************
+ * @fn      		- GPIO_WriteMaskedPort
+ * @brief           - Write the pins selected by a mask, leave the others
+ * @param[in]       - pGPIOx: Base address of the GPIO peripheral
+ * @param[in]       - PinMask: Pins to write (bit n = pin n)
+ * @param[in]       - Value: New levels for the masked pins
+ * @return          - None
+ * @Note            - One BSRR store: masked 1s are set, masked 0s reset
+ *********************************************************************/
+void GPIO_WriteMaskedPort(GPIO_RegDef_t *pGPIOx, uint16_t PinMask, uint16_t Value)
+{
+    uint32_t set = (uint32_t)(Value & PinMask);
+    uint32_t reset = (uint32_t)(~Value & PinMask);
+
+    pGPIOx->BSRR = (reset << 16) | set;
+}
+
+/*********************************************************************
+ * @fn      		- GPIO_ToggleOutputPins
+ * @brief           - Toggle all pins selected by a mask
+ * @param[in]       - pGPIOx: Base address of the GPIO peripheral
+ * @param[in]       - PinMask: Pins to toggle (bit n = pin n)
+ * @return          - None
+ * @Note            - Pins currently high go to the reset half of BSRR,
+ *                    pins currently low to the set half, in one store
+ *********************************************************************/
+void GPIO_ToggleOutputPins(GPIO_RegDef_t *pGPIOx, uint16_t PinMask)
+{
+    uint32_t odr = pGPIOx->ODR;
+
+    pGPIOx->BSRR = ((odr & PinMask) << 16) | (~odr & PinMask);
 }
 
 /*********************************************************************
  * @fn      		- GPIO_IRQConfig
- * @brief           - Configure GPIO interrupt
- * @param[in]       - IRQNumber: IRQ number
- * @param[in]       - IRQPriority: Interrupt priority
+ * @brief           - Enable or disable an interrupt in the NVIC
+ * @param[in]       - IRQNumber: IRQ number (e.g. GPIO_PinToIRQ(pin))
+ * @param[in]       - IRQPriority: priority, 0 (highest) to 15
  * @param[in]       - EnorDi: ENABLE or DISABLE
  * @return          - None
- * @Note            - NVIC configuration required
+ * @Note            - See NVIC_IRQConfig
  *********************************************************************/
 void GPIO_IRQConfig(uint8_t IRQNumber, uint8_t IRQPriority, uint8_t EnorDi)
 {
-    // Will be implemented in interrupt handling module
-    // This requires NVIC register access
-    (void)IRQNumber;
-    (void)IRQPriority;
-    (void)EnorDi;
+    NVIC_IRQConfig(IRQNumber, IRQPriority, EnorDi);
 }
 
 /*********************************************************************
  * @fn      		- GPIO_IRQHandling
- * @brief           - Handle GPIO interrupt
+ * @brief           - Clear the EXTI pending bit of a pin
  * @param[in]       - PinNumber: Pin number that triggered interrupt
  * @return          - None
- * @Note            - Clear pending interrupt flag
+ * @Note            - PR is write-1-to-clear: a plain store, never |=,
+ *                    which would also clear every other pending line
  *********************************************************************/
 void GPIO_IRQHandling(uint8_t PinNumber)
 {
-    // Will be implemented in interrupt handling module
-    // Clear EXTI pending register bit
-    (void)PinNumber;
+    EXTI->PR = 1U << PinNumber;
+}
+
+/*********************************************************************
+ * @fn      		- GPIO_PinToIRQ
+ * @brief           - NVIC IRQ number serving a pin's EXTI line
+ * @param[in]       - PinNumber: Pin number (0-15)
+ * @return          - IRQ_NO_EXTIx value
+ * @Note            - Lines 5-9 and 10-15 share one IRQ each
+ *********************************************************************/
+uint8_t GPIO_PinToIRQ(uint8_t PinNumber)
+{
+    if (PinNumber <= 4)
+        return (uint8_t)(IRQ_NO_EXTI0 + PinNumber);
+    if (PinNumber <= 9)
+        return IRQ_NO_EXTI9_5;
+    return IRQ_NO_EXTI15_10;
+}
+
+/*********************************************************************
+ * @fn      		- GPIO_RegisterCallback
+ * @brief           - Set the function run when a pin's EXTI line fires
+ * @param[in]       - PinNumber: Pin number (0-15)
+ * @param[in]       - Callback: function, or NULL to only clear the line
+ * @return          - None
+ * @Note            - One callback per line: EXTI routes a line from one
+ *                    port at a time
+ *********************************************************************/
+void GPIO_RegisterCallback(uint8_t PinNumber, GPIO_EXTICallback_t Callback)
+{
+    if (PinNumber < 16)
+        exti_callbacks[PinNumber] = Callback;
+}
+
+/*********************************************************************
+ * @fn      		- GPIO_EXTIDispatch
+ * @brief           - Service the pending EXTI lines in a mask
+ * @param[in]       - LineMask: lines owned by the calling IRQ handler
+ * @return          - None
+ * @Note            - Reads PR once and clears all the lines with one
+ *                    store before the callbacks, so an edge arriving
+ *                    during a callback pends the IRQ again. Lines are
+ *                    found with CLZ, highest first: one instruction per
+ *                    serviced line instead of testing each bit.
+ *********************************************************************/
+void GPIO_EXTIDispatch(uint32_t LineMask)
+{
+    uint32_t pending = EXTI->PR & LineMask;
+
+    if (pending == 0)
+        return;
+
+    EXTI->PR = pending;
+
+    while (pending)
+    {
+        uint8_t line = (uint8_t)(31 - __builtin_clz(pending));
+
+        pending &= ~(1U << line);
+        if (exti_callbacks[line] != NULL)
+            exti_callbacks[line](line);
+    }
+}
+
+#ifndef GPIO_NO_EXTI_HANDLERS
+// Vector table entries: each handler services the lines of its IRQ
+void EXTI0_IRQHandler(void)
+{
+    GPIO_EXTIDispatch(0x0001U);
+}
+
+void EXTI1_IRQHandler(void)
+{
+    GPIO_EXTIDispatch(0x0002U);
+}
+
+void EXTI2_IRQHandler(void)
+{
+    GPIO_EXTIDispatch(0x0004U);
+}
+
+void EXTI3_IRQHandler(void)
+{
+    GPIO_EXTIDispatch(0x0008U);
+}
+
+void EXTI4_IRQHandler(void)
+{
+    GPIO_EXTIDispatch(0x0010U);
+}
+
+void EXTI9_5_IRQHandler(void)
+{
+    GPIO_EXTIDispatch(0x03E0U);
+}
+
+void EXTI15_10_IRQHandler(void)
+{
+    GPIO_EXTIDispatch(0xFC00U);
 }
+#endif
@@ -0,0 +1,93 @@
+/*
+ * stm32f446re_rcc_driver.c
+ *
+ * Clock tree queries for STM32F446RE
+ * Peripheral drivers derive their dividers (USART BRR, ...) from these
+ * instead of a frequency fixed at build time, so they stay correct when
+ * the application changes the PLL or the bus prescalers.
+ */
+
+#include "stm32f446re_rcc_driver.h"
+
+// AHB divider for HPRE 1000-1111 (there is no /32)
+static const uint16_t ahb_prescaler[8] = { 2, 4, 8, 16, 64, 128, 256, 512 };
+
+/*********************************************************************
+ * @fn      		- rcc_pll_input
+ * @brief           - PLL input clock after the PLLM divider (VCO input)
+ * @return          - Frequency in Hz, 0 if PLLM is not programmed
+ *********************************************************************/
+static uint32_t rcc_pll_input(void)
+{
+    uint32_t pllcfgr = RCC->PLLCFGR;
+    uint32_t pllm = (pllcfgr >> RCC_PLLCFGR_PLLM) & 0x3FU;
+    uint32_t source = (pllcfgr & (1U << RCC_PLLCFGR_PLLSRC)) ? HSE_VALUE : HSI_VALUE;
+
+    return pllm ? source / pllm : 0;
+}
+
+/*********************************************************************
+ * @fn      		- RCC_GetSYSCLKValue
+ * @brief           - System clock frequency
+ * @return          - SYSCLK in Hz
+ * @Note            - Follows SWS, the source actually selected, not SW
+ *********************************************************************/
+uint32_t RCC_GetSYSCLKValue(void)
+{
+    uint32_t pllcfgr = RCC->PLLCFGR;
+    uint32_t vco = rcc_pll_input() * ((pllcfgr >> RCC_PLLCFGR_PLLN) & 0x1FFU);
+    uint32_t div;
+
+    switch ((RCC->CFGR >> RCC_CFGR_SWS) & 0x3U)
+    {
+    case 1:
+        return HSE_VALUE;
+    case 2:
+        div = (((pllcfgr >> RCC_PLLCFGR_PLLP) & 0x3U) + 1U) * 2U;
+        return vco / div;
+    case 3:
+        div = (pllcfgr >> RCC_PLLCFGR_PLLR) & 0x7U;
+        return div ? vco / div : 0;
+    default:
+        return HSI_VALUE;
+    }
+}
+
+/*********************************************************************
+ * @fn      		- RCC_GetHCLKValue
+ * @brief           - AHB clock frequency (CPU, DMA, GPIO)
+ * @return          - HCLK in Hz
+ *********************************************************************/
+uint32_t RCC_GetHCLKValue(void)
+{
+    uint32_t hpre = (RCC->CFGR >> RCC_CFGR_HPRE) & 0xFU;
+    uint32_t sysclk = RCC_GetSYSCLKValue();
+
+    return hpre < 8 ? sysclk : sysclk / ahb_prescaler[hpre - 8];
+}
+
+/*********************************************************************
+ * @fn      		- RCC_GetPCLK1Value
+ * @brief           - APB1 clock frequency
+ * @return          - PCLK1 in Hz
+ * @Note            - Clocks USART2/3, UART4/5, SPI2/3, TIM2-7, I2C
+ *********************************************************************/
+uint32_t RCC_GetPCLK1Value(void)
+{
+    uint32_t ppre = (RCC->CFGR >> RCC_CFGR_PPRE1) & 0x7U;
+
+    return ppre < 4 ? RCC_GetHCLKValue() : RCC_GetHCLKValue() >> (ppre - 3);
+}
+
+/*********************************************************************
+ * @fn      		- RCC_GetPCLK2Value
+ * @brief           - APB2 clock frequency
+ * @return          - PCLK2 in Hz
+ * @Note            - Clocks USART1/6, SPI1/4, TIM1/8-11
+ *********************************************************************/
+uint32_t RCC_GetPCLK2Value(void)
+{
+    uint32_t ppre = (RCC->CFGR >> RCC_CFGR_PPRE2) & 0x7U;
+
+    return ppre < 4 ? RCC_GetHCLKValue() : RCC_GetHCLKValue() >> (ppre - 3);
+}
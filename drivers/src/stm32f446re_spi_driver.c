@@ -0,0 +1,802 @@
+/*
+ * stm32f446re_spi_driver.c
+ *
+ * SPI driver for STM32F446RE
+ * SPI_Init sets up SPI1-3 from a const port table (bus, clock bit, default
+ * pins, DMA streams); SPI_TransferData and SPI_SendData move whole buffers.
+ * The SPI has one TX holding register in front of the shift register, so
+ * the blocking transfer writes the next frame as soon as TXE allows,
+ * before reading the frame that is still coming in, and SCK runs without
+ * gaps between frames. Transmit-only skips the RXNE reads altogether and
+ * drops the stale frame and OVR at the end.
+ * SPI_TransferDMA hands a block to two DMA streams (RX and TX) and reports
+ * through the handle's callback when the last frame has been received.
+ * The transaction queue shares one bus between several devices: SPI_Submit
+ * only queues a descriptor and kicks the SPI interrupt, which starts it.
+ * Each completion (last RXNE, or RX DMA transfer complete) raises chip
+ * select, runs the descriptor's callback and starts the next transaction
+ * straight away: the one chained through pNext, else the queue's head.
+ * CR1 is rewritten only when the next transaction is for a device with
+ * different settings.
+ */
+
+#include <stddef.h>
+#include "stm32f446re_spi_driver.h"
+#include "stm32f446re_gpio_drivers.h"
+#include "stm32f446re_rcc_driver.h"
+
+/*
+ * CR2 interrupt and DMA enables are changed from thread context
+ * (SPI_Submit) and from the SPI and DMA interrupts, so every change goes
+ * through REG_WRITE_BIT (one bit-band store on the target).
+ */
+
+// CR1 fields that differ between devices on one bus
+#define SPI_CR1_DEVICE_MASK	( (7U << SPI_CR1_BR) | (1U << SPI_CR1_CPOL) | (1U << SPI_CR1_CPHA) \
+							| (1U << SPI_CR1_DFF) )
+
+// Everything the driver needs to know about one port
+typedef struct
+{
+uint32_t BaseAddr ;
+uint8_t APB2 ;				// 1: APB2 (PCLK2), 0: APB1 (PCLK1)
+uint8_t ClockBit ;			// Bit in RCC APBxENR / APBxRSTR
+uint8_t AltFn ;				// GPIO alternate function of SCK, MISO, MOSI
+uint8_t Port ;				// GPIO_PORT_INDEX of the default pins
+uint8_t SckPin ;
+uint8_t MisoPin ;
+uint8_t MosiPin ;
+uint8_t DMA ;				// 0 = none, 2 = DMA2
+uint8_t TxStream ;
+uint8_t RxStream ;
+uint8_t Channel ;
+
+} spi_port_t;
+
+// Default pins are the LQFP64 (Nucleo-64) ones. SPI2 and SPI3 only map to
+// DMA1 streams the USART driver already uses (USART3/UART4 TX, UART5 and
+// USART2 RX), so they have no DMA mapping here.
+static const spi_port_t spi_ports[] =
+{
+    // Base         APB2 Bit AF  Port SCK MISO MOSI  DMA  TX  RX  ch
+    { SPI1_BASEADDR, 1,  12, 5,  0,   5,  6,   7,    2,   3,  0,  3 },	// PA5/PA6/PA7
+    { SPI2_BASEADDR, 0,  14, 5,  1,   13, 14,  15,   0,   0,  0,  0 },	// PB13/PB14/PB15
+    { SPI3_BASEADDR, 0,  15, 6,  2,   10, 11,  12,   0,   0,  0,  0 },	// PC10/PC11/PC12
+};
+
+// DMA source and sink for blocks without TX data or without an RX buffer
+static const uint16_t spi_dummy_tx = SPI_DUMMY_FRAME;
+static uint16_t spi_dummy_rx;
+
+/*********************************************************************
+ * @fn      		- spi_port
+ * @brief           - Look up a port in spi_ports
+ * @param[in]       - pSPIx: Base address of the SPI peripheral
+ * @return          - Table entry, NULL if pSPIx is not an SPI
+ *********************************************************************/
+static const spi_port_t *spi_port(SPI_RegDef_t *pSPIx)
+{
+    uint32_t base = MMIO_DEV_ADDR(pSPIx);
+
+    for (uint32_t i = 0; i < sizeof(spi_ports) / sizeof(spi_ports[0]); i++)
+    {
+        if (spi_ports[i].BaseAddr == base)
+            return &spi_ports[i];
+    }
+    return NULL;
+}
+
+/*********************************************************************
+ * @fn      		- spi_pins_init
+ * @brief           - Put a port's default SCK, MISO and MOSI pins in
+ *                    their alternate function
+ * @param[in]       - pPort: spi_ports entry
+ * @return          - None
+ * @Note            - Push-pull, high speed, no pull. NSS / chip select
+ *                    pins are left to the application.
+ *********************************************************************/
+static void spi_pins_init(const spi_port_t *pPort)
+{
+    GPIO_PinMaskConfig_t config;
+
+    config.GPIO_PinMask = (uint16_t)((1U << pPort->SckPin) | (1U << pPort->MisoPin) | (1U << pPort->MosiPin));
+    config.GPIO_PinMode = GPIO_MODE_ALTFN;
+    config.GPIO_PinSpeed = GPIO_SPEED_HIGH;
+    config.GPIO_PinPupdControl = GPIO_NO_PUPD;
+    config.GPIO_PinOPType = GPIO_OP_TYPE_PP;
+    config.GPIO_PinAltFunMode = pPort->AltFn;
+    GPIO_InitPins(GPIO_PORT_FROM_INDEX(pPort->Port), &config);
+}
+
+/*********************************************************************
+ * @fn      		- spi_frame
+ * @brief           - Frame Index of a buffer
+ * @param[in]       - pBuffer: TX buffer, NULL for dummy frames
+ * @param[in]       - Index: frame number
+ * @param[in]       - Dff16: 1 for 16-bit frames
+ * @return          - Value to write to DR
+ *********************************************************************/
+static uint32_t spi_frame(const uint8_t *pBuffer, uint32_t Index, uint8_t Dff16)
+{
+    if (pBuffer == NULL)
+        return SPI_DUMMY_FRAME;
+    return Dff16 ? ((const uint16_t *)pBuffer)[Index] : pBuffer[Index];
+}
+
+/*********************************************************************
+ * @fn      		- spi_device_select
+ * @brief           - Set CR1 up for the device of the next transaction
+ * @param[in]       - pSPIHandle: SPI handle, bus idle
+ * @param[in]       - pDevice: device to talk to
+ * @return          - None
+ * @Note            - Nothing to do for the device of the previous
+ *                    transaction, or for one with the same settings.
+ *                    Otherwise SPE is dropped around the write, as BR,
+ *                    CPOL, CPHA and DFF must not change while enabled.
+ *                    SPIConfig and SclkHz follow the new settings.
+ *********************************************************************/
+static void spi_device_select(SPI_Handle_t *pSPIHandle, const SPI_Device_t *pDevice)
+{
+    SPI_RegDef_t *pSPIx = pSPIHandle->pSPIx;
+    SPI_Config_t *pConfig = &pSPIHandle->SPIConfig;
+    const spi_port_t *pPort;
+    uint32_t cr1, bits;
+
+    if (pDevice == pSPIHandle->pCurDevice)
+        return;
+    pSPIHandle->pCurDevice = pDevice;
+
+    bits = ((uint32_t)(pDevice->SPI_SclkSpeed & 7U) << SPI_CR1_BR)
+         | ((uint32_t)(pDevice->SPI_CPOL & 1U) << SPI_CR1_CPOL)
+         | ((uint32_t)(pDevice->SPI_CPHA & 1U) << SPI_CR1_CPHA)
+         | ((uint32_t)(pDevice->SPI_DFF & 1U) << SPI_CR1_DFF);
+    cr1 = pSPIx->CR1;
+    if ((cr1 & SPI_CR1_DEVICE_MASK) == bits)
+        return;
+
+    pSPIx->CR1 = cr1 & ~(1U << SPI_CR1_SPE);
+    cr1 = (cr1 & ~SPI_CR1_DEVICE_MASK) | bits;
+    pSPIx->CR1 = cr1 & ~(1U << SPI_CR1_SPE);
+    pSPIx->CR1 = cr1;
+    pSPIHandle->Reconfigs++;
+
+    pConfig->SPI_SclkSpeed = pDevice->SPI_SclkSpeed & 7U;
+    pConfig->SPI_DFF = pDevice->SPI_DFF & 1U;
+    pConfig->SPI_CPOL = pDevice->SPI_CPOL & 1U;
+    pConfig->SPI_CPHA = pDevice->SPI_CPHA & 1U;
+    pPort = spi_port(pSPIx);
+    pSPIHandle->SclkHz = (pPort->APB2 ? RCC_GetPCLK2Value() : RCC_GetPCLK1Value()) >> (pConfig->SPI_SclkSpeed + 1U);
+}
+
+/*********************************************************************
+ * @fn      		- spi_xact_valid
+ * @brief           - Check a transaction before it is queued or chained
+ * @param[in]       - pXact: transaction
+ * @return          - 1 if it can run, 0 if it has no device, its length
+ *                    is out of range or it is still queued or active
+ *********************************************************************/
+static uint8_t spi_xact_valid(const SPI_Transaction_t *pXact)
+{
+    uint32_t frames;
+
+    if (pXact->pDevice == NULL)
+        return 0;
+    if (pXact->Status == SPI_XACT_QUEUED || pXact->Status == SPI_XACT_ACTIVE)
+        return 0;
+
+    frames = pXact->pDevice->SPI_DFF == SPI_DFF_16BITS ? pXact->Len / 2 : pXact->Len;
+    return frames != 0 && frames <= SPI_DMA_MAX_FRAMES;
+}
+
+/*********************************************************************
+ * @fn      		- spi_xact_start
+ * @brief           - Put a queued transaction on the bus
+ * @param[in]       - pSPIHandle: SPI handle, bus idle
+ * @param[in]       - pXact: transaction taken from the queue
+ * @return          - None
+ * @Note            - Runs in interrupt context. Blocks of SPI_DMA_MIN_LEN
+ *                    bytes or more go by DMA where the port has it, the
+ *                    rest frame by frame from the RXNE/TXE interrupt.
+ *********************************************************************/
+static void spi_xact_start(SPI_Handle_t *pSPIHandle, SPI_Transaction_t *pXact)
+{
+    SPI_RegDef_t *pSPIx = pSPIHandle->pSPIx;
+    const SPI_Device_t *pDevice = pXact->pDevice;
+
+    pSPIHandle->pActive = pXact;
+    pXact->Status = SPI_XACT_ACTIVE;
+
+    // Mode first, so SCK already idles at the new CPOL when CS falls
+    spi_device_select(pSPIHandle, pDevice);
+    if (pDevice->pCSPort != NULL)
+        pDevice->pCSPort->BSRR = 1U << (pDevice->CSPin + 16U);
+
+    if (pXact->Len >= SPI_DMA_MIN_LEN
+        && SPI_TransferDMA(pSPIHandle, pXact->pTxBuffer, pXact->pRxBuffer, pXact->Len))
+        return;
+
+    pSPIHandle->XferCount = pDevice->SPI_DFF == SPI_DFF_16BITS ? pXact->Len / 2 : pXact->Len;
+    pSPIHandle->XferTx = 0;
+    pSPIHandle->XferRx = 0;
+
+    // DR then SR read drops a stale frame and OVR
+    (void)pSPIx->DR;
+    (void)pSPIx->SR;
+    REG_WRITE_BIT(pSPIx->CR2, SPI_CR2_RXNEIE, 1);
+    REG_WRITE_BIT(pSPIx->CR2, SPI_CR2_TXEIE, 1);
+}
+
+/*********************************************************************
+ * @fn      		- spi_queue_next
+ * @brief           - Start the next queued transaction, if any
+ * @param[in]       - pSPIHandle: SPI handle, no transaction active
+ * @return          - None
+ * @Note            - TXEIE is cleared before the queue is read: a
+ *                    transaction submitted after the read sets it again,
+ *                    so the SPI interrupt comes back for it
+ *********************************************************************/
+static void spi_queue_next(SPI_Handle_t *pSPIHandle)
+{
+    SPI_Transaction_t *pXact;
+
+    REG_WRITE_BIT(pSPIHandle->pSPIx->CR2, SPI_CR2_TXEIE, 0);
+    if (RingBuffer_GetBulk(&pSPIHandle->Queue, (uint8_t *)&pXact, sizeof(pXact)) == sizeof(pXact))
+        spi_xact_start(pSPIHandle, pXact);
+}
+
+/*********************************************************************
+ * @fn      		- spi_xact_finish
+ * @brief           - End the active transaction and start the next one
+ * @param[in]       - pSPIHandle: SPI handle
+ * @param[in]       - Event: SPI_EVENT_XFER_CMPLT or SPI_EVENT_XFER_ERROR
+ * @return          - None
+ * @Note            - CS rises once the last frame has left the shift
+ *                    register (BSY clear). A transaction chained through
+ *                    pNext (by the Done callback or before SPI_Submit)
+ *                    starts ahead of the queue, which keeps SPI_Submit
+ *                    as its only producer. One without a device or with
+ *                    a bad length ends in SPI_XACT_ERROR, no callback;
+ *                    one still queued is left alone.
+ *********************************************************************/
+static void spi_xact_finish(SPI_Handle_t *pSPIHandle, uint8_t Event)
+{
+    SPI_RegDef_t *pSPIx = pSPIHandle->pSPIx;
+    SPI_Transaction_t *pXact = pSPIHandle->pActive;
+    const SPI_Device_t *pDevice = pXact->pDevice;
+    SPI_Transaction_t *pNext;
+
+    while (pSPIx->SR & (1U << SPI_SR_BSY))
+        ;
+    REG_WRITE_BIT(pSPIx->CR2, SPI_CR2_RXNEIE, 0);
+    if (pDevice->pCSPort != NULL)
+        pDevice->pCSPort->BSRR = 1U << pDevice->CSPin;
+
+    pXact->Status = (Event == SPI_EVENT_XFER_CMPLT) ? SPI_XACT_DONE : SPI_XACT_ERROR;
+    pSPIHandle->pActive = NULL;
+    if (pXact->Done != NULL)
+        pXact->Done(pXact, Event);
+
+    pNext = pXact->pNext;
+    pXact->pNext = NULL;
+    if (pNext != NULL && pNext->Status != SPI_XACT_QUEUED && pNext->Status != SPI_XACT_ACTIVE)
+    {
+        if (spi_xact_valid(pNext))
+        {
+            spi_xact_start(pSPIHandle, pNext);
+            return;
+        }
+        pNext->Status = SPI_XACT_ERROR;
+    }
+
+    spi_queue_next(pSPIHandle);
+}
+
+/*********************************************************************
+ * @fn      		- SPI_PeriClockControl
+ * @brief           - Enable or disable the peripheral clock of an SPI
+ * @param[in]       - pSPIx: Base address of the SPI peripheral
+ * @param[in]       - EnorDi: ENABLE or DISABLE macro
+ * @return          - None
+ *********************************************************************/
+void SPI_PeriClockControl(SPI_RegDef_t *pSPIx, uint8_t EnorDi)
+{
+    const spi_port_t *pPort = spi_port(pSPIx);
+    __VO uint32_t *pENR;
+
+    if (pPort == NULL)
+        return;
+
+    pENR = pPort->APB2 ? &RCC->APB2ENR : &RCC->APB1ENR;
+    if (EnorDi == ENABLE)
+        *pENR |= (1U << pPort->ClockBit);
+    else
+        *pENR &= ~(1U << pPort->ClockBit);
+}
+
+/*********************************************************************
+ * @fn      		- SPI_Init
+ * @brief           - Set up an SPI from pSPIHandle->SPIConfig
+ * @param[in]       - pSPIHandle: handle with pSPIx and SPIConfig set
+ * @return          - 1 on success, 0 if the port or a config field is
+ *                    invalid; the SPI is then left untouched
+ * @Note            - Enables the SPI, GPIO and DMA clocks, puts the
+ *                    default pins (see spi_ports) in alternate function
+ *                    mode and enables the SPI (SPE). SclkHz is computed
+ *                    from the live PCLK. With SPI_SSM_EN a master holds
+ *                    SSI high so it never sees a mode fault; with
+ *                    SPI_SSM_DI a master drives NSS itself (SSOE).
+ *********************************************************************/
+uint8_t SPI_Init(SPI_Handle_t *pSPIHandle)
+{
+    SPI_Config_t *pConfig = &pSPIHandle->SPIConfig;
+    SPI_RegDef_t *pSPIx = pSPIHandle->pSPIx;
+    const spi_port_t *pPort = spi_port(pSPIx);
+    uint8_t master = pConfig->SPI_DeviceMode == SPI_DEVICE_MODE_MASTER;
+    uint32_t pclk, cr1, cr2 = 0;
+
+    if (pPort == NULL)
+        return 0;
+    if (pConfig->SPI_SclkSpeed > SPI_SCLK_SPEED_DIV256 || pConfig->SPI_DFF > SPI_DFF_16BITS)
+        return 0;
+    if (pConfig->SPI_BusConfig < SPI_BUS_CONFIG_FD || pConfig->SPI_BusConfig > SPI_BUS_CONFIG_SIMPLEX_RXONLY)
+        return 0;
+
+    // 1. Clocks, pins and DMA streams
+    SPI_PeriClockControl(pSPIx, ENABLE);
+    spi_pins_init(pPort);
+
+    pSPIHandle->pDMA = NULL;
+    pSPIHandle->DMABusy = 0;
+    pSPIHandle->pActive = NULL;
+    pSPIHandle->pCurDevice = NULL;
+    if (pPort->DMA == 2)
+    {
+        DMA2_PCLK_EN();
+        pSPIHandle->pDMA = DMA2;
+        pSPIHandle->TxStream = pPort->TxStream;
+        pSPIHandle->RxStream = pPort->RxStream;
+        pSPIHandle->DMAChannel = pPort->Channel;
+    }
+
+    // 2. Frame format and bus
+    cr1 = ((uint32_t)pConfig->SPI_SclkSpeed << SPI_CR1_BR)
+        | ((uint32_t)(pConfig->SPI_CPOL & 1U) << SPI_CR1_CPOL)
+        | ((uint32_t)(pConfig->SPI_CPHA & 1U) << SPI_CR1_CPHA)
+        | ((uint32_t)pConfig->SPI_DFF << SPI_CR1_DFF);
+    if (master)
+        cr1 |= (1U << SPI_CR1_MSTR);
+    if (pConfig->SPI_SSM == SPI_SSM_EN)
+        cr1 |= (1U << SPI_CR1_SSM) | ((uint32_t)master << SPI_CR1_SSI);
+    else if (master)
+        cr2 |= (1U << SPI_CR2_SSOE);
+
+    if (pConfig->SPI_BusConfig == SPI_BUS_CONFIG_HD)
+        cr1 |= (1U << SPI_CR1_BIDIMODE);
+    else if (pConfig->SPI_BusConfig == SPI_BUS_CONFIG_SIMPLEX_RXONLY)
+        cr1 |= (1U << SPI_CR1_RXONLY);
+
+    // 3. SPE last: CR1 must not change while the SPI is enabled
+    pSPIx->CR1 = 0;
+    pSPIx->CR2 = cr2;
+    pSPIx->CR1 = cr1;
+    pSPIx->CR1 = cr1 | (1U << SPI_CR1_SPE);
+
+    pclk = pPort->APB2 ? RCC_GetPCLK2Value() : RCC_GetPCLK1Value();
+    pSPIHandle->SclkHz = pclk >> (pConfig->SPI_SclkSpeed + 1U);
+    return 1;
+}
+
+/*********************************************************************
+ * @fn      		- SPI_DeInit
+ * @brief           - Reset all registers of an SPI
+ * @param[in]       - pSPIx: Base address of the SPI peripheral
+ * @return          - None
+ * @Note            - Pulses the port's bit in RCC APBxRSTR
+ *********************************************************************/
+void SPI_DeInit(SPI_RegDef_t *pSPIx)
+{
+    const spi_port_t *pPort = spi_port(pSPIx);
+    __VO uint32_t *pRSTR;
+
+    if (pPort == NULL)
+        return;
+
+    pRSTR = pPort->APB2 ? &RCC->APB2RSTR : &RCC->APB1RSTR;
+    *pRSTR |= (1U << pPort->ClockBit);
+    *pRSTR &= ~(1U << pPort->ClockBit);
+}
+
+/*********************************************************************
+ * @fn      		- SPI_TransferData
+ * @brief           - Full-duplex block transfer, waiting on TXE/RXNE
+ * @param[in]       - pSPIHandle: SPI handle set up by SPI_Init (master)
+ * @param[in]       - pTxBuffer: frames to send, NULL to send SPI_DUMMY_FRAME
+ * @param[out]      - pRxBuffer: received frames, NULL to discard them
+ * @param[in]       - Len: number of bytes (two per 16-bit frame)
+ * @return          - None
+ * @Note            - Up to two frames are in flight: one in the shift
+ *                    register, the next in the TX buffer, written before
+ *                    the previous frame is read. The third is held back
+ *                    until RXNE has been served, so RX cannot overrun
+ *                    unless an interrupt stalls the loop for longer than
+ *                    a frame time. Returns once the bus is idle (BSY).
+ *********************************************************************/
+void SPI_TransferData(SPI_Handle_t *pSPIHandle, const uint8_t *pTxBuffer, uint8_t *pRxBuffer, uint32_t Len)
+{
+    SPI_RegDef_t *pSPIx = pSPIHandle->pSPIx;
+    uint8_t dff16 = pSPIHandle->SPIConfig.SPI_DFF == SPI_DFF_16BITS;
+    uint32_t count = dff16 ? Len / 2 : Len;
+    uint32_t tx = 0, rx = 0;
+    uint32_t frame;
+
+    if (pRxBuffer == NULL && pTxBuffer != NULL)
+    {
+        SPI_SendData(pSPIHandle, pTxBuffer, Len);
+        return;
+    }
+
+    while (rx < count)
+    {
+        if (tx < count && tx - rx < 2 && (pSPIx->SR & (1U << SPI_SR_TXE)))
+        {
+            pSPIx->DR = spi_frame(pTxBuffer, tx, dff16);
+            tx++;
+        }
+        if (pSPIx->SR & (1U << SPI_SR_RXNE))
+        {
+            frame = pSPIx->DR;
+            if (pRxBuffer != NULL && dff16)
+                ((uint16_t *)pRxBuffer)[rx] = (uint16_t)frame;
+            else if (pRxBuffer != NULL)
+                pRxBuffer[rx] = (uint8_t)frame;
+            rx++;
+        }
+    }
+    while (pSPIx->SR & (1U << SPI_SR_BSY))
+        ;
+}
+
+/*********************************************************************
+ * @fn      		- SPI_SendData
+ * @brief           - Transmit-only block transfer, received frames dropped
+ * @param[in]       - pSPIHandle: SPI handle set up by SPI_Init (master)
+ * @param[in]       - pTxBuffer: frames to send
+ * @param[in]       - Len: number of bytes (two per 16-bit frame)
+ * @return          - None
+ * @Note            - Only TXE is polled, so the TX buffer is refilled as
+ *                    soon as a frame moves to the shift register. RX
+ *                    overruns on the way (OVR); once the bus is idle the
+ *                    DR then SR read clears RXNE and OVR for the next
+ *                    transfer.
+ *********************************************************************/
+void SPI_SendData(SPI_Handle_t *pSPIHandle, const uint8_t *pTxBuffer, uint32_t Len)
+{
+    SPI_RegDef_t *pSPIx = pSPIHandle->pSPIx;
+    uint8_t dff16 = pSPIHandle->SPIConfig.SPI_DFF == SPI_DFF_16BITS;
+    uint32_t count = dff16 ? Len / 2 : Len;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        while (!(pSPIx->SR & (1U << SPI_SR_TXE)))
+            ;
+        pSPIx->DR = spi_frame(pTxBuffer, i, dff16);
+    }
+    while (!(pSPIx->SR & (1U << SPI_SR_TXE)))
+        ;
+    while (pSPIx->SR & (1U << SPI_SR_BSY))
+        ;
+
+    (void)pSPIx->DR;
+    (void)pSPIx->SR;
+}
+
+/*********************************************************************
+ * @fn      		- SPI_ReceiveData
+ * @brief           - Receive a block, clocking out SPI_DUMMY_FRAME
+ * @param[in]       - pSPIHandle: SPI handle set up by SPI_Init (master)
+ * @param[out]      - pRxBuffer: received frames
+ * @param[in]       - Len: number of bytes (two per 16-bit frame)
+ * @return          - None
+ *********************************************************************/
+void SPI_ReceiveData(SPI_Handle_t *pSPIHandle, uint8_t *pRxBuffer, uint32_t Len)
+{
+    SPI_TransferData(pSPIHandle, NULL, pRxBuffer, Len);
+}
+
+/*********************************************************************
+ * @fn      		- SPI_TransferDMA
+ * @brief           - Full-duplex block transfer by DMA
+ * @param[in]       - pSPIHandle: SPI handle set up by SPI_Init (master)
+ * @param[in]       - pTxBuffer: frames to send, NULL to send SPI_DUMMY_FRAME;
+ *                    untouched until the callback
+ * @param[out]      - pRxBuffer: received frames, NULL to discard them
+ * @param[in]       - Len: number of bytes (two per 16-bit frame), up to
+ *                    SPI_DMA_MAX_FRAMES frames
+ * @return          - 1 if the transfer was started, 0 if the port has no
+ *                    DMA, Len is invalid or a transfer is running
+ * @Note            - SPI1: RX on DMA2 stream 0, TX on stream 3, channel 3.
+ *                    The RX stream runs even when frames are discarded
+ *                    and has the higher priority, so RX never overruns
+ *                    and its transfer complete marks the end of the
+ *                    block. Enable the RX stream's interrupt (SPI1:
+ *                    IRQ_NO_DMA2_STREAM0), and the TX stream's to see
+ *                    TX transfer errors.
+ *********************************************************************/
+uint8_t SPI_TransferDMA(SPI_Handle_t *pSPIHandle, const uint8_t *pTxBuffer, uint8_t *pRxBuffer, uint32_t Len)
+{
+    SPI_RegDef_t *pSPIx = pSPIHandle->pSPIx;
+    DMA_RegDef_t *pDMA = pSPIHandle->pDMA;
+    uint8_t dff16 = pSPIHandle->SPIConfig.SPI_DFF == SPI_DFF_16BITS;
+    uint32_t count = dff16 ? Len / 2 : Len;
+    uint32_t common;
+    DMA_Stream_RegDef_t *pRx;
+    DMA_Stream_RegDef_t *pTx;
+
+    if (pDMA == NULL || count == 0 || count > SPI_DMA_MAX_FRAMES)
+        return 0;
+    if (SPI_Busy(pSPIHandle))
+        return 0;
+
+    pRx = &pDMA->S[pSPIHandle->RxStream];
+    pTx = &pDMA->S[pSPIHandle->TxStream];
+    DMA_StreamDisable(pDMA, pSPIHandle->RxStream);
+    DMA_StreamDisable(pDMA, pSPIHandle->TxStream);
+
+    pSPIHandle->pTxData = pTxBuffer;
+    pSPIHandle->pRxData = pRxBuffer;
+    pSPIHandle->Len = count;
+    pSPIHandle->DMABusy = 1;
+
+    // DR then SR read drops a stale frame and OVR
+    (void)pSPIx->DR;
+    (void)pSPIx->SR;
+
+    common = ((uint32_t)pSPIHandle->DMAChannel << DMA_SCR_CHSEL) | (1U << DMA_SCR_TEIE);
+    if (dff16)
+        common |= (1U << DMA_SCR_PSIZE) | (1U << DMA_SCR_MSIZE);
+
+    // RX first (RM0390: RXDMAEN, streams, then TXDMAEN)
+    pRx->PAR = MMIO_DEV_ADDR(&pSPIx->DR);
+    pRx->M0AR = (uint32_t)(uintptr_t)(pRxBuffer != NULL ? (void *)pRxBuffer : (void *)&spi_dummy_rx);
+    pRx->NDTR = count;
+    pRx->FCR = 0;
+    pRx->CR = common | (2U << DMA_SCR_PL) | (1U << DMA_SCR_TCIE)
+            | ((pRxBuffer != NULL) ? (1U << DMA_SCR_MINC) : 0U) | (1U << DMA_SCR_EN);
+    REG_WRITE_BIT(pSPIx->CR2, SPI_CR2_RXDMAEN, 1);
+
+    pTx->PAR = MMIO_DEV_ADDR(&pSPIx->DR);
+    pTx->M0AR = (uint32_t)(uintptr_t)(pTxBuffer != NULL ? (const void *)pTxBuffer : (const void *)&spi_dummy_tx);
+    pTx->NDTR = count;
+    pTx->FCR = 0;
+    pTx->CR = common | (1U << DMA_SCR_DIR)
+            | ((pTxBuffer != NULL) ? (1U << DMA_SCR_MINC) : 0U) | (1U << DMA_SCR_EN);
+    REG_WRITE_BIT(pSPIx->CR2, SPI_CR2_TXDMAEN, 1);
+    return 1;
+}
+
+/*********************************************************************
+ * @fn      		- SPI_Busy
+ * @brief           - Check whether a transfer is still in progress
+ * @param[in]       - pSPIHandle: SPI handle
+ * @return          - 1 while a DMA block is running or the bus is busy
+ *********************************************************************/
+uint8_t SPI_Busy(SPI_Handle_t *pSPIHandle)
+{
+    return pSPIHandle->DMABusy || (pSPIHandle->pSPIx->SR & (1U << SPI_SR_BSY)) != 0;
+}
+
+/*********************************************************************
+ * @fn      		- SPI_DeviceInit
+ * @brief           - Set up a device's chip select pin
+ * @param[in]       - pDevice: device with pCSPort and CSPin set
+ * @return          - None
+ * @Note            - Push-pull output, driven high (deselected) before
+ *                    the pin is switched to output
+ *********************************************************************/
+void SPI_DeviceInit(const SPI_Device_t *pDevice)
+{
+    GPIO_PinMaskConfig_t config;
+
+    if (pDevice->pCSPort == NULL)
+        return;
+
+    GPIO_PeriClockControl(pDevice->pCSPort, ENABLE);
+    pDevice->pCSPort->BSRR = 1U << pDevice->CSPin;
+
+    config.GPIO_PinMask = (uint16_t)(1U << pDevice->CSPin);
+    config.GPIO_PinMode = GPIO_MODE_OUT;
+    config.GPIO_PinSpeed = GPIO_SPEED_HIGH;
+    config.GPIO_PinPupdControl = GPIO_NO_PUPD;
+    config.GPIO_PinOPType = GPIO_OP_TYPE_PP;
+    config.GPIO_PinAltFunMode = 0;
+    GPIO_InitPins(pDevice->pCSPort, &config);
+}
+
+/*********************************************************************
+ * @fn      		- SPI_QueueInit
+ * @brief           - Set up the transaction queue of an SPI handle
+ * @param[in]       - pSPIHandle: SPI handle set up by SPI_Init (master)
+ * @param[in]       - pStorage: Slots transaction pointers
+ * @param[in]       - Slots: queue length, a power of two
+ * @return          - 1 on success, 0 if Slots is not a power of two
+ * @Note            - The queue is a RingBuffer_t of descriptor pointers:
+ *                    SPI_Submit (thread context) is the only producer,
+ *                    the SPI/DMA interrupts the only consumer. Done
+ *                    callbacks chain through pNext instead.
+ *********************************************************************/
+uint8_t SPI_QueueInit(SPI_Handle_t *pSPIHandle, SPI_Transaction_t **pStorage, uint32_t Slots)
+{
+    if (!RingBuffer_Init(&pSPIHandle->Queue, (uint8_t *)pStorage, Slots * sizeof(SPI_Transaction_t *)))
+        return 0;
+
+    pSPIHandle->pActive = NULL;
+    return 1;
+}
+
+/*********************************************************************
+ * @fn      		- SPI_Submit
+ * @brief           - Queue a transaction without waiting for the bus
+ * @param[in]       - pSPIHandle: SPI handle set up by SPI_QueueInit
+ * @param[in]       - pXact: transaction; it and its buffers stay untouched
+ *                    until Status leaves SPI_XACT_QUEUED/ACTIVE
+ * @return          - 1 if queued, 0 if the queue is full, the transaction
+ *                    is invalid or still in the queue
+ * @Note            - Returns at once. Transactions run in submission
+ *                    order, back-to-back, each framed by its device's CS.
+ *                    Enable the SPI IRQ (and the DMA stream IRQs) at one
+ *                    priority. Not to be mixed with the blocking calls or
+ *                    SPI_TransferDMA while transactions are pending.
+ *                    Thread context only, never from a Done callback: the
+ *                    queue has one producer. A callback sets pNext to run
+ *                    a follow-up transaction next.
+ *********************************************************************/
+uint8_t SPI_Submit(SPI_Handle_t *pSPIHandle, SPI_Transaction_t *pXact)
+{
+    if (pSPIHandle->Queue.Size == 0 || !spi_xact_valid(pXact))
+        return 0;
+    if (RingBuffer_Free(&pSPIHandle->Queue) < sizeof(pXact))
+        return 0;
+
+    pXact->Status = SPI_XACT_QUEUED;
+    RingBuffer_PutBulk(&pSPIHandle->Queue, (const uint8_t *)&pXact, sizeof(pXact));
+
+    // Queue first, then the kick: TXE is set while the bus is idle, so the
+    // SPI interrupt runs at once and starts the transaction. A running
+    // transaction starts it on completion instead.
+    REG_WRITE_BIT(pSPIHandle->pSPIx->CR2, SPI_CR2_TXEIE, 1);
+    return 1;
+}
+
+/*********************************************************************
+ * @fn      		- SPI_QueueIdle
+ * @brief           - Check whether all submitted transactions are done
+ * @param[in]       - pSPIHandle: SPI handle
+ * @return          - 1 if nothing is queued or on the bus
+ *********************************************************************/
+uint8_t SPI_QueueIdle(SPI_Handle_t *pSPIHandle)
+{
+    return pSPIHandle->pActive == NULL && RingBuffer_Count(&pSPIHandle->Queue) == 0;
+}
+
+/*********************************************************************
+ * @fn      		- SPI_IRQConfig
+ * @brief           - Enable or disable an SPI or DMA stream interrupt
+ * @param[in]       - IRQNumber: IRQ number (e.g. IRQ_NO_DMA2_STREAM0)
+ * @param[in]       - IRQPriority: priority, 0 (highest) to 15
+ * @param[in]       - EnorDi: ENABLE or DISABLE
+ * @return          - None
+ * @Note            - See NVIC_IRQConfig
+ *********************************************************************/
+void SPI_IRQConfig(uint8_t IRQNumber, uint8_t IRQPriority, uint8_t EnorDi)
+{
+    NVIC_IRQConfig(IRQNumber, IRQPriority, EnorDi);
+}
+
+/*********************************************************************
+ * @fn      		- SPI_IRQHandling
+ * @brief           - SPI interrupt: runs the transaction queue
+ * @param[in]       - pSPIHandle: SPI handle
+ * @return          - None
+ * @Note            - Call from SPIx_IRQHandler. With the bus idle, starts
+ *                    the next queued transaction. For an interrupt-driven
+ *                    transaction RXNE stores a frame and TXE writes the
+ *                    next, at most two frames ahead of RX as in
+ *                    SPI_TransferData; the last RXNE completes it. An
+ *                    overrun aborts it with SPI_EVENT_XFER_ERROR.
+ *********************************************************************/
+void SPI_IRQHandling(SPI_Handle_t *pSPIHandle)
+{
+    SPI_RegDef_t *pSPIx = pSPIHandle->pSPIx;
+    SPI_Transaction_t *pXact = pSPIHandle->pActive;
+    uint8_t dff16 = pSPIHandle->SPIConfig.SPI_DFF == SPI_DFF_16BITS;
+    uint32_t sr = pSPIx->SR;
+    uint32_t frame;
+
+    if (pXact == NULL)
+    {
+        spi_queue_next(pSPIHandle);
+        return;
+    }
+    if (pSPIHandle->DMABusy)
+    {
+        // Kicked by SPI_Submit: the DMA completion starts the next one
+        REG_WRITE_BIT(pSPIx->CR2, SPI_CR2_TXEIE, 0);
+        return;
+    }
+
+    if (sr & (1U << SPI_SR_RXNE))
+    {
+        frame = pSPIx->DR;
+        if (sr & (1U << SPI_SR_OVR))
+        {
+            (void)pSPIx->SR;	// DR then SR read clears OVR
+            spi_xact_finish(pSPIHandle, SPI_EVENT_XFER_ERROR);
+            return;
+        }
+        if (pXact->pRxBuffer != NULL && dff16)
+            ((uint16_t *)pXact->pRxBuffer)[pSPIHandle->XferRx] = (uint16_t)frame;
+        else if (pXact->pRxBuffer != NULL)
+            pXact->pRxBuffer[pSPIHandle->XferRx] = (uint8_t)frame;
+
+        if (++pSPIHandle->XferRx == pSPIHandle->XferCount)
+        {
+            spi_xact_finish(pSPIHandle, SPI_EVENT_XFER_CMPLT);
+            return;
+        }
+    }
+
+    if (pSPIHandle->XferTx < pSPIHandle->XferCount && pSPIHandle->XferTx - pSPIHandle->XferRx < 2
+        && (pSPIx->SR & (1U << SPI_SR_TXE)))
+    {
+        pSPIx->DR = spi_frame(pXact->pTxBuffer, pSPIHandle->XferTx, dff16);
+        pSPIHandle->XferTx++;
+    }
+
+    // TXE only matters while a frame may be written; RXNE reopens it
+    REG_WRITE_BIT(pSPIx->CR2, SPI_CR2_TXEIE,
+                      pSPIHandle->XferTx < pSPIHandle->XferCount && pSPIHandle->XferTx - pSPIHandle->XferRx < 2);
+}
+
+/*********************************************************************
+ * @fn      		- SPI_DMAIRQHandling
+ * @brief           - RX and TX DMA stream interrupt
+ * @param[in]       - pSPIHandle: SPI handle
+ * @return          - None
+ * @Note            - Call from both streams' IRQ handlers (SPI1:
+ *                    DMA2_Stream0_IRQHandler and DMA2_Stream3_IRQHandler).
+ *                    RX transfer complete ends the block; a transfer error
+ *                    on either stream aborts it. A queued transaction is
+ *                    finished and the next one started; run both streams
+ *                    at the SPI IRQ's priority when using the queue.
+ *********************************************************************/
+void SPI_DMAIRQHandling(SPI_Handle_t *pSPIHandle)
+{
+    DMA_RegDef_t *pDMA = pSPIHandle->pDMA;
+    uint8_t rx_stream = pSPIHandle->RxStream;
+    uint8_t tx_stream = pSPIHandle->TxStream;
+    uint32_t rx_flags, tx_flags;
+    uint8_t error;
+
+    if (pDMA == NULL || !pSPIHandle->DMABusy)
+        return;
+
+    rx_flags = (pDMA->ISR[rx_stream >> 2] >> DMA_FLAG_SHIFT(rx_stream)) & DMA_STREAM_FLAGS;
+    tx_flags = (pDMA->ISR[tx_stream >> 2] >> DMA_FLAG_SHIFT(tx_stream)) & DMA_STREAM_FLAGS;
+    error = ((rx_flags | tx_flags) & (1U << DMA_FLAG_TEIF)) != 0;
+
+    if (!error && !(rx_flags & (1U << DMA_FLAG_TCIF)))
+        return;
+
+    pDMA->S[rx_stream].CR = 0;
+    pDMA->S[tx_stream].CR = 0;
+    pDMA->IFCR[rx_stream >> 2] = rx_flags << DMA_FLAG_SHIFT(rx_stream);
+    pDMA->IFCR[tx_stream >> 2] = tx_flags << DMA_FLAG_SHIFT(tx_stream);
+    REG_WRITE_BIT(pSPIHandle->pSPIx->CR2, SPI_CR2_TXDMAEN, 0);
+    REG_WRITE_BIT(pSPIHandle->pSPIx->CR2, SPI_CR2_RXDMAEN, 0);
+    pSPIHandle->DMABusy = 0;
+
+    if (pSPIHandle->pActive != NULL)
+        spi_xact_finish(pSPIHandle, error ? SPI_EVENT_XFER_ERROR : SPI_EVENT_XFER_CMPLT);
+    else if (pSPIHandle->Callback != NULL)
+        pSPIHandle->Callback(pSPIHandle, error ? SPI_EVENT_XFER_ERROR : SPI_EVENT_XFER_CMPLT);
+}
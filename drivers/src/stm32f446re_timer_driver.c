@@ -0,0 +1,786 @@
+/*
+ * stm32f446re_timer_driver.c
+ *
+ * Timer driver for STM32F446RE, TIM2-TIM5
+ * TIM_Init turns a period in microseconds into PSC and ARR using TIMxCLK
+ * as the clock tree is set up right now, instead of a bus frequency fixed
+ * at build time. The smallest prescaler that lets the period fit in ARR
+ * gives the finest resolution; if a slightly larger one divides the
+ * period exactly, that one is used instead.
+ * The software timer service keeps its timers in a list sorted by
+ * deadline and programs one compare channel of a free-running counter
+ * with the earliest deadline only. The channel interrupt therefore fires
+ * once per expiry rather than at a fixed tick rate, and the counter keeps
+ * time while the core sleeps in between.
+ */
+
+#include <stddef.h>
+#include "stm32f446re_timer_driver.h"
+#include "stm32f446re_rcc_driver.h"
+
+/*
+ * The software timer channel's CCxIE is cleared from thread context to
+ * keep the timer interrupt out while the list is changed, and set again
+ * from both contexts, always through REG_WRITE_BIT.
+ */
+
+#define TIM_PSC_MAX			65536U	// PSC + 1
+#define TIM_PSC_SEARCH_DIV	16U		// Exact-period search: up to 1/16 above the smallest prescaler
+
+// Channel x's byte in CCMR1/CCMR2 and nibble in CCER
+#define TIM_CCMR_SHIFT(Channel)	( (((Channel) - 1U) & 1U) * 8U )
+#define TIM_CCER_SHIFT(Channel)	( ((Channel) - 1U) * 4U )
+
+// Everything the driver needs to know about one timer
+typedef struct
+{
+uint32_t BaseAddr ;
+uint8_t ClockBit ;			// Bit in RCC APB1ENR / APB1RSTR
+uint8_t IRQNumber ;
+uint8_t Wide ;				// 1: 32-bit counter, 0: 16-bit
+
+} tim_port_t;
+
+static const tim_port_t tim_ports[] =
+{
+    // Base          Bit  IRQ           Wide
+    { TIM2_BASEADDR, 0,   IRQ_NO_TIM2,  1 },
+    { TIM3_BASEADDR, 1,   IRQ_NO_TIM3,  0 },
+    { TIM4_BASEADDR, 2,   IRQ_NO_TIM4,  0 },
+    { TIM5_BASEADDR, 3,   IRQ_NO_TIM5,  1 },
+};
+
+/*********************************************************************
+ * @fn      		- tim_port
+ * @brief           - Look up a timer in tim_ports
+ * @param[in]       - pTIMx: Base address of the timer
+ * @return          - Table entry, NULL if pTIMx is not TIM2-TIM5
+ *********************************************************************/
+static const tim_port_t *tim_port(TIM_RegDef_t *pTIMx)
+{
+    uint32_t base = MMIO_DEV_ADDR(pTIMx);
+
+    for (uint32_t i = 0; i < sizeof(tim_ports) / sizeof(tim_ports[0]); i++)
+    {
+        if (tim_ports[i].BaseAddr == base)
+            return &tim_ports[i];
+    }
+    return NULL;
+}
+
+/*********************************************************************
+ * @fn      		- tim_kernel_clock
+ * @brief           - Clock of the APB1 timers (TIMxCLK)
+ * @return          - Frequency in Hz
+ * @Note            - PCLK1 when APB1 is not divided, twice PCLK1
+ *                    otherwise (RCC DCKCFGR TIMPRE at its reset value)
+ *********************************************************************/
+static uint32_t tim_kernel_clock(void)
+{
+    uint32_t ppre = (RCC->CFGR >> RCC_CFGR_PPRE1) & 0x7U;
+
+    return ppre < 4 ? RCC_GetPCLK1Value() : RCC_GetPCLK1Value() * 2U;
+}
+
+/*********************************************************************
+ * @fn      		- tim_ticks
+ * @brief           - Counter ticks in a time span
+ * @param[in]       - ClockHz: TIMxCLK
+ * @param[in]       - Prescaler: PSC + 1
+ * @param[in]       - Us: time span in microseconds
+ * @return          - Ticks, rounded to the nearest
+ *********************************************************************/
+static uint64_t tim_ticks(uint32_t ClockHz, uint32_t Prescaler, uint32_t Us)
+{
+    uint64_t den = (uint64_t)Prescaler * 1000000U;
+
+    return ((uint64_t)ClockHz * Us + den / 2U) / den;
+}
+
+/*********************************************************************
+ * @fn      		- tim_prescaler
+ * @brief           - Prescaler for a period of Ticks timer clocks
+ * @param[in]       - Ticks: period in TIMxCLK cycles
+ * @param[in]       - Mask: largest ARR value
+ * @return          - PSC + 1, 0 if the period does not fit
+ * @Note            - Smallest prescaler for which the period fits in
+ *                    ARR, or the first up to 1/TIM_PSC_SEARCH_DIV above
+ *                    it that divides the period exactly (1 s at 16 MHz on
+ *                    a 16-bit timer: 250 x 64000 rather than 245 x 65306).
+ *                    The resolution stays within 1/16 of the finest; past
+ *                    that the smallest prescaler is kept and ARR rounded
+ *                    (257 x 509 ticks: 2 x 65407, not 257 x 509).
+ *********************************************************************/
+static uint32_t tim_prescaler(uint64_t Ticks, uint32_t Mask)
+{
+    uint64_t presc = (Ticks + Mask) / ((uint64_t)Mask + 1U);
+
+    if (presc == 0)
+        presc = 1;
+    if (presc > TIM_PSC_MAX)
+        return 0;
+
+    for (uint64_t p = presc; p <= TIM_PSC_MAX && p <= presc + presc / TIM_PSC_SEARCH_DIV; p++)
+    {
+        if (Ticks % p == 0)
+            return (uint32_t)p;
+    }
+    return (uint32_t)presc;
+}
+
+/*********************************************************************
+ * @fn      		- tim_soft_key
+ * @brief           - Sort key of a software timer deadline
+ * @param[in]       - pTIMHandle: timer handle
+ * @param[in]       - Deadline: counter value
+ * @param[in]       - Now: counter value the keys are compared at
+ * @return          - Key, increasing with the deadline
+ * @Note            - Deadlines are at most TIM_SoftTimerMaxTicks (a
+ *                    quarter of the counter range) ahead. Anything
+ *                    further is taken as overdue and sorts first, so a
+ *                    deadline the counter has just passed stays ahead
+ *                    of the ones still to come.
+ *********************************************************************/
+static uint32_t tim_soft_key(const TIM_Handle_t *pTIMHandle, uint32_t Deadline, uint32_t Now)
+{
+    uint32_t mask = pTIMHandle->CounterMask;
+
+    return (Deadline - Now - (mask >> 2) - 1U) & mask;
+}
+
+/*********************************************************************
+ * @fn      		- tim_soft_due
+ * @brief           - Has a deadline been reached
+ * @param[in]       - pTIMHandle: timer handle
+ * @param[in]       - Deadline: counter value
+ * @param[in]       - Now: current counter value
+ * @return          - 1 if Deadline is Now or overdue
+ *********************************************************************/
+static uint8_t tim_soft_due(const TIM_Handle_t *pTIMHandle, uint32_t Deadline, uint32_t Now)
+{
+    uint32_t mask = pTIMHandle->CounterMask;
+    uint32_t dist = (Deadline - Now) & mask;
+
+    return dist == 0 || dist > (mask >> 2);
+}
+
+/*********************************************************************
+ * @fn      		- tim_soft_insert
+ * @brief           - Link a software timer into the deadline list
+ * @param[in]       - pTIMHandle: timer handle, channel interrupt held off
+ * @param[in]       - pTimer: timer with Deadline set
+ * @param[in]       - Now: current counter value
+ * @return          - None
+ * @Note            - Goes after timers with the same deadline, so they
+ *                    expire in the order they were started
+ *********************************************************************/
+static void tim_soft_insert(TIM_Handle_t *pTIMHandle, TIM_SoftTimer_t *pTimer, uint32_t Now)
+{
+    TIM_SoftTimer_t **ppLink = &pTIMHandle->pSoftHead;
+    uint32_t key = tim_soft_key(pTIMHandle, pTimer->Deadline, Now);
+
+    while (*ppLink != NULL && tim_soft_key(pTIMHandle, (*ppLink)->Deadline, Now) <= key)
+        ppLink = &(*ppLink)->pNext;
+    pTimer->pNext = *ppLink;
+    *ppLink = pTimer;
+}
+
+/*********************************************************************
+ * @fn      		- tim_soft_remove
+ * @brief           - Unlink a software timer from the deadline list
+ * @param[in]       - pTIMHandle: timer handle, channel interrupt held off
+ * @param[in]       - pTimer: timer to unlink
+ * @return          - None
+ *********************************************************************/
+static void tim_soft_remove(TIM_Handle_t *pTIMHandle, TIM_SoftTimer_t *pTimer)
+{
+    TIM_SoftTimer_t **ppLink = &pTIMHandle->pSoftHead;
+
+    while (*ppLink != NULL && *ppLink != pTimer)
+        ppLink = &(*ppLink)->pNext;
+    if (*ppLink != NULL)
+        *ppLink = pTimer->pNext;
+    pTimer->pNext = NULL;
+}
+
+/*********************************************************************
+ * @fn      		- tim_soft_arm
+ * @brief           - Program the compare channel for the earliest deadline
+ * @param[in]       - pTIMHandle: timer handle
+ * @return          - 1 if that deadline has already been reached
+ * @Note            - The compare flag is cleared after CCR is written,
+ *                    so a match on the old value cannot fire the
+ *                    interrupt. If the counter reached the deadline
+ *                    before the flag could be set, the return value
+ *                    says so. With no timer armed the channel interrupt
+ *                    is left off.
+ *********************************************************************/
+static uint8_t tim_soft_arm(TIM_Handle_t *pTIMHandle)
+{
+    TIM_RegDef_t *pTIMx = pTIMHandle->pTIMx;
+    uint8_t ch = pTIMHandle->SoftChannel;
+    TIM_SoftTimer_t *pHead = pTIMHandle->pSoftHead;
+    uint8_t due;
+
+    if (pHead == NULL)
+    {
+        REG_WRITE_BIT(pTIMx->DIER, TIM_DIER_CC1IE + ch - 1U, 0);
+        return 0;
+    }
+
+    pTIMx->CCR[ch - 1U] = pHead->Deadline;
+    pTIMx->SR = ~(1U << (TIM_SR_CC1IF + ch - 1U));
+    due = tim_soft_due(pTIMHandle, pHead->Deadline, pTIMx->CNT);
+    REG_WRITE_BIT(pTIMx->DIER, TIM_DIER_CC1IE + ch - 1U, 1);
+    return due;
+}
+
+/*********************************************************************
+ * @fn      		- tim_soft_lock / tim_soft_unlock
+ * @brief           - Hold the software timer interrupt off while the
+ *                    list is changed, then rearm the channel
+ * @param[in]       - pTIMHandle: timer handle
+ * @return          - None
+ * @Note            - A deadline already reached when the channel is
+ *                    rearmed is handed to the interrupt with a software
+ *                    compare event (CCxG) rather than run here
+ *********************************************************************/
+static void tim_soft_lock(TIM_Handle_t *pTIMHandle)
+{
+    REG_WRITE_BIT(pTIMHandle->pTIMx->DIER, TIM_DIER_CC1IE + pTIMHandle->SoftChannel - 1U, 0);
+}
+
+static void tim_soft_unlock(TIM_Handle_t *pTIMHandle)
+{
+    if (tim_soft_arm(pTIMHandle))
+        pTIMHandle->pTIMx->EGR = 1U << (TIM_EGR_CC1G + pTIMHandle->SoftChannel - 1U);
+}
+
+/*********************************************************************
+ * @fn      		- tim_soft_service
+ * @brief           - Software timer channel interrupt
+ * @param[in]       - pTIMHandle: timer handle
+ * @return          - None
+ * @Note            - Expires every timer whose deadline has been
+ *                    reached, reloads periodic ones from their previous
+ *                    deadline (no drift from interrupt latency), and
+ *                    rearms the channel. Deadlines reached meanwhile,
+ *                    e.g. while a callback ran, are expired in the
+ *                    same interrupt.
+ *********************************************************************/
+static void tim_soft_service(TIM_Handle_t *pTIMHandle)
+{
+    TIM_RegDef_t *pTIMx = pTIMHandle->pTIMx;
+    TIM_SoftTimer_t *pTimer;
+    uint32_t now;
+
+    pTIMHandle->SoftIRQs++;
+    do
+    {
+        now = pTIMx->CNT;
+        while ((pTimer = pTIMHandle->pSoftHead) != NULL && tim_soft_due(pTIMHandle, pTimer->Deadline, now))
+        {
+            pTIMHandle->pSoftHead = pTimer->pNext;
+            pTIMHandle->SoftExpired++;
+            if (pTimer->PeriodTicks != 0)
+            {
+                pTimer->Deadline = (pTimer->Deadline + pTimer->PeriodTicks) & pTIMHandle->CounterMask;
+                tim_soft_insert(pTIMHandle, pTimer, now);
+            }
+            else
+            {
+                pTimer->pNext = NULL;
+                pTimer->Active = 0;
+            }
+            pTimer->Fn(pTimer);
+        }
+    } while (tim_soft_arm(pTIMHandle));
+}
+
+/*********************************************************************
+ * @fn      		- TIM_PeriClockControl
+ * @brief           - Enable or disable the peripheral clock of a timer
+ * @param[in]       - pTIMx: Base address of the timer
+ * @param[in]       - EnorDi: ENABLE or DISABLE macro
+ * @return          - None
+ *********************************************************************/
+void TIM_PeriClockControl(TIM_RegDef_t *pTIMx, uint8_t EnorDi)
+{
+    const tim_port_t *pPort = tim_port(pTIMx);
+
+    if (pPort == NULL)
+        return;
+
+    if (EnorDi == ENABLE)
+        RCC->APB1ENR |= (1U << pPort->ClockBit);
+    else
+        RCC->APB1ENR &= ~(1U << pPort->ClockBit);
+}
+
+/*********************************************************************
+ * @fn      		- TIM_Init
+ * @brief           - Set up a timer from pTIMHandle->TIMConfig
+ * @param[in]       - pTIMHandle: handle with pTIMx and TIMConfig set
+ * @return          - 1 on success, 0 if the timer or the period/clock
+ *                    pair is invalid; the timer is then left untouched
+ * @Note            - With TIM_TickHz 0 the prescaler comes from
+ *                    TIM_PeriodUs (see tim_prescaler); otherwise it is
+ *                    TIMxCLK / TIM_TickHz, rounded, and TIM_PeriodUs
+ *                    (0: whole counter range) must fit in ARR at that
+ *                    rate. The counter is left stopped at 0 with the
+ *                    new PSC loaded and no flag set, channels off.
+ *********************************************************************/
+uint8_t TIM_Init(TIM_Handle_t *pTIMHandle)
+{
+    TIM_RegDef_t *pTIMx = pTIMHandle->pTIMx;
+    TIM_Config_t *pConfig = &pTIMHandle->TIMConfig;
+    const tim_port_t *pPort = tim_port(pTIMx);
+    uint32_t mask, clk, presc, cr1;
+    uint64_t ticks;
+
+    if (pPort == NULL)
+        return 0;
+    mask = pPort->Wide ? 0xFFFFFFFFU : 0xFFFFU;
+    clk = tim_kernel_clock();
+
+    // 1. Prescaler and period
+    if (pConfig->TIM_TickHz != 0)
+    {
+        presc = (uint32_t)((clk + (uint64_t)pConfig->TIM_TickHz / 2U) / pConfig->TIM_TickHz);
+        if (presc == 0 || presc > TIM_PSC_MAX)
+            return 0;
+        ticks = pConfig->TIM_PeriodUs ? tim_ticks(clk, presc, pConfig->TIM_PeriodUs) : (uint64_t)mask + 1U;
+    }
+    else if (pConfig->TIM_PeriodUs != 0)
+    {
+        ticks = tim_ticks(clk, 1, pConfig->TIM_PeriodUs);
+        presc = tim_prescaler(ticks, mask);
+        if (presc == 0)
+            return 0;
+        ticks = (ticks + presc / 2U) / presc;
+    }
+    else
+    {
+        presc = 1;
+        ticks = (uint64_t)mask + 1U;
+    }
+    if (ticks < 2 || ticks - 1U > mask)
+        return 0;
+
+    // 2. Counter, stopped, with PSC loaded by an update event that
+    //    does not set UIF (URS)
+    TIM_PeriClockControl(pTIMx, ENABLE);
+    pTIMx->CR1 = 0;
+    pTIMx->DIER = 0;
+    pTIMx->CCER = 0;
+    pTIMx->CCMR1 = 0;
+    pTIMx->CCMR2 = 0;
+    pTIMx->PSC = presc - 1U;
+    pTIMx->ARR = (uint32_t)(ticks - 1U);
+    cr1 = (1U << TIM_CR1_URS) | (1U << TIM_CR1_ARPE);
+    if (pConfig->TIM_OnePulse == TIM_ONE_PULSE_EN)
+        cr1 |= (1U << TIM_CR1_OPM);
+    pTIMx->CR1 = cr1;
+    pTIMx->EGR = 1U << TIM_EGR_UG;
+    pTIMx->SR = 0;
+    if (pConfig->TIM_UpdateIT == ENABLE)
+        pTIMx->DIER = 1U << TIM_DIER_UIE;
+
+    pTIMHandle->ClockHz = clk;
+    pTIMHandle->Prescaler = presc;
+    pTIMHandle->AutoReload = (uint32_t)(ticks - 1U);
+    pTIMHandle->CounterMask = mask;
+    pTIMHandle->IRQNumber = pPort->IRQNumber;
+    pTIMHandle->Overcaptures = 0;
+    pTIMHandle->SoftChannel = 0;
+    pTIMHandle->pSoftHead = NULL;
+    pTIMHandle->SoftExpired = 0;
+    pTIMHandle->SoftIRQs = 0;
+    return 1;
+}
+
+/*********************************************************************
+ * @fn      		- TIM_DeInit
+ * @brief           - Reset a timer's registers through RCC APB1RSTR
+ * @param[in]       - pTIMx: Base address of the timer
+ * @return          - None
+ *********************************************************************/
+void TIM_DeInit(TIM_RegDef_t *pTIMx)
+{
+    const tim_port_t *pPort = tim_port(pTIMx);
+
+    if (pPort == NULL)
+        return;
+
+    RCC->APB1RSTR |= (1U << pPort->ClockBit);
+    RCC->APB1RSTR &= ~(1U << pPort->ClockBit);
+}
+
+/*********************************************************************
+ * @fn      		- TIM_Start
+ * @brief           - Start the counter
+ * @param[in]       - pTIMHandle: timer handle
+ * @return          - None
+ * @Note            - In one-pulse mode each call gives one period; the
+ *                    hardware clears CEN again at the update event
+ *********************************************************************/
+void TIM_Start(TIM_Handle_t *pTIMHandle)
+{
+    pTIMHandle->pTIMx->CR1 |= (1U << TIM_CR1_CEN);
+}
+
+/*********************************************************************
+ * @fn      		- TIM_Stop
+ * @brief           - Stop the counter where it is
+ * @param[in]       - pTIMHandle: timer handle
+ * @return          - None
+ *********************************************************************/
+void TIM_Stop(TIM_Handle_t *pTIMHandle)
+{
+    pTIMHandle->pTIMx->CR1 &= ~(1U << TIM_CR1_CEN);
+}
+
+/*********************************************************************
+ * @fn      		- TIM_GetCounter
+ * @brief           - Current counter value
+ * @param[in]       - pTIMHandle: timer handle
+ * @return          - CNT
+ *********************************************************************/
+uint32_t TIM_GetCounter(TIM_Handle_t *pTIMHandle)
+{
+    return pTIMHandle->pTIMx->CNT & pTIMHandle->CounterMask;
+}
+
+/*********************************************************************
+ * @fn      		- TIM_UsToTicks
+ * @brief           - Convert a time span to counter ticks
+ * @param[in]       - pTIMHandle: initialised timer handle
+ * @param[in]       - Us: time span in microseconds
+ * @return          - Ticks, rounded; 0xFFFFFFFF if they do not fit
+ *********************************************************************/
+uint32_t TIM_UsToTicks(TIM_Handle_t *pTIMHandle, uint32_t Us)
+{
+    uint64_t ticks = tim_ticks(pTIMHandle->ClockHz, pTIMHandle->Prescaler, Us);
+
+    return ticks > 0xFFFFFFFFU ? 0xFFFFFFFFU : (uint32_t)ticks;
+}
+
+/*********************************************************************
+ * @fn      		- TIM_OCConfig
+ * @brief           - Set a channel up for output compare or PWM
+ * @param[in]       - pTIMHandle: timer handle
+ * @param[in]       - Channel: TIM_CHANNEL_1 to TIM_CHANNEL_4
+ * @param[in]       - OCMode: TIM_OC_MODE_*
+ * @param[in]       - Compare: CCR value
+ * @return          - 1 on success, 0 for a bad channel or mode
+ * @Note            - The channel output (active high) is enabled for
+ *                    every mode but TIM_OC_MODE_TIMING; its pin must be
+ *                    put in the timer's alternate function by the
+ *                    application. PWM modes use CCR preload, so a new
+ *                    duty cycle starts with the next period. A one-pulse
+ *                    timer with TIM_OC_MODE_PWM2 gives a pulse from
+ *                    Compare to the end of the period.
+ *********************************************************************/
+uint8_t TIM_OCConfig(TIM_Handle_t *pTIMHandle, uint8_t Channel, uint8_t OCMode, uint32_t Compare)
+{
+    TIM_RegDef_t *pTIMx = pTIMHandle->pTIMx;
+    __VO uint32_t *pCCMR;
+    uint32_t mode;
+
+    if (Channel < TIM_CHANNEL_1 || Channel > TIM_CHANNEL_4 || OCMode > TIM_OC_MODE_PWM2)
+        return 0;
+    pCCMR = Channel <= TIM_CHANNEL_2 ? &pTIMx->CCMR1 : &pTIMx->CCMR2;
+
+    // CCxS can only change with the channel off
+    pTIMx->CCER &= ~(0xFU << TIM_CCER_SHIFT(Channel));
+    mode = (uint32_t)OCMode << TIM_CCMR_OCM;
+    if (OCMode >= TIM_OC_MODE_PWM1)
+        mode |= (1U << TIM_CCMR_OCPE);
+    *pCCMR = (*pCCMR & ~(0xFFU << TIM_CCMR_SHIFT(Channel))) | (mode << TIM_CCMR_SHIFT(Channel));
+    pTIMx->CCR[Channel - 1U] = Compare;
+    if (OCMode != TIM_OC_MODE_TIMING)
+        pTIMx->CCER |= (1U << TIM_CCER_CCE) << TIM_CCER_SHIFT(Channel);
+    return 1;
+}
+
+/*********************************************************************
+ * @fn      		- TIM_ICConfig
+ * @brief           - Set a channel up for input capture on its own pin
+ * @param[in]       - pTIMHandle: timer handle
+ * @param[in]       - Channel: TIM_CHANNEL_1 to TIM_CHANNEL_4
+ * @param[in]       - ICEdge: TIM_IC_EDGE_*
+ * @param[in]       - ICFilter: 0 (none) to 15, ICxF
+ * @return          - 1 on success, 0 for a bad channel, edge or filter
+ * @Note            - No input prescaler: every edge is captured. The
+ *                    pin's alternate function is left to the
+ *                    application. With the channel interrupt enabled,
+ *                    TIM_IRQHandling stores each capture in
+ *                    Capture[Channel - 1] before the callback runs.
+ *********************************************************************/
+uint8_t TIM_ICConfig(TIM_Handle_t *pTIMHandle, uint8_t Channel, uint8_t ICEdge, uint8_t ICFilter)
+{
+    TIM_RegDef_t *pTIMx = pTIMHandle->pTIMx;
+    __VO uint32_t *pCCMR;
+    uint32_t ccer;
+
+    if (Channel < TIM_CHANNEL_1 || Channel > TIM_CHANNEL_4 || ICFilter > 15)
+        return 0;
+    switch (ICEdge)
+    {
+    case TIM_IC_EDGE_RISING:
+        ccer = (1U << TIM_CCER_CCE);
+        break;
+    case TIM_IC_EDGE_FALLING:
+        ccer = (1U << TIM_CCER_CCE) | (1U << TIM_CCER_CCP);
+        break;
+    case TIM_IC_EDGE_BOTH:
+        ccer = (1U << TIM_CCER_CCE) | (1U << TIM_CCER_CCP) | (1U << TIM_CCER_CCNP);
+        break;
+    default:
+        return 0;
+    }
+    pCCMR = Channel <= TIM_CHANNEL_2 ? &pTIMx->CCMR1 : &pTIMx->CCMR2;
+
+    pTIMx->CCER &= ~(0xFU << TIM_CCER_SHIFT(Channel));
+    *pCCMR = (*pCCMR & ~(0xFFU << TIM_CCMR_SHIFT(Channel)))
+           | (((1U << TIM_CCMR_CCS) | ((uint32_t)ICFilter << TIM_CCMR_ICF)) << TIM_CCMR_SHIFT(Channel));
+    pTIMx->CCER |= ccer << TIM_CCER_SHIFT(Channel);
+    return 1;
+}
+
+/*********************************************************************
+ * @fn      		- TIM_SetCompare
+ * @brief           - Change a channel's compare value (CCR)
+ * @param[in]       - pTIMHandle: timer handle
+ * @param[in]       - Channel: TIM_CHANNEL_1 to TIM_CHANNEL_4
+ * @param[in]       - Compare: new CCR value
+ * @return          - None
+ *********************************************************************/
+void TIM_SetCompare(TIM_Handle_t *pTIMHandle, uint8_t Channel, uint32_t Compare)
+{
+    if (Channel >= TIM_CHANNEL_1 && Channel <= TIM_CHANNEL_4)
+        pTIMHandle->pTIMx->CCR[Channel - 1U] = Compare;
+}
+
+/*********************************************************************
+ * @fn      		- TIM_GetCapture
+ * @brief           - Read a channel's capture register
+ * @param[in]       - pTIMHandle: timer handle
+ * @param[in]       - Channel: TIM_CHANNEL_1 to TIM_CHANNEL_4
+ * @return          - CCR value, 0 for a bad channel
+ * @Note            - The read clears the channel's CCxIF
+ *********************************************************************/
+uint32_t TIM_GetCapture(TIM_Handle_t *pTIMHandle, uint8_t Channel)
+{
+    if (Channel < TIM_CHANNEL_1 || Channel > TIM_CHANNEL_4)
+        return 0;
+    return pTIMHandle->pTIMx->CCR[Channel - 1U];
+}
+
+/*********************************************************************
+ * @fn      		- TIM_ChannelITConfig
+ * @brief           - Enable or disable a channel's compare/capture interrupt
+ * @param[in]       - pTIMHandle: timer handle
+ * @param[in]       - Channel: TIM_CHANNEL_1 to TIM_CHANNEL_4
+ * @param[in]       - EnorDi: ENABLE or DISABLE
+ * @return          - None
+ * @Note            - Not for the software timer channel, which the
+ *                    driver enables only while a timer is armed
+ *********************************************************************/
+void TIM_ChannelITConfig(TIM_Handle_t *pTIMHandle, uint8_t Channel, uint8_t EnorDi)
+{
+    if (Channel < TIM_CHANNEL_1 || Channel > TIM_CHANNEL_4 || Channel == pTIMHandle->SoftChannel)
+        return;
+    REG_WRITE_BIT(pTIMHandle->pTIMx->DIER, TIM_DIER_CC1IE + Channel - 1U, EnorDi == ENABLE);
+}
+
+/*********************************************************************
+ * @fn      		- TIM_SoftTimerInit
+ * @brief           - Run software timers on a compare channel
+ * @param[in]       - pTIMHandle: free-running timer (TIM_PeriodUs 0,
+ *                    no one-pulse), initialised
+ * @param[in]       - Channel: TIM_CHANNEL_1 to TIM_CHANNEL_4
+ * @return          - 1 on success, 0 for a bad channel or a timer with
+ *                    a shorter period
+ * @Note            - Deadlines are kept in counter ticks, so the timer's
+ *                    tick rate is their resolution. The channel becomes
+ *                    a compare-only (timing) channel. Start the counter
+ *                    and enable the timer IRQ as usual.
+ *********************************************************************/
+uint8_t TIM_SoftTimerInit(TIM_Handle_t *pTIMHandle, uint8_t Channel)
+{
+    if (pTIMHandle->AutoReload != pTIMHandle->CounterMask
+        || pTIMHandle->TIMConfig.TIM_OnePulse == TIM_ONE_PULSE_EN)
+        return 0;
+    if (!TIM_OCConfig(pTIMHandle, Channel, TIM_OC_MODE_TIMING, 0))
+        return 0;
+
+    REG_WRITE_BIT(pTIMHandle->pTIMx->DIER, TIM_DIER_CC1IE + Channel - 1U, 0);
+    pTIMHandle->SoftChannel = Channel;
+    pTIMHandle->pSoftHead = NULL;
+    return 1;
+}
+
+/*********************************************************************
+ * @fn      		- TIM_SoftTimerStart
+ * @brief           - Arm a software timer
+ * @param[in]       - pTIMHandle: handle with the software timers set up
+ * @param[in]       - pTimer: timer with Fn (and pContext) set
+ * @param[in]       - DelayTicks: ticks from now to the first expiry,
+ *                    0 to expire at once
+ * @param[in]       - PeriodTicks: ticks between later expiries, 0 for
+ *                    a one-shot timer
+ * @return          - 1 on success, 0 if the service is not set up, Fn
+ *                    is missing or a time exceeds TIM_SoftTimerMaxTicks
+ * @Note            - Restarts a timer that is already armed. Fn runs
+ *                    from TIM_IRQHandling. Call from thread context or
+ *                    from a callback of the same timer, not from other
+ *                    interrupts.
+ *********************************************************************/
+uint8_t TIM_SoftTimerStart(TIM_Handle_t *pTIMHandle, TIM_SoftTimer_t *pTimer, uint32_t DelayTicks, uint32_t PeriodTicks)
+{
+    uint32_t max = TIM_SoftTimerMaxTicks(pTIMHandle);
+    uint32_t now;
+
+    if (pTIMHandle->SoftChannel == 0 || pTimer->Fn == NULL || DelayTicks > max || PeriodTicks > max)
+        return 0;
+
+    tim_soft_lock(pTIMHandle);
+    if (pTimer->Active)
+        tim_soft_remove(pTIMHandle, pTimer);
+    now = pTIMHandle->pTIMx->CNT & pTIMHandle->CounterMask;
+    pTimer->Deadline = (now + DelayTicks) & pTIMHandle->CounterMask;
+    pTimer->PeriodTicks = PeriodTicks;
+    pTimer->Active = 1;
+    tim_soft_insert(pTIMHandle, pTimer, now);
+    tim_soft_unlock(pTIMHandle);
+    return 1;
+}
+
+/*********************************************************************
+ * @fn      		- TIM_SoftTimerStop
+ * @brief           - Disarm a software timer
+ * @param[in]       - pTIMHandle: handle with the software timers set up
+ * @param[in]       - pTimer: timer to stop
+ * @return          - 1 if it was armed, 0 if not (a one-shot timer that
+ *                    has already fired)
+ * @Note            - Fn does not run after this returns. Same calling
+ *                    contexts as TIM_SoftTimerStart. Active is read and
+ *                    cleared under the lock, so the interrupt cannot
+ *                    expire the timer between the check and the remove.
+ *********************************************************************/
+uint8_t TIM_SoftTimerStop(TIM_Handle_t *pTIMHandle, TIM_SoftTimer_t *pTimer)
+{
+    uint8_t was_active;
+
+    if (pTIMHandle->SoftChannel == 0)
+        return 0;
+
+    tim_soft_lock(pTIMHandle);
+    was_active = pTimer->Active;
+    if (was_active)
+    {
+        tim_soft_remove(pTIMHandle, pTimer);
+        pTimer->Active = 0;
+    }
+    tim_soft_unlock(pTIMHandle);
+    return was_active;
+}
+
+/*********************************************************************
+ * @fn      		- TIM_SoftTimerMaxTicks
+ * @brief           - Longest software timer delay or period
+ * @param[in]       - pTIMHandle: initialised timer handle
+ * @return          - A quarter of the counter range: 16383 ticks on
+ *                    TIM3/TIM4, 1073741823 on TIM2/TIM5
+ *********************************************************************/
+uint32_t TIM_SoftTimerMaxTicks(TIM_Handle_t *pTIMHandle)
+{
+    return pTIMHandle->CounterMask >> 2;
+}
+
+/*********************************************************************
+ * @fn      		- TIM_SoftTimerNextTicks
+ * @brief           - Time to the next software timer expiry
+ * @param[in]       - pTIMHandle: handle with the software timers set up
+ * @return          - Ticks, 0 if one is due, 0xFFFFFFFF if none is armed
+ * @Note            - For an idle loop deciding how long it may sleep;
+ *                    the compare interrupt wakes the core in any case
+ *********************************************************************/
+uint32_t TIM_SoftTimerNextTicks(TIM_Handle_t *pTIMHandle)
+{
+    TIM_SoftTimer_t *pHead = pTIMHandle->pSoftHead;
+    uint32_t now;
+
+    if (pHead == NULL)
+        return 0xFFFFFFFFU;
+    now = pTIMHandle->pTIMx->CNT;
+    if (tim_soft_due(pTIMHandle, pHead->Deadline, now))
+        return 0;
+    return (pHead->Deadline - now) & pTIMHandle->CounterMask;
+}
+
+/*********************************************************************
+ * @fn      		- TIM_IRQConfig
+ * @brief           - Enable or disable a timer interrupt
+ * @param[in]       - IRQNumber: IRQ number (e.g. IRQ_NO_TIM2)
+ * @param[in]       - IRQPriority: priority, 0 (highest) to 15
+ * @param[in]       - EnorDi: ENABLE or DISABLE
+ * @return          - None
+ *********************************************************************/
+void TIM_IRQConfig(uint8_t IRQNumber, uint8_t IRQPriority, uint8_t EnorDi)
+{
+    NVIC_IRQConfig(IRQNumber, IRQPriority, EnorDi);
+}
+
+/*********************************************************************
+ * @fn      		- TIM_IRQHandling
+ * @brief           - Timer interrupt: update, compare and capture events
+ * @param[in]       - pTIMHandle: timer handle
+ * @return          - None
+ * @Note            - Call from TIMx_IRQHandler. Only flags whose
+ *                    interrupt is enabled are handled, each cleared
+ *                    before its event is reported. The software timer
+ *                    channel runs the software timers; on an input
+ *                    capture channel the captured value is stored and
+ *                    a lost capture (CCxOF) counted.
+ *********************************************************************/
+void TIM_IRQHandling(TIM_Handle_t *pTIMHandle)
+{
+    TIM_RegDef_t *pTIMx = pTIMHandle->pTIMx;
+    uint32_t pending = pTIMx->SR & pTIMx->DIER & 0x1FU;	// DIER bits 4:0 match SR
+    uint32_t flag, overcapture;
+
+    if (pending & (1U << TIM_SR_UIF))
+    {
+        pTIMx->SR = ~(1U << TIM_SR_UIF);
+        if (pTIMHandle->Callback != NULL)
+            pTIMHandle->Callback(pTIMHandle, TIM_EVENT_UPDATE);
+    }
+
+    for (uint8_t ch = TIM_CHANNEL_1; ch <= TIM_CHANNEL_4; ch++)
+    {
+        flag = 1U << (TIM_SR_CC1IF + ch - 1U);
+        if (!(pending & flag))
+            continue;
+        if (ch == pTIMHandle->SoftChannel)
+        {
+            tim_soft_service(pTIMHandle);
+            continue;
+        }
+
+        pTIMx->SR = ~flag;
+        if (((ch <= TIM_CHANNEL_2 ? pTIMx->CCMR1 : pTIMx->CCMR2) >> TIM_CCMR_SHIFT(ch)) & (3U << TIM_CCMR_CCS))
+        {
+            pTIMHandle->Capture[ch - 1U] = pTIMx->CCR[ch - 1U];
+            overcapture = 1U << (TIM_SR_CC1OF + ch - 1U);
+            if (pTIMx->SR & overcapture)
+            {
+                pTIMx->SR = ~overcapture;
+                pTIMHandle->Overcaptures++;
+            }
+        }
+        if (pTIMHandle->Callback != NULL)
+            pTIMHandle->Callback(pTIMHandle, (uint8_t)(TIM_EVENT_CC1 + ch - 1U));
+    }
+}
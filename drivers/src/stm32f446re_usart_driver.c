@@ -0,0 +1,790 @@
+/*
+ * stm32f446re_usart_driver.c
+ *
+ * USART driver for STM32F446RE
+ * USART_Init sets up any of the six ports from a const port table (bus,
+ * clock bit, default pins, DMA streams) and programs BRR from the clock
+ * the bus is actually running at. USART_Send/USART_Receive run in the
+ * polling, interrupt or DMA mode chosen per direction in the config.
+ * Non-blocking transmit never waits on TXE: USART_SendIT queues into a
+ * ring buffer that the TXE interrupt drains one byte per interrupt,
+ * USART_SendDMA hands a whole block to the port's DMA stream. Both report
+ * through the handle's callback when the last stop bit has been sent.
+ * Reception runs a circular DMA straight into the RX ring buffer's
+ * storage; half/full-transfer and idle-line interrupts publish what has
+ * arrived, so the CPU is interrupted per burst instead of per byte.
+ */
+
+#include <stddef.h>
+#include "stm32f446re_usart_driver.h"
+#include "stm32f446re_gpio_drivers.h"
+#include "stm32f446re_rcc_driver.h"
+
+/*
+ * CR1 interrupt enables and the CR3 DMA enables are changed from thread
+ * context and from the USART and DMA interrupts, so every change goes
+ * through REG_WRITE_BIT (one bit-band store on the target).
+ */
+
+// Everything the driver needs to know about one port
+typedef struct
+{
+uint32_t BaseAddr ;
+uint8_t APB2 ;				// 1: APB2 (PCLK2), 0: APB1 (PCLK1)
+uint8_t ClockBit ;			// Bit in RCC APBxENR / APBxRSTR
+uint8_t FlowControl ;		// CTS/RTS available
+uint8_t AltFn ;				// GPIO alternate function of TX and RX
+uint8_t TxPort ;			// GPIO_PORT_INDEX of the default TX pin
+uint8_t TxPin ;
+uint8_t RxPort ;
+uint8_t RxPin ;
+uint8_t DMA ;				// 1 = DMA1, 2 = DMA2
+uint8_t TxStream ;
+uint8_t TxChannel ;
+uint8_t RxStream ;
+uint8_t RxChannel ;
+
+} usart_port_t;
+
+// Default pins are the LQFP64 (Nucleo-64) ones; DMA streams from the RM0390
+// request mapping tables, chosen so no two ports share a stream
+static const usart_port_t usart_ports[] =
+{
+    // Base           APB2 Bit Flow AF  TX: port pin  RX: port pin  DMA  TX: s ch  RX: s ch
+    { USART1_BASEADDR, 1,  4,  1,   7,  0, 9,         0, 10,        2,   7, 4,     2, 4 },	// PA9/PA10
+    { USART2_BASEADDR, 0,  17, 1,   7,  0, 2,         0, 3,         1,   6, 4,     5, 4 },	// PA2/PA3
+    { USART3_BASEADDR, 0,  18, 1,   7,  2, 10,        2, 11,        1,   3, 4,     1, 4 },	// PC10/PC11
+    { UART4_BASEADDR,  0,  19, 0,   8,  0, 0,         0, 1,         1,   4, 4,     2, 4 },	// PA0/PA1
+    { UART5_BASEADDR,  0,  20, 0,   8,  2, 12,        3, 2,         1,   7, 4,     0, 4 },	// PC12/PD2
+    { USART6_BASEADDR, 1,  5,  1,   8,  2, 6,         2, 7,         2,   6, 5,     1, 5 },	// PC6/PC7
+};
+
+/*********************************************************************
+ * @fn      		- usart_port
+ * @brief           - Look up a port in usart_ports
+ * @param[in]       - pUSARTx: Base address of the USART peripheral
+ * @return          - Table entry, NULL if pUSARTx is not a USART
+ *********************************************************************/
+static const usart_port_t *usart_port(USART_RegDef_t *pUSARTx)
+{
+    uint32_t base = MMIO_DEV_ADDR(pUSARTx);
+
+    for (uint32_t i = 0; i < sizeof(usart_ports) / sizeof(usart_ports[0]); i++)
+    {
+        if (usart_ports[i].BaseAddr == base)
+            return &usart_ports[i];
+    }
+    return NULL;
+}
+
+/*********************************************************************
+ * @fn      		- usart_dma_map
+ * @brief           - Fill in the DMA streams serving a USART
+ * @param[in]       - pUSARTHandle: handle with pUSARTx set
+ * @return          - None
+ * @Note            - Streams and channels from usart_ports (USART2: TX
+ *                    DMA1 stream 6, RX DMA1 stream 5, channel 4). Enables
+ *                    the DMA controller's clock.
+ *********************************************************************/
+static void usart_dma_map(USART_Handle_t *pUSARTHandle)
+{
+    const usart_port_t *pPort = usart_port(pUSARTHandle->pUSARTx);
+    DMA_RegDef_t *pDMA;
+
+    pUSARTHandle->pTxDMA = NULL;
+    pUSARTHandle->pRxDMA = NULL;
+    if (pPort == NULL)
+        return;
+
+    if (pPort->DMA == 1)
+    {
+        pDMA = DMA1;
+        DMA1_PCLK_EN();
+    }
+    else
+    {
+        pDMA = DMA2;
+        DMA2_PCLK_EN();
+    }
+
+    pUSARTHandle->pTxDMA = pDMA;
+    pUSARTHandle->TxStream = pPort->TxStream;
+    pUSARTHandle->TxChannel = pPort->TxChannel;
+    pUSARTHandle->pRxDMA = pDMA;
+    pUSARTHandle->RxStream = pPort->RxStream;
+    pUSARTHandle->RxChannel = pPort->RxChannel;
+}
+
+/*********************************************************************
+ * @fn      		- usart_pins_init
+ * @brief           - Put a port's default TX and/or RX pin in its
+ *                    alternate function
+ * @param[in]       - pPort: usart_ports entry
+ * @param[in]       - Tx: configure the TX pin
+ * @param[in]       - Rx: configure the RX pin
+ * @return          - None
+ * @Note            - Push-pull, high speed, pull-up (idle line high).
+ *                    One GPIO_InitPins call per GPIO port.
+ *********************************************************************/
+static void usart_pins_init(const usart_port_t *pPort, uint8_t Tx, uint8_t Rx)
+{
+    GPIO_PinMaskConfig_t config;
+    uint8_t same_port = (pPort->TxPort == pPort->RxPort);
+
+    config.GPIO_PinMode = GPIO_MODE_ALTFN;
+    config.GPIO_PinSpeed = GPIO_SPEED_HIGH;
+    config.GPIO_PinPupdControl = GPIO_PIN_PU;
+    config.GPIO_PinOPType = GPIO_OP_TYPE_PP;
+    config.GPIO_PinAltFunMode = pPort->AltFn;
+
+    if (Tx)
+    {
+        config.GPIO_PinMask = (uint16_t)((1U << pPort->TxPin) | ((Rx && same_port) ? (1U << pPort->RxPin) : 0U));
+        GPIO_InitPins(GPIO_PORT_FROM_INDEX(pPort->TxPort), &config);
+    }
+    if (Rx && !(Tx && same_port))
+    {
+        config.GPIO_PinMask = (uint16_t)(1U << pPort->RxPin);
+        GPIO_InitPins(GPIO_PORT_FROM_INDEX(pPort->RxPort), &config);
+    }
+}
+
+/*********************************************************************
+ * @fn      		- usart_rx_update
+ * @brief           - Publish the bytes the RX DMA wrote since the last call
+ * @param[in]       - pUSARTHandle: USART handle
+ * @return          - Number of new bytes
+ * @Note            - The DMA write offset is Size - NDTR. HT and TC make
+ *                    sure it never moves a whole buffer between calls.
+ *                    Runs from the USART and RX DMA interrupts, which
+ *                    must not preempt each other (same priority).
+ *********************************************************************/
+static uint32_t usart_rx_update(USART_Handle_t *pUSARTHandle)
+{
+    RingBuffer_t *pRB = &pUSARTHandle->RxBuffer;
+    uint32_t pos = (pRB->Size - pUSARTHandle->pRxDMA->S[pUSARTHandle->RxStream].NDTR) & pRB->Mask;
+    uint32_t len = (pos - pUSARTHandle->RxPos) & pRB->Mask;
+
+    if (len == 0)
+        return 0;
+
+    pUSARTHandle->RxPos = pos;
+    pUSARTHandle->RxBurstLen += len;
+    if (!RingBuffer_Commit(pRB, len))
+    {
+        pUSARTHandle->RxOverruns++;
+        if (pUSARTHandle->Callback != NULL)
+            pUSARTHandle->Callback(pUSARTHandle, USART_EVENT_RX_OVERRUN);
+    }
+    return len;
+}
+
+/*********************************************************************
+ * @fn      		- USART_PeriClockControl
+ * @brief           - Enable or disable the peripheral clock of a USART
+ * @param[in]       - pUSARTx: Base address of the USART peripheral
+ * @param[in]       - EnorDi: ENABLE or DISABLE macro
+ * @return          - None
+ *********************************************************************/
+void USART_PeriClockControl(USART_RegDef_t *pUSARTx, uint8_t EnorDi)
+{
+    const usart_port_t *pPort = usart_port(pUSARTx);
+    __VO uint32_t *pENR;
+
+    if (pPort == NULL)
+        return;
+
+    pENR = pPort->APB2 ? &RCC->APB2ENR : &RCC->APB1ENR;
+    if (EnorDi == ENABLE)
+        *pENR |= (1U << pPort->ClockBit);
+    else
+        *pENR &= ~(1U << pPort->ClockBit);
+}
+
+/*********************************************************************
+ * @fn      		- USART_ComputeBRR
+ * @brief           - BRR value for a baud rate, rounded to nearest
+ * @param[in]       - PClk: clock of the USART's APB bus in Hz
+ * @param[in]       - Baud: wanted baud rate
+ * @param[in]       - Over8: 0 for 16x oversampling, 1 for 8x
+ * @param[out]      - pErrorPpm: baud rate error of the result in ppm,
+ *                    (actual - wanted) / wanted; may be NULL
+ * @return          - BRR value, 0 if the baud rate cannot be reached
+ * @Note            - USARTDIV = PClk / (8 * (2 - OVER8) * Baud). BRR
+ *                    holds it in 1/16 units (OVER8 = 0), so BRR is just
+ *                    PClk / Baud; with OVER8 = 1 the fraction has 3 bits
+ *                    and sits right-aligned in BRR[3:0].
+ *********************************************************************/
+uint32_t USART_ComputeBRR(uint32_t PClk, uint32_t Baud, uint8_t Over8, int32_t *pErrorPpm)
+{
+    uint32_t div;		// USARTDIV in 1/16 (OVER8 = 0) or 1/8 (OVER8 = 1) units
+    uint32_t div_max = Over8 ? 0x7FFFU : 0xFFFFU;	// 12-bit mantissa
+    int64_t actual_x_div;
+
+    if (Baud == 0)
+        return 0;
+
+    div = (uint32_t)(((uint64_t)PClk + Baud / 2) / Baud);
+    if (div < (Over8 ? 8U : 16U) || div > div_max)
+        return 0;
+
+    // Actual baud is PClk / div: error = (PClk - div * Baud) / (div * Baud)
+    actual_x_div = (int64_t)div * Baud;
+    if (pErrorPpm != NULL)
+        *pErrorPpm = (int32_t)(((int64_t)PClk - actual_x_div) * 1000000 / actual_x_div);
+
+    return Over8 ? ((div >> 3) << 4) | (div & 0x7U) : div;
+}
+
+/*********************************************************************
+ * @fn      		- USART_Init
+ * @brief           - Set up a USART from pUSARTHandle->USART_Config
+ * @param[in]       - pUSARTHandle: handle with pUSARTx, USART_Config
+ *                    (and Callback) set
+ * @return          - 1 on success, 0 if the port, baud rate (error above
+ *                    USART_BAUD_MAX_ERROR_PPM), flow control or ring
+ *                    buffer storage is invalid; the USART is then left
+ *                    disabled
+ * @Note            - Enables the USART, GPIO and DMA clocks, puts the
+ *                    default pins (see usart_ports) in alternate function
+ *                    mode and computes BRR from the live PCLK, so call it
+ *                    again after changing the clock tree. BaudActual and
+ *                    BaudErrorPpm report the rounding. CTS/RTS pins are
+ *                    left to the application. NVIC lines are enabled
+ *                    separately with USART_IRQConfig.
+ *********************************************************************/
+uint8_t USART_Init(USART_Handle_t *pUSARTHandle)
+{
+    USART_Config_t *pConfig = &pUSARTHandle->USART_Config;
+    USART_RegDef_t *pUSARTx = pUSARTHandle->pUSARTx;
+    const usart_port_t *pPort = usart_port(pUSARTx);
+    uint8_t tx = pConfig->USART_Mode != USART_MODE_ONLY_RX;
+    uint8_t rx = pConfig->USART_Mode != USART_MODE_ONLY_TX;
+    uint8_t over8 = pConfig->USART_Oversampling == USART_OVERSAMPLING_8;
+    uint32_t pclk, brr, div, cr1, cr3 = 0;
+    int32_t error = 0;
+    uint8_t ok = 1;
+
+    if (pPort == NULL)
+        return 0;
+    if (pConfig->USART_HWFlowControl != USART_HW_FLOW_CTRL_NONE && !pPort->FlowControl)
+        return 0;
+
+    // 1. Baud rate: 16x oversampling unless only 8x gets close enough
+    pclk = pPort->APB2 ? RCC_GetPCLK2Value() : RCC_GetPCLK1Value();
+    brr = USART_ComputeBRR(pclk, pConfig->USART_Baud, over8, &error);
+    if (pConfig->USART_Oversampling == USART_OVERSAMPLING_AUTO
+        && (brr == 0 || error > USART_BAUD_MAX_ERROR_PPM || error < -USART_BAUD_MAX_ERROR_PPM))
+    {
+        over8 = 1;
+        brr = USART_ComputeBRR(pclk, pConfig->USART_Baud, over8, &error);
+    }
+    if (brr == 0 || error > USART_BAUD_MAX_ERROR_PPM || error < -USART_BAUD_MAX_ERROR_PPM)
+        return 0;
+
+    div = over8 ? ((brr >> 4) << 3) | (brr & 0x7U) : brr;
+    pUSARTHandle->BaudActual = (pclk + div / 2) / div;
+    pUSARTHandle->BaudErrorPpm = error;
+
+    // 2. Clocks and pins
+    USART_PeriClockControl(pUSARTx, ENABLE);
+    usart_pins_init(pPort, tx, rx);
+
+    // 3. Frame format, UE last
+    cr1 = ((uint32_t)over8 << USART_CR1_OVER8) | (1U << USART_CR1_UE);
+    if (pConfig->USART_WordLength == USART_WORDLEN_9BITS)
+        cr1 |= (1U << USART_CR1_M);
+    if (pConfig->USART_ParityControl != USART_PARITY_DISABLE)
+        cr1 |= (1U << USART_CR1_PCE);
+    if (pConfig->USART_ParityControl == USART_PARITY_EN_ODD)
+        cr1 |= (1U << USART_CR1_PS);
+    if (tx)
+        cr1 |= (1U << USART_CR1_TE);
+    if (rx)
+        cr1 |= (1U << USART_CR1_RE);
+
+    if (pConfig->USART_HWFlowControl & USART_HW_FLOW_CTRL_CTS)
+        cr3 |= (1U << USART_CR3_CTSE);
+    if (pConfig->USART_HWFlowControl & USART_HW_FLOW_CTRL_RTS)
+        cr3 |= (1U << USART_CR3_RTSE);
+
+    pUSARTx->CR1 = 0;
+    pUSARTx->BRR = brr;
+    pUSARTx->CR2 = (uint32_t)(pConfig->USART_NoOfStopBits & 0x3U) << USART_CR2_STOP;
+    pUSARTx->CR3 = cr3;
+    pUSARTx->CR1 = cr1;
+
+    // 4. Transfer modes
+    if (tx && pConfig->USART_TxMode != USART_XFER_POLL)
+        ok = USART_TxInit(pUSARTHandle, pConfig->pTxStorage, pConfig->TxStorageSize);
+
+    if (ok && rx && pConfig->USART_RxMode == USART_XFER_IT)
+        ok = USART_ReceiveITStart(pUSARTHandle, pConfig->pRxStorage, pConfig->RxStorageSize);
+    else if (ok && rx && pConfig->USART_RxMode == USART_XFER_DMA)
+        ok = USART_ReceiveDMAStart(pUSARTHandle, pConfig->pRxStorage, pConfig->RxStorageSize);
+
+    if (!ok)
+        pUSARTx->CR1 = 0;
+    return ok;
+}
+
+/*********************************************************************
+ * @fn      		- USART_DeInit
+ * @brief           - Reset all registers of a USART
+ * @param[in]       - pUSARTx: Base address of the USART peripheral
+ * @return          - None
+ * @Note            - Pulses the port's bit in RCC APBxRSTR
+ *********************************************************************/
+void USART_DeInit(USART_RegDef_t *pUSARTx)
+{
+    const usart_port_t *pPort = usart_port(pUSARTx);
+    __VO uint32_t *pRSTR;
+
+    if (pPort == NULL)
+        return;
+
+    pRSTR = pPort->APB2 ? &RCC->APB2RSTR : &RCC->APB1RSTR;
+    *pRSTR |= (1U << pPort->ClockBit);
+    *pRSTR &= ~(1U << pPort->ClockBit);
+}
+
+/*********************************************************************
+ * @fn      		- USART_TxInit
+ * @brief           - Set up the transmit side of a USART handle
+ * @param[in]       - pUSARTHandle: handle with pUSARTx (and Callback) set
+ * @param[in]       - pTxStorage: storage for the TX ring buffer
+ * @param[in]       - Size: ring buffer size, a power of two
+ * @return          - 1 on success, 0 if Size is not a power of two
+ * @Note            - Selects the port's TX DMA stream (USART2: DMA1
+ *                    stream 6, channel 4). Called by USART_Init for
+ *                    USART_XFER_IT/DMA; on its own, the USART (baud
+ *                    rate, TE, UE) must already be configured.
+ *********************************************************************/
+uint8_t USART_TxInit(USART_Handle_t *pUSARTHandle, uint8_t *pTxStorage, uint32_t Size)
+{
+    if (!RingBuffer_Init(&pUSARTHandle->TxBuffer, pTxStorage, Size))
+        return 0;
+
+    pUSARTHandle->TxDMABusy = 0;
+    pUSARTHandle->pTxData = NULL;
+    pUSARTHandle->TxLen = 0;
+    usart_dma_map(pUSARTHandle);
+    return 1;
+}
+
+/*********************************************************************
+ * @fn      		- USART_SendIT
+ * @brief           - Queue bytes for interrupt-driven transmission
+ * @param[in]       - pUSARTHandle: USART handle
+ * @param[in]       - pTxBuffer: bytes to send (copied)
+ * @param[in]       - Len: number of bytes
+ * @return          - Number of bytes queued, less than Len if the ring
+ *                    buffer is full
+ * @Note            - Returns at once. Bytes queued while a DMA block is
+ *                    running are sent after it.
+ *********************************************************************/
+uint32_t USART_SendIT(USART_Handle_t *pUSARTHandle, const uint8_t *pTxBuffer, uint32_t Len)
+{
+    uint32_t queued = RingBuffer_PutBulk(&pUSARTHandle->TxBuffer, pTxBuffer, Len);
+
+    // Data first, then the DMA check: if the DMA completion runs in
+    // between, it finds the data and enables TXEIE itself
+    if (queued != 0 && !pUSARTHandle->TxDMABusy)
+        REG_WRITE_BIT(pUSARTHandle->pUSARTx->CR1, USART_CR1_TXEIE, 1);
+
+    return queued;
+}
+
+/*********************************************************************
+ * @fn      		- USART_SendDMA
+ * @brief           - Send a block by DMA without copying it
+ * @param[in]       - pUSARTHandle: USART handle
+ * @param[in]       - pTxBuffer: bytes to send, untouched until the callback
+ * @param[in]       - Len: number of bytes, 1 to USART_DMA_MAX_LEN
+ * @return          - 1 if the transfer was started, 0 if the port has no
+ *                    TX DMA or is still transmitting
+ * @Note            - Refused while interrupt-driven bytes are pending, so
+ *                    output order is kept; fall back to USART_SendIT
+ *********************************************************************/
+uint8_t USART_SendDMA(USART_Handle_t *pUSARTHandle, const uint8_t *pTxBuffer, uint32_t Len)
+{
+    USART_RegDef_t *pUSARTx = pUSARTHandle->pUSARTx;
+    DMA_Stream_RegDef_t *pStream;
+    uint8_t stream = pUSARTHandle->TxStream;
+
+    if (pUSARTHandle->pTxDMA == NULL || Len == 0 || Len > USART_DMA_MAX_LEN)
+        return 0;
+    if (USART_TxBusy(pUSARTHandle))
+        return 0;
+
+    pStream = &pUSARTHandle->pTxDMA->S[stream];
+    DMA_StreamDisable(pUSARTHandle->pTxDMA, stream);
+
+    pStream->PAR = MMIO_DEV_ADDR(&pUSARTx->DR);
+    pStream->M0AR = (uint32_t)(uintptr_t)pTxBuffer;
+    pStream->NDTR = Len;
+    pStream->FCR = 0;	// Direct mode, byte by byte to DR
+
+    pUSARTHandle->pTxData = pTxBuffer;
+    pUSARTHandle->TxLen = Len;
+    pUSARTHandle->TxDMABusy = 1;
+
+    pUSARTx->SR = ~(1U << USART_SR_TC);
+    REG_WRITE_BIT(pUSARTx->CR3, USART_CR3_DMAT, 1);
+    pStream->CR = ((uint32_t)pUSARTHandle->TxChannel << DMA_SCR_CHSEL) | (1U << DMA_SCR_MINC)
+                | (1U << DMA_SCR_DIR) | (1U << DMA_SCR_TCIE) | (1U << DMA_SCR_TEIE)
+                | (1U << DMA_SCR_EN);
+    return 1;
+}
+
+/*********************************************************************
+ * @fn      		- USART_TxBusy
+ * @brief           - Check whether a transmission is still in progress
+ * @param[in]       - pUSARTHandle: USART handle
+ * @return          - 1 while bytes are queued, a DMA block is running or
+ *                    the last byte is still being shifted out
+ *********************************************************************/
+uint8_t USART_TxBusy(USART_Handle_t *pUSARTHandle)
+{
+    uint32_t cr1 = pUSARTHandle->pUSARTx->CR1;
+
+    return pUSARTHandle->TxDMABusy || RingBuffer_Count(&pUSARTHandle->TxBuffer) != 0
+        || (cr1 & ((1U << USART_CR1_TXEIE) | (1U << USART_CR1_TCIE))) != 0;
+}
+
+/*********************************************************************
+ * @fn      		- USART_SendData
+ * @brief           - Send bytes, waiting on TXE for each
+ * @param[in]       - pUSARTHandle: USART handle
+ * @param[in]       - pTxBuffer: bytes to send
+ * @param[in]       - Len: number of bytes
+ * @return          - None
+ * @Note            - Returns once the last stop bit has been sent (TC).
+ *                    Not to be mixed with queued IT/DMA transmission.
+ *********************************************************************/
+void USART_SendData(USART_Handle_t *pUSARTHandle, const uint8_t *pTxBuffer, uint32_t Len)
+{
+    USART_RegDef_t *pUSARTx = pUSARTHandle->pUSARTx;
+
+    for (uint32_t i = 0; i < Len; i++)
+    {
+        while (!(pUSARTx->SR & (1U << USART_SR_TXE)))
+            ;
+        pUSARTx->DR = pTxBuffer[i];
+    }
+    while (!(pUSARTx->SR & (1U << USART_SR_TC)))
+        ;
+}
+
+/*********************************************************************
+ * @fn      		- USART_ReceiveData
+ * @brief           - Receive bytes, waiting on RXNE for each
+ * @param[in]       - pUSARTHandle: USART handle
+ * @param[out]      - pRxBuffer: destination
+ * @param[in]       - Len: number of bytes
+ * @return          - None
+ *********************************************************************/
+void USART_ReceiveData(USART_Handle_t *pUSARTHandle, uint8_t *pRxBuffer, uint32_t Len)
+{
+    USART_RegDef_t *pUSARTx = pUSARTHandle->pUSARTx;
+
+    for (uint32_t i = 0; i < Len; i++)
+    {
+        while (!(pUSARTx->SR & (1U << USART_SR_RXNE)))
+            ;
+        pRxBuffer[i] = (uint8_t)pUSARTx->DR;
+    }
+}
+
+/*********************************************************************
+ * @fn      		- USART_Send
+ * @brief           - Send bytes in the handle's USART_TxMode
+ * @param[in]       - pUSARTHandle: USART handle set up by USART_Init
+ * @param[in]       - pTxBuffer: bytes to send
+ * @param[in]       - Len: number of bytes
+ * @return          - Number of bytes sent or queued
+ * @Note            - POLL: blocks until sent. IT: copies into the TX ring
+ *                    buffer (USART_SendIT). DMA: blocks of at least
+ *                    USART_DMA_MIN_LEN bytes go by DMA without a copy, so
+ *                    pTxBuffer must stay untouched until
+ *                    USART_EVENT_TX_CMPLT; shorter blocks, or any while
+ *                    the DMA is busy, are copied as in IT mode.
+ *********************************************************************/
+uint32_t USART_Send(USART_Handle_t *pUSARTHandle, const uint8_t *pTxBuffer, uint32_t Len)
+{
+    switch (pUSARTHandle->USART_Config.USART_TxMode)
+    {
+    case USART_XFER_POLL:
+        USART_SendData(pUSARTHandle, pTxBuffer, Len);
+        return Len;
+    case USART_XFER_DMA:
+        if (Len >= USART_DMA_MIN_LEN && USART_SendDMA(pUSARTHandle, pTxBuffer, Len))
+            return Len;
+        return USART_SendIT(pUSARTHandle, pTxBuffer, Len);
+    default:
+        return USART_SendIT(pUSARTHandle, pTxBuffer, Len);
+    }
+}
+
+/*********************************************************************
+ * @fn      		- USART_Receive
+ * @brief           - Receive bytes in the handle's USART_RxMode
+ * @param[in]       - pUSARTHandle: USART handle set up by USART_Init
+ * @param[out]      - pRxBuffer: destination
+ * @param[in]       - Len: maximum number of bytes
+ * @return          - Number of bytes read
+ * @Note            - POLL: blocks until Len bytes have arrived. IT and
+ *                    DMA: returns at once with what RxBuffer holds.
+ *********************************************************************/
+uint32_t USART_Receive(USART_Handle_t *pUSARTHandle, uint8_t *pRxBuffer, uint32_t Len)
+{
+    if (pUSARTHandle->USART_Config.USART_RxMode == USART_XFER_POLL)
+    {
+        USART_ReceiveData(pUSARTHandle, pRxBuffer, Len);
+        return Len;
+    }
+    return RingBuffer_GetBulk(&pUSARTHandle->RxBuffer, pRxBuffer, Len);
+}
+
+/*********************************************************************
+ * @fn      		- USART_ReceiveITStart
+ * @brief           - Receive continuously by RXNE interrupt into RxBuffer
+ * @param[in]       - pUSARTHandle: USART handle, receiver (RE, UE) set up
+ * @param[in]       - pRxStorage: RX ring buffer storage
+ * @param[in]       - Size: ring buffer size, a power of two
+ * @return          - 1 on success, 0 if Size is not a power of two
+ * @Note            - One interrupt per byte. Bytes arriving while the
+ *                    buffer is full are dropped and counted in RxOverruns.
+ *********************************************************************/
+uint8_t USART_ReceiveITStart(USART_Handle_t *pUSARTHandle, uint8_t *pRxStorage, uint32_t Size)
+{
+    USART_RegDef_t *pUSARTx = pUSARTHandle->pUSARTx;
+
+    if (!RingBuffer_Init(&pUSARTHandle->RxBuffer, pRxStorage, Size))
+        return 0;
+
+    pUSARTHandle->RxOverruns = 0;
+
+    // SR then DR read drops a stale RXNE or ORE
+    (void)pUSARTx->SR;
+    (void)pUSARTx->DR;
+    REG_WRITE_BIT(pUSARTx->CR1, USART_CR1_RXNEIE, 1);
+    return 1;
+}
+
+/*********************************************************************
+ * @fn      		- USART_ReceiveDMAStart
+ * @brief           - Receive continuously by circular DMA into RxBuffer
+ * @param[in]       - pUSARTHandle: USART handle, receiver (RE, UE) set up
+ * @param[in]       - pRxStorage: RX ring buffer storage, written by DMA
+ * @param[in]       - Size: power of two, at most 32768
+ * @return          - 1 on success, 0 if the port has no RX DMA or Size
+ *                    is invalid
+ * @Note            - Read the data with RingBuffer_Get*(&RxBuffer). The
+ *                    callback gets USART_EVENT_RX_DATA at half and full
+ *                    buffer and USART_EVENT_RX_IDLE (RxFrameLen bytes)
+ *                    when the line goes idle. Size the buffer for the
+ *                    bytes that can arrive before the reader runs:
+ *                    the DMA cannot be held off and overwrites old data.
+ *********************************************************************/
+uint8_t USART_ReceiveDMAStart(USART_Handle_t *pUSARTHandle, uint8_t *pRxStorage, uint32_t Size)
+{
+    USART_RegDef_t *pUSARTx = pUSARTHandle->pUSARTx;
+    DMA_Stream_RegDef_t *pStream;
+    uint8_t stream;
+
+    usart_dma_map(pUSARTHandle);
+    if (pUSARTHandle->pRxDMA == NULL || Size > USART_DMA_MAX_LEN)
+        return 0;
+    if (!RingBuffer_Init(&pUSARTHandle->RxBuffer, pRxStorage, Size))
+        return 0;
+
+    stream = pUSARTHandle->RxStream;
+    pStream = &pUSARTHandle->pRxDMA->S[stream];
+    DMA_StreamDisable(pUSARTHandle->pRxDMA, stream);
+
+    pUSARTHandle->RxPos = 0;
+    pUSARTHandle->RxBurstLen = 0;
+    pUSARTHandle->RxFrameLen = 0;
+    pUSARTHandle->RxOverruns = 0;
+
+    pStream->PAR = MMIO_DEV_ADDR(&pUSARTx->DR);
+    pStream->M0AR = (uint32_t)(uintptr_t)pRxStorage;
+    pStream->NDTR = Size;
+    pStream->FCR = 0;
+    pStream->CR = ((uint32_t)pUSARTHandle->RxChannel << DMA_SCR_CHSEL) | (1U << DMA_SCR_MINC)
+                | (1U << DMA_SCR_CIRC) | (1U << DMA_SCR_HTIE) | (1U << DMA_SCR_TCIE)
+                | (1U << DMA_SCR_TEIE) | (1U << DMA_SCR_EN);
+
+    // SR then DR read drops a stale IDLE or RXNE
+    (void)pUSARTx->SR;
+    (void)pUSARTx->DR;
+    REG_WRITE_BIT(pUSARTx->CR3, USART_CR3_DMAR, 1);
+    REG_WRITE_BIT(pUSARTx->CR1, USART_CR1_IDLEIE, 1);
+    return 1;
+}
+
+/*********************************************************************
+ * @fn      		- USART_ReceiveDMAStop
+ * @brief           - Stop circular DMA reception
+ * @param[in]       - pUSARTHandle: USART handle
+ * @return          - None
+ * @Note            - Bytes received up to the stop stay readable in
+ *                    RxBuffer
+ *********************************************************************/
+void USART_ReceiveDMAStop(USART_Handle_t *pUSARTHandle)
+{
+    USART_RegDef_t *pUSARTx = pUSARTHandle->pUSARTx;
+
+    if (pUSARTHandle->pRxDMA == NULL)
+        return;
+
+    REG_WRITE_BIT(pUSARTx->CR1, USART_CR1_IDLEIE, 0);
+    REG_WRITE_BIT(pUSARTx->CR3, USART_CR3_DMAR, 0);
+    usart_rx_update(pUSARTHandle);
+    DMA_StreamDisable(pUSARTHandle->pRxDMA, pUSARTHandle->RxStream);
+}
+
+/*********************************************************************
+ * @fn      		- USART_IRQConfig
+ * @brief           - Enable or disable a USART or DMA stream interrupt
+ * @param[in]       - IRQNumber: IRQ number (e.g. IRQ_NO_USART2)
+ * @param[in]       - IRQPriority: priority, 0 (highest) to 15
+ * @param[in]       - EnorDi: ENABLE or DISABLE
+ * @return          - None
+ * @Note            - See NVIC_IRQConfig
+ *********************************************************************/
+void USART_IRQConfig(uint8_t IRQNumber, uint8_t IRQPriority, uint8_t EnorDi)
+{
+    NVIC_IRQConfig(IRQNumber, IRQPriority, EnorDi);
+}
+
+/*********************************************************************
+ * @fn      		- USART_IRQHandling
+ * @brief           - USART interrupt: transmit, reception, idle line
+ * @param[in]       - pUSARTHandle: USART handle
+ * @return          - None
+ * @Note            - Call from USARTx_IRQHandler. TXE moves the next
+ *                    queued byte to DR; once the queue is empty TXEIE is
+ *                    swapped for TCIE, and TC runs the callback. RXNE
+ *                    stores the byte in RxBuffer. IDLE publishes the end
+ *                    of a DMA-received burst.
+ *********************************************************************/
+void USART_IRQHandling(USART_Handle_t *pUSARTHandle)
+{
+    USART_RegDef_t *pUSARTx = pUSARTHandle->pUSARTx;
+    uint32_t sr = pUSARTx->SR;
+    uint32_t cr1 = pUSARTx->CR1;
+    uint8_t data;
+
+    if ((cr1 & (1U << USART_CR1_RXNEIE)) && (sr & ((1U << USART_SR_RXNE) | (1U << USART_SR_ORE))))
+    {
+        data = (uint8_t)pUSARTx->DR;	// Clears RXNE, and ORE after the SR read
+        if (!RingBuffer_Put(&pUSARTHandle->RxBuffer, data))
+        {
+            pUSARTHandle->RxOverruns++;
+            if (pUSARTHandle->Callback != NULL)
+                pUSARTHandle->Callback(pUSARTHandle, USART_EVENT_RX_OVERRUN);
+        }
+    }
+
+    if ((cr1 & (1U << USART_CR1_IDLEIE)) && (sr & (1U << USART_SR_IDLE)))
+    {
+        (void)pUSARTx->DR;	// SR then DR read clears IDLE
+        usart_rx_update(pUSARTHandle);
+        pUSARTHandle->RxFrameLen = pUSARTHandle->RxBurstLen;
+        pUSARTHandle->RxBurstLen = 0;
+
+        if (pUSARTHandle->RxFrameLen != 0 && pUSARTHandle->Callback != NULL)
+            pUSARTHandle->Callback(pUSARTHandle, USART_EVENT_RX_IDLE);
+    }
+
+    if ((cr1 & (1U << USART_CR1_TXEIE)) && (sr & (1U << USART_SR_TXE)))
+    {
+        if (RingBuffer_Get(&pUSARTHandle->TxBuffer, &data))
+        {
+            pUSARTx->DR = data;
+        }
+        else
+        {
+            REG_WRITE_BIT(pUSARTx->CR1, USART_CR1_TXEIE, 0);
+            REG_WRITE_BIT(pUSARTx->CR1, USART_CR1_TCIE, 1);
+        }
+    }
+    else if ((cr1 & (1U << USART_CR1_TCIE)) && (sr & (1U << USART_SR_TC)))
+    {
+        REG_WRITE_BIT(pUSARTx->CR1, USART_CR1_TCIE, 0);
+        pUSARTx->SR = ~(1U << USART_SR_TC);
+
+        if (pUSARTHandle->Callback != NULL)
+            pUSARTHandle->Callback(pUSARTHandle, USART_EVENT_TX_CMPLT);
+    }
+}
+
+/*********************************************************************
+ * @fn      		- USART_TxDMAIRQHandling
+ * @brief           - TX DMA stream interrupt
+ * @param[in]       - pUSARTHandle: USART handle
+ * @return          - None
+ * @Note            - Call from the stream's IRQ handler (USART2:
+ *                    DMA1_Stream6_IRQHandler). Bytes queued by
+ *                    USART_SendIT during the block go out next; otherwise
+ *                    TC reports completion once the last byte is sent.
+ *********************************************************************/
+void USART_TxDMAIRQHandling(USART_Handle_t *pUSARTHandle)
+{
+    DMA_RegDef_t *pDMA = pUSARTHandle->pTxDMA;
+    uint8_t stream = pUSARTHandle->TxStream;
+    uint32_t shift = DMA_FLAG_SHIFT(stream);
+    uint32_t flags = (pDMA->ISR[stream >> 2] >> shift) & DMA_STREAM_FLAGS;
+    uint8_t error = (flags & (1U << DMA_FLAG_TEIF)) != 0;
+
+    if (!(flags & ((1U << DMA_FLAG_TCIF) | (1U << DMA_FLAG_TEIF))))
+        return;
+
+    pDMA->IFCR[stream >> 2] = flags << shift;
+    pDMA->S[stream].CR = 0;
+    REG_WRITE_BIT(pUSARTHandle->pUSARTx->CR3, USART_CR3_DMAT, 0);
+    pUSARTHandle->TxDMABusy = 0;
+
+    if (error && pUSARTHandle->Callback != NULL)
+        pUSARTHandle->Callback(pUSARTHandle, USART_EVENT_TX_ERROR);
+
+    if (RingBuffer_Count(&pUSARTHandle->TxBuffer) != 0)
+        REG_WRITE_BIT(pUSARTHandle->pUSARTx->CR1, USART_CR1_TXEIE, 1);
+    else if (!error)
+        REG_WRITE_BIT(pUSARTHandle->pUSARTx->CR1, USART_CR1_TCIE, 1);
+}
+
+/*********************************************************************
+ * @fn      		- USART_RxDMAIRQHandling
+ * @brief           - RX DMA stream interrupt (half/full transfer)
+ * @param[in]       - pUSARTHandle: USART handle
+ * @return          - None
+ * @Note            - Call from the stream's IRQ handler (USART2:
+ *                    DMA1_Stream5_IRQHandler), at the USART IRQ's
+ *                    priority. A transfer error stops reception.
+ *********************************************************************/
+void USART_RxDMAIRQHandling(USART_Handle_t *pUSARTHandle)
+{
+    DMA_RegDef_t *pDMA = pUSARTHandle->pRxDMA;
+    uint8_t stream = pUSARTHandle->RxStream;
+    uint32_t shift = DMA_FLAG_SHIFT(stream);
+    uint32_t flags = (pDMA->ISR[stream >> 2] >> shift) & DMA_STREAM_FLAGS;
+
+    if (!(flags & ((1U << DMA_FLAG_HTIF) | (1U << DMA_FLAG_TCIF) | (1U << DMA_FLAG_TEIF))))
+        return;
+
+    pDMA->IFCR[stream >> 2] = flags << shift;
+
+    if (flags & (1U << DMA_FLAG_TEIF))
+    {
+        USART_ReceiveDMAStop(pUSARTHandle);
+        if (pUSARTHandle->Callback != NULL)
+            pUSARTHandle->Callback(pUSARTHandle, USART_EVENT_RX_ERROR);
+        return;
+    }
+
+    if (usart_rx_update(pUSARTHandle) != 0 && pUSARTHandle->Callback != NULL)
+        pUSARTHandle->Callback(pUSARTHandle, USART_EVENT_RX_DATA);
+}
@@ -0,0 +1,282 @@
+/*
+ * timer_wheel.c
+ *
+ * Hierarchical timing wheel for large numbers of software timers
+ */
+
+#include <string.h>
+#include "timer_wheel.h"
+
+/*
+ * Tick count hand-over from the interrupt to the thread, as in
+ * ring_buffer.c: only the interrupt writes Ticks.
+ */
+#define TW_LOAD_ACQUIRE(p)		__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define TW_STORE_RELEASE(p, v)	__atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define TW_LOAD_OWN(p)			__atomic_load_n((p), __ATOMIC_RELAXED)
+
+/*********************************************************************
+ * @fn      		- tw_link
+ * @brief           - Push a timer onto a slot list
+ * @param[in]       - ppSlot: list head
+ * @param[in]       - pTimer: timer, not on any list
+ * @return          - None
+ *********************************************************************/
+static void tw_link(WheelTimer_t **ppSlot, WheelTimer_t *pTimer)
+{
+    WheelTimer_t *pNext = *ppSlot;
+
+    pTimer->pNext = pNext;
+    pTimer->ppPrev = ppSlot;
+    if (pNext != NULL)
+        pNext->ppPrev = &pTimer->pNext;
+    *ppSlot = pTimer;
+}
+
+/*********************************************************************
+ * @fn      		- tw_unlink
+ * @brief           - Take a timer off whatever list it is on
+ * @param[in]       - pTimer: linked timer
+ * @return          - None
+ * @Note            - O(1): ppPrev is the pointer that points at it,
+ *                    a slot head or the previous timer's pNext
+ *********************************************************************/
+static void tw_unlink(WheelTimer_t *pTimer)
+{
+    WheelTimer_t *pNext = pTimer->pNext;
+
+    *pTimer->ppPrev = pNext;
+    if (pNext != NULL)
+        pNext->ppPrev = pTimer->ppPrev;
+    pTimer->pNext = NULL;
+    pTimer->ppPrev = NULL;
+}
+
+/*********************************************************************
+ * @fn      		- tw_insert
+ * @brief           - Link a timer into the slot of its expiry tick
+ * @param[in]       - pTW: timer wheel
+ * @param[in]       - pTimer: timer with Expires set, not on any list
+ * @return          - None
+ * @Note            - Expires - Now selects the level: below 256 the
+ *                    level-0 slot of the tick itself, otherwise the
+ *                    level whose slots are just fine enough, found from
+ *                    the top set bit (CLZ on the Cortex-M4)
+ *********************************************************************/
+static void tw_insert(TimerWheel_t *pTW, WheelTimer_t *pTimer)
+{
+    uint32_t expires = pTimer->Expires;
+    uint32_t delta = expires - pTW->Now;
+
+    if (delta < TW_ROOT_SIZE)
+    {
+        tw_link(&pTW->pRoot[expires & TW_ROOT_MASK], pTimer);
+        return;
+    }
+
+    uint32_t level = (31U - (uint32_t)__builtin_clz(delta) - TW_ROOT_BITS) / TW_LEVEL_BITS;
+    uint32_t index = (expires >> (TW_ROOT_BITS + level * TW_LEVEL_BITS)) & TW_LEVEL_MASK;
+
+    tw_link(&pTW->pLevel[level][index], pTimer);
+}
+
+/*********************************************************************
+ * @fn      		- tw_cascade
+ * @brief           - Move the timers of one slot down to finer levels
+ * @param[in]       - pTW: timer wheel
+ * @param[in]       - Level: level of the slot
+ * @param[in]       - Index: slot
+ * @return          - Index, so the caller goes on to the next level
+ *                    only when this one wrapped to slot 0
+ * @Note            - Called when Now enters the slot's range, so every
+ *                    timer in it lands at least one level lower
+ *********************************************************************/
+static uint32_t tw_cascade(TimerWheel_t *pTW, uint32_t Level, uint32_t Index)
+{
+    WheelTimer_t *pTimer = pTW->pLevel[Level][Index];
+
+    pTW->pLevel[Level][Index] = NULL;
+    while (pTimer != NULL)
+    {
+        WheelTimer_t *pNext = pTimer->pNext;
+
+        tw_insert(pTW, pTimer);
+        pTW->Cascaded++;
+        pTimer = pNext;
+    }
+    return Index;
+}
+
+/*********************************************************************
+ * @fn      		- TimerWheel_Init
+ * @brief           - Empty a timer wheel and set its time to 0
+ * @param[in]       - pTW: timer wheel
+ * @return          - None
+ * @Note            - Not while the tick interrupt can run
+ *********************************************************************/
+void TimerWheel_Init(TimerWheel_t *pTW)
+{
+    memset(pTW, 0, sizeof(*pTW));
+}
+
+/*********************************************************************
+ * @fn      		- TimerWheel_Tick
+ * @brief           - Count one tick (interrupt)
+ * @param[in]       - pTW: timer wheel
+ * @return          - None
+ * @Note            - Call from the periodic interrupt (SysTick handler,
+ *                    TIM update callback). A few cycles: the wheel is
+ *                    advanced by TimerWheel_Process.
+ *********************************************************************/
+void TimerWheel_Tick(TimerWheel_t *pTW)
+{
+    TW_STORE_RELEASE(&pTW->Ticks, TW_LOAD_OWN(&pTW->Ticks) + 1U);
+}
+
+/*********************************************************************
+ * @fn      		- TimerWheel_Start
+ * @brief           - Start or restart a timer (thread)
+ * @param[in]       - pTW: timer wheel
+ * @param[in]       - pTimer: timer with Fn (and pContext) set
+ * @param[in]       - DelayTicks: ticks to the first expiry, 1 to
+ *                    TW_MAX_DELAY (0 is taken as 1)
+ * @param[in]       - PeriodTicks: reload after each expiry, 0 = one-shot
+ * @return          - 1 if started, 0 if the delay is out of range or
+ *                    Fn is NULL
+ * @Note            - O(1). The delay counts from the latest tick, even
+ *                    if TimerWheel_Process has not caught up with it;
+ *                    the first tick may be a partial one. A running
+ *                    timer is stopped first. May be called from an
+ *                    expiry callback.
+ *********************************************************************/
+uint8_t TimerWheel_Start(TimerWheel_t *pTW, WheelTimer_t *pTimer, uint32_t DelayTicks, uint32_t PeriodTicks)
+{
+    if (pTimer->Fn == NULL || DelayTicks > TW_MAX_DELAY || PeriodTicks > TW_MAX_DELAY)
+        return 0;
+
+    if (DelayTicks == 0)
+        DelayTicks = 1;
+
+    if (pTimer->ppPrev != NULL)
+        tw_unlink(pTimer);
+    else
+        pTW->Active++;
+
+    pTimer->Expires = TW_LOAD_ACQUIRE(&pTW->Ticks) + DelayTicks;
+    pTimer->PeriodTicks = PeriodTicks;
+    tw_insert(pTW, pTimer);
+    return 1;
+}
+
+/*********************************************************************
+ * @fn      		- TimerWheel_Stop
+ * @brief           - Stop a timer (thread)
+ * @param[in]       - pTW: timer wheel
+ * @param[in]       - pTimer: timer
+ * @return          - 1 if it was running, 0 if it had already expired
+ *                    or was never started
+ * @Note            - O(1). After it returns the callback will not run,
+ *                    also when called from another timer's callback
+ *                    for a timer that expires at the same tick.
+ *********************************************************************/
+uint8_t TimerWheel_Stop(TimerWheel_t *pTW, WheelTimer_t *pTimer)
+{
+    if (pTimer->ppPrev == NULL)
+        return 0;
+
+    tw_unlink(pTimer);
+    pTW->Active--;
+    return 1;
+}
+
+/*********************************************************************
+ * @fn      		- TimerWheel_IsActive
+ * @brief           - Is a timer running
+ * @param[in]       - pTimer: timer
+ * @return          - 1 between TimerWheel_Start and its (last) expiry
+ *                    or TimerWheel_Stop, else 0
+ *********************************************************************/
+uint8_t TimerWheel_IsActive(const WheelTimer_t *pTimer)
+{
+    return pTimer->ppPrev != NULL;
+}
+
+/*********************************************************************
+ * @fn      		- TimerWheel_Pending
+ * @brief           - Ticks counted but not yet processed (thread)
+ * @param[in]       - pTW: timer wheel
+ * @return          - Number of ticks TimerWheel_Process will advance
+ * @Note            - 0 means the main loop can sleep until the next
+ *                    interrupt
+ *********************************************************************/
+uint32_t TimerWheel_Pending(TimerWheel_t *pTW)
+{
+    return TW_LOAD_ACQUIRE(&pTW->Ticks) - pTW->Now;
+}
+
+/*********************************************************************
+ * @fn      		- TimerWheel_Process
+ * @brief           - Advance the wheel to the latest tick and run the
+ *                    callbacks of the timers that expired (thread)
+ * @param[in]       - pTW: timer wheel
+ * @return          - Number of callbacks run
+ * @Note            - Call from the main loop, at least once every few
+ *                    ticks; missed ticks are caught up one by one, each
+ *                    timer still firing at its own tick. Timers expiring
+ *                    at the same tick run in no particular order.
+ *                    Periodic timers are reloaded from their expiry
+ *                    tick (no drift) before their callback runs, which
+ *                    may stop or restart them. Not re-entrant: do not
+ *                    call from a callback.
+ *********************************************************************/
+uint32_t TimerWheel_Process(TimerWheel_t *pTW)
+{
+    uint32_t ticks = TW_LOAD_ACQUIRE(&pTW->Ticks);
+    uint32_t fired = 0;
+
+    while (pTW->Now != ticks)
+    {
+        uint32_t now = ++pTW->Now;
+        uint32_t index = now & TW_ROOT_MASK;
+
+        /* Level 0 wrapped: refill it from level 1, level 1 from 2 ... */
+        if (index == 0)
+        {
+            for (uint32_t level = 0; level < TW_LEVELS; level++)
+            {
+                uint32_t shift = TW_ROOT_BITS + level * TW_LEVEL_BITS;
+
+                if (tw_cascade(pTW, level, (now >> shift) & TW_LEVEL_MASK) != 0)
+                    break;
+            }
+        }
+
+        /* Move the slot to pExpiring, where a callback can still stop them */
+        pTW->pExpiring = pTW->pRoot[index];
+        pTW->pRoot[index] = NULL;
+        if (pTW->pExpiring != NULL)
+            pTW->pExpiring->ppPrev = &pTW->pExpiring;
+
+        while (pTW->pExpiring != NULL)
+        {
+            WheelTimer_t *pTimer = pTW->pExpiring;
+
+            tw_unlink(pTimer);
+            if (pTimer->PeriodTicks != 0)
+            {
+                pTimer->Expires += pTimer->PeriodTicks;
+                tw_insert(pTW, pTimer);
+            }
+            else
+            {
+                pTW->Active--;
+            }
+
+            pTimer->Fn(pTimer);
+            fired++;
+        }
+    }
+
+    pTW->Expired += fired;
+    return fired;
+}